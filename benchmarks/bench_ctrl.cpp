@@ -0,0 +1,178 @@
+//===-- bench_ctrl.cpp - Controller Benchmarks ----------------------------===//
+//
+// Copyright 2021 Michael Bolus
+// Copyright 2021 Georgia Institute of Technology
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file benchmarks single-step control (`Controller::Control`,
+/// `Controller::ControlOutputReference`) and switching between sub-systems
+/// (`SwitchedController::Switch`).
+///
+/// \brief Controller benchmarks
+//===----------------------------------------------------------------------===//
+
+#include "bench_util.h"
+
+namespace bench {
+
+const data_t kULb = -10;  ///< lower bound on control
+const data_t kUUb = 10;   ///< upper bound on control
+const size_t kNSys = 2;   ///< number of sub-systems switched between
+
+/// whether a control step of this system should be allocation-free
+template <typename System>
+bool IsAllocFree(const System& sys) {
+  (void)sys;
+  return true;
+}
+
+/// whether a control step of this system should be allocation-free (n.b.,
+/// the information-form covariance update uses LAPACK workspace)
+inline bool IsAllocFree(const lds::poisson::System& sys) {
+  return sys.cov_update() == lds::kCovUpdateCholesky;
+}
+
+/// constructs a controller of a random system with random feedback gains
+template <typename System, typename Controller>
+Controller RandomController(size_t n_u, size_t n_x, size_t n_y,
+                            size_t control_type,
+                            lds::CovUpdateType cov_update) {
+  System sys = RandomSystem<System>(n_u, n_x, n_y);
+  sys.set_cov_update(cov_update);
+  Controller controller(std::move(sys), kULb, kUUb, control_type);
+  controller.set_Kc(0.1 * Matrix(n_u, n_x, arma::fill::randn));
+  controller.set_Kc_inty(0.1 * Matrix(n_u, n_y, arma::fill::randn));
+  controller.set_x_ref(Vector(n_x, arma::fill::randn));
+  controller.set_u_ref(Vector(n_u, arma::fill::randu));
+  controller.set_y_ref(controller.sys().y() + 0.1);
+  return controller;
+}
+
+template <typename System, typename Controller,
+          lds::CovUpdateType cov_update>
+void BM_Control(benchmark::State& state) {
+  auto n_x = static_cast<size_t>(state.range(0));
+  auto n_u = static_cast<size_t>(state.range(1));
+  auto n_y = static_cast<size_t>(state.range(2));
+
+  Seed();
+  System sys_true = RandomSystem<System>(n_u, n_x, n_y);
+  std::vector<Vector> z =
+      SimulateMeasurements(sys_true, RandomInput(n_u), kNMeasurements);
+  auto controller = RandomController<System, Controller>(
+      n_u, n_x, n_y, lds::kControlTypeIntY, cov_update);
+
+  // warm up (sizing scratch, etc.), after which steps should not allocate
+  size_t t = 0;
+  for (; t < kNWarmUp; t++) {
+    controller.Control(z[t]);
+  }
+  lds::ResetAllocationCount();
+
+  for (auto _ : state) {
+    controller.Control(z[t]);
+    benchmark::ClobberMemory();
+    t = (t + 1) % kNMeasurements;
+  }
+  ReportAllocations(state, IsAllocFree(controller.sys()));
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_TEMPLATE(BM_Control, lds::gaussian::System, lds::gaussian::Controller,
+                   lds::kCovUpdateInverse)
+    ->Apply(StepGrid);
+BENCHMARK_TEMPLATE(BM_Control, lds::gaussian::System, lds::gaussian::Controller,
+                   lds::kCovUpdateCholesky)
+    ->Apply(StepGrid);
+BENCHMARK_TEMPLATE(BM_Control, lds::poisson::System, lds::poisson::Controller,
+                   lds::kCovUpdateInverse)
+    ->Apply(StepGrid);
+BENCHMARK_TEMPLATE(BM_Control, lds::poisson::System, lds::poisson::Controller,
+                   lds::kCovUpdateCholesky)
+    ->Apply(StepGrid);
+
+template <typename System, typename Controller,
+          lds::CovUpdateType cov_update>
+void BM_ControlOutputReference(benchmark::State& state) {
+  auto n_x = static_cast<size_t>(state.range(0));
+  auto n_u = static_cast<size_t>(state.range(1));
+  auto n_y = static_cast<size_t>(state.range(2));
+
+  Seed();
+  System sys_true = RandomSystem<System>(n_u, n_x, n_y);
+  std::vector<Vector> z =
+      SimulateMeasurements(sys_true, RandomInput(n_u), kNMeasurements);
+  auto controller = RandomController<System, Controller>(
+      n_u, n_x, n_y, lds::kControlTypeIntY, cov_update);
+
+  // warm up (sizing scratch, etc.), after which steps should not allocate
+  size_t t = 0;
+  for (; t < kNWarmUp; t++) {
+    controller.ControlOutputReference(z[t]);
+  }
+  lds::ResetAllocationCount();
+
+  for (auto _ : state) {
+    controller.ControlOutputReference(z[t]);
+    benchmark::ClobberMemory();
+    t = (t + 1) % kNMeasurements;
+  }
+  ReportAllocations(state, IsAllocFree(controller.sys()));
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_TEMPLATE(BM_ControlOutputReference, lds::gaussian::System,
+                   lds::gaussian::Controller, lds::kCovUpdateInverse)
+    ->Apply(StepGrid);
+BENCHMARK_TEMPLATE(BM_ControlOutputReference, lds::gaussian::System,
+                   lds::gaussian::Controller, lds::kCovUpdateCholesky)
+    ->Apply(StepGrid);
+BENCHMARK_TEMPLATE(BM_ControlOutputReference, lds::poisson::System,
+                   lds::poisson::Controller, lds::kCovUpdateInverse)
+    ->Apply(StepGrid);
+BENCHMARK_TEMPLATE(BM_ControlOutputReference, lds::poisson::System,
+                   lds::poisson::Controller, lds::kCovUpdateCholesky)
+    ->Apply(StepGrid);
+
+template <typename System, typename SwitchedController>
+void BM_Switch(benchmark::State& state) {
+  auto n_x = static_cast<size_t>(state.range(0));
+  auto n_u = static_cast<size_t>(state.range(1));
+  auto n_y = static_cast<size_t>(state.range(2));
+
+  Seed();
+  std::vector<System> systems;
+  for (size_t k = 0; k < kNSys; k++) {
+    systems.push_back(RandomSystem<System>(n_u, n_x, n_y));
+  }
+  SwitchedController controller(systems, kULb, kUUb);
+  controller.PrecomputeSetPoints();
+
+  size_t idx = 0;
+  for (auto _ : state) {
+    idx = (idx + 1) % kNSys;
+    controller.Switch(idx);
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_TEMPLATE(BM_Switch, lds::gaussian::System,
+                   lds::gaussian::SwitchedController)
+    ->Apply(StepGrid);
+BENCHMARK_TEMPLATE(BM_Switch, lds::poisson::System,
+                   lds::poisson::SwitchedController)
+    ->Apply(StepGrid);
+
+}  // namespace bench
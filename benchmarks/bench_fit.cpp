@@ -0,0 +1,99 @@
+//===-- bench_fit.cpp - Fitting Benchmarks --------------------------------===//
+//
+// Copyright 2021 Michael Bolus
+// Copyright 2021 Georgia Institute of Technology
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file benchmarks fitting of Gaussian- and Poisson-output models by
+/// expectation-maximization (`EM::Run`) and subspace identification
+/// (`SSID::Run`). n.b., only built with LDSCTRLEST_BUILD_FIT.
+///
+/// \brief Fitting benchmarks
+//===----------------------------------------------------------------------===//
+
+#include "bench_util.h"
+
+namespace bench {
+
+const size_t kNEMIter = 10;  ///< EM iterations per run (no early stopping)
+const size_t kNHankel = 25;  ///< size of block-hankel data matrix (SSID)
+
+template <typename System, typename FitEM>
+void BM_EM(benchmark::State& state) {
+  auto n_x = static_cast<size_t>(state.range(0));
+  auto n_y = static_cast<size_t>(state.range(1));
+  auto n_t = static_cast<size_t>(state.range(2));
+  auto n_trials = static_cast<size_t>(state.range(3));
+  size_t n_u = 1;
+
+  Seed();
+  System sys_true = RandomSystem<System>(n_u, n_x, n_y);
+  std::vector<Matrix> u;
+  std::vector<Matrix> z;
+  std::tie(u, z) = SimulateTrainingData(sys_true, n_t, n_trials);
+
+  for (auto _ : state) {
+    // n.b., EM takes ownership of the data
+    state.PauseTiming();
+    Seed();
+    FitEM em(n_x, kDt, lds::UniformMatrixList<lds::kMatFreeDim2>(u),
+             lds::UniformMatrixList<lds::kMatFreeDim2>(z));
+    // run a fixed number of iterations so runs are comparable
+    em.set_log_lik_tol(0);
+    state.ResumeTiming();
+
+    em.Run(true, true, true, true, true, kNEMIter, 0);
+  }
+  state.SetItemsProcessed(state.iterations() * n_t * n_trials);
+}
+BENCHMARK_TEMPLATE(BM_EM, lds::gaussian::System, lds::gaussian::FitEM)
+    ->Apply(FitGrid);
+BENCHMARK_TEMPLATE(BM_EM, lds::poisson::System, lds::poisson::FitEM)
+    ->Apply(FitGrid);
+
+template <typename System, typename FitSSID>
+void BM_SSID(benchmark::State& state) {
+  auto n_x = static_cast<size_t>(state.range(0));
+  auto n_y = static_cast<size_t>(state.range(1));
+  auto n_t = static_cast<size_t>(state.range(2));
+  auto n_trials = static_cast<size_t>(state.range(3));
+  size_t n_u = 1;
+
+  Seed();
+  System sys_true = RandomSystem<System>(n_u, n_x, n_y);
+  std::vector<Matrix> u;
+  std::vector<Matrix> z;
+  std::tie(u, z) = SimulateTrainingData(sys_true, n_t, n_trials);
+
+  for (auto _ : state) {
+    // n.b., SSID takes ownership of the data
+    state.PauseTiming();
+    FitSSID ssid(n_x, kNHankel, kDt,
+                 lds::UniformMatrixList<lds::kMatFreeDim2>(u),
+                 lds::UniformMatrixList<lds::kMatFreeDim2>(z));
+    state.ResumeTiming();
+
+    ssid.Run(lds::kSSIDMOESP);
+  }
+  state.SetItemsProcessed(state.iterations() * n_t * n_trials);
+}
+BENCHMARK_TEMPLATE(BM_SSID, lds::gaussian::System, lds::gaussian::FitSSID)
+    ->Apply(FitGrid);
+BENCHMARK_TEMPLATE(BM_SSID, lds::poisson::System, lds::poisson::FitSSID)
+    ->Apply(FitGrid);
+
+}  // namespace bench
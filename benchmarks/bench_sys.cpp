@@ -0,0 +1,54 @@
+//===-- bench_sys.cpp - System Benchmarks ---------------------------------===//
+//
+// Copyright 2021 Michael Bolus
+// Copyright 2021 Georgia Institute of Technology
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file benchmarks single-step state estimation (`System::Filter`) of
+/// Gaussian- and Poisson-output systems.
+///
+/// \brief System benchmarks
+//===----------------------------------------------------------------------===//
+
+#include "bench_util.h"
+
+namespace bench {
+
+template <typename System>
+void BM_Filter(benchmark::State& state) {
+  auto n_x = static_cast<size_t>(state.range(0));
+  auto n_u = static_cast<size_t>(state.range(1));
+  auto n_y = static_cast<size_t>(state.range(2));
+
+  Seed();
+  System sys_true = RandomSystem<System>(n_u, n_x, n_y);
+  System sys(sys_true);
+  Vector u = RandomInput(n_u);
+  std::vector<Vector> z = SimulateMeasurements(sys_true, u, kNMeasurements);
+
+  size_t t = 0;
+  for (auto _ : state) {
+    sys.Filter(u, z[t]);
+    benchmark::ClobberMemory();
+    t = (t + 1) % kNMeasurements;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_TEMPLATE(BM_Filter, lds::gaussian::System)->Apply(StepGrid);
+BENCHMARK_TEMPLATE(BM_Filter, lds::poisson::System)->Apply(StepGrid);
+
+}  // namespace bench
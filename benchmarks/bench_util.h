@@ -0,0 +1,188 @@
+//===-- bench_util.h - Benchmark Utilities ---------------------*- C++ -*-===//
+//
+// Copyright 2021 Michael Bolus
+// Copyright 2021 Georgia Institute of Technology
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file defines utilities shared by the benchmarks (`ldsCtrlEst_bench`):
+/// randomly-drawn (but reproducible) stable models, simulated data, and the
+/// grids of problem sizes benchmarked.
+///
+/// \brief benchmark utilities
+//===----------------------------------------------------------------------===//
+
+#ifndef LDSCTRLEST_BENCH_UTIL_H
+#define LDSCTRLEST_BENCH_UTIL_H
+
+#include <benchmark/benchmark.h>
+
+#include <ldsCtrlEst>
+
+namespace bench {
+
+using lds::data_t;
+using lds::Matrix;
+using lds::Vector;
+
+const data_t kDt = 1e-3;             ///< sample period
+const size_t kNMeasurements = 1000;  ///< measurements cycled through per step
+const size_t kSeed = 0;              ///< seed of random number generators
+const size_t kNWarmUp = 10;  ///< steps taken before allocations are counted
+
+/// Seeds the random number generators (so that benchmarks are reproducible)
+inline void Seed() {
+  arma::arma_rng::set_seed(kSeed);
+  lds::poisson::rng.seed(kSeed);
+}
+
+/// Draws a random state matrix with spectral norm (>= spectral radius) 0.95
+inline Matrix StableA(size_t n_x) {
+  Matrix a(n_x, n_x, arma::fill::randn);
+  return a * (0.95 / arma::norm(a, 2));
+}
+
+/**
+ * Draws a random, stable model. The output matrix is scaled so that the
+ * outputs of a Poisson system stay within a reasonable range of rates.
+ *
+ * @brief      draws a random system
+ *
+ * @param      n_u   number of inputs
+ * @param      n_x   number of states
+ * @param      n_y   number of outputs
+ *
+ * @tparam     System  system type
+ *
+ * @return     system
+ */
+template <typename System>
+System RandomSystem(size_t n_u, size_t n_x, size_t n_y) {
+  System sys(n_u, n_x, n_y, kDt);
+  sys.set_A(StableA(n_x));
+  sys.set_B(0.1 * Matrix(n_x, n_u, arma::fill::randn));
+  sys.set_C(Matrix(n_y, n_x, arma::fill::randn) / std::sqrt(n_x));
+  sys.set_d(Vector(n_y).fill(std::log(20 * kDt)));  // ~20 events/s (Poisson)
+  sys.Reset();
+  return sys;
+}
+
+/// Draws a random input
+inline Vector RandomInput(size_t n_u) {
+  return Vector(n_u, arma::fill::randu);
+}
+
+/**
+ * @brief      simulates measurements of a system
+ *
+ * @param      sys   system (simulated in place)
+ * @param      u     input
+ * @param      n_t   number of time steps
+ *
+ * @tparam     System  system type
+ *
+ * @return     measurements
+ */
+template <typename System>
+std::vector<Vector> SimulateMeasurements(System& sys, const Vector& u,
+                                         size_t n_t) {
+  std::vector<Vector> z(n_t);
+  for (auto& z_t : z) {
+    z_t = sys.Simulate(u);
+  }
+  return z;
+}
+
+/**
+ * @brief      simulates training data (random inputs) for fitting
+ *
+ * @param      sys       system (simulated in place)
+ * @param      n_t       number of time steps per trial
+ * @param      n_trials  number of trials
+ *
+ * @tparam     System  system type
+ *
+ * @return     tuple(input data, measurement data)
+ */
+template <typename System>
+std::tuple<std::vector<Matrix>, std::vector<Matrix>> SimulateTrainingData(
+    System& sys, size_t n_t, size_t n_trials) {
+  std::vector<Matrix> u(n_trials, Matrix(sys.n_u(), n_t, arma::fill::zeros));
+  std::vector<Matrix> z(n_trials, Matrix(sys.n_y(), n_t, arma::fill::zeros));
+  for (size_t trial = 0; trial < n_trials; trial++) {
+    sys.Reset();
+    u[trial].randu();
+    for (size_t t = 0; t < n_t; t++) {
+      z[trial].col(t) = sys.Simulate(u[trial].col(t));
+    }
+  }
+  return std::make_tuple(std::move(u), std::move(z));
+}
+
+/**
+ * Reports heap allocations per iteration since the last
+ * `lds::ResetAllocationCount()` as the counter `allocs_per_step`. When built
+ * with `LDSCTRLEST_COUNT_ALLOCS`, a benchmark that is required to be
+ * allocation-free fails if anything was allocated.
+ *
+ * @brief      reports (and checks) allocations per step
+ *
+ * @param      state             benchmark state
+ * @param      do_require_none   whether any allocation is an error
+ */
+inline void ReportAllocations(benchmark::State& state, bool do_require_none) {
+  std::size_t n_allocs = lds::AllocationCount();
+  state.counters["allocs_per_step"] = benchmark::Counter(
+      static_cast<double>(n_allocs), benchmark::Counter::kAvgIterations);
+#ifdef LDSCTRLEST_COUNT_ALLOCS
+  if (do_require_none && n_allocs > 0) {
+    state.SkipWithError("step allocated on the heap after warm-up");
+  }
+#else
+  (void)do_require_none;
+#endif
+}
+
+/// Grid of (n_x, n_u, n_y) for the per-step (online) benchmarks
+inline void StepGrid(benchmark::internal::Benchmark* b) {
+  b->ArgNames({"n_x", "n_u", "n_y"});
+  for (int64_t n_x : {1, 4, 16, 64}) {
+    for (int64_t n_u : {1, 4}) {
+      for (int64_t n_y : {1, 8, 64}) {
+        b->Args({n_x, n_u, n_y});
+      }
+    }
+  }
+}
+
+/// Grid of (n_x, n_y, n_t, n_trials) for the fitting benchmarks (n_u = 1)
+inline void FitGrid(benchmark::internal::Benchmark* b) {
+  b->ArgNames({"n_x", "n_y", "n_t", "n_trials"});
+  for (int64_t n_x : {2, 8}) {
+    for (int64_t n_y : {4, 16}) {
+      for (int64_t n_t : {1000, 10000}) {
+        for (int64_t n_trials : {1, 10}) {
+          b->Args({n_x, n_y, n_t, n_trials});
+        }
+      }
+    }
+  }
+  b->Unit(benchmark::kMillisecond);
+}
+
+}  // namespace bench
+
+#endif
@@ -0,0 +1,8 @@
+# threads (used for parallel execution within the library, e.g. lds::ThreadPool)
+set(THREADS_PREFER_PTHREAD_FLAG ON)
+find_package(Threads REQUIRED)
+
+# n.b., this is a link flag (e.g., `-pthread`), which is passed through as is
+list(APPEND PROJECT_REQUIRED_LIBRARIES_ABSOLUTE_NAME ${CMAKE_THREAD_LIBS_INIT})
+
+message(STATUS "CMAKE_THREAD_LIBS_INIT = ${CMAKE_THREAD_LIBS_INIT}")
@@ -33,18 +33,26 @@
 // #include <ldsCtrlEst>
 // #endif
 
+// n.b., must precede armadillo (optionally hooks its memory allocation)
+#include "lds_alloc_count.h"
+
 #include <armadillo>
 
 /// Linear Dynamical Systems (LDS) namespace
 namespace lds {
-/// Type of all data in library. If need 32b, change `double` to `float`. This
-/// could be potentially useful for large scale problems where there are memory
-/// constraints.
-using data_t = double;  // may change to float (but breaks mex functions)
+/// Type of all data in library. Single precision (`float`) may be selected at
+/// build time with `LDSCTRLEST_SINGLE_PRECISION`, which halves the memory
+/// bandwidth (and doubles the SIMD width) of large problems.
+#ifdef LDSCTRLEST_SINGLE_PRECISION
+using data_t = float;
+#else
+using data_t = double;
+#endif
 using Vector = arma::Col<data_t>;
 using Matrix = arma::Mat<data_t>;
 using Cube = arma::Cube<data_t>;
 using View = arma::subview<data_t>;
+using SpMatrix = arma::SpMat<data_t>;
 
 /// provides fill types for constructing new armadillo vectors, matrices
 namespace fill = arma::fill;
@@ -98,19 +106,26 @@ enum SSIDWt {
   kSSIDCVA     ///< CVA "Canonical Variate Analysis"
 };
 
+/// Methods for updating the covariance of the state estimate during filtering
+///
+/// Reference:
+///
+/// Bucy, Joseph. 1968. Filtering for Stochastic Processes with Applications to
+/// Guidance.
+///
+/// \brief covariance update methods
+enum CovUpdateType {
+  kCovUpdateInverse,  ///< explicit (pseudo-)inverse of innovation covariance
+  kCovUpdateCholesky  ///< Cholesky factorization + triangular solves, followed
+                      ///< by Joseph-form update (keeps covariance sym. PSD)
+};
+
 enum MatrixListFreeDim {
   kMatFreeDimNone,  ///< neither dim free to be hetero in mat list
   kMatFreeDim1,     ///< allow 1st dim of mats in list to be hetero
   kMatFreeDim2      ///< allow 2nd dim of mats in list to be hetero
 };
 
-// TODO(mfbolus): for SwitchedController, may want systems to have differing
-// numbers of states. Use this enum as template parameter?
-// enum SystemListFreeDim {
-//   kSysFreeDimNone,
-//   kSysFreeDimX  ///< allow state dim (x) of systems in list to be hetero
-// };
-
 // place hard limits on contents of vecors/mats
 void Limit(std::vector<data_t>& x, data_t lb, data_t ub);
 void Limit(Vector& x, data_t lb, data_t ub);
@@ -156,6 +171,102 @@ void ForceSymPD(Matrix& X);
  */
 void ForceSymMinEig(Matrix& X, data_t eig_min = 0);
 
+/**
+ * Stores the upper triangle of a symmetric matrix column by column (as LAPACK
+ * packed storage, uplo = 'U'), i.e., n(n+1)/2 elements. Each off-diagonal
+ * element is the mean of it and its transpose, such that a matrix that is
+ * unpacked again is symmetric by construction.
+ *
+ * @brief      packs symmetric matrix (upper triangle)
+ *
+ * @param      X       square matrix (n x n)
+ * @param      packed  [out] packed matrix (n(n+1)/2 elements)
+ */
+void PackSym(const Matrix& X, data_t* packed);
+
+/**
+ * @brief      unpacks symmetric matrix (see PackSym)
+ *
+ * @param      packed  packed matrix (n(n+1)/2 elements)
+ * @param      X       [out] symmetric matrix (n x n, sized beforehand)
+ */
+void UnpackSym(const data_t* packed, Matrix& X);
+
+/// Workspace of JosephUpdate (sized on first use), so that repeated updates
+/// of the same dimensions do not allocate
+struct JosephWork {
+  Matrix pct;     ///< P*C' (n_x x n_y), then K*R
+  Matrix s;       ///< innovation covariance (n_y x n_y), then its factor
+  Matrix i_kc;    ///< I-K*C (n_x x n_x)
+  Matrix i_kc_p;  ///< (I-K*C)*P (n_x x n_x)
+};
+
+/**
+ * Kalman update of the state estimate covariance that solves for the gain by
+ * Cholesky factorization of the innovation covariance (S = C*P*C' + R) and
+ * triangular solves rather than inverting S explicitly. The covariance is then
+ * updated in Joseph form, P = (I-K*C)*P*(I-K*C)' + K*R*K', which remains
+ * symmetric positive semi-definite in finite precision.
+ *
+ * @brief      Cholesky/Joseph-form Kalman covariance update
+ *
+ * @param      P     [in] predicted covariance; [out] updated covariance
+ * @param      K     [out] Kalman gain
+ * @param      C     output matrix
+ * @param      R     output noise covariance
+ */
+void JosephUpdate(Matrix& P, Matrix& K, const Matrix& C, const Matrix& R);
+
+/// Cholesky/Joseph-form Kalman covariance update (see above) in workspace
+void JosephUpdate(Matrix& P, Matrix& K, const Matrix& C, const Matrix& R,
+                  JosephWork& work);
+
+/**
+ * Cholesky/Joseph-form Kalman covariance update (see above) for diagonal
+ * output noise covariance, R = diag(r), which is never formed explicitly.
+ *
+ * @brief      Cholesky/Joseph-form update with diagonal noise covariance
+ *
+ * @param      P     [in] predicted covariance; [out] updated covariance
+ * @param      K     [out] Kalman gain
+ * @param      C     output matrix
+ * @param      r     diagonal of output noise covariance
+ */
+void JosephUpdate(Matrix& P, Matrix& K, const Matrix& C, const Vector& r);
+
+/// Cholesky/Joseph-form update with diagonal noise covariance (see above) in
+/// workspace
+void JosephUpdate(Matrix& P, Matrix& K, const Matrix& C, const Vector& r,
+                  JosephWork& work);
+
+/**
+ * Updates the state estimate covariance given output information that is
+ * diagonal in the output space, P = inv(inv(P) + C'*diag(w)*C) (e.g., the
+ * point-process filter, where w is the output rate). The cheaper of two
+ * equivalent forms is chosen every call: when fewer outputs carry information
+ * (w > 0) than there are states, by the Woodbury identity,
+ * P = P - P*C'*inv(diag(1/w) + C*P*C')*C*P, which factorizes only an
+ * n_active-by-n_active matrix; otherwise, in information form, which inverts
+ * two n_x-by-n_x matrices. Outputs without information (w = 0) are skipped in
+ * either case.
+ *
+ * @brief      covariance update given diagonal output information
+ *
+ * @param      P     [in] predicted covariance; [out] updated covariance
+ * @param      C     output matrix
+ * @param      w     output information (diagonal)
+ */
+void InfoUpdate(Matrix& P, const Matrix& C, const Vector& w);
+
+/**
+ * @brief      covariance update given diagonal output information (sparse C)
+ *
+ * @param      P     [in] predicted covariance; [out] updated covariance
+ * @param      C     output matrix (sparse)
+ * @param      w     output information (diagonal)
+ */
+void InfoUpdate(Matrix& P, const SpMatrix& C, const Vector& w);
+
 /**
  * @brief      LQ decomposition
  *
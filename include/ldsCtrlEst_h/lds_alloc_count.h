@@ -0,0 +1,66 @@
+//===-- ldsCtrlEst_h/lds_alloc_count.h - Allocation Hook --------*- C++ -*-===//
+//
+// Copyright 2021 Michael Bolus
+// Copyright 2021 Georgia Institute of Technology
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file declares a hook for counting the heap allocations made by
+/// Armadillo. It is used to verify that the per-step estimation/control path
+/// (e.g., `lds::Controller::Control`) is allocation-free after warm-up.
+///
+/// Counting is only active when the library (and any code including it) is
+/// compiled with `LDSCTRLEST_COUNT_ALLOCS` defined (cmake option of the same
+/// name). In that case, this header must be included *before* `<armadillo>`,
+/// which `lds.h` and the `ldsCtrlEst` preamble take care of.
+///
+/// \brief Armadillo allocation-counting hook
+//===----------------------------------------------------------------------===//
+
+#ifndef LDSCTRLEST_LDS_ALLOC_COUNT_H
+#define LDSCTRLEST_LDS_ALLOC_COUNT_H
+
+#include <cstddef>
+
+namespace lds {
+
+/**
+ * @brief      Gets number of Armadillo heap allocations since last reset
+ *
+ * @return     number of allocations (always 0 unless compiled with
+ *             LDSCTRLEST_COUNT_ALLOCS)
+ */
+std::size_t AllocationCount();
+
+/// Resets Armadillo heap allocation count to zero
+void ResetAllocationCount();
+
+/// Counting replacement for Armadillo's memory acquisition
+void* CountedAcquire(std::size_t n_bytes);
+
+/// Counting replacement for Armadillo's memory release
+void CountedRelease(void* mem);
+
+}  // namespace lds
+
+#ifdef LDSCTRLEST_COUNT_ALLOCS
+#ifndef ARMA_ALIEN_MEM_ALLOC_FUNCTION
+#define ARMA_ALIEN_MEM_ALLOC_FUNCTION lds::CountedAcquire
+#define ARMA_ALIEN_MEM_FREE_FUNCTION lds::CountedRelease
+#endif
+#endif
+
+#endif
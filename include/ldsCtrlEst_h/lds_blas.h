@@ -0,0 +1,153 @@
+//===-- ldsCtrlEst_h/lds_blas.h - BLAS Threading Policy ---------*- C++ -*-===//
+//
+// Copyright 2021 Michael Bolus
+// Copyright 2021 Georgia Institute of Technology
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file declares the policy by which the library sets the number of
+/// threads used by the BLAS/LAPACK it is linked against (e.g., OpenBLAS), so
+/// that BLAS does not spin up threads for the small products of the real-time
+/// path, nor for work the library already runs on its own ThreadPool, while
+/// large fitting kernels (SSID, EM) may still be multithreaded.
+///
+/// The policy is opt-in: the library leaves the BLAS thread count alone until
+/// the application calls InitBlasPolicy (or SetBlasPolicy), as the count is
+/// shared with the rest of the host process (e.g., MATLAB). Once enabled, the
+/// number of threads BLAS rests at is that of kBlasWorkRealTime. Fitting
+/// entry points (e.g., SSID::Run, EM::Run) raise it to that of kBlasWorkFit
+/// for their duration, and ThreadPool::ParallelFor lowers it to that of
+/// kBlasWorkParallel for its duration (within which the scopes of fitting
+/// entry points have no effect).
+///
+/// With MKL, scopes set the thread count of the calling thread only
+/// (mkl_set_num_threads_local), so a fit on a background thread leaves the
+/// thread running the control loop at kBlasWorkRealTime.
+///
+/// n.b., the OpenBLAS thread count is process-wide. Scopes are then counted
+/// across threads: the count is that of kBlasWorkParallel while any parallel
+/// scope is active, else that of kBlasWorkFit while any fit is active, and it
+/// returns to kBlasWorkRealTime only once the last scope exits. A fit in the
+/// background (e.g., refitting while controlling, then swapping models)
+/// therefore also raises the count seen by the real-time thread; set
+/// kBlasWorkFit to 1 if that thread must not be multithreaded.
+///
+/// \brief BLAS threading policy
+//===----------------------------------------------------------------------===//
+
+#ifndef LDSCTRLEST_LDS_BLAS_H
+#define LDSCTRLEST_LDS_BLAS_H
+
+#include <cstddef>
+
+namespace lds {
+
+/// BLAS/LAPACK implementation whose threading can be controlled
+enum BlasBackend : std::size_t {
+  kBlasUnknown,   ///< unknown (thread count is left alone)
+  kBlasOpenBLAS,  ///< OpenBLAS
+  kBlasMKL,       ///< Intel MKL
+};
+
+/// Kinds of work with their own BLAS thread count
+enum BlasWork : std::size_t {
+  kBlasWorkRealTime,  ///< estimation/control step (default: 1 thread)
+  kBlasWorkFit,       ///< fitting kernels, e.g., SSID, EM (default: 0)
+  kBlasWorkParallel,  ///< within ThreadPool::ParallelFor (default: 1)
+  kNumBlasWork,       ///< number of kinds of work
+};
+
+/**
+ * Detected at build time when the library is statically linked against
+ * OpenBLAS (or MKL), otherwise at run time where the platform supports weak
+ * symbols (e.g., Linux).
+ *
+ * @brief      gets BLAS/LAPACK implementation whose threading can be
+ *             controlled
+ *
+ * @return     BLAS/LAPACK implementation
+ */
+BlasBackend BlasBackendLinked();
+
+/**
+ * @brief      gets number of threads BLAS currently uses
+ *
+ * @return     number of threads (0 = unknown, see BlasBackendLinked)
+ */
+std::size_t BlasThreads();
+
+/**
+ * @brief      gets number of BLAS threads for a kind of work
+ *
+ * @param      work  kind of work
+ *
+ * @return     number of threads (0 = hardware concurrency)
+ */
+std::size_t BlasPolicy(BlasWork work);
+
+/**
+ * Enables the policy (see InitBlasPolicy). The process-wide count is
+ * re-applied immediately, so the new count takes effect for scopes already
+ * active.
+ *
+ * @brief      sets number of BLAS threads for a kind of work
+ *
+ * @param      work       kind of work
+ * @param      n_threads  number of threads (0 = hardware concurrency)
+ */
+void SetBlasPolicy(BlasWork work, std::size_t n_threads);
+
+/// enables the policy, applying the resting (kBlasWorkRealTime) thread count
+/// (n.b., until then, the library does not change the BLAS thread count)
+void InitBlasPolicy();
+
+/**
+ * @brief      gets whether the policy is enabled
+ *
+ * @return     whether InitBlasPolicy (or SetBlasPolicy) has been called with
+ *             a known BLAS backend linked
+ */
+bool IsBlasPolicyEnabled();
+
+/// Scope within which BLAS uses the number of threads of a kind of work
+class BlasThreadScope {
+ public:
+  /**
+   * Within a scope of kBlasWorkParallel (on any thread), further scopes leave
+   * the thread count alone, as BLAS must not multithread underneath the
+   * library's own threads. Scopes do nothing unless the policy is enabled.
+   *
+   * @brief      Constructs a new BlasThreadScope (applying thread count).
+   *
+   * @param      work  kind of work
+   */
+  explicit BlasThreadScope(BlasWork work);
+
+  /// Restores thread count (see above)
+  ~BlasThreadScope();
+
+  BlasThreadScope(const BlasThreadScope&) = delete;
+  BlasThreadScope& operator=(const BlasThreadScope&) = delete;
+
+ private:
+  BlasWork work_;                 ///< kind of work
+  std::size_t n_threads_prev_{};  ///< thread count before scope (MKL only)
+  bool is_applied_{};             ///< whether scope set the thread count
+};
+
+}  // namespace lds
+
+#endif
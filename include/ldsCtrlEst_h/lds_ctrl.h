@@ -31,9 +31,95 @@
 #include "lds.h"
 // system type
 #include "lds_sys.h"
+// LQR design
+#include "lds_lqr.h"
+// state monitor
+#include "lds_state_monitor.h"
+// model hot-swap
+#include "lds_model_swap.h"
+
+#include <memory>
+#include <vector>
 
 namespace lds {
 
+/**
+ * Sub-system(s) of a controller, one of which is active (i.e., estimated and
+ * controlled). Activating another sub-system only changes an index and
+ * pointer, so that the (many) matrices of the sub-systems are never copied or
+ * moved on switching. Copies point into their own sub-systems.
+ *
+ * @brief      sub-system(s) of a controller, one of which is active
+ *
+ * @tparam     System  type derived from lds::System
+ */
+template <typename System>
+class ActiveSystem {
+ public:
+  /// Constructs a new ActiveSystem (single, default sub-system)
+  ActiveSystem() : list_(1), active_(list_.data()) {}
+  /// Constructs a new ActiveSystem (single sub-system)
+  explicit ActiveSystem(const System& sys)
+      : list_(1, sys), active_(list_.data()) {}
+  /// Constructs a new ActiveSystem (single sub-system, moving)
+  explicit ActiveSystem(System&& sys) : list_(1) {
+    list_[0] = std::move(sys);
+    active_ = list_.data();
+  }
+  /// Constructs a new ActiveSystem (first of sub-systems active, moving)
+  explicit ActiveSystem(std::vector<System>&& list) : list_(std::move(list)) {
+    if (list_.empty()) {
+      throw std::runtime_error("ActiveSystem requires at least one system");
+    }
+    active_ = list_.data();
+  }
+  ActiveSystem(const ActiveSystem& that)
+      : list_(that.list_), idx_(that.idx_), active_(&list_[idx_]) {}
+  ActiveSystem(ActiveSystem&& that) noexcept
+      : list_(std::move(that.list_)), idx_(that.idx_), active_(that.active_) {
+    that.active_ = nullptr;
+  }
+  ActiveSystem& operator=(ActiveSystem that) noexcept {
+    // n.b., swapping vectors exchanges buffers, so elements do not move
+    list_.swap(that.list_);
+    idx_ = that.idx_;
+    active_ = &list_[idx_];
+    return *this;
+  }
+
+  /// Assigns active sub-system
+  ActiveSystem& operator=(const System& sys) {
+    *active_ = sys;
+    return *this;
+  }
+
+  /// Activates sub-system `idx`
+  void Activate(size_t idx) {
+    active_ = &list_.at(idx);
+    idx_ = idx;
+  }
+
+  /// Get index of active sub-system
+  size_t idx() const { return idx_; };
+  /// Get number of sub-systems
+  size_t size() const { return list_.size(); };
+
+  System* operator->() { return active_; };
+  const System* operator->() const { return active_; };
+  System& operator*() { return *active_; };
+  const System& operator*() const { return *active_; };
+
+  /// Get sub-system `idx`
+  System& operator[](size_t idx) { return list_[idx]; };
+  /// Get sub-system `idx`
+  const System& operator[](size_t idx) const { return list_[idx]; };
+
+ private:
+  std::vector<System> list_;  ///< sub-systems
+  size_t idx_{};              ///< index of active sub-system
+  System* active_{};          ///< active sub-system
+};
+
 template <typename System>
 class Controller {
   static_assert(std::is_base_of<lds::System, System>::value,
@@ -139,7 +225,7 @@ class Controller {
                                        bool do_reset_at_control_onset = true);
 
   // get methods:
-  const System& sys() const { return sys_; };
+  const System& sys() const { return *sys_; };
   /// Get state feedback controller gain
   const Matrix& Kc() const { return Kc_; };
   /// Get integral controller gain
@@ -160,11 +246,13 @@ class Controller {
   // set methods
   /// Set system
   void set_sys(const System& sys) {
-    bool does_match = sys_.n_u() == sys.n_u();
-    does_match = does_match && (sys_.n_x() == sys.n_x());
-    does_match = does_match && (sys_.n_y() == sys.n_y());
+    bool does_match = sys_->n_u() == sys.n_u();
+    does_match = does_match && (sys_->n_x() == sys.n_x());
+    does_match = does_match && (sys_->n_y() == sys.n_y());
     if (does_match) {
       sys_ = sys;
+      InvalidateSetPoint();
+      InvalidateDelayPrediction();
     } else {
       throw std::runtime_error(
           "new system argument to `set_sys` does not match dimensionality of "
@@ -178,7 +266,7 @@ class Controller {
   /// Set reference state (x_ref)
   void set_x_ref(const Vector& x_ref) {
     Reassign(x_ref_, x_ref);
-    cx_ref_ = sys_.C() * x_ref_;
+    cx_ref_ = sys_->C() * x_ref_;
   };
 
   // y_ref needs to be handled differently depending on output fn.
@@ -192,10 +280,36 @@ class Controller {
   void set_Kc_inty(const Matrix& Kc_inty) { Reassign(Kc_inty_, Kc_inty); };
   /// Set input controller gain
   void set_Kc_u(const Matrix& Kc_u) { Reassign(Kc_u_, Kc_u); };
+  /// Set controller gains (e.g., designed by lds::DesignLQR)
+  void set_gains(const LQRGains& gains);
+
+  /**
+   * Designs the controller gains by LQR of the current model (see
+   * lds::DesignLQR), given the control type. n.b., to redesign without
+   * blocking the control loop (e.g., after a model update), call
+   * lds::DesignLQR in another thread and pass the result to set_gains.
+   *
+   * @brief      designs controller gains by LQR
+   *
+   * @param      q_y     output cost (n_y x n_y)
+   * @param      q_inty  integrated output error cost (n_y x n_y)
+   * @param      r       input cost (n_u x n_u)
+   */
+  void DesignLQR(const Matrix& q_y, const Matrix& q_inty, const Matrix& r);
+
+  /**
+   * @brief      designs controller gains by LQR with relative costs
+   *
+   * @param      q_inty_over_q_y  [optional] relative cost of integrated
+   *                              output error vs. output error
+   * @param      r_over_q_y       [optional] relative cost of input vs. output
+   *                              error
+   */
+  void DesignLQR(data_t q_inty_over_q_y = 1, data_t r_over_q_y = 1);
   /// Set time constant of anti-integral-windup
   void set_tau_awu(data_t tau) {
     tau_awu_ = tau;
-    k_awu_ = sys_.dt() / tau_awu_;
+    k_awu_ = sys_->dt() / tau_awu_;
   };
 
   /**
@@ -223,9 +337,129 @@ class Controller {
    */
   void set_u_ub(data_t u_ub) { u_ub_ = u_ub; };
 
+  /**
+   * When controlling to an output reference (ControlOutputReference), the
+   * steady-state set point (u_ref, x_ref) is only recalculated on every `n`-th
+   * step and held in between. Combine with System::set_recurse_Ke_period to
+   * decimate the slowly-varying parts of the step.
+   *
+   * @brief      sets number of control steps per set-point calculation
+   *
+   * @param      n     number of steps (1 = every step)
+   */
+  void set_setpoint_period(size_t n) {
+    if (n == 0) {
+      throw std::runtime_error(
+          "period of set-point calculation must be at least one step");
+    }
+    setpoint_period_ = n;
+    n_until_setpoint_ = 0;
+  };
+  /// gets number of control steps per set-point calculation
+  size_t setpoint_period() const { return setpoint_period_; };
+
+  /**
+   * Solves the steady-state set-point problem (see ControlOutputReference) up
+   * front, rather than on first use, e.g., so that it is part of a snapshot.
+   *
+   * @brief      precomputes set-point solution
+   */
+  void PrecomputeSetPoint() { CalcSetPointSolution(); };
+
+  /**
+   * Compensates for `n` samples of latency between the calculation of a
+   * control signal and its effect on the system (e.g., of actuation and
+   * acquisition). Each control signal is held in a ring of the last `n`
+   * signals, so that the state estimate is updated with the input that
+   * actually drove the system, and feedback acts on the state predicted `n`
+   * steps ahead through the inputs still in flight,
+   *
+   * x_pred = A^n x + sum_j A^(n-1-j) (B (g % u_j) + m),
+   *
+   * rather than on the current estimate. The powers of A are only calculated
+   * again when A, B, or g change (see System::revision), so the added cost per
+   * step is O(n n_x n_u + n_x^2).
+   *
+   * n.b., error integrated for integral action (kControlTypeIntY) remains that
+   * of the current estimate.
+   *
+   * @brief      sets number of steps of input delay to compensate
+   *
+   * @param      n     number of steps (0 = none)
+   */
+  void set_input_delay(size_t n) {
+    input_delay_ = n;
+    u_delay_ = Matrix(sys_->n_u(), n, fill::zeros);
+    delay_head_ = 0;
+    x_pred_ = Vector(sys_->n_x(), fill::zeros);
+    InvalidateDelayPrediction();
+  };
+  /// gets number of steps of input delay compensated
+  size_t input_delay() const { return input_delay_; };
+  /// gets state on which feedback acts (predicted input_delay steps ahead)
+  const Vector& x_pred() const { return input_delay_ ? x_pred_ : sys_->x(); };
+
+  /**
+   * Once set, the state selected by the monitor's fields is published to it
+   * at the end of each step (Control, ControlOutputReference), so that other
+   * threads (e.g., GUI, logging) can read a consistent copy of it without
+   * blocking the thread stepping the controller (see StateMonitor::TryRead).
+   *
+   * n.b., copies of the controller publish to the same monitor.
+   *
+   * @brief      sets monitor that state is published to at each step
+   *
+   * @param      monitor  monitor (null = none)
+   */
+  void set_monitor(std::shared_ptr<StateMonitor> monitor) {
+    if (monitor &&
+        ((monitor->n_u() != sys_->n_u()) || (monitor->n_x() != sys_->n_x()) ||
+         (monitor->n_y() != sys_->n_y()))) {
+      throw std::runtime_error(
+          "dimensionality of monitor does not match that of controller");
+    }
+    monitor_ = std::move(monitor);
+  };
+  /// gets monitor that state is published to at each step (null = none)
+  const std::shared_ptr<StateMonitor>& monitor() const { return monitor_; };
+
+  /**
+   * Once set, the latest model published to the slot (e.g., by a thread
+   * refitting the system to the latest data) is taken at the start of the
+   * next step (Control, ControlOutputReference), without blocking either
+   * thread. The parameters of the system are copied in place (see
+   * System::set_params), so the state estimate carries over, as are the
+   * gains if published (see set_gains). The set-point solution and
+   * delay-prediction matrices are recalculated as for set_sys.
+   *
+   * n.b., references are kept as they are (e.g., set y_ref again if the
+   * output bias changes). For a SwitchedController, the model is that of the
+   * active sub-system. Copies of the controller take from the same slot, so
+   * only one of them may be stepped.
+   *
+   * @brief      sets slot that models are taken from at each step
+   *
+   * @param      model_swap  slot (null = none)
+   */
+  void set_model_swap(std::shared_ptr<ModelSwap<System>> model_swap) {
+    if (model_swap && ((model_swap->n_u() != sys_->n_u()) ||
+                       (model_swap->n_x() != sys_->n_x()) ||
+                       (model_swap->n_y() != sys_->n_y()))) {
+      throw std::runtime_error(
+          "dimensionality of model slot does not match that of controller");
+    }
+    model_swap_ = std::move(model_swap);
+  };
+  /// gets slot that models are taken from at each step (null = none)
+  const std::shared_ptr<ModelSwap<System>>& model_swap() const {
+    return model_swap_;
+  };
+
   /// reset system and control variables.
   void Reset() {
-    sys_.Reset();
+    sys_->Reset();
+    u_delay_.zeros();
+    delay_head_ = 0;
     u_ref_.zeros();
     u_ref_prev_.zeros();
     int_e_.zeros();
@@ -233,18 +467,86 @@ class Controller {
     u_sat_.zeros();
     u_saturated_ = false;
     t_since_control_onset_ = 0.0;
+    n_until_setpoint_ = 0;
   };
 
+  /**
+   * Saves the underlying system (see System::SaveSnapshot), gains, references,
+   * control signal, integrated error, and cached set-point solution to a
+   * snapshot, so that a controller restored from it comes up in the same warm
+   * state (i.e., without redesign or a reconvergence transient).
+   *
+   * @brief      saves controller to snapshot
+   *
+   * @param      snap    snapshot
+   * @param      prefix  [optional] prefix of record names
+   */
+  virtual void SaveSnapshot(Snapshot& snap,
+                            const std::string& prefix = "") const;
+
+  /**
+   * n.b., the controller must have the dimensions (n_u, n_x, n_y) of the
+   * controller that was saved.
+   *
+   * @brief      restores controller from snapshot
+   *
+   * @param      snap    snapshot
+   * @param      prefix  [optional] prefix of record names
+   */
+  virtual void LoadSnapshot(const Snapshot& snap,
+                            const std::string& prefix = "");
+
   /// prints variables to stdout
   void Print() {
-    sys_.Print();
+    sys_->Print();
     std::cout << "g_design : " << g_design_ << "\n";
     std::cout << "u_lb : " << u_lb_ << "\n";
     std::cout << "u_ub : " << u_ub_ << "\n";
   };
 
+  /**
+   * Gets latency statistics (p50/p99/max, in ns) of a stage of the
+   * estimation/control step, whether it is part of the underlying system
+   * (e.g., `kLatencyRecurseKe`) or the controller (e.g., `kLatencyAntiWindup`).
+   * Statistics are zero unless built with `LDSCTRLEST_PROFILE`.
+   *
+   * @brief      gets latency statistics of a stage
+   *
+   * @param      stage  stage
+   *
+   * @return     latency statistics
+   */
+  LatencyStats latency(LatencyStage stage) const {
+    return stage < kLatencySetPoint ? sys_->latency().stats(stage)
+                                    : latency_.stats(stage);
+  };
+
+  /// resets latency histograms of system and controller stages
+  void ResetLatency() {
+    sys_->ResetLatency();
+    latency_.Reset();
+  };
+
+  /// prints latency statistics of system and controller stages to stdout
+  void PrintLatency() const {
+    sys_->latency().Print();
+    latency_.Print();
+  };
+
  protected:
-  System sys_;  ///< underlying LDS
+  /**
+   * @brief      Constructs a new Controller of sub-systems (first active;
+   *             see ActiveSystem), moving them.
+   *
+   * @param      systems       sub-systems (derived from lds::System)
+   * @param      u_lb          lower bound on control (u)
+   * @param      u_ub          upper bound on control (u)
+   * @param      control_type  control type bit mask
+   */
+  Controller(std::vector<System>&& systems, data_t u_lb, data_t u_ub,
+             size_t control_type);
+
+  ActiveSystem<System> sys_;  ///< underlying LDS
 
   Vector u_;         ///< control signal
   Vector u_return_;  ///< control signal that is *returned* to user
@@ -298,6 +600,82 @@ class Controller {
   data_t t_since_control_onset_ = 0;  ///< time since control epoch onset
   size_t control_type_{};             ///< controller type
 
+  // Scratch (preallocated so the per-step path does not allocate):
+  Vector tmp_x_;    ///< scratch (n_x)
+  Vector tmp_u_;    ///< scratch (n_u)
+  Matrix tmp_awu_;  ///< scratch for anti-windup (n_u x n_y)
+  Vector tmp_xu_;   ///< scratch for set point (n_x + n_u)
+
+  // cached steady-state set-point solution:
+  // [x_ref; u_ref] = setpoint_b_ * cx_ref - setpoint_m_ * m
+  Matrix setpoint_b_;                ///< maps cx_ref to set point
+  Matrix setpoint_m_;                ///< maps disturbance m to set point
+  size_t setpoint_revision_{};       ///< system revision of cached solution
+  bool is_setpoint_cached_ = false;  ///< whether cached solution is valid
+  size_t setpoint_period_ = 1;       ///< control steps per set-point calc
+  size_t n_until_setpoint_{};        ///< control steps until next calc
+  Vector u_ref_hold_;                ///< held set-point input
+
+  /// invalidates cached set-point solution (e.g., when system is replaced)
+  void InvalidateSetPoint() {
+    is_setpoint_cached_ = false;
+    n_until_setpoint_ = 0;
+  };
+
+  /**
+   * @brief      solves (and caches) the set-point KKT system for the current
+   *             system parameters (A, B, g, C)
+   */
+  void CalcSetPointSolution();
+
+  // input-delay compensation (see set_input_delay):
+  // x_pred = delay_a_ * x + delay_b_ * [g % u_j ...] + delay_m_ * m
+  size_t input_delay_{};          ///< steps of input delay
+  Matrix u_delay_;                ///< ring of inputs in flight (n_u x n)
+  size_t delay_head_{};           ///< column of oldest input in ring
+  Vector x_pred_;                 ///< state predicted input_delay_ steps ahead
+  Matrix delay_a_;                ///< A^n
+  Matrix delay_b_;                ///< [A^(n-1) B, ..., A B, B]
+  Matrix delay_m_;                ///< sum of A^j (j < n)
+  size_t delay_revision_{};       ///< system revision of prediction matrices
+  bool is_delay_cached_ = false;  ///< whether prediction matrices are valid
+
+  /// invalidates prediction matrices (e.g., when system is replaced)
+  void InvalidateDelayPrediction() { is_delay_cached_ = false; };
+
+  /**
+   * @brief      calculates (and caches) prediction matrices for the current
+   *             system parameters (A, B)
+   */
+  void CalcDelayPrediction();
+
+  LatencyProfile latency_;  ///< latency histograms of controller stages
+
+  std::shared_ptr<StateMonitor> monitor_;  ///< monitor published to (if any)
+  std::shared_ptr<ModelSwap<System>> model_swap_;  ///< model slot (if any)
+
+  /// takes latest model published to slot (if any) at the start of a step
+  void SwapModel();
+
+  /**
+   * @brief      updates state estimate given latest measurement (n.b.,
+   *             overridden where more than one estimator is run, e.g.,
+   *             SwitchedController::set_imm)
+   *
+   * @param      u_tm1  input that drove the system at t-minus-1
+   * @param      z      current measurement
+   */
+  virtual void Estimate(const Vector& u_tm1, const Vector& z) {
+    sys_->Filter(u_tm1, z);
+  };
+
+  /// publishes state to monitor (if any) at the end of a step
+  void PublishState() {
+    if (monitor_) {
+      monitor_->Publish(*sys_, u_return_, u_ref_, x_ref_, y_ref_);
+    }
+  };
+
  private:
   /**
    * @brief      calculates the control signal update (single-step)
@@ -333,6 +711,22 @@ class Controller {
    */
   void CalcSteadyStateSetPoint();
 
+  /**
+   * @brief      exchanges latest control signal for the oldest one in flight
+   *             (see set_input_delay)
+   *
+   * @return     input that drove the system over the last step
+   */
+  const Vector& ShiftInputDelay();
+
+  /**
+   * @brief      predicts state input_delay steps ahead through inputs in
+   *             flight (see set_input_delay)
+   *
+   * @return     state on which feedback acts
+   */
+  const Vector& PredictState();
+
   /**
    * Performs saturation check on control signal and antiwindup adjustment of
    * integral error.
@@ -375,6 +769,45 @@ inline Controller<System>::Controller(System&& sys, data_t u_lb, data_t u_ub,
   InitVars();
 }
 
+template <typename System>
+inline Controller<System>::Controller(std::vector<System>&& systems,
+                                      data_t u_lb, data_t u_ub,
+                                      size_t control_type)
+    : sys_(std::move(systems)),
+      u_lb_(u_lb),
+      u_ub_(u_ub),
+      control_type_(control_type),
+      tau_awu_(lds::kInf) {
+  InitVars();
+}
+
+template <typename System>
+inline void Controller<System>::set_gains(const LQRGains& gains) {
+  set_Kc(gains.Kc);
+  if (control_type_ & kControlTypeIntY) {
+    set_Kc_inty(gains.Kc_inty);
+  }
+  if (control_type_ & kControlTypeDeltaU) {
+    set_Kc_u(gains.Kc_u);
+  }
+}
+
+template <typename System>
+inline void Controller<System>::DesignLQR(const Matrix& q_y,
+                                          const Matrix& q_inty,
+                                          const Matrix& r) {
+  set_gains(lds::DesignLQR(sys_->A(), sys_->B(), sys_->C(), sys_->dt(),
+                           control_type_, q_y, q_inty, r));
+}
+
+template <typename System>
+inline void Controller<System>::DesignLQR(data_t q_inty_over_q_y,
+                                          data_t r_over_q_y) {
+  Matrix q_y(sys_->n_y(), sys_->n_y(), fill::eye);
+  Matrix r = Matrix(sys_->n_u(), sys_->n_u(), fill::eye) * r_over_q_y;
+  DesignLQR(q_y, q_y * q_inty_over_q_y, r);
+}
+
 template <typename System>
 inline void Controller<System>::set_control_type(size_t control_type) {
   if (control_type_ == control_type) {
@@ -390,23 +823,24 @@ inline void Controller<System>::set_control_type(size_t control_type) {
 
   // controller was designed to minimize integral error
   if (control_type & kControlTypeIntY) {
-    Kc_inty_.zeros(sys_.n_u(), sys_.n_y());
-    int_e_.zeros(sys_.n_y());
-    int_e_awu_adjust_.zeros(sys_.n_u());
+    Kc_inty_.zeros(sys_->n_u(), sys_->n_y());
+    tmp_awu_.zeros(sys_->n_u(), sys_->n_y());
+    int_e_.zeros(sys_->n_y());
+    int_e_awu_adjust_.zeros(sys_->n_u());
     control_type_ = control_type_ | kControlTypeIntY;
   }
 
   // controller was designed to minimize deltaU
   // (i.e. state augmented with u)
   if (control_type & kControlTypeDeltaU) {
-    Kc_u_.zeros(sys_.n_u(), sys_.n_u());
+    Kc_u_.zeros(sys_->n_u(), sys_->n_u());
     control_type_ = control_type_ | kControlTypeDeltaU;
   }
 
   // whether to adapt set point calculate with (re-estimated) process
   // disturbance (m)
   if (control_type & kControlTypeAdaptM) {
-    if (sys_.do_adapt_m)  // only if adapting m...
+    if (sys_->do_adapt_m)  // only if adapting m...
     {
       control_type_ = control_type_ | kControlTypeAdaptM;
     }
@@ -418,14 +852,18 @@ inline const Vector& Controller<System>::Control(
     const Vector& z, bool do_control, bool do_lock_control,
     data_t sigma_soft_start, data_t sigma_u_noise,
     bool do_reset_at_control_onset) {
+  SwapModel();
+
   // update state estimates, given latest measurement
-  sys_.Filter(u_, z);
+  // (n.b., with the input that drove the system; see set_input_delay)
+  Estimate(ShiftInputDelay(), z);
 
   bool do_estimation = true;  // always have estimator on in this case
 
   // calculate control signal
   CalcControl(do_control, do_estimation, do_lock_control, sigma_soft_start,
               sigma_u_noise, do_reset_at_control_onset);
+  PublishState();
 
   return u_return_;
 }
@@ -435,22 +873,36 @@ inline const Vector& Controller<System>::ControlOutputReference(
     const Vector& z, bool do_control, bool do_estimation, bool do_lock_control,
     data_t sigma_soft_start, data_t sigma_u_noise,
     bool do_reset_at_control_onset) {
+  SwapModel();
+
   // update state estimates, given latest measurement
+  // (n.b., with the input that drove the system; see set_input_delay)
+  const Vector& u_tm1 = ShiftInputDelay();
   if (do_estimation) {
-    sys_.Filter(u_, z);
+    Estimate(u_tm1, z);
   } else {
-    sys_.f(u_);
+    sys_->f(u_tm1);
   }
 
   // calculate the set point
   // solves for u_ref and x_ref when output is at y_ref at steady state.
+  // (n.b., held in between calculations; see set_setpoint_period)
   if (do_control) {
-    CalcSteadyStateSetPoint();
+    if (n_until_setpoint_ == 0) {
+      CalcSteadyStateSetPoint();
+      u_ref_hold_ = u_ref_;
+      n_until_setpoint_ = setpoint_period_;
+    } else {
+      // n.b., soft start scales u_ref in place, so restore held value
+      u_ref_ = u_ref_hold_;
+    }
+    n_until_setpoint_--;
   }
 
   // calculate control signal
   CalcControl(do_control, do_estimation, do_lock_control, sigma_soft_start,
               sigma_u_noise, do_reset_at_control_onset);
+  PublishState();
 
   return u_return_;
 }
@@ -468,7 +920,7 @@ inline void Controller<System>::CalcControl(bool do_control, bool do_estimation,
       }
       t_since_control_onset_ = 0.0;
     } else {
-      t_since_control_onset_ += sys_.dt();
+      t_since_control_onset_ += sys_->dt();
     }
 
     // enforce softstart on control vars.
@@ -484,6 +936,9 @@ inline void Controller<System>::CalcControl(bool do_control, bool do_estimation,
     }
 
     if (!do_lock_control) {
+      // state on which feedback acts (predicted ahead if input is delayed)
+      const Vector& x = PredictState();
+
       // first do u -> v change of vars. (v = g.*u)
       // e.g., convert into physical units (e.g., v[=] mW/mm2 rather than driver
       // control voltage u[=]V)
@@ -504,42 +959,45 @@ inline void Controller<System>::CalcControl(bool do_control, bool do_estimation,
         // situation arises that argues for keeping the above.
         dv_ref_.zeros();
 
-        dv_ = dv_ref_;                     // nominally-optimal.
-        dv_ -= Kc_ * (sys_.x() - x_ref_);  // instantaneous state error
-        dv_ -= Kc_u_ * (v_ - v_ref_);      // penalty on amp u (rel to ref)
+        dv_ = dv_ref_;                // nominally-optimal.
+        tmp_x_ = x - x_ref_;          // instantaneous state error
+        dv_ -= Kc_ * tmp_x_;
+        tmp_u_ = v_ - v_ref_;         // penalty on amp u (rel to ref)
+        dv_ -= Kc_u_ * tmp_u_;
 
         if (control_type_ & kControlTypeIntY) {
           // TODO(mfbolus): one approach to protection against integral windup
           // would be to not integrate error when control signal saturated:
 
           // if(!uSaturated)
-          int_e_ += (sys_.cx() - cx_ref_) * sys_.dt();  // integrated error
+          int_e_ += (sys_->cx() - cx_ref_) * sys_->dt();  // integrated error
           dv_ -= Kc_inty_ * int_e_;  // control for integrated error
         }
 
         // update the control
         v_ += dv_;
       } else {
-        v_ = v_ref_;                      // nominally-optimal.
-        v_ -= Kc_ * (sys_.x() - x_ref_);  // instantaneous state error
+        v_ = v_ref_;                 // nominally-optimal.
+        tmp_x_ = x - x_ref_;         // instantaneous state error
+        v_ -= Kc_ * tmp_x_;
 
         if (control_type_ & kControlTypeIntY) {
           // TODO(mfbolus): one approach to protection against integral windup
           // would be to not integrate error when control signal saturated:
 
           // if (!uSaturated)
-          int_e_ += (sys_.cx() - cx_ref_) * sys_.dt();  // integrated error
+          int_e_ += (sys_->cx() - cx_ref_) * sys_->dt();  // integrated error
           v_ -= Kc_inty_ * int_e_;  // control for integrated error
         }
       }
 
       // convert back to control voltage u[=]V
-      u_ = v_ / sys_.g();
+      u_ = v_ / sys_->g();
     }       // else do nothing until lock is low
   } else {  // if not control
     // feed through u_ref in open loop
-    u_ = u_ref_ % g_design_ / sys_.g();
-    v_ = sys_.g() % u_;
+    u_ = u_ref_ % g_design_ / sys_->g();
+    v_ = sys_->g() % u_;
     u_ref_.zeros();
     int_e_.zeros();
     int_e_awu_adjust_.zeros();
@@ -554,7 +1012,8 @@ inline void Controller<System>::CalcControl(bool do_control, bool do_estimation,
   // while keeping controller/estimator blind to this addition.
   u_return_ = u_;
   if ((sigma_u_noise > 0.0) && (do_control && !do_lock_control)) {
-    u_return_ += sigma_u_noise * Vector(sys_.n_u(), fill::randn);
+    tmp_u_.randn();
+    u_return_ += sigma_u_noise * tmp_u_;
     Limit(u_return_, u_lb_, u_ub_);
   };
 
@@ -564,38 +1023,237 @@ inline void Controller<System>::CalcControl(bool do_control, bool do_estimation,
   do_lock_control_prev_ = do_lock_control;
 }  // CalcControl
 
+template <typename System>
+inline const Vector& Controller<System>::ShiftInputDelay() {
+  if (input_delay_ == 0) {
+    return u_;
+  }
+  // n.b., scratch is free until the control signal is calculated
+  tmp_u_ = u_delay_.col(delay_head_);
+  u_delay_.col(delay_head_) = u_;
+  delay_head_ = (delay_head_ + 1) % input_delay_;
+  return tmp_u_;
+}
+
+template <typename System>
+inline const Vector& Controller<System>::PredictState() {
+  if (input_delay_ == 0) {
+    return sys_->x();
+  }
+  // n.b., a cache of a SwitchedController mode may predate set_input_delay
+  if (!is_delay_cached_ || (delay_revision_ != sys_->revision()) ||
+      (delay_b_.n_cols != input_delay_ * sys_->n_u())) {
+    CalcDelayPrediction();
+  }
+
+  x_pred_ = delay_a_ * sys_->x();
+  x_pred_ += delay_m_ * sys_->m();
+  size_t n_u = sys_->n_u();
+  for (size_t j = 0; j < input_delay_; j++) {
+    // n.b., oldest input in flight is at head of ring
+    tmp_u_ = sys_->g() % u_delay_.col((delay_head_ + j) % input_delay_);
+    x_pred_ += delay_b_.cols(j * n_u, (j + 1) * n_u - 1) * tmp_u_;
+  }
+  return x_pred_;
+}
+
+template <typename System>
+inline void Controller<System>::CalcDelayPrediction() {
+  size_t n = input_delay_;
+  size_t n_u = sys_->n_u();
+
+  // block j of delay_b_ is A^(n-1-j) B, so fill from the last block
+  delay_b_ = Matrix(sys_->n_x(), n * n_u);
+  delay_b_.cols((n - 1) * n_u, n * n_u - 1) = sys_->B();
+  delay_m_ = Matrix(sys_->n_x(), sys_->n_x(), fill::eye);
+  delay_a_ = sys_->A();
+  for (size_t j = 1; j < n; j++) {
+    // n.b., delay_a_ = A^j here
+    delay_m_ += delay_a_;
+    delay_b_.cols((n - 1 - j) * n_u, (n - j) * n_u - 1) = delay_a_ * sys_->B();
+    delay_a_ = sys_->A() * delay_a_;
+  }
+
+  delay_revision_ = sys_->revision();
+  is_delay_cached_ = true;
+}
+
+template <typename System>
+inline void Controller<System>::SaveSnapshot(Snapshot& snap,
+                                             const std::string& prefix) const {
+  sys_->SaveSnapshot(snap, prefix + "sys.");
+
+  snap.Set(prefix + "Kc", Kc_);
+  snap.Set(prefix + "Kc_u", Kc_u_);
+  snap.Set(prefix + "Kc_inty", Kc_inty_);
+  snap.Set(prefix + "g_design", g_design_);
+
+  snap.Set(prefix + "u", u_);
+  snap.Set(prefix + "u_return", u_return_);
+  snap.Set(prefix + "v", v_);
+  snap.Set(prefix + "u_ref", u_ref_);
+  snap.Set(prefix + "u_ref_prev", u_ref_prev_);
+  snap.Set(prefix + "u_ref_hold", u_ref_hold_);
+  snap.Set(prefix + "x_ref", x_ref_);
+  snap.Set(prefix + "y_ref", y_ref_);
+  snap.Set(prefix + "cx_ref", cx_ref_);
+  snap.Set(prefix + "int_e", int_e_);
+  snap.Set(prefix + "int_e_awu_adjust", int_e_awu_adjust_);
+  snap.Set(prefix + "u_sat", u_sat_);
+
+  snap.Set(prefix + "u_lb", u_lb_);
+  snap.Set(prefix + "u_ub", u_ub_);
+  snap.Set(prefix + "tau_awu", tau_awu_);
+  snap.Set(prefix + "control_type", control_type_);
+  snap.Set(prefix + "do_control_prev", do_control_prev_);
+  snap.Set(prefix + "do_lock_control_prev", do_lock_control_prev_);
+  snap.Set(prefix + "u_saturated", u_saturated_);
+  snap.Set(prefix + "t_since_control_onset", t_since_control_onset_);
+  snap.Set(prefix + "setpoint_period", setpoint_period_);
+  snap.Set(prefix + "n_until_setpoint", n_until_setpoint_);
+  snap.Set(prefix + "input_delay", input_delay_);
+  snap.Set(prefix + "u_delay", u_delay_);
+  snap.Set(prefix + "delay_head", delay_head_);
+
+  // n.b., only valid for the parameters of the system being saved
+  bool is_setpoint_valid =
+      is_setpoint_cached_ && (setpoint_revision_ == sys_->revision());
+  snap.Set(prefix + "is_setpoint_cached", is_setpoint_valid);
+  if (is_setpoint_valid) {
+    snap.Set(prefix + "setpoint_b", setpoint_b_);
+    snap.Set(prefix + "setpoint_m", setpoint_m_);
+  }
+}
+
+template <typename System>
+inline void Controller<System>::LoadSnapshot(const Snapshot& snap,
+                                             const std::string& prefix) {
+  sys_->LoadSnapshot(snap, prefix + "sys.");
+
+  snap.Get(prefix + "Kc", Kc_);
+  snap.Get(prefix + "Kc_u", Kc_u_);
+  snap.Get(prefix + "Kc_inty", Kc_inty_);
+  snap.Get(prefix + "g_design", g_design_);
+
+  snap.Get(prefix + "u", u_);
+  snap.Get(prefix + "u_return", u_return_);
+  snap.Get(prefix + "v", v_);
+  snap.Get(prefix + "u_ref", u_ref_);
+  snap.Get(prefix + "u_ref_prev", u_ref_prev_);
+  snap.Get(prefix + "u_ref_hold", u_ref_hold_);
+  snap.Get(prefix + "x_ref", x_ref_);
+  snap.Get(prefix + "y_ref", y_ref_);
+  snap.Get(prefix + "cx_ref", cx_ref_);
+  snap.Get(prefix + "int_e", int_e_);
+  snap.Get(prefix + "int_e_awu_adjust", int_e_awu_adjust_);
+  snap.Get(prefix + "u_sat", u_sat_);
+
+  u_lb_ = snap.GetScalar(prefix + "u_lb");
+  u_ub_ = snap.GetScalar(prefix + "u_ub");
+  set_tau_awu(snap.GetScalar(prefix + "tau_awu"));
+  control_type_ =
+      static_cast<size_t>(snap.GetScalar(prefix + "control_type"));
+  do_control_prev_ = snap.GetScalar(prefix + "do_control_prev") != 0;
+  do_lock_control_prev_ =
+      snap.GetScalar(prefix + "do_lock_control_prev") != 0;
+  u_saturated_ = snap.GetScalar(prefix + "u_saturated") != 0;
+  t_since_control_onset_ = snap.GetScalar(prefix + "t_since_control_onset");
+  setpoint_period_ =
+      static_cast<size_t>(snap.GetScalar(prefix + "setpoint_period"));
+  n_until_setpoint_ =
+      static_cast<size_t>(snap.GetScalar(prefix + "n_until_setpoint"));
+  // n.b., absent from snapshots saved before input-delay compensation
+  if (snap.Has(prefix + "input_delay")) {
+    set_input_delay(
+        static_cast<size_t>(snap.GetScalar(prefix + "input_delay")));
+    snap.Get(prefix + "u_delay", u_delay_);
+    delay_head_ = static_cast<size_t>(snap.GetScalar(prefix + "delay_head"));
+  }
+
+  is_setpoint_cached_ = snap.GetScalar(prefix + "is_setpoint_cached") != 0;
+  if (is_setpoint_cached_) {
+    setpoint_b_ = snap.Get(prefix + "setpoint_b");
+    setpoint_m_ = snap.Get(prefix + "setpoint_m");
+    setpoint_revision_ = sys_->revision();
+  }
+}
+
 template <typename System>
 inline void Controller<System>::CalcSteadyStateSetPoint() {
+  LDSCTRLEST_LATENCY_SCOPE(latency_, kLatencySetPoint);
+
+  // n.b., KKT system only depends on A, B, g, C, so it is only solved again
+  // when one of those has changed.
+  if (!is_setpoint_cached_ || (setpoint_revision_ != sys_->revision())) {
+    CalcSetPointSolution();
+  }
+
+  // adapt setpoint calc with disturbance?
+  const Vector& m =
+      (control_type_ & kControlTypeAdaptM) ? sys_->m() : sys_->m0();
+
+  // (n.b., evaluated in place with preallocated scratch)
+  tmp_xu_ = setpoint_b_ * cx_ref_;
+  tmp_xu_ -= setpoint_m_ * m;
+  x_ref_ = tmp_xu_.subvec(0, sys_->n_x() - 1);
+  u_ref_ = tmp_xu_.subvec(sys_->n_x(), sys_->n_x() + sys_->n_u() - 1);
+  cx_ref_ = sys_->C() * x_ref_;
+}  // CalcSteadyStateSetPoint
+
+template <typename System>
+inline void Controller<System>::SwapModel() {
+  if (!model_swap_) {
+    return;
+  }
+  const typename ModelSwap<System>::Model* model = model_swap_->TryTake();
+  if (!model) {
+    return;
+  }
+  sys_->set_params(model->sys);
+  if (model->gains.Kc.n_elem > 0) {
+    set_gains(model->gains);
+  }
+  InvalidateSetPoint();
+  InvalidateDelayPrediction();
+}
+
+template <typename System>
+inline void Controller<System>::CalcSetPointSolution() {
   // Linearly-constrained least squares (ls).
   //
   // _reference:
   //  Boyd & Vandenberghe (2018) Introduction to Applied Linear Algebra
   //
   Matrix a_ls =
-      join_horiz(sys_.C(), Matrix(sys_.n_y(), sys_.n_u(), fill::zeros));
-  Vector b_ls = cx_ref_;
-  Matrix c_ls = join_horiz(sys_.A() - Matrix(sys_.n_x(), sys_.n_x(), fill::eye),
-                           sys_.B() * arma::diagmat(sys_.g()));
-  Vector d_ls = -sys_.m0();
-  if (control_type_ & kControlTypeAdaptM) {
-    d_ls = -sys_.m();  // adapt setpoint calc with disturbance?
-  }
+      join_horiz(sys_->C(), Matrix(sys_->n_y(), sys_->n_u(), fill::zeros));
+  Matrix c_ls =
+      join_horiz(sys_->A() - Matrix(sys_->n_x(), sys_->n_x(), fill::eye),
+                 sys_->B() * arma::diagmat(sys_->g()));
 
   Matrix a_ls_t = a_ls.t();  // TODO(mfbolus): not sure why but causes seg
                              // fault if I do not do this.
   Matrix phi_ls =
       join_vert(join_horiz(2 * a_ls_t * a_ls, c_ls.t()),
-                join_horiz(c_ls, Matrix(sys_.n_x(), sys_.n_x(), fill::zeros)));
+                join_horiz(c_ls,
+                           Matrix(sys_->n_x(), sys_->n_x(), fill::zeros)));
   // TODO(mfbolus): should be actual inverse, rather than pseudo-inverse:
   Matrix inv_phi = pinv(phi_ls);
-  Vector xulam = inv_phi * join_vert(2 * a_ls_t * b_ls, d_ls);
-  x_ref_ = xulam.subvec(0, sys_.n_x() - 1);
-  u_ref_ = xulam.subvec(sys_.n_x(), sys_.n_x() + sys_.n_u() - 1);
-  cx_ref_ = sys_.C() * x_ref_;
-}  // CalcSteadyStateSetPoint
+
+  // [x; u; lam] = inv_phi * [2 * a_ls' * b_ls; d_ls], where b_ls = cx_ref,
+  // d_ls = -m, and a_ls = [C 0], so only keep the blocks that map those onto
+  // [x; u].
+  size_t n_xu = sys_->n_x() + sys_->n_u();
+  setpoint_b_ =
+      2 * inv_phi.submat(0, 0, n_xu - 1, sys_->n_x() - 1) * sys_->C().t();
+  setpoint_m_ = inv_phi.submat(0, n_xu, n_xu - 1, n_xu + sys_->n_x() - 1);
+
+  setpoint_revision_ = sys_->revision();
+  is_setpoint_cached_ = true;
+}  // CalcSetPointSolution
 
 template <typename System>
 void Controller<System>::AntiWindup() {
+  LDSCTRLEST_LATENCY_SCOPE(latency_, kLatencyAntiWindup);
   u_saturated_ = false;
   u_sat_ = u_;
 
@@ -621,8 +1279,13 @@ void Controller<System>::AntiWindup() {
     // gradual: see Astroem, Rundqwist 1989
     // this is a fudge for doing MIMO gradual
     // n.b., went ahead and multiplied 1/T by dt so don't have to do that here.
-    int_e_awu_adjust_ =
-        k_awu_ * (sign(Kc_inty_).t() / sys_.n_u()) * (u_ - u_sat_);
+    // int_e_awu_adjust_ =
+    //     k_awu_ * (sign(Kc_inty_).t() / sys_->n_u()) * (u_ - u_sat_);
+    // (n.b., evaluated in place with preallocated scratch)
+    tmp_awu_ = sign(Kc_inty_);
+    tmp_u_ = u_ - u_sat_;
+    int_e_awu_adjust_ = tmp_awu_.t() * tmp_u_;
+    int_e_awu_adjust_ *= k_awu_ / sys_->n_u();
     // int_e_awu_adjust_ = k_awu_ * (u_-u_sat_);
 
     int_e_ += int_e_awu_adjust_;
@@ -635,31 +1298,39 @@ void Controller<System>::AntiWindup() {
 template <typename System>
 void Controller<System>::InitVars() {
   // initialize to default values
-  u_ref_ = Vector(sys_.n_u(), fill::zeros);
-  u_ref_prev_ = Vector(sys_.n_u(), fill::zeros);
-  x_ref_ = Vector(sys_.n_x(), fill::zeros);
-  y_ref_ = Vector(sys_.n_y(), fill::zeros);
-  cx_ref_ = Vector(sys_.n_y(), fill::zeros);
-
-  u_ = Vector(sys_.n_u(), fill::zeros);
-  u_return_ = Vector(sys_.n_u(), fill::zeros);
-  u_sat_ = Vector(sys_.n_u(), fill::zeros);
+  u_ref_ = Vector(sys_->n_u(), fill::zeros);
+  u_ref_prev_ = Vector(sys_->n_u(), fill::zeros);
+  u_ref_hold_ = Vector(sys_->n_u(), fill::zeros);
+  x_ref_ = Vector(sys_->n_x(), fill::zeros);
+  y_ref_ = Vector(sys_->n_y(), fill::zeros);
+  cx_ref_ = Vector(sys_->n_y(), fill::zeros);
+
+  u_ = Vector(sys_->n_u(), fill::zeros);
+  u_return_ = Vector(sys_->n_u(), fill::zeros);
+  u_sat_ = Vector(sys_->n_u(), fill::zeros);
+  tmp_xu_ = Vector(sys_->n_x() + sys_->n_u(), fill::zeros);
+  InvalidateSetPoint();
+  set_input_delay(input_delay_);
 
   // Might not need all these, so zero elements until later.
-  Kc_ = Matrix(sys_.n_u(), sys_.n_x(), fill::zeros);
+  Kc_ = Matrix(sys_->n_u(), sys_->n_x(), fill::zeros);
   Kc_u_ = Matrix(0, 0, fill::zeros);
   Kc_inty_ = Matrix(0, 0, fill::zeros);
 
-  g_design_ = sys_.g();  // by default, same as model
-  dv_ = Vector(sys_.n_u(), fill::zeros);
-  v_ = Vector(sys_.n_u(), fill::zeros);
-  du_ref_ = Vector(sys_.n_u(), fill::zeros);
-  dv_ref_ = Vector(sys_.n_u(), fill::zeros);
-  v_ref_ = Vector(sys_.n_u(), fill::zeros);
+  g_design_ = sys_->g();  // by default, same as model
+  dv_ = Vector(sys_->n_u(), fill::zeros);
+  v_ = Vector(sys_->n_u(), fill::zeros);
+  du_ref_ = Vector(sys_->n_u(), fill::zeros);
+  dv_ref_ = Vector(sys_->n_u(), fill::zeros);
+  v_ref_ = Vector(sys_->n_u(), fill::zeros);
 
   int_e_ = Vector(0, fill::zeros);
   int_e_awu_adjust_ = Vector(0, fill::zeros);
 
+  tmp_x_ = Vector(sys_->n_x(), fill::zeros);
+  tmp_u_ = Vector(sys_->n_u(), fill::zeros);
+  tmp_awu_ = Matrix(0, 0, fill::zeros);
+
   set_control_type(control_type_);
 }
 
@@ -0,0 +1,239 @@
+//===-- ldsCtrlEst_h/lds_ctrl_bank.h - Controller Bank ----------*- C++ -*-===//
+//
+// Copyright 2021 Michael Bolus
+// Copyright 2021 Georgia Institute of Technology
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file declares and defines a runner for many independent control
+/// loops of identical dimensions (`lds::ControllerBank`). Measurements,
+/// control signals, states and outputs of all channels are exchanged as
+/// matrices with one column per channel, and the loops can be sharded across
+/// a pool of threads.
+///
+/// n.b., this is a thread-sharded loop over the channels, not a batched
+/// engine: each channel is a full controller with its own parameters and
+/// storage (not laid out as structure-of-arrays), stepped by its own
+/// per-channel kernels, so nothing is vectorized or multiplied across
+/// channels. Throughput scales with the number of threads.
+///
+/// \brief ControllerBank
+//===----------------------------------------------------------------------===//
+
+#ifndef LDSCTRLEST_LDS_CTRL_BANK_H
+#define LDSCTRLEST_LDS_CTRL_BANK_H
+
+// namespace
+#include "lds.h"
+// thread pool
+#include "lds_thread_pool.h"
+
+#include <memory>
+
+namespace lds {
+
+/// Thread-sharded runner of independent controllers of identical dimensions
+template <typename Controller>
+class ControllerBank {
+ public:
+  /**
+   * @brief      Constructs a new ControllerBank.
+   */
+  ControllerBank() = default;
+
+  /**
+   * Channels are sharded across threads in contiguous blocks, each channel
+   * stepped by its own controller (see file description).
+   *
+   * @brief      Constructs a new ControllerBank.
+   *
+   * @param      controllers  controllers (must have identical dimensions)
+   * @param      n_threads    [optional] number of threads to shard channels
+   *                          across (1 = calling thread only, 0 = hardware
+   *                          concurrency)
+   *
+   * @tparam     Controller   controller type (e.g., lds::poisson::Controller)
+   */
+  explicit ControllerBank(std::vector<Controller> controllers,
+                          size_t n_threads = 1);
+
+  /**
+   * @brief      updates control signals of all channels (single-step)
+   *
+   * @param      z           measurements (n_y x n_ctrl)
+   * @param      do_control  [optional] whether to update control (true) or
+   *                         simply feed through u_ref (false)
+   *
+   * @return     control signals (n_u x n_ctrl)
+   */
+  const Matrix& Control(const Matrix& z, bool do_control = true);
+
+  /**
+   * @brief      updates control signals of all channels given previously-set
+   *             y_ref (single-step)
+   *
+   * @param      z              measurements (n_y x n_ctrl)
+   * @param      do_control     [optional] whether to update control (true) or
+   *                            simply feed through u_ref (false)
+   * @param      do_estimation  [optional] whether to update state estimates
+   *
+   * @return     control signals (n_u x n_ctrl)
+   */
+  const Matrix& ControlOutputReference(const Matrix& z, bool do_control = true,
+                                       bool do_estimation = true);
+
+  /// Get number of controllers
+  size_t n_ctrl() const { return controllers_.size(); };
+  /// Get number of inputs (per channel)
+  size_t n_u() const { return n_u_; };
+  /// Get number of states (per channel)
+  size_t n_x() const { return n_x_; };
+  /// Get number of outputs (per channel)
+  size_t n_y() const { return n_y_; };
+  /// Get number of threads channels are sharded across
+  size_t n_threads() const { return pool_ ? pool_->n_threads() : 1; };
+
+  /// Get control signals (n_u x n_ctrl)
+  const Matrix& u() const { return u_; };
+  /// Get state estimates (n_x x n_ctrl)
+  const Matrix& x() const { return x_; };
+  /// Get output estimates (n_y x n_ctrl)
+  const Matrix& y() const { return y_; };
+
+  /// Get controller of channel `k` (e.g., to set its references/gains)
+  Controller& at(size_t k) { return controllers_.at(k); };
+  /// Get controller of channel `k`
+  const Controller& at(size_t k) const { return controllers_.at(k); };
+
+  /// Set number of threads channels are sharded across
+  void set_n_threads(size_t n_threads);
+
+  /// Reset all controllers
+  void Reset() {
+    for (auto& controller : controllers_) {
+      controller.Reset();
+    }
+  };
+
+ private:
+  /// steps all channels with `step(controller, z_k)` and gathers signals
+  template <typename Step>
+  void StepAll(const Matrix& z, const Step& step);
+
+  std::vector<Controller> controllers_;  ///< controllers (one per channel)
+  std::unique_ptr<ThreadPool> pool_;     ///< threads (null if serial)
+
+  size_t n_u_{};  ///< number of inputs (per channel)
+  size_t n_x_{};  ///< number of states (per channel)
+  size_t n_y_{};  ///< number of outputs (per channel)
+
+  Matrix z_;  ///< measurements (n_y x n_ctrl)
+  Matrix u_;  ///< control signals (n_u x n_ctrl)
+  Matrix x_;  ///< state estimates (n_x x n_ctrl)
+  Matrix y_;  ///< output estimates (n_y x n_ctrl)
+};
+
+// Implement the above:
+
+template <typename Controller>
+inline ControllerBank<Controller>::ControllerBank(
+    std::vector<Controller> controllers, size_t n_threads)
+    : controllers_(std::move(controllers)) {
+  if (controllers_.empty()) {
+    throw std::runtime_error("ControllerBank requires at least one controller");
+  }
+
+  n_u_ = controllers_[0].sys().n_u();
+  n_x_ = controllers_[0].sys().n_x();
+  n_y_ = controllers_[0].sys().n_y();
+  for (const auto& controller : controllers_) {
+    bool does_match = controller.sys().n_u() == n_u_;
+    does_match = does_match && (controller.sys().n_x() == n_x_);
+    does_match = does_match && (controller.sys().n_y() == n_y_);
+    if (!does_match) {
+      throw std::runtime_error(
+          "controllers of ControllerBank must have identical dimensions");
+    }
+  }
+
+  z_ = Matrix(n_y_, n_ctrl(), fill::zeros);
+  u_ = Matrix(n_u_, n_ctrl(), fill::zeros);
+  x_ = Matrix(n_x_, n_ctrl(), fill::zeros);
+  y_ = Matrix(n_y_, n_ctrl(), fill::zeros);
+
+  set_n_threads(n_threads);
+}
+
+template <typename Controller>
+inline void ControllerBank<Controller>::set_n_threads(size_t n_threads) {
+  if (n_threads == 1) {
+    pool_.reset();
+  } else {
+    pool_.reset(new ThreadPool(n_threads));
+  }
+}
+
+template <typename Controller>
+inline const Matrix& ControllerBank<Controller>::Control(const Matrix& z,
+                                                         bool do_control) {
+  StepAll(z, [do_control](Controller& controller,
+                          const Vector& z_k) -> const Vector& {
+    return controller.Control(z_k, do_control);
+  });
+  return u_;
+}
+
+template <typename Controller>
+inline const Matrix& ControllerBank<Controller>::ControlOutputReference(
+    const Matrix& z, bool do_control, bool do_estimation) {
+  StepAll(z, [do_control, do_estimation](
+                 Controller& controller, const Vector& z_k) -> const Vector& {
+    return controller.ControlOutputReference(z_k, do_control, do_estimation);
+  });
+  return u_;
+}
+
+template <typename Controller>
+template <typename Step>
+inline void ControllerBank<Controller>::StepAll(const Matrix& z,
+                                                const Step& step) {
+  Reassign(z_, z, "ControllerBank measurement");
+
+  auto step_chunk = [&](size_t k_begin, size_t k_end) {
+    for (size_t k = k_begin; k < k_end; k++) {
+      // n.b., views onto column k (no copies)
+      const Vector z_k(z_.colptr(k), n_y_, false, true);
+      Vector u_k(u_.colptr(k), n_u_, false, true);
+      Vector x_k(x_.colptr(k), n_x_, false, true);
+      Vector y_k(y_.colptr(k), n_y_, false, true);
+
+      Controller& controller = controllers_[k];
+      u_k = step(controller, z_k);
+      x_k = controller.sys().x();
+      y_k = controller.sys().y();
+    }
+  };
+
+  if (pool_) {
+    pool_->ParallelFor(n_ctrl(), step_chunk);
+  } else {
+    step_chunk(0, n_ctrl());
+  }
+}
+
+}  // namespace lds
+
+#endif
@@ -0,0 +1,308 @@
+//===-- ldsCtrlEst_h/lds_ctrl_pipeline.h - Control Pipeline -----*- C++ -*-===//
+//
+// Copyright 2021 Michael Bolus
+// Copyright 2021 Georgia Institute of Technology
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file declares and defines a wrapper that runs a controller on its own
+/// real-time thread (`lds::ControlPipeline`). Measurements arrive through a
+/// lock-free single-producer/single-consumer queue (e.g., from an acquisition
+/// thread) and snapshots of the control signal and state/output estimates are
+/// published through a second queue to non-real-time consumers (e.g., a
+/// logger), so that slow consumers never stall the control loop.
+///
+/// \brief ControlPipeline
+//===----------------------------------------------------------------------===//
+
+#ifndef LDSCTRLEST_LDS_CTRL_PIPELINE_H
+#define LDSCTRLEST_LDS_CTRL_PIPELINE_H
+
+// namespace
+#include "lds.h"
+// queue
+#include "lds_spsc_queue.h"
+
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <functional>
+#include <thread>
+
+#ifdef __linux__
+#include <pthread.h>
+#endif
+
+namespace lds {
+
+/// Runs a controller on a dedicated thread fed by lock-free queues
+template <typename Controller>
+class ControlPipeline {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  /// Measurement (with time of arrival)
+  struct Measurement {
+    Measurement() = default;
+    /// Constructs a zeroed measurement of given dimension
+    explicit Measurement(size_t n_y) : z(n_y, fill::zeros) {}
+
+    Vector z;             ///< measurement
+    Clock::time_point t;  ///< time measurement was pushed
+  };
+
+  /// Snapshot of controller published after each step
+  struct Snapshot {
+    Snapshot() = default;
+    /// Constructs a zeroed snapshot of given dimensions
+    Snapshot(size_t n_u, size_t n_x, size_t n_y)
+        : u(n_u, fill::zeros), x(n_x, fill::zeros), y(n_y, fill::zeros) {}
+
+    size_t k{};  ///< step index
+    Vector u;    ///< control signal returned to user
+    Vector x;    ///< state estimate
+    Vector y;    ///< output estimate
+  };
+
+  /**
+   * @brief      Constructs a new ControlPipeline.
+   *
+   * @param      controller            controller
+   * @param      capacity              [optional] capacity of measurement and
+   *                                   snapshot queues
+   * @param      do_output_reference   [optional] whether to step with
+   *                                   ControlOutputReference (true) or
+   *                                   Control (false)
+   */
+  explicit ControlPipeline(Controller controller, size_t capacity = 64,
+                           bool do_output_reference = true);
+
+  /// Stops real-time thread (discarding any exception it threw)
+  ~ControlPipeline() {
+    try {
+      Stop();
+    } catch (...) {
+    }
+  };
+
+  ControlPipeline(const ControlPipeline&) = delete;
+  ControlPipeline& operator=(const ControlPipeline&) = delete;
+
+  /**
+   * @brief      starts real-time thread
+   *
+   * @param      cpu   [optional] core to pin the thread to (-1 = no pinning;
+   *                   only supported on Linux)
+   */
+  void Start(int cpu = -1);
+
+  /**
+   * @brief      stops real-time thread (after it finishes any step in
+   *             progress)
+   *
+   * If the control step threw on the real-time thread, the thread stops
+   * stepping and that exception is rethrown here.
+   */
+  void Stop();
+
+  /**
+   * @brief      pushes new measurement (producer thread only)
+   *
+   * @param      z     measurement
+   *
+   * @return     whether it was accepted (false = overrun, measurement dropped)
+   */
+  bool PushMeasurement(const Vector& z);
+
+  /**
+   * @brief      pops the oldest published snapshot (consumer thread only)
+   *
+   * @param      snapshot  [out] snapshot
+   *
+   * @return     whether a snapshot was available
+   */
+  bool PopSnapshot(Snapshot& snapshot) { return snapshots_.Pop(snapshot); };
+
+  /// Get whether the real-time thread is running (false after it threw)
+  bool is_running() const { return is_running_.load(); };
+  /// Get number of control steps taken
+  size_t n_steps() const { return n_steps_.load(); };
+  /// Get number of measurements dropped because the input queue was full
+  size_t n_overruns() const { return n_overruns_.load(); };
+  /// Get number of steps finishing later than the deadline after arrival
+  size_t n_deadline_misses() const { return n_deadline_misses_.load(); };
+  /// Get number of snapshots dropped because the output queue was full
+  size_t n_dropped_snapshots() const { return n_dropped_snapshots_.load(); };
+
+  /// Get controller (n.b., only safe while not running)
+  Controller& controller() { return controller_; };
+
+  /// Set deadline (s) from a measurement's arrival to the end of its step (0 =
+  /// no deadline). n.b., only safe while not running
+  void set_deadline(data_t deadline) { deadline_ = deadline; };
+
+  /// Set function called on the real-time thread with each new control signal
+  /// (e.g., to write it to hardware). n.b., only safe while not running
+  void set_actuator(std::function<void(const Vector&)> actuator) {
+    actuator_ = std::move(actuator);
+  };
+
+ private:
+  /// Real-time thread entry point (records any exception)
+  void Run();
+
+  /// Real-time thread loop
+  void Loop();
+
+  Controller controller_;     ///< controller
+  bool do_output_reference_;  ///< whether to use ControlOutputReference
+  data_t deadline_{};         ///< deadline (s)
+  std::function<void(const Vector&)> actuator_;  ///< control signal sink
+
+  SpscQueue<Measurement> measurements_;  ///< measurement queue (input)
+  SpscQueue<Snapshot> snapshots_;        ///< snapshot queue (output)
+  Measurement measurement_;              ///< measurement being processed
+  Snapshot snapshot_;                    ///< snapshot being published
+  Measurement pushed_;                   ///< scratch for producer
+
+  std::thread thread_;                   ///< real-time thread
+  std::atomic<bool> is_running_{false};  ///< whether thread is running
+  std::atomic<bool> do_stop_{false};     ///< whether thread should stop
+  std::exception_ptr error_;             ///< exception thrown by thread
+
+  std::atomic<size_t> n_steps_{0};              ///< steps taken
+  std::atomic<size_t> n_overruns_{0};           ///< measurements dropped
+  std::atomic<size_t> n_deadline_misses_{0};    ///< deadlines missed
+  std::atomic<size_t> n_dropped_snapshots_{0};  ///< snapshots dropped
+};
+
+// Implement the above:
+
+template <typename Controller>
+inline ControlPipeline<Controller>::ControlPipeline(Controller controller,
+                                                    size_t capacity,
+                                                    bool do_output_reference)
+    : controller_(std::move(controller)),
+      do_output_reference_(do_output_reference),
+      measurements_(capacity, Measurement(controller_.sys().n_y())),
+      snapshots_(capacity,
+                 Snapshot(controller_.sys().n_u(), controller_.sys().n_x(),
+                          controller_.sys().n_y())),
+      measurement_(controller_.sys().n_y()),
+      snapshot_(controller_.sys().n_u(), controller_.sys().n_x(),
+                controller_.sys().n_y()),
+      pushed_(controller_.sys().n_y()) {}
+
+template <typename Controller>
+inline void ControlPipeline<Controller>::Start(int cpu) {
+  if (thread_.joinable()) {
+    return;  // already started (n.b., Stop first to restart)
+  }
+  do_stop_.store(false);
+  is_running_.store(true);
+  thread_ = std::thread(&ControlPipeline<Controller>::Run, this);
+
+  if (cpu >= 0) {
+#ifdef __linux__
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    CPU_SET(cpu, &cpu_set);
+    if (pthread_setaffinity_np(thread_.native_handle(), sizeof(cpu_set_t),
+                               &cpu_set) != 0) {
+      std::cerr << "ControlPipeline: failed to pin thread to cpu " << cpu
+                << ".\n";
+    }
+#else
+    std::cerr << "ControlPipeline: thread pinning not supported on this "
+                 "platform.\n";
+#endif
+  }
+}
+
+template <typename Controller>
+inline void ControlPipeline<Controller>::Stop() {
+  if (!thread_.joinable()) {
+    return;
+  }
+  do_stop_.store(true);
+  thread_.join();
+  is_running_.store(false);
+  if (error_) {
+    std::exception_ptr error = error_;
+    error_ = nullptr;
+    std::rethrow_exception(error);
+  }
+}
+
+template <typename Controller>
+inline bool ControlPipeline<Controller>::PushMeasurement(const Vector& z) {
+  Reassign(pushed_.z, z, "ControlPipeline measurement");
+  pushed_.t = Clock::now();
+  bool did_push = measurements_.Push(pushed_);
+  if (!did_push) {
+    n_overruns_++;
+  }
+  return did_push;
+}
+
+template <typename Controller>
+inline void ControlPipeline<Controller>::Run() {
+  try {
+    Loop();
+  } catch (...) {
+    error_ = std::current_exception();
+  }
+  is_running_.store(false);
+}
+
+template <typename Controller>
+inline void ControlPipeline<Controller>::Loop() {
+  while (!do_stop_.load(std::memory_order_relaxed)) {
+    if (!measurements_.Pop(measurement_)) {
+      std::this_thread::yield();
+      continue;
+    }
+
+    const Vector& u =
+        do_output_reference_
+            ? controller_.ControlOutputReference(measurement_.z)
+            : controller_.Control(measurement_.z);
+    if (actuator_) {
+      actuator_(u);
+    }
+
+    if (deadline_ > 0) {
+      std::chrono::duration<data_t> latency = Clock::now() - measurement_.t;
+      if (latency.count() > deadline_) {
+        n_deadline_misses_++;
+      }
+    }
+
+    // publish
+    snapshot_.k = n_steps_.load(std::memory_order_relaxed);
+    snapshot_.u = u;
+    snapshot_.x = controller_.sys().x();
+    snapshot_.y = controller_.sys().y();
+    if (!snapshots_.Push(snapshot_)) {
+      n_dropped_snapshots_++;
+    }
+    n_steps_++;
+  }
+}
+
+}  // namespace lds
+
+#endif
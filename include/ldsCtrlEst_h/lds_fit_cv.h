@@ -0,0 +1,329 @@
+//===-- ldsCtrlEst_h/lds_fit_cv.h - Cross-Validation ------------*- C++ -*-===//
+//
+// Copyright 2021 Michael Bolus
+// Copyright 2021 Georgia Institute of Technology
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file declares the type for choosing the settings of a fit (model
+/// order, block-hankel size, SSID weighting, EM refinement) by k-fold
+/// cross-validation over trials (lds::CrossValidate).
+///
+/// \brief k-fold cross-validation
+//===----------------------------------------------------------------------===//
+
+#ifndef LDSCTRLEST_LDS_FIT_CV_H
+#define LDSCTRLEST_LDS_FIT_CV_H
+
+#include "lds_fit_em.h"
+#include "lds_fit_ssid.h"
+#include "lds_gaussian_fit.h"
+#include "lds_poisson_fit.h"
+
+#include <utility>
+
+namespace lds {
+
+/// Settings of a fit evaluated by cross-validation
+struct CVConfig {
+  /**
+   * @brief      Constructs new settings of a fit.
+   *
+   * @param      n_x        number of states
+   * @param      n_h        size of block-hankel data matrix (SSID)
+   * @param      ssid_wt    weight for singular value decomp (SSID)
+   * @param      n_iter_em  [optional] max number of EM iterations refining the
+   *                        SSID fit (0 = SSID only)
+   */
+  CVConfig(size_t n_x, size_t n_h, SSIDWt ssid_wt, size_t n_iter_em = 0)
+      : n_x(n_x), n_h(n_h), ssid_wt(ssid_wt), n_iter_em(n_iter_em){};
+
+  size_t n_x{};        ///< number of states
+  size_t n_h{};        ///< size of block-hankel data matrix (SSID)
+  SSIDWt ssid_wt{};    ///< weight for singular value decomp (SSID)
+  size_t n_iter_em{};  ///< max number of EM iterations (0 = SSID only)
+};
+
+namespace gaussian {
+/**
+ * Held-out data are filtered by a System with the parameters of the fit
+ * (System::Filter), and each measurement is scored under the predictive
+ * distribution N(C*x_pre + d, C*P_pre*C' + R) before it is assimilated.
+ *
+ * @brief      calculates one-step-ahead predictive log-likelihood of a trial
+ *
+ * @param      fit   fit
+ * @param      u     input
+ * @param      z     measurement
+ *
+ * @return     log-likelihood
+ */
+data_t PredictiveLogLik(const Fit& fit, const Matrix& u, const Matrix& z);
+}  // namespace gaussian
+
+namespace poisson {
+/**
+ * Held-out data are filtered by a System with the parameters of the fit
+ * (System::Filter), and each measurement is scored under a Poisson
+ * distribution with the predicted rate, exp(C*x_pre + d), before it is
+ * assimilated.
+ *
+ * @brief      calculates one-step-ahead predictive log-likelihood of a trial
+ *
+ * @param      fit   fit
+ * @param      u     input
+ * @param      z     measurement
+ *
+ * @return     log-likelihood
+ */
+data_t PredictiveLogLik(const Fit& fit, const Matrix& u, const Matrix& z);
+}  // namespace poisson
+
+/// k-fold Cross-Validation Type
+template <typename FitSSID, typename FitEM>
+class CrossValidate {
+ public:
+  /// fit type of EM type (e.g., lds::gaussian::Fit)
+  using Fit = typename std::decay<decltype(std::declval<FitEM&>().fit())>::type;
+
+  /**
+   * @brief      Constructs a new CrossValidate type.
+   */
+  CrossValidate() = default;
+
+  /**
+   * @brief      Constructs a new CrossValidate type.
+   *
+   * @param      dt      sample period
+   * @param      u_data  input data
+   * @param      z_data  measurement data
+   */
+  CrossValidate(data_t dt, UniformMatrixList<kMatFreeDim2>&& u_data,
+                UniformMatrixList<kMatFreeDim2>&& z_data);
+
+  /**
+   * Trial `k` is held out in fold `k % n_folds`. For every pair of fold and
+   * configuration, a fit is made by SSID (and optionally refined by EM) from
+   * the remaining trials and scored by the one-step-ahead predictive
+   * log-likelihood of the held-out trials (see gaussian::PredictiveLogLik,
+   * poisson::PredictiveLogLik). Folds are views of the data, which is never
+   * copied, and all fold-configuration pairs are fit concurrently (see
+   * set_n_threads).
+   *
+   * A pair that fails to fit (e.g., a block-hankel data matrix too large for
+   * the training data of a fold) is scored as -inf.
+   *
+   * @brief      Runs cross-validation
+   *
+   * @param      configs  settings of fits
+   * @param      n_folds  number of folds (<= number of trials)
+   *
+   * @return     best settings (greatest summed held-out log-likelihood)
+   */
+  const CVConfig& Run(const std::vector<CVConfig>& configs, size_t n_folds);
+
+  /**
+   * @brief      Returns the input/output data to caller.
+   *
+   * @return     tuple(input data, output data)
+   */
+  std::tuple<UniformMatrixList<kMatFreeDim2>, UniformMatrixList<kMatFreeDim2>>
+  ReturnData() {
+    auto tuple = std::make_tuple(std::move(u_), std::move(z_));
+    u_ = UniformMatrixList<kMatFreeDim2>();
+    z_ = UniformMatrixList<kMatFreeDim2>();
+    return tuple;
+  }
+
+  /// gets held-out log-likelihood of last run (configurations x folds)
+  const Matrix& log_lik() const { return log_lik_; };
+  /// gets index of best configuration of last run
+  size_t best_config() const { return best_config_; };
+
+  /// gets number of threads fold-configuration pairs are distributed across
+  size_t n_threads() const { return pool_ ? pool_->n_threads() : 1; };
+
+  /**
+   * @brief      sets number of threads fold-configuration pairs are
+   *             distributed across
+   *
+   * @param      n_threads  number of threads (1 = calling thread only, 0 =
+   *                        hardware concurrency)
+   */
+  void set_n_threads(size_t n_threads) {
+    if (n_threads == 1) {
+      pool_.reset();
+    } else {
+      pool_.reset(new ThreadPool(n_threads));
+    }
+  };
+
+  /// gets convergence tolerance of EM (max fractional abs change)
+  data_t em_tol() const { return em_tol_; };
+  /// sets convergence tolerance of EM (max fractional abs change)
+  void set_em_tol(data_t tol) { em_tol_ = tol; };
+
+  /**
+   * @brief      sets function called to configure each EM instance before it
+   *             is fit (e.g., to call set_accelerate)
+   *
+   * @param      fn    configuration function (empty = none)
+   */
+  void set_em_setup(std::function<void(FitEM&)> fn) {
+    em_setup_ = std::move(fn);
+  };
+
+ private:
+  /**
+   * @brief      fits settings to training trials
+   *
+   * @param      config  settings of fit
+   * @param      train   indices of training trials
+   *
+   * @return     fit
+   */
+  Fit FitTrials(const CVConfig& config, const std::vector<size_t>& train);
+
+  /**
+   * @brief      views trials of data without copying
+   *
+   * @param      data    data
+   * @param      trials  indices of trials
+   *
+   * @return     list of views of trials
+   */
+  static UniformMatrixList<kMatFreeDim2> ViewTrials(
+      UniformMatrixList<kMatFreeDim2>& data, const std::vector<size_t>& trials);
+
+  UniformMatrixList<kMatFreeDim2> u_;  ///< input data
+  UniformMatrixList<kMatFreeDim2> z_;  ///< measurement data
+  data_t dt_{};                        ///< sample period
+
+  std::vector<CVConfig> configs_;  ///< settings of fits of last run
+  Matrix log_lik_;                 ///< held-out log-likelihood
+  size_t best_config_{};           ///< index of best configuration
+
+  std::unique_ptr<ThreadPool> pool_;      ///< threads (null if serial)
+  data_t em_tol_{1e-2};                   ///< convergence tolerance of EM
+  std::function<void(FitEM&)> em_setup_;  ///< configures each EM instance
+};
+
+template <typename FitSSID, typename FitEM>
+CrossValidate<FitSSID, FitEM>::CrossValidate(
+    data_t dt, UniformMatrixList<kMatFreeDim2>&& u_data,
+    UniformMatrixList<kMatFreeDim2>&& z_data)
+    : dt_(dt) {
+  if (z_data.size() != u_data.size()) {
+    throw std::runtime_error("I/O data have different number of trials.");
+  }
+  u_ = std::move(u_data);
+  z_ = std::move(z_data);
+}
+
+template <typename FitSSID, typename FitEM>
+const CVConfig& CrossValidate<FitSSID, FitEM>::Run(
+    const std::vector<CVConfig>& configs, size_t n_folds) {
+  if (configs.empty()) {
+    throw std::runtime_error("CrossValidate needs at least one config.");
+  }
+  size_t n_trials = u_.size();
+  if ((n_folds < 2) || (n_folds > n_trials)) {
+    throw std::runtime_error(
+        "Number of folds must be in [2, number of trials].");
+  }
+  configs_ = configs;
+
+  // n.b., the train/test split of each fold is shared by all configs
+  std::vector<std::vector<size_t>> train(n_folds);
+  std::vector<std::vector<size_t>> test(n_folds);
+  for (size_t trial = 0; trial < n_trials; trial++) {
+    for (size_t fold = 0; fold < n_folds; fold++) {
+      (trial % n_folds == fold ? test : train)[fold].push_back(trial);
+    }
+  }
+
+  size_t n_configs = configs_.size();
+  log_lik_ = Matrix(n_configs, n_folds);
+  log_lik_.fill(-arma::datum::inf);
+
+  // n.b., each pair fits serially (ThreadPool::ParallelFor is not reentrant)
+  auto run_chunk = [&](size_t j_begin, size_t j_end) {
+    for (size_t j = j_begin; j < j_end; j++) {
+      size_t k = j / n_folds;
+      size_t fold = j % n_folds;
+      try {
+        Fit fit = FitTrials(configs_[k], train[fold]);
+        data_t log_lik = 0;
+        for (size_t trial : test[fold]) {
+          log_lik += PredictiveLogLik(fit, u_.at(trial), z_.at(trial));
+        }
+        // n.b., NaN (e.g., unstable fit) is scored as failure
+        log_lik_(k, fold) =
+            std::isfinite(log_lik) ? log_lik : -arma::datum::inf;
+      } catch (const std::runtime_error&) {
+        // e.g., too little training data for block-hankel data matrix
+        log_lik_(k, fold) = -arma::datum::inf;
+      }
+    }
+  };
+  if (pool_) {
+    pool_->ParallelFor(n_configs * n_folds, run_chunk);
+  } else {
+    run_chunk(0, n_configs * n_folds);
+  }
+
+  Vector log_lik_tot = arma::sum(log_lik_, 1);
+  best_config_ = log_lik_tot.index_max();
+  if (!std::isfinite(log_lik_tot[best_config_])) {
+    throw std::runtime_error("CrossValidate failed to fit any config.");
+  }
+  return configs_[best_config_];
+}
+
+template <typename FitSSID, typename FitEM>
+auto CrossValidate<FitSSID, FitEM>::FitTrials(
+    const CVConfig& config, const std::vector<size_t>& train) -> Fit {
+  FitSSID ssid(config.n_x, config.n_h, dt_, ViewTrials(u_, train),
+               ViewTrials(z_, train));
+  Fit fit = std::get<0>(ssid.Run(config.ssid_wt));
+  if (config.n_iter_em == 0) {
+    return fit;
+  }
+
+  FitEM em(fit, ViewTrials(u_, train), ViewTrials(z_, train));
+  if (em_setup_) {
+    em_setup_(em);
+  }
+  return em.Run(true, true, true, true, true, config.n_iter_em, em_tol_);
+}
+
+template <typename FitSSID, typename FitEM>
+UniformMatrixList<kMatFreeDim2> CrossValidate<FitSSID, FitEM>::ViewTrials(
+    UniformMatrixList<kMatFreeDim2>& data, const std::vector<size_t>& trials) {
+  std::vector<data_t*> mems(trials.size());
+  std::vector<std::array<size_t, 2>> dims(trials.size());
+  for (size_t k = 0; k < trials.size(); k++) {
+    // n.b., SSID and EM only read their training data
+    const Matrix& mat = data.at(trials[k]);
+    mems[k] = const_cast<data_t*>(mat.memptr());
+    dims[k] = {mat.n_rows, mat.n_cols};
+  }
+  return UniformMatrixList<kMatFreeDim2>(mems, dims);
+}
+
+}  // namespace lds
+
+#endif
@@ -21,6 +21,11 @@
 /// This file declares the type for fitting a linear dynamical system by
 /// expectation-maximization (lds::EM).
 ///
+/// References:
+/// [1] Varadhan R, Roland C. (2008) Simple and Globally Convergent Methods for
+/// Accelerating the Convergence of Any EM Algorithm. Scandinavian Journal of
+/// Statistics 35(2).
+///
 /// \brief subspace identification
 //===----------------------------------------------------------------------===//
 
@@ -28,9 +33,28 @@
 #define LDSCTRLEST_LDS_EMAX_H
 
 #include "lds_fit.h"
+// thread pool
+#include "lds_thread_pool.h"
+// BLAS threading policy
+#include "lds_blas.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <memory>
 
 namespace lds {
 
+/// Progress of fitting by expectation-maximization (see EM::Run)
+struct EMStats {
+  size_t n_iter{};          ///< number of iterations run
+  size_t n_e_steps{};       ///< number of E steps (filter/smoother passes)
+  size_t n_extrapolated{};  ///< number of accepted accelerated steps
+  data_t log_lik{};         ///< log-likelihood of data at most recent E step
+  data_t max_dtheta{};      ///< max fractional abs change in parameters
+  bool is_converged{};      ///< whether converged
+};
+
 template <typename Fit>
 class EM {
   static_assert(std::is_base_of<lds::Fit, Fit>::value,
@@ -80,6 +104,15 @@ class EM {
    * @param      tol               convergence tolerance (max fractional abs
    *                               change)
    *
+   * Each iteration is reported to the progress callback (if set), and the
+   * progress of the last run can be retrieved by `stats()`. Besides the
+   * parameter tolerance, the fit is also considered converged once the
+   * relative change in marginal log-likelihood falls below `log_lik_tol`.
+   *
+   * If acceleration is enabled (see set_accelerate), each iteration takes
+   * two EM steps and extrapolates the parameters along the resulting path
+   * (SQUAREM [1]). n.b., such an iteration costs two or three E steps.
+   *
    * @return     Fit
    */
   const Fit& Run(bool calc_dynamics = true, bool calc_Q = true,
@@ -101,6 +134,9 @@ class EM {
     return tuple;
   }
 
+  /// gets fit (i.e., current parameters)
+  const Fit& fit() const { return fit_; };
+
   /// gets estimated state (over time)
   const std::vector<Matrix>& x() const { return x_; };
   /// gets estimated output (over time)
@@ -112,12 +148,118 @@ class EM {
   const Matrix& sum_E_xu_tm1_xu_tm1() const { return sum_E_xu_tm1_xu_tm1_; };
   /// gets single lag state-input covariance
   const Matrix& sum_E_xu_t_xu_tm1() const { return sum_E_xu_t_xu_tm1_; };
+  /// gets sum of state estimates (current time)
+  const Vector& sum_E_x_t() const { return sum_E_x_t_; };
+  /// gets measurement-state covariance (current time)
+  const Matrix& sum_z_x_t() const { return sum_z_x_t_; };
+  /// gets sum of measurements (current time)
+  const Vector& sum_z_t() const { return sum_z_t_; };
+  /// gets measurement covariance (current time)
+  const Matrix& sum_z_z_t() const { return sum_z_z_t_; };
   /// total number of time samples
   size_t n_t_tot() { return n_t_tot_; }
 
   /// gets parameters updated in M step
   const Vector& theta() const { return theta_; };
 
+  /// gets progress of last run
+  const EMStats& stats() const { return stats_; };
+
+  /// gets whether iterations are accelerated (SQUAREM)
+  bool accelerate() const { return accelerate_; };
+
+  /**
+   * Rather than plain EM steps, each iteration extrapolates the parameters
+   * along two EM steps by the squared iterative method of [1] (SQUAREM),
+   * which typically converges in a fraction of the iterations. The
+   * extrapolated step is only accepted if it does not decrease the marginal
+   * log-likelihood; otherwise the iteration falls back to the plain EM step.
+   *
+   * @brief      sets whether iterations are accelerated (SQUAREM)
+   *
+   * @param      accelerate  whether to accelerate
+   */
+  void set_accelerate(bool accelerate) { accelerate_ = accelerate; };
+
+  /// gets convergence tolerance (relative change in log-likelihood)
+  data_t log_lik_tol() const { return log_lik_tol_; };
+
+  /**
+   * @brief      sets convergence tolerance (relative change in log-likelihood)
+   *
+   * @param      tol   relative tolerance (e.g., 1e-6; 0 = parameters only)
+   */
+  void set_log_lik_tol(data_t tol) { log_lik_tol_ = tol; };
+
+  /**
+   * @brief      sets function called with progress after every iteration
+   *
+   * @param      fn    progress callback (empty = none)
+   */
+  void set_progress_callback(std::function<void(const EMStats&)> fn) {
+    progress_callback_ = std::move(fn);
+  };
+
+  /// gets number of threads trials are distributed across in E step
+  size_t n_threads() const { return pool_ ? pool_->n_threads() : 1; };
+
+  /**
+   * @brief      sets number of threads trials are distributed across in E step
+   *
+   * @param      n_threads  number of threads (1 = calling thread only, 0 =
+   *                        hardware concurrency)
+   */
+  void set_n_threads(size_t n_threads) {
+    if (n_threads == 1) {
+      pool_.reset();
+    } else {
+      pool_.reset(new ThreadPool(n_threads));
+    }
+  };
+
+  /// gets memory budget of smoother (bytes, 0 = unbounded)
+  size_t smoother_memory() const { return smoother_memory_; };
+
+  /**
+   * Unless unbounded, the filtered estimates of a trial are only stored at
+   * checkpoints during the forward pass and each segment between checkpoints
+   * is re-filtered during the backward pass (i.e., at most one extra forward
+   * pass), such that the filter storage of the smoother stays within budget.
+   *
+   * n.b., the budget applies to each trial being smoothed concurrently (see
+   * set_n_threads) and does not include the smoothed state and output
+   * estimates that are returned (x, y) or smoothed covariances kept over
+   * time if the M step needs them.
+   *
+   * @brief      sets memory budget of smoother
+   *
+   * @param      n_bytes  memory budget (bytes, 0 = unbounded)
+   */
+  void set_smoother_memory(size_t n_bytes);
+
+  /// gets whether filter covariances kept by smoother are packed
+  bool packed_cov() const { return packed_cov_; };
+
+  /**
+   * Stores the filter covariances the smoother keeps over time (and at
+   * checkpoints; see set_smoother_memory) as packed upper triangles (see
+   * PackSym), which nearly halves their memory (and so lengthens segments
+   * within a memory budget). As they are then symmetric by construction,
+   * they are not re-symmetrized during the backward pass, and the symmetric
+   * covariance terms of the sufficient statistics are accumulated in upper
+   * triangles only.
+   *
+   * n.b., trials are not smoothed in parallel over time (see
+   * DoesSmoothByScan) if packed, as that keeps full covariances, and
+   * smoothed covariances kept over time for the M step (see DoesStoreCov)
+   * are not packed.
+   *
+   * @brief      sets whether filter covariances kept by smoother are packed
+   *
+   * @param      packed_cov  whether to pack
+   */
+  void set_packed_cov(bool packed_cov);
+
  protected:
   /**
    * @brief      Expectation step
@@ -158,15 +300,237 @@ class EM {
    */
   void Smooth(bool force_common_initial);
 
+  /// Sufficient statistics of a trial needed in M step (sums over t>0)
+  struct SufficientStats {
+    Matrix x_t_x_t;        ///< state covariance (current time)
+    Matrix xu_tm1_xu_tm1;  ///< state-input covariance (t-minus-1)
+    Matrix xu_t_xu_tm1;    ///< single lag state-input covariance
+    Vector x_t;            ///< state estimate (current time)
+    Matrix z_x_t;          ///< measurement-state covariance (current time)
+    Vector z_t;            ///< measurement (current time)
+    Matrix z_z_t;          ///< measurement covariance (current time)
+    size_t n_t{};          ///< number of time steps
+    data_t log_lik{};      ///< marginal log-likelihood of measurements
+  };
+
+  /// Scratch reused between time steps by LogLikelihood
+  struct LikelihoodCache {
+    Matrix chol_s;       ///< Cholesky factor of innovation cov
+    data_t log_det_s{};  ///< log-determinant of innovation cov
+  };
+
+  /**
+   * @brief      get smoothed estimates of a single trial
+   *
+   * The sufficient statistics are accumulated during the backward pass, so
+   * that the smoothed state covariances do not need to be kept over time
+   * (see DoesStoreCov).
+   *
+   * n.b., only touches per-trial data and local scratch, so that different
+   * trials can be smoothed concurrently.
+   *
+   * @param      trial                 trial index
+   * @param      force_common_initial  whether to force common initial
+   *                                   conditions
+   * @param      stats                 [out] sufficient statistics of trial
+   */
+  void SmoothTrial(size_t trial, bool force_common_initial,
+                   SufficientStats& stats);
+
+  /**
+   * @brief      get smoothed estimates of all trials
+   *
+   * Trials are smoothed by SmoothTrial, distributed across threads, except
+   * those smoothed in parallel over time (see DoesSmoothByScan), which are
+   * smoothed one after another, each using all threads.
+   *
+   * @param      force_common_initial  whether to force common initial
+   *                                   conditions
+   * @param      stats                 [out] sufficient statistics of trials
+   */
+  void SmoothTrials(bool force_common_initial,
+                    std::vector<SufficientStats>& stats);
+
+  /**
+   * @brief      sets initial conditions of a trial before smoothing
+   *
+   * @param      trial                 trial index
+   * @param      force_common_initial  whether to force common initial
+   *                                   conditions
+   */
+  void InitSmoothTrial(size_t trial, bool force_common_initial);
+
+  /// zeros sufficient statistics (sized to the model)
+  void InitStats(SufficientStats& stats) const;
+
+  /**
+   * @brief      whether trial is smoothed in parallel over time
+   *
+   * By default, every trial is smoothed serially in time (SmoothTrial).
+   * Override along with ScanSmoothTrial to smooth long trials in parallel.
+   *
+   * @param      trial  trial index
+   *
+   * @return     whether to smooth trial by ScanSmoothTrial
+   */
+  virtual bool DoesSmoothByScan(size_t /* trial */) const { return false; }
+
+  /**
+   * @brief      get smoothed estimates of a single trial, in parallel over
+   *             time (by default, same as SmoothTrial)
+   *
+   * n.b., called from the calling thread only, so it may use all threads
+   * (see ForEach).
+   *
+   * @param      trial                 trial index
+   * @param      force_common_initial  whether to force common initial
+   *                                   conditions
+   * @param      stats                 [out] sufficient statistics of trial
+   */
+  virtual void ScanSmoothTrial(size_t trial, bool force_common_initial,
+                               SufficientStats& stats) {
+    SmoothTrial(trial, force_common_initial, stats);
+  }
+
+  /**
+   * @brief      runs forward filter over a segment of a trial
+   *
+   * n.b., buffers are indexed relative to the segment: element 0 must hold
+   * the posterior estimate at `t_begin-1` and element `t-t_begin+1` receives
+   * the estimates at time t.
+   *
+   * @param      trial    trial index
+   * @param      t_begin  first time of segment
+   * @param      t_end    last time of segment
+   * @param      x_pre    predicted state est.
+   * @param      x_post   posterior state est.
+   * @param      p_pre    cov of predicted state est.
+   * @param      p_post   cov of posterior state est.
+   * @param      y        output est.
+   * @param      Ke       [out] estimator gain at t_end
+   * @param      log_lik  [optional, out] accumulates marginal log-likelihood
+   *                      of measurements over segment
+   * @param      p_pre_pk   [optional, out] packed cov of predicted state est.
+   *                        (column per element; see PackSym)
+   * @param      p_post_pk  [optional, out] packed cov of posterior state est.
+   *
+   * n.b., if packed covariances are given, p_pre and p_post are working
+   * covariances of two slices each: slice 0 must hold the posterior cov at
+   * `t_begin-1` (as must column 0 of p_post_pk), and slice 1 receives the
+   * covariances at t.
+   *
+   * @return     index within segment from which covariances and gain are
+   *             constant (see steady_state_tol_; past the end if never)
+   */
+  size_t FilterSegment(size_t trial, size_t t_begin, size_t t_end,
+                       Matrix& x_pre, Matrix& x_post, Cube& p_pre,
+                       Cube& p_post, Matrix& y, Matrix& Ke,
+                       data_t* log_lik = nullptr, Matrix* p_pre_pk = nullptr,
+                       Matrix* p_post_pk = nullptr);
+
+  /**
+   * @brief      length of smoother segments that keeps within memory budget
+   *
+   * @param      n_t   number of time steps of trial
+   *
+   * @return     number of time steps per segment
+   */
+  size_t SmootherSegmentLength(size_t n_t) const;
+
+  /// whether x has converged to x_prev (relative infinity-norm tolerance)
+  static bool IsConverged(const Matrix& x, const Matrix& x_prev, data_t tol) {
+    return norm(x - x_prev, "inf") <= tol * norm(x_prev, "inf");
+  }
+
+  /**
+   * @brief      accumulate covariance terms of sufficient statistics of a
+   *             single time step
+   *
+   * @param      p_t      smoothed state cov at t
+   * @param      p_tm1    smoothed state cov at t-1
+   * @param      p_t_tm1  smoothed single-lag state cov (t, t-1)
+   * @param      stats    [out] sufficient statistics of trial
+   * @param      is_upper [optional] whether to accumulate the upper triangles
+   *                      of symmetric terms only (see set_packed_cov)
+   */
+  void AccumulateCovStats(const Matrix& p_t, const Matrix& p_tm1,
+                          const Matrix& p_t_tm1, SufficientStats& stats,
+                          bool is_upper = false);
+
+  /**
+   * @brief      accumulate terms of sufficient statistics that depend on the
+   *             smoothed state estimates (and data) of a whole trial
+   *
+   * n.b., formed as products of the states/inputs/measurements stacked over
+   * time (i.e., matrix-matrix products), once the trial has been smoothed.
+   *
+   * @param      trial  trial index
+   * @param      stats  [out] sufficient statistics of trial
+   */
+  void AccumulateMeanStats(size_t trial, SufficientStats& stats);
+
+  /**
+   * @brief      whether smoothed state cov must be kept over time (P_)
+   *
+   * By default, only the initial state cov is kept, as all other second
+   * moments are accumulated as sufficient statistics. Override if M step
+   * needs the full sequence.
+   *
+   * @return     whether to store P_ over time
+   */
+  virtual bool DoesStoreCov() const { return false; }
+
+  /**
+   * @brief      called before each E step (e.g., to precompute quantities
+   *             derived from the parameters that the E step uses)
+   */
+  virtual void PrepareExpectation() {}
+
+  /**
+   * @brief      calls `fn(trial)` for every trial (in parallel if n_threads>1)
+   *
+   * @param      fn    function of trial index
+   */
+  template <typename F>
+  void ForEachTrial(const F& fn) {
+    ForEach(n_trials_, fn);
+  }
+
+  /**
+   * @brief      calls `fn(k)` for k in [0,n) (in parallel if n_threads>1)
+   *
+   * @param      n     number of calls
+   * @param      fn    function of index
+   */
+  template <typename F>
+  void ForEach(size_t n, const F& fn);
+
   /**
    * @brief      recursively update estimator gain Ke
    *
    * @param      Ke      estimator gain
    * @param      P_pre   cov of predicted state est.
    * @param      P_post  cov of postior sate est.
+   * @param      y_pre   predicted output at time t
    * @param[in]  t       time
    */
-  virtual void RecurseKe(Matrix& Ke, Cube& P_pre, Cube& P_post, size_t t) = 0;
+  virtual void RecurseKe(Matrix& Ke, Cube& P_pre, Cube& P_post,
+                         const Vector& y_pre, size_t t) = 0;
+
+  /**
+   * @brief      log-likelihood of measurement given past measurements
+   *
+   * @param      z          measurement at time t
+   * @param      y_pre      predicted output at time t
+   * @param      P_pre      cov of predicted state est. at time t
+   * @param      is_steady  whether P_pre is the same as at previous call
+   * @param      cache      scratch reused between time steps
+   *
+   * @return     log-likelihood
+   */
+  virtual data_t LogLikelihood(const Vector& z, const Vector& y_pre,
+                               const Matrix& P_pre, bool is_steady,
+                               LikelihoodCache& cache) const = 0;
 
   /**
    * @brief      reset to initial conditions
@@ -185,19 +549,41 @@ class EM {
    */
   Vector UpdateTheta();
 
+  /**
+   * @brief      sets fit parameters from parameter list (see UpdateTheta)
+   *
+   * @param      theta  parameter list
+   */
+  void SetTheta(const Vector& theta);
+
+  /**
+   * @brief      runs an accelerated iteration (SQUAREM)
+   *
+   * n.b., expects the E step to have been run at the current parameters and
+   * leaves it run at the updated parameters.
+   *
+   * @param      force_common_initial  whether to force common initial
+   *                                   conditions
+   * @param      maximize              function running the M step
+   */
+  template <typename F>
+  void AcceleratedStep(bool force_common_initial, const F& maximize);
+
   // input/output training data
   UniformMatrixList<kMatFreeDim2> u_;  ///< input training data
   UniformMatrixList<kMatFreeDim2> z_;  ///< measurement training data
   std::vector<Matrix> x_;              ///< state estimate
-  std::vector<Cube> P_;                ///< state estimate cov
-  std::vector<Cube> P_t_tm1_;          ///< single-lag state covariance
+  std::vector<Cube> P_;  ///< state estimate cov (initial only, unless stored)
   std::vector<Matrix> y_;              ///< output estimate
-  Matrix diag_y_;
 
   // expectations calculated in E-step
   Matrix sum_E_x_t_x_t_;        ///< state covariance (current time)
   Matrix sum_E_xu_tm1_xu_tm1_;  ///< state-input covariance (t-minus-1)
   Matrix sum_E_xu_t_xu_tm1_;    ///< single lag state-input covariance
+  Vector sum_E_x_t_;            ///< state estimate (current time)
+  Matrix sum_z_x_t_;            ///< measurement-state covariance
+  Vector sum_z_t_;              ///< measurement (current time)
+  Matrix sum_z_z_t_;            ///< measurement covariance
 
   Fit fit_;
   Vector theta_;
@@ -209,6 +595,23 @@ class EM {
   size_t n_trials_{};        ///< number of input/output data sequences
   std::vector<size_t> n_t_;  ///< number of time steps
   size_t n_t_tot_{};         ///< total number of time steps across trials
+
+  std::unique_ptr<ThreadPool> pool_;  ///< E-step threads (null if serial)
+  size_t smoother_memory_{};          ///< smoother budget (bytes, 0 = inf)
+  bool packed_cov_{};  ///< whether smoother keeps filter covariances packed
+
+  /// Tolerance for detecting that filter/smoother covariances have reached
+  /// steady state, after which they (and the gains) are held constant
+  /// (0 = never). n.b., only valid if the covariance recursion does not
+  /// depend on the data (i.e., Gaussian observations).
+  data_t steady_state_tol_{};
+
+  data_t log_lik_{};            ///< log-likelihood of data at last E step
+  bool accelerate_{};           ///< whether to accelerate (SQUAREM)
+  data_t log_lik_tol_{};        ///< log-likelihood tolerance (0 = none)
+  data_t squarem_step_max_{1};  ///< current max SQUAREM step length
+  EMStats stats_;               ///< progress of last run
+  std::function<void(const EMStats&)> progress_callback_;  ///< progress fn
 };
 
 template <typename Fit>
@@ -259,6 +662,10 @@ void EM<Fit>::InitVars() {
           "I/O training data have different number of time steps.");
     }
     n_t_[trial] = u_.at(trial).n_cols;
+    if (n_t_[trial] < 2) {
+      throw std::runtime_error(
+          "I/O training data must have at least two time steps.");
+    }
     n_t_tot_ += n_t_[trial];
   }
 
@@ -269,153 +676,531 @@ void EM<Fit>::InitVars() {
 
   x_ = std::vector<Matrix>(n_trials_);
   P_ = std::vector<Cube>(n_trials_);
-  P_t_tm1_ = std::vector<Cube>(n_trials_);
   y_ = std::vector<Matrix>(n_trials_);
   for (size_t trial = 0; trial < n_trials_; trial++) {
     x_[trial] = Matrix(n_x_, n_t_[trial], fill::zeros);
-    P_[trial] = Cube(n_x_, n_x_, n_t_[trial], fill::zeros);
-    P_t_tm1_[trial] = Cube(n_x_, n_x_, n_t_[trial], fill::zeros);
+    P_[trial] = Cube(n_x_, n_x_, 1, fill::zeros);  // sized in E step
     y_[trial] = Matrix(n_y_, n_t_[trial], fill::zeros);
   }
 
-  diag_y_ = Matrix(n_y_, n_y_, fill::zeros);
-
   // covariances in expectation step
   sum_E_x_t_x_t_ = Matrix(n_x_, n_x_, fill::zeros);
   sum_E_xu_tm1_xu_tm1_ = Matrix(n_x_ + n_u_, n_x_ + n_u_, fill::zeros);
   sum_E_xu_t_xu_tm1_ = Matrix(n_x_ + n_u_, n_x_ + n_u_, fill::zeros);
+  sum_E_x_t_ = Vector(n_x_, fill::zeros);
+  sum_z_x_t_ = Matrix(n_y_, n_x_, fill::zeros);
+  sum_z_t_ = Vector(n_y_, fill::zeros);
+  sum_z_z_t_ = Matrix(n_y_, n_y_, fill::zeros);
 }
 
 template <typename Fit>
 const Fit& EM<Fit>::Run(bool calc_dynamics, bool calc_Q, bool calc_init,
                         bool calc_output, bool calc_measurement,
                         size_t max_iter, data_t tol) {
+  BlasThreadScope blas(kBlasWorkFit);
   Reset();  // to initial conditions
-
-  size_t n_params =
-      3 * n_x_ * n_x_ + n_x_ * n_u_ + n_x_ + n_y_ * n_x_ + n_y_ * n_y_;
-  Vector theta(n_params);
-  Vector theta_new(n_params);
-  data_t max_dtheta = 1;
+  stats_ = EMStats();
+  squarem_step_max_ = 1;
 
   // if solving for initial conditions, allow them be varied.
   // otherwise, freeze at provided values.
   bool force_common_initial = !calc_init;
-
-  // go until parameter convergence
-  for (size_t l = 0; l < max_iter; l++) {
-    theta_ = UpdateTheta();
-
-    std::cout << "Iteration " << l + 1 << "/" << max_iter << " ...\n";
-
-    Expectation(force_common_initial);
+  auto maximize = [&]() {
     Maximization(calc_dynamics, calc_Q, calc_init, calc_output,
                  calc_measurement);
+  };
 
-    // check convergence
-    theta_new = UpdateTheta();
+  // n.b., accelerated iterations start and end with the E step run
+  if (accelerate_) {
+    Expectation(force_common_initial);
+    stats_.n_e_steps++;
+  }
+
+  // go until convergence
+  theta_ = UpdateTheta();
+  for (size_t l = 0; l < max_iter; l++) {
+    data_t log_lik_prev = log_lik_;
+    bool has_log_lik_prev = accelerate_ || (l > 0);
+
+    if (accelerate_) {
+      AcceleratedStep(force_common_initial, maximize);
+    } else {
+      Expectation(force_common_initial);
+      stats_.n_e_steps++;
+      maximize();
+    }
 
+    // check convergence
+    Vector theta_new = UpdateTheta();
     Vector dtheta = abs(theta_new - theta_) / abs(theta_);
     // some parameters could be zero...
     arma::uvec ubi_finite = find_finite(dtheta);
+    theta_ = std::move(theta_new);
+
+    stats_.n_iter = l + 1;
+    stats_.log_lik = log_lik_;
+    stats_.max_dtheta = max(dtheta.elem(ubi_finite));
+    stats_.is_converged = stats_.max_dtheta < tol;
+    if ((log_lik_tol_ > 0) && has_log_lik_prev) {
+      data_t dlog_lik = std::abs(log_lik_ - log_lik_prev);
+      stats_.is_converged |= dlog_lik < log_lik_tol_ * std::abs(log_lik_prev);
+    }
 
-    max_dtheta = max(dtheta.elem(ubi_finite));
-    std::cout << "max dtheta: " << max_dtheta << "\n";
-    if (max_dtheta < tol) {
-      std::cout << "Converged.\n";
+    if (progress_callback_) {
+      progress_callback_(stats_);
+    }
+    if (stats_.is_converged) {
       break;
     }
-
-    std::cout << "\n";
   }
 
   return fit_;
 }
 
+template <typename Fit>
+template <typename F>
+void EM<Fit>::AcceleratedStep(bool force_common_initial, const F& maximize) {
+  // Varadhan, Roland (2008): the two EM steps theta_1 = M(theta_0) and
+  // theta_2 = M(theta_1) are extrapolated to
+  // theta_0 - 2*alpha*r + alpha^2*v, where r = theta_1 - theta_0 and
+  // v = theta_2 - theta_1 - r, with step length alpha = -|r|/|v| (<= -1).
+  Vector theta_0 = UpdateTheta();
+  maximize();
+  Vector theta_1 = UpdateTheta();
+  Expectation(force_common_initial);
+  stats_.n_e_steps++;
+  data_t log_lik_1 = log_lik_;
+  maximize();
+  Vector theta_2 = UpdateTheta();
+
+  Vector r = theta_1 - theta_0;
+  Vector v = theta_2 - theta_1 - r;
+  data_t norm_r = norm(r);
+  data_t norm_v = norm(v);
+  data_t alpha = -1;  // i.e., plain EM step (theta_2)
+  if (norm_v > 0) {
+    alpha = std::min(data_t(-1), -norm_r / norm_v);
+    alpha = std::max(-squarem_step_max_, alpha);
+  }
+
+  bool is_extrapolated = false;
+  if (alpha < -1) {
+    // keep initial conditions of trials in case extrapolation is rejected
+    std::vector<Vector> x0(n_trials_);
+    std::vector<Matrix> p0(n_trials_);
+    for (size_t trial = 0; trial < n_trials_; trial++) {
+      x0[trial] = x_[trial].col(0);
+      p0[trial] = P_[trial].slice(0);
+    }
+
+    try {
+      SetTheta(theta_0 - 2 * alpha * r + alpha * alpha * v);
+      Expectation(force_common_initial);
+      stats_.n_e_steps++;
+      // safeguard: extrapolation must not decrease likelihood
+      is_extrapolated = std::isfinite(log_lik_) && (log_lik_ >= log_lik_1);
+    } catch (const std::runtime_error&) {
+      // e.g., extrapolated covariances are not positive definite
+    }
+
+    // grow max step length while it is accepted; shrink when rejected
+    const data_t step_factor = 4;
+    if (is_extrapolated) {
+      stats_.n_extrapolated++;
+      if (alpha == -squarem_step_max_) {
+        squarem_step_max_ *= step_factor;
+      }
+    } else {
+      squarem_step_max_ = std::max(data_t(1), squarem_step_max_ / step_factor);
+      for (size_t trial = 0; trial < n_trials_; trial++) {
+        x_[trial].col(0) = x0[trial];
+        P_[trial].slice(0) = p0[trial];
+      }
+    }
+  }
+
+  if (!is_extrapolated) {
+    SetTheta(theta_2);
+    Expectation(force_common_initial);
+    stats_.n_e_steps++;
+  }
+}  // AcceleratedStep
+
 template <typename Fit>
 void EM<Fit>::Smooth(bool force_common_initial) {
-  Matrix k_e(n_x_, n_y_);  // estimator gain
-  Cube k_backfilt;         // back-filtering gains
+  std::vector<SufficientStats> stats(n_trials_);
+  SmoothTrials(force_common_initial, stats);
+}  // Smooth
 
-  // TODO(mfbolus): this loop could be made parallel
-  for (size_t trial = 0; trial < z_.size(); trial++) {
-    Matrix x_pre(n_x_, n_t_[trial], fill::zeros);
-    Cube p_pre(n_x_, n_x_, n_t_[trial], fill::zeros);
-    Matrix x_post(n_x_, n_t_[trial], fill::zeros);
-    Cube p_post(n_x_, n_x_, n_t_[trial], fill::zeros);
-
-    if (force_common_initial)  // forces all trials to have same initial
-                               // conditions.
-    {
-      x_[trial].col(0) = fit_.x0();
-      P_[trial].slice(0) = fit_.P0();
+template <typename Fit>
+void EM<Fit>::SmoothTrials(bool force_common_initial,
+                           std::vector<SufficientStats>& stats) {
+  stats.resize(n_trials_);
+  ForEachTrial([&](size_t trial) {
+    if (!DoesSmoothByScan(trial)) {
+      SmoothTrial(trial, force_common_initial, stats[trial]);
     }
-    y_[trial].col(0) = fit_.C() * x_[trial].col(0) + fit_.d();
+  });
+  // n.b., the pool is not reentrant, so these are not nested in ForEachTrial
+  for (size_t trial = 0; trial < n_trials_; trial++) {
+    if (DoesSmoothByScan(trial)) {
+      ScanSmoothTrial(trial, force_common_initial, stats[trial]);
+    }
+  }
+}  // SmoothTrials
+
+template <typename Fit>
+void EM<Fit>::InitSmoothTrial(size_t trial, bool force_common_initial) {
+  bool do_store_cov = DoesStoreCov();
+  if (P_[trial].n_slices != (do_store_cov ? n_t_[trial] : 1)) {
+    P_[trial].resize(n_x_, n_x_, do_store_cov ? n_t_[trial] : 1);
+  }
 
-    // This *should not* be necessary but make sure P is symmetric.
-    ForceSymPD(P_[trial].slice(0));
+  if (force_common_initial)  // forces all trials to have same initial
+                             // conditions.
+  {
+    x_[trial].col(0) = fit_.x0();
+    P_[trial].slice(0) = fit_.P0();
+  }
+  y_[trial].col(0) = fit_.C() * x_[trial].col(0) + fit_.d();
 
-    x_pre.col(0) = x_[trial].col(0);
-    p_pre.slice(0) = P_[trial].slice(0);
+  // This *should not* be necessary but make sure P is symmetric.
+  ForceSymPD(P_[trial].slice(0));
+}  // InitSmoothTrial
+
+template <typename Fit>
+void EM<Fit>::InitStats(SufficientStats& stats) const {
+  stats.x_t_x_t = Matrix(n_x_, n_x_, fill::zeros);
+  stats.xu_tm1_xu_tm1 = Matrix(n_x_ + n_u_, n_x_ + n_u_, fill::zeros);
+  stats.xu_t_xu_tm1 = Matrix(n_x_ + n_u_, n_x_ + n_u_, fill::zeros);
+  stats.x_t = Vector(n_x_, fill::zeros);
+  stats.z_x_t = Matrix(n_y_, n_x_, fill::zeros);
+  stats.z_t = Vector(n_y_, fill::zeros);
+  stats.z_z_t = Matrix(n_y_, n_y_, fill::zeros);
+  stats.n_t = 0;
+  stats.log_lik = 0;
+}  // InitStats
+
+template <typename Fit>
+template <typename F>
+void EM<Fit>::ForEach(size_t n, const F& fn) {
+  auto run_chunk = [&](size_t k_begin, size_t k_end) {
+    for (size_t k = k_begin; k < k_end; k++) {
+      fn(k);
+    }
+  };
+
+  if (pool_) {
+    pool_->ParallelFor(n, run_chunk);
+  } else {
+    run_chunk(0, n);
+  }
+}
 
-    x_post.col(0) = x_[trial].col(0);
-    p_post.slice(0) = P_[trial].slice(0);
+template <typename Fit>
+void EM<Fit>::SmoothTrial(size_t trial, bool force_common_initial,
+                          SufficientStats& stats) {
+  bool do_store_cov = DoesStoreCov();
+  InitSmoothTrial(trial, force_common_initial);
+
+  // The trial is filtered in segments [1 + k*n_seg_t, (k+1)*n_seg_t], of
+  // which only the initial (posterior) estimates are checkpointed during the
+  // forward pass. Each segment is then re-filtered during the backward pass.
+  // n.b., if there is a single segment, there is no separate forward pass.
+  size_t t_end = n_t_[trial] - 1;
+  size_t n_seg_t = SmootherSegmentLength(n_t_[trial]);
+  size_t n_seg = (t_end + n_seg_t - 1) / n_seg_t;
+  bool do_steady_state = steady_state_tol_ > 0;
+
+  // n.b., if packed (see set_packed_cov), covariances over time are kept as
+  // columns of p_pre_pk, p_post_pk, and p_check_pk, while p_pre and p_post
+  // only hold the (unpacked) ones being worked on
+  bool is_packed = packed_cov_;
+  size_t n_pk = is_packed ? n_x_ * (n_x_ + 1) / 2 : 0;
+  size_t n_cov = is_packed ? 2 : n_seg_t + 1;
 
-    // filter
-    for (size_t t = 1; t < n_t_[trial]; t++) {
-      // predict
-      fit_.f(x_pre, x_post, u_.at(trial), t);
-      fit_.h(y_[trial], x_pre, t);
-      diag_y_.diag() = y_[trial].col(t);  // TODO(mfbolus): change if parallel
+  Matrix k_e(n_x_, n_y_);  // estimator gain
+  Matrix x_pre(n_x_, n_seg_t + 1, fill::zeros);
+  Cube p_pre(n_x_, n_x_, n_cov, fill::zeros);
+  Matrix x_post(n_x_, n_seg_t + 1, fill::zeros);
+  Cube p_post(n_x_, n_x_, n_cov, fill::zeros);
+  Matrix y(n_y_, n_seg_t + 1, fill::zeros);
+  Matrix p_pre_pk(n_pk, n_seg_t + 1, fill::zeros);   // packed p_pre
+  Matrix p_post_pk(n_pk, n_seg_t + 1, fill::zeros);  // packed p_post
+  Matrix* p_pre_out = is_packed ? &p_pre_pk : nullptr;
+  Matrix* p_post_out = is_packed ? &p_post_pk : nullptr;
+
+  Matrix x_check(n_x_, n_seg);      // checkpointed posterior state est.
+  Cube p_check(n_x_, n_x_, is_packed ? 0 : n_seg);  // checkpointed cov
+  Matrix p_check_pk(n_pk, n_seg);                   // packed p_check
+  x_check.col(0) = x_[trial].col(0);
+  if (is_packed) {
+    PackSym(P_[trial].slice(0), p_check_pk.colptr(0));
+  } else {
+    p_check.slice(0) = P_[trial].slice(0);
+  }
 
-      // update --> posterior estimation
-      RecurseKe(k_e, p_pre, p_post, t);
-      x_post.col(t) =
-          x_pre.col(t) + k_e * (z_.at(trial).col(t) - y_[trial].col(t));
-      y_[trial].col(t) = fit_.C() * x_post.col(t) + fit_.d();
+  // (posterior at checkpoint k is the initial estimate of segment k)
+  auto load_check = [&](size_t k) {
+    x_post.col(0) = x_check.col(k);
+    if (is_packed) {
+      p_post_pk.col(0) = p_check_pk.col(k);
+      UnpackSym(p_check_pk.colptr(k), p_post.slice(0));
+    } else {
+      p_post.slice(0) = p_check.slice(k);
     }
+  };
+
+  // forward pass (checkpoints only)
+  for (size_t k = 0; k + 1 < n_seg; k++) {
+    load_check(k);
+    FilterSegment(trial, 1 + k * n_seg_t, (k + 1) * n_seg_t, x_pre, x_post,
+                  p_pre, p_post, y, k_e, nullptr, p_pre_out, p_post_out);
+    x_check.col(k + 1) = x_post.col(n_seg_t);
+    if (is_packed) {
+      p_check_pk.col(k + 1) = p_post_pk.col(n_seg_t);
+    } else {
+      p_check.slice(k + 1) = p_post.slice(n_seg_t);
+    }
+  }
 
-    // backfilter -> Smoothed estimate
-    // Reference:
-    // Shumway et Stoffer (1982)
-    ForceSymPD(p_post.slice(n_t_[trial] - 1));
-    k_backfilt = Cube(n_x_, n_x_, n_t_[trial], fill::zeros);
-    x_[trial].col(n_t_[trial] - 1) = x_post.col(n_t_[trial] - 1);
-    P_[trial].slice(n_t_[trial] - 1) = p_post.slice(n_t_[trial] - 1);
-    for (size_t t = (n_t_[trial] - 1); t > 0; t--) {
+  // backfilter -> Smoothed estimate
+  // Reference:
+  // Shumway et Stoffer (1982)
+  // n.b., smoothed covariances are only needed at t, t-1 to accumulate the
+  // sufficient statistics, so they are not kept over time unless required.
+  InitStats(stats);
+
+  Matrix id(n_x_, n_x_, fill::eye);
+  Matrix p_t;             // smoothed cov at t
+  Matrix p_tm1;           // smoothed cov at t-1
+  Matrix p_tp1_t;         // smoothed single-lag cov (t+1, t)
+  Matrix p_t_tm1;         // smoothed single-lag cov (t, t-1)
+  Matrix k_backfilt;      // back-filtering gain from t to t-1
+  Matrix k_backfilt_tp1;  // back-filtering gain from t+1 to t
+  for (size_t k = n_seg; k-- > 0;) {
+    size_t t_begin = 1 + k * n_seg_t;
+    size_t t_last = std::min((k + 1) * n_seg_t, t_end);
+    load_check(k);
+    // n.b., each segment is filtered exactly once here, so the likelihood is
+    // accumulated during this pass
+    size_t j_steady =
+        FilterSegment(trial, t_begin, t_last, x_pre, x_post, p_pre, p_post, y,
+                      k_e, &stats.log_lik, p_pre_out, p_post_out);
+
+    size_t j_last = t_last - t_begin + 1;
+    if (is_packed) {
+      // n.b., going backward, the posterior cov at t is that unpacked at t+1
+      UnpackSym(p_post_pk.colptr(j_last), p_post.slice(0));
+    } else {
       // TODO(mfmbolus): should not be necessary to force symm positive def
-      ForceSymPD(p_pre.slice(t));
-      ForceSymPD(p_post.slice(t - 1));
-      ForceSymPD(P_[trial].slice(t));
-      k_backfilt.slice(t - 1) =
-          p_post.slice(t - 1) * fit_.A().t() * inv_sympd(p_pre.slice(t));
+      ForceSymPD(p_post.slice(j_last));
+    }
+    if (t_last == t_end) {
+      x_[trial].col(t_end) = x_post.col(j_last);
+      p_t = p_post.slice(is_packed ? 0 : j_last);
+    }
+
+    // n.b., once the filter has reached steady state, so does the
+    // back-filtering gain. Smoothed covariances then typically converge as
+    // well (going backward), after which they are also held constant.
+    bool is_smoothed_steady = false;
+    for (size_t t = t_last; t >= t_begin; t--) {
+      size_t j = t - t_begin + 1;  // index within segment
+
+      // slices of predicted cov at t and posterior cov at t-1 (j_post - 1)
+      // and t (j_post)
+      size_t j_pre = j;
+      size_t j_post = j;
+      if (is_packed) {
+        j_pre = 0;
+        j_post = 1;
+        p_post.slice(1) = p_post.slice(0);
+        UnpackSym(p_pre_pk.colptr(j), p_pre.slice(0));
+        UnpackSym(p_post_pk.colptr(j - 1), p_post.slice(0));
+      }
+
+      bool is_steady = do_steady_state && (j < j_last) && (j > j_steady);
+      if (is_steady) {
+        k_backfilt = k_backfilt_tp1;
+      } else {
+        is_smoothed_steady = false;
+        if (!is_packed) {
+          ForceSymPD(p_pre.slice(j_pre));
+          ForceSymPD(p_post.slice(j_post - 1));
+        }
+        k_backfilt = p_post.slice(j_post - 1) * fit_.A().t() *
+                     inv_sympd(p_pre.slice(j_pre));
+      }
+
+      if (is_smoothed_steady) {
+        p_t_tm1 = p_tp1_t;
+        p_tm1 = p_t;
+      } else {
+        // single-lag cov
+        if (t == t_end) {
+          p_t_tm1 =
+              (id - k_e * fit_.C()) * fit_.A() * p_post.slice(j_post - 1);
+        } else {
+          p_t_tm1 =
+              p_post.slice(j_post) * k_backfilt.t() +
+              k_backfilt_tp1 * (p_tp1_t - fit_.A() * p_post.slice(j_post)) *
+                  k_backfilt.t();
+        }
+
+        p_tm1 = p_post.slice(j_post - 1) +
+                k_backfilt * (p_t - p_pre.slice(j_pre)) * k_backfilt.t();
+        ForceSymPD(p_tm1);
+
+        is_smoothed_steady =
+            is_steady && IsConverged(p_tm1, p_t, steady_state_tol_) &&
+            IsConverged(p_t_tm1, p_tp1_t, steady_state_tol_);
+      }
+
       x_[trial].col(t - 1) =
-          x_post.col(t - 1) +
-          k_backfilt.slice(t - 1) * (x_[trial].col(t) - x_pre.col(t));
-      P_[trial].slice(t - 1) =
-          p_post.slice(t - 1) + k_backfilt.slice(t - 1) *
-                                    (P_[trial].slice(t) - p_pre.slice(t)) *
-                                    k_backfilt.slice(t - 1).t();
+          x_post.col(j - 1) + k_backfilt * (x_[trial].col(t) - x_pre.col(j));
+
+      AccumulateCovStats(p_t, p_tm1, p_t_tm1, stats, is_packed);
+      if (do_store_cov) {
+        P_[trial].slice(t) = p_t;
+      }
+
+      p_t.swap(p_tm1);
+      p_tp1_t.swap(p_t_tm1);
+      k_backfilt_tp1.swap(k_backfilt);
     }
+  }
+  P_[trial].slice(0) = p_t;
+  if (is_packed) {
+    // n.b., symmetric terms were accumulated in upper triangles only
+    stats.x_t_x_t = symmatu(stats.x_t_x_t);
+    Matrix x_tm1_x_tm1 = stats.xu_tm1_xu_tm1.submat(0, 0, n_x_ - 1, n_x_ - 1);
+    stats.xu_tm1_xu_tm1.submat(0, 0, n_x_ - 1, n_x_ - 1) =
+        symmatu(x_tm1_x_tm1);
+  }
+  AccumulateMeanStats(trial, stats);
 
-    // do the same for P_t_tm1
-    Matrix id(n_x_, n_x_, fill::eye);
-    P_t_tm1_[trial].slice(n_t_[trial] - 1) =
-        (id - k_e * fit_.C()) * fit_.A() * p_post.slice(n_t_[trial] - 2);
-    for (size_t t = (n_t_[trial] - 1); t > 1; t--) {
-      P_t_tm1_[trial].slice(t - 1) =
-          p_post.slice(t - 1) * k_backfilt.slice(t - 2).t() +
-          k_backfilt.slice(t - 1) *
-              (P_t_tm1_[trial].slice(t) - fit_.A() * p_post.slice(t - 1)) *
-              k_backfilt.slice(t - 2).t();
+  // finally, get smoothed estimate of output
+  for (size_t t = 0; t < n_t_[trial]; t++) {
+    fit_.h(y_[trial], x_[trial], t);
+  }  // samps loop
+}  // SmoothTrial
+
+template <typename Fit>
+size_t EM<Fit>::FilterSegment(size_t trial, size_t t_begin, size_t t_end,
+                              Matrix& x_pre, Matrix& x_post, Cube& p_pre,
+                              Cube& p_post, Matrix& y, Matrix& Ke,
+                              data_t* log_lik, Matrix* p_pre_pk,
+                              Matrix* p_post_pk) {
+  // inputs over segment, s.t. input at t-1 has same index as estimates at t-1
+  Matrix u = u_.at(trial).cols(t_begin - 1, t_end - 1);
+  LikelihoodCache cache;
+  bool is_packed = p_pre_pk && p_post_pk;
+
+  size_t j_steady = t_end - t_begin + 2;  // past the end
+  for (size_t t = t_begin; t <= t_end; t++) {
+    size_t j = t - t_begin + 1;  // index within segment
+    size_t k = is_packed ? 1 : j;  // slice of covariances at t
+
+    // predict
+    fit_.f(x_pre, x_post, u, j);
+    fit_.h(y, x_pre, j);
+
+    // update --> posterior estimation
+    if (j > j_steady) {
+      // steady state: covariances and gain (Ke) stay the same
+      if (is_packed) {
+        p_pre_pk->col(j) = p_pre_pk->col(j - 1);
+        p_post_pk->col(j) = p_post_pk->col(j - 1);
+      } else {
+        p_pre.slice(j) = p_pre.slice(j - 1);
+        p_post.slice(j) = p_post.slice(j - 1);
+      }
+    } else {
+      RecurseKe(Ke, p_pre, p_post, y.col(j), k);
+      if (steady_state_tol_ > 0 && j > 1 &&
+          IsConverged(p_post.slice(k), p_post.slice(k - 1),
+                      steady_state_tol_)) {
+        j_steady = j;
+      }
+      if (is_packed) {
+        PackSym(p_pre.slice(k), p_pre_pk->colptr(j));
+        PackSym(p_post.slice(k), p_post_pk->colptr(j));
+        p_post.slice(k - 1) = p_post.slice(k);  // initial cov of next step
+      }
     }
+    if (log_lik) {
+      *log_lik += LogLikelihood(z_.at(trial).col(t), y.col(j), p_pre.slice(k),
+                                j > j_steady, cache);
+    }
+    x_post.col(j) = x_pre.col(j) + Ke * (z_.at(trial).col(t) - y.col(j));
+    y.col(j) = fit_.C() * x_post.col(j) + fit_.d();
+    y_[trial].col(t) = y.col(j);
+  }
 
-    // finally, get smoothed estimate of output
-    for (size_t t = 0; t < n_t_[trial]; t++) {
-      fit_.h(y_[trial], x_[trial], t);
-    }  // samps loop
-  }    // trial loop
-}  // Smooth
+  return j_steady;
+}  // FilterSegment
+
+template <typename Fit>
+size_t EM<Fit>::SmootherSegmentLength(size_t n_t) const {
+  size_t t_end = n_t - 1;  // number of time steps to filter
+  if (smoother_memory_ == 0 || t_end < 2) {
+    return t_end;
+  }
+
+  // memory of filter storage per time step of segment, per checkpoint
+  size_t n_cov = packed_cov_ ? n_x_ * (n_x_ + 1) / 2 : n_x_ * n_x_;
+  size_t n_bytes_t = (2 * n_cov + 2 * n_x_ + n_y_ + n_u_) * sizeof(data_t);
+  size_t n_bytes_check = (n_cov + n_x_) * sizeof(data_t);
+  auto n_bytes = [&](size_t n_seg_t) {
+    return (n_seg_t + 1) * n_bytes_t +
+           (t_end + n_seg_t - 1) / n_seg_t * n_bytes_check;
+  };
+
+  if (n_bytes(t_end) <= smoother_memory_) {
+    return t_end;  // no need for checkpoints
+  }
+
+  // segment length minimizing memory
+  auto n_seg_t = static_cast<size_t>(std::ceil(
+      std::sqrt(static_cast<data_t>(t_end) * n_bytes_check / n_bytes_t)));
+  n_seg_t = std::max(std::min(n_seg_t, t_end), size_t(1));
+  if (n_bytes(n_seg_t) > smoother_memory_) {
+    throw std::runtime_error(
+        "Smoother memory budget is too small for length of training data.");
+  }
+  return n_seg_t;
+}
+
+template <typename Fit>
+void EM<Fit>::set_smoother_memory(size_t n_bytes) {
+  size_t n_bytes_orig = smoother_memory_;
+  smoother_memory_ = n_bytes;
+  try {
+    // make sure budget is sufficient for all trials
+    for (size_t trial = 0; trial < n_trials_; trial++) {
+      SmootherSegmentLength(n_t_[trial]);
+    }
+  } catch (const std::runtime_error&) {
+    smoother_memory_ = n_bytes_orig;
+    throw;
+  }
+}
+
+template <typename Fit>
+void EM<Fit>::set_packed_cov(bool packed_cov) {
+  bool packed_cov_orig = packed_cov_;
+  packed_cov_ = packed_cov;
+  try {
+    // n.b., unpacking may exceed the memory budget
+    for (size_t trial = 0; trial < n_trials_; trial++) {
+      SmootherSegmentLength(n_t_[trial]);
+    }
+  } catch (const std::runtime_error&) {
+    packed_cov_ = packed_cov_orig;
+    throw;
+  }
+}
 
 // template <typename Fit>
 // void EM<Fit>::RecurseKe(Matrix& Ke, Cube& P_pre, Cube& P_post, size_t t) {
@@ -442,42 +1227,81 @@ void EM<Fit>::Smooth(bool force_common_initial) {
 
 template <typename Fit>
 void EM<Fit>::Expectation(bool force_common_initial) {
-  // calculate the mean/cov of state needed for maximizing E[pr(z|theta)]
-  Smooth(force_common_initial);
+  // calculate the mean/cov of state needed for maximizing E[pr(z|theta)] and
+  // the various forms of sum(E[xx']) needed, trial by trial
+  // n.b., partial sums are kept per trial and reduced in trial order so that
+  // the result does not depend on the number of threads.
+  PrepareExpectation();
+  std::vector<SufficientStats> stats(n_trials_);
+  SmoothTrials(force_common_initial, stats);
 
-  // now get the various forms of sum(E[xx']) needed
   // n.b. Going to start at t=1 rather than 0 bc most max terms need that.
   // so really "n_t_tot_" is (n_t_tot_-1)
   n_t_tot_ = 0;
-  sum_E_x_t_x_t_ = Matrix(n_x_, n_x_, fill::zeros);
-  sum_E_xu_tm1_xu_tm1_ = Matrix(n_x_ + n_u_, n_x_ + n_u_, fill::zeros);
-  sum_E_xu_t_xu_tm1_ = Matrix(n_x_ + n_u_, n_x_ + n_u_, fill::zeros);
+  log_lik_ = 0;
+  sum_E_x_t_x_t_.zeros();
+  sum_E_xu_tm1_xu_tm1_.zeros();
+  sum_E_xu_t_xu_tm1_.zeros();
+  sum_E_x_t_.zeros();
+  sum_z_x_t_.zeros();
+  sum_z_t_.zeros();
+  sum_z_z_t_.zeros();
+  for (size_t trial = 0; trial < n_trials_; trial++) {
+    sum_E_x_t_x_t_ += stats[trial].x_t_x_t;
+    sum_E_xu_tm1_xu_tm1_ += stats[trial].xu_tm1_xu_tm1;
+    sum_E_xu_t_xu_tm1_ += stats[trial].xu_t_xu_tm1;
+    sum_E_x_t_ += stats[trial].x_t;
+    sum_z_x_t_ += stats[trial].z_x_t;
+    sum_z_t_ += stats[trial].z_t;
+    sum_z_z_t_ += stats[trial].z_z_t;
+    n_t_tot_ += stats[trial].n_t;
+    log_lik_ += stats[trial].log_lik;
+  }
+}  // Expectation
 
-  Vector xu_tm1(n_x_ + n_u_, fill::zeros);
-  Vector xu_t(n_x_ + n_u_, fill::zeros);
+template <typename Fit>
+void EM<Fit>::AccumulateCovStats(const Matrix& p_t, const Matrix& p_tm1,
+                                 const Matrix& p_t_tm1,
+                                 SufficientStats& stats, bool is_upper) {
+  if (is_upper) {
+    for (size_t c = 0; c < n_x_; c++) {
+      const data_t* p_t_c = p_t.colptr(c);
+      const data_t* p_tm1_c = p_tm1.colptr(c);
+      data_t* x_t_x_t_c = stats.x_t_x_t.colptr(c);
+      data_t* x_tm1_x_tm1_c = stats.xu_tm1_xu_tm1.colptr(c);
+      for (size_t r = 0; r <= c; r++) {
+        x_t_x_t_c[r] += p_t_c[r];
+        x_tm1_x_tm1_c[r] += p_tm1_c[r];
+      }
+    }
+  } else {
+    stats.x_t_x_t += p_t;
+    stats.xu_tm1_xu_tm1.submat(0, 0, n_x_ - 1, n_x_ - 1) += p_tm1;
+  }
+  stats.xu_t_xu_tm1.submat(0, 0, n_x_ - 1, n_x_ - 1) += p_t_tm1;
+  stats.n_t += 1;
+}  // AccumulateCovStats
 
-  for (size_t trial = 0; trial < z_.size(); trial++) {
-    for (size_t t = 1; t < n_t_[trial]; t++) {
-      // ------------ sum_E_x_t_x_t ------------
-      sum_E_x_t_x_t_ += x_[trial].col(t) * x_[trial].col(t).t();
-      sum_E_x_t_x_t_ += P_[trial].slice(t);
-
-      // ------------ sum_E_xu_tm1_xu_tm1 ------------
-      xu_tm1 = join_vert(x_[trial].col(t - 1), u_.at(trial).col(t - 1));
-      sum_E_xu_tm1_xu_tm1_ += xu_tm1 * xu_tm1.t();
-      sum_E_xu_tm1_xu_tm1_.submat(0, 0, n_x_ - 1, n_x_ - 1) +=
-          P_[trial].slice(t - 1);
-
-      // ------------ sum_E_xu_t_xu_tm1 ------------
-      xu_t = join_vert(x_[trial].col(t), u_.at(trial).col(t));
-      sum_E_xu_t_xu_tm1_ += xu_t * xu_tm1.t();
-      sum_E_xu_t_xu_tm1_.submat(0, 0, n_x_ - 1, n_x_ - 1) +=
-          P_t_tm1_[trial].slice(t);
-
-      n_t_tot_ += 1;
-    }  // time
-  }    // trial
-}  // Expectation
+template <typename Fit>
+void EM<Fit>::AccumulateMeanStats(size_t trial, SufficientStats& stats) {
+  // states/inputs, measurements stacked over time (t-1 and t, for t>0)
+  size_t n_t = n_t_[trial] - 1;
+  Matrix xu = join_vert(x_[trial], u_.at(trial));
+  const Matrix& z = z_.at(trial);
+  const Matrix xu_tm1(xu.colptr(0), n_x_ + n_u_, n_t, false, true);
+  const Matrix xu_t(xu.colptr(1), n_x_ + n_u_, n_t, false, true);
+  const Matrix x_t(x_[trial].colptr(1), n_x_, n_t, false, true);
+  const Matrix z_t(const_cast<data_t*>(z.colptr(1)), n_y_, n_t, false, true);
+
+  // n.b., X*X' products are symmetric rank-k updates
+  stats.x_t_x_t += x_t * x_t.t();
+  stats.x_t += sum(x_t, 1);
+  stats.xu_tm1_xu_tm1 += xu_tm1 * xu_tm1.t();
+  stats.xu_t_xu_tm1 += xu_t * xu_tm1.t();
+  stats.z_x_t += z_t * x_t.t();
+  stats.z_t += sum(z_t, 1);
+  stats.z_z_t += z_t * z_t.t();
+}  // AccumulateMeanStats
 
 template <typename Fit>
 void EM<Fit>::Maximization(bool calc_dynamics, bool calc_Q, bool calc_init,
@@ -510,8 +1334,6 @@ void EM<Fit>::MaximizeDynamics() {
               inv_sympd(sum_E_xu_tm1_xu_tm1_);
   fit_.set_A(ab.submat(0, 0, n_x_ - 1, n_x_ - 1));
   fit_.set_B(ab.submat(0, n_x_, n_x_ - 1, n_x_ + n_u_ - 1));
-  std::cout << "A_new[0]: " << fit_.A()[0] << "\n";
-  std::cout << "B_new[0]: " << fit_.B()[0] << "\n";
 }
 
 template <typename Fit>
@@ -561,8 +1383,6 @@ void EM<Fit>::MaximizeQ() {
   q /= n_t_tot_;
 
   fit_.set_Q(q);
-  std::cout << "Q_new[0]: " << fit_.Q()[0] << "\n";
-  // std::cout << "Q_new: \n" << fit_.Q() << "\n";
 }
 
 template <typename Fit>
@@ -573,7 +1393,6 @@ void EM<Fit>::MaximizeInitial() {
     x0 += x_[trial].col(0);
   }
   x0 /= z_.size();
-  std::cout << "x0_new[0]: " << x0[0] << "\n";
 
   // always recalc P0 even if the initial state is fixed (at zero, for
   // example)
@@ -597,49 +1416,30 @@ void EM<Fit>::MaximizeInitial() {
   p0 /= z_.size();
 
   fit_.set_P0(p0);
-  std::cout << "P0_new[0]: " << fit_.P0()[0] << "\n";
 }
 
 template <typename Fit>
 void EM<Fit>::MaximizeOutput() {
   // solve for C+d:
-  Matrix sum_zx(n_y_, n_x_ + 1, fill::zeros);
-  Vector x1(n_x_ + 1, fill::zeros);
-  x1[n_x_] = 1.0;  // augment with one to solve for bias
+  // (augment state with one to solve for bias)
+  Matrix sum_zx = join_horiz(sum_z_x_t_, sum_z_t_);
   Matrix sum_e_x1_x1(n_x_ + 1, n_x_ + 1, fill::zeros);
-  for (size_t trial = 0; trial < z_.size(); trial++) {
-    for (size_t t = 1; t < n_t_[trial]; t++) {
-      x1.subvec(0, n_x_ - 1) = x_[trial].col(t);
-      sum_zx += z_.at(trial).col(t) * x1.t();
-      sum_e_x1_x1 += x1 * x1.t();
-      sum_e_x1_x1.submat(0, 0, n_x_ - 1, n_x_ - 1) += P_[trial].slice(t);
-    }
-  }
+  sum_e_x1_x1.submat(0, 0, n_x_ - 1, n_x_ - 1) = sum_E_x_t_x_t_;
+  sum_e_x1_x1.submat(0, n_x_, n_x_ - 1, n_x_) = sum_E_x_t_;
+  sum_e_x1_x1.submat(n_x_, 0, n_x_, n_x_ - 1) = sum_E_x_t_.t();
+  sum_e_x1_x1(n_x_, n_x_) = n_t_tot_;
   Matrix cd = sum_zx * inv_sympd(sum_e_x1_x1);
   fit_.set_C(cd.submat(0, 0, n_y_ - 1, n_x_ - 1));
   fit_.set_d(vectorise(cd.submat(0, n_x_, n_y_ - 1, n_x_)));
-  std::cout << "C_new[0]: " << fit_.C()[0] << "\n";
-  std::cout << "d_new[0]: " << fit_.d()[0] << "\n";
 }
 
 template <typename Fit>
 void EM<Fit>::MaximizeMeasurement() {
   // Solve for measurement noise covar
-  size_t n_t_tot = 0;
   // Ghahgramani, Hinton 1996:
-  Matrix sum_zz(n_y_, n_y_, fill::zeros);
-  Matrix sum_yz(n_y_, n_y_, fill::zeros);
-  for (size_t trial = 0; trial < z_.size(); trial++) {
-    for (size_t t = 1; t < n_t_[trial]; t++) {
-      sum_zz += z_.at(trial).col(t) * z_.at(trial).col(t).t();
-      // Use Cnew:
-      sum_yz +=
-          (fit_.C() * x_[trial].col(t) + fit_.d()) * z_.at(trial).col(t).t();
-      n_t_tot += 1;
-    }
-  }
-  fit_.set_R((sum_zz - sum_yz) / n_t_tot);
-  std::cout << "R_new[0]: " << fit_.R()[0] << "\n";
+  // Use Cnew:
+  Matrix sum_yz = fit_.C() * sum_z_x_t_.t() + fit_.d() * sum_z_t_.t();
+  fit_.set_R((sum_z_z_t_ - sum_yz) / n_t_tot_);
 }
 
 template <typename Fit>
@@ -683,6 +1483,28 @@ Vector EM<Fit>::UpdateTheta() {
   return theta;
 }
 
+template <typename Fit>
+void EM<Fit>::SetTheta(const Vector& theta) {
+  size_t idx_start = 0;
+  auto next = [&](size_t n_rows, size_t n_cols) {
+    Matrix x = reshape(theta.subvec(idx_start, idx_start + n_rows * n_cols - 1),
+                       n_rows, n_cols);
+    idx_start += n_rows * n_cols;
+    return x;
+  };
+
+  fit_.set_A(next(n_x_, n_x_));
+  fit_.set_B(next(n_x_, n_u_));
+  fit_.set_Q(next(n_x_, n_x_));
+  fit_.set_x0(vectorise(next(n_x_, 1)));
+  fit_.set_P0(next(n_x_, n_x_));
+  fit_.set_C(next(n_y_, n_x_));
+  fit_.set_d(vectorise(next(n_y_, 1)));
+  if (fit_.R().n_elem > 0) {
+    fit_.set_R(next(n_y_, n_y_));
+  }
+}
+
 }  // namespace lds
 
 #endif
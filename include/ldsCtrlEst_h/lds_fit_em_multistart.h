@@ -0,0 +1,336 @@
+//===-- ldsCtrlEst_h/lds_fit_em_multistart.h - Multi-Start EM ---*- C++ -*-===//
+//
+// Copyright 2021 Michael Bolus
+// Copyright 2021 Georgia Institute of Technology
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file declares the type for fitting a linear dynamical system by
+/// expectation-maximization from multiple perturbed initial fits
+/// (lds::MultiStartEM).
+///
+/// \brief multi-start expectation-maximization
+//===----------------------------------------------------------------------===//
+
+#ifndef LDSCTRLEST_LDS_FIT_EM_MULTISTART_H
+#define LDSCTRLEST_LDS_FIT_EM_MULTISTART_H
+
+#include "lds_fit_em.h"
+
+#include <random>
+#include <utility>
+
+namespace lds {
+
+/// Multi-start EM Fit Type
+template <typename FitEM>
+class MultiStartEM {
+ public:
+  /// fit type of EM type (e.g., lds::gaussian::Fit)
+  using Fit = typename std::decay<decltype(std::declval<FitEM&>().fit())>::type;
+
+  /**
+   * @brief      Constructs a new MultiStartEM Fit type.
+   */
+  MultiStartEM() = default;
+
+  /**
+   * @brief      Constructs a new MultiStartEM Fit type.
+   *
+   * @param      fit0     initial fit (e.g., by SSID)
+   * @param      u_train  input training data
+   * @param      z_train  measurement training data
+   */
+  MultiStartEM(const Fit& fit0, UniformMatrixList<kMatFreeDim2>&& u_train,
+               UniformMatrixList<kMatFreeDim2>&& z_train);
+
+  /**
+   * The initial fit is used as the first start and `n_starts-1` further
+   * starts are drawn by perturbing its dynamics and output matrices (see
+   * set_perturb_scale). All starts are fit by EM concurrently (see
+   * set_n_threads), each reading the same training data in place.
+   *
+   * Every `prune_iter` iterations, the starts are ranked by marginal
+   * log-likelihood and the poorest fraction is dropped (see
+   * set_prune_fraction), such that most iterations are spent on the best
+   * start(s).
+   *
+   * @brief      Runs fitting by EM from multiple starts
+   *
+   * @param      n_starts          number of starts
+   * @param      calc_dynamics     [optional] whether to caclulate dynamics (A,
+   *                               B)
+   * @param      calc_Q            [optional] whether to calculate process noise
+   *                               covariance
+   * @param      calc_init         [optional] whether to calculate initial
+   *                               conditions
+   * @param      calc_output       [optional] whether to calculate output
+   *                               function
+   * @param      calc_measurement  [optional] whether to calculate parameters
+   *                               for measurement/observation law
+   * @param      max_iter          max number of iterations (per start)
+   * @param      tol               convergence tolerance (max fractional abs
+   *                               change)
+   *
+   * @return     best Fit
+   */
+  const Fit& Run(size_t n_starts, bool calc_dynamics = true,
+                 bool calc_Q = true, bool calc_init = true,
+                 bool calc_output = true, bool calc_measurement = true,
+                 size_t max_iter = 100, data_t tol = 1e-2);
+
+  /**
+   * @brief      Returns the input/output data to caller.
+   *
+   * @return     tuple(input data, output data)
+   */
+  std::tuple<UniformMatrixList<kMatFreeDim2>, UniformMatrixList<kMatFreeDim2>>
+  ReturnData() {
+    auto tuple = std::make_tuple(std::move(u_), std::move(z_));
+    u_ = UniformMatrixList<kMatFreeDim2>();
+    z_ = UniformMatrixList<kMatFreeDim2>();
+    return tuple;
+  }
+
+  /// gets best fit of last run
+  const Fit& fit() const { return fit_; };
+  /// gets index of best start of last run
+  size_t best_start() const { return best_start_; };
+  /// gets log-likelihood of each start (when last fit; -inf if failed)
+  const Vector& log_lik() const { return log_lik_; };
+  /// gets number of iterations each start was fit
+  const std::vector<size_t>& n_iter() const { return n_iter_; };
+
+  /// gets number of threads starts are distributed across
+  size_t n_threads() const { return pool_ ? pool_->n_threads() : 1; };
+
+  /**
+   * @brief      sets number of threads starts are distributed across
+   *
+   * @param      n_threads  number of threads (1 = calling thread only, 0 =
+   *                        hardware concurrency)
+   */
+  void set_n_threads(size_t n_threads) {
+    if (n_threads == 1) {
+      pool_.reset();
+    } else {
+      pool_.reset(new ThreadPool(n_threads));
+    }
+  };
+
+  /// gets scale of perturbations of starts
+  data_t perturb_scale() const { return perturb_scale_; };
+  /**
+   * @brief      sets scale of perturbations of starts
+   *
+   * @param      scale  standard deviation of fractional perturbation of each
+   *                    element of A, B, C
+   */
+  void set_perturb_scale(data_t scale) { perturb_scale_ = scale; };
+
+  /// gets seed of random perturbations
+  std::mt19937::result_type seed() const { return seed_; };
+  /// sets seed of random perturbations
+  void set_seed(std::mt19937::result_type seed) { seed_ = seed; };
+
+  /// gets number of iterations between pruning of starts
+  size_t prune_iter() const { return prune_iter_; };
+  /// sets number of iterations between pruning of starts (0 = never prune)
+  void set_prune_iter(size_t n_iter) { prune_iter_ = n_iter; };
+
+  /// gets fraction of remaining starts dropped at each pruning
+  data_t prune_fraction() const { return prune_fraction_; };
+  /// sets fraction of remaining starts dropped at each pruning
+  void set_prune_fraction(data_t fraction) { prune_fraction_ = fraction; };
+
+  /**
+   * @brief      sets function called to configure each EM instance before it
+   *             is fit (e.g., to call set_accelerate)
+   *
+   * @param      fn    configuration function (empty = none)
+   */
+  void set_em_setup(std::function<void(FitEM&)> fn) {
+    em_setup_ = std::move(fn);
+  };
+
+ private:
+  /**
+   * @brief      draws a perturbed start
+   *
+   * @param      rng   random number generator
+   *
+   * @return     perturbed fit
+   */
+  Fit Perturb(std::mt19937& rng) const;
+
+  /**
+   * @brief      views training data without copying
+   *
+   * @param      data  training data
+   *
+   * @return     list of views of data
+   */
+  static UniformMatrixList<kMatFreeDim2> ViewData(
+      UniformMatrixList<kMatFreeDim2>& data);
+
+  Fit fit0_;                           ///< initial fit
+  Fit fit_;                            ///< best fit
+  UniformMatrixList<kMatFreeDim2> u_;  ///< input training data
+  UniformMatrixList<kMatFreeDim2> z_;  ///< measurement training data
+
+  Vector log_lik_;              ///< log-likelihood of each start
+  std::vector<size_t> n_iter_;  ///< number of iterations of each start
+  size_t best_start_{};         ///< index of best start
+
+  std::unique_ptr<ThreadPool> pool_;  ///< threads (null if serial)
+  data_t perturb_scale_{0.1};         ///< scale of perturbations
+  std::mt19937::result_type seed_{};  ///< seed of perturbations
+  size_t prune_iter_{10};             ///< iterations between pruning
+  data_t prune_fraction_{0.5};        ///< fraction of starts pruned
+  std::function<void(FitEM&)> em_setup_;  ///< configures each EM instance
+};
+
+template <typename FitEM>
+MultiStartEM<FitEM>::MultiStartEM(const Fit& fit0,
+                                  UniformMatrixList<kMatFreeDim2>&& u_train,
+                                  UniformMatrixList<kMatFreeDim2>&& z_train)
+    : fit0_(fit0), fit_(fit0) {
+  u_ = std::move(u_train);
+  z_ = std::move(z_train);
+}
+
+template <typename FitEM>
+auto MultiStartEM<FitEM>::Run(size_t n_starts, bool calc_dynamics,
+                              bool calc_Q, bool calc_init, bool calc_output,
+                              bool calc_measurement, size_t max_iter,
+                              data_t tol) -> const Fit& {
+  if (n_starts == 0) {
+    throw std::runtime_error("MultiStartEM needs at least one start.");
+  }
+
+  // n.b., starts are drawn serially, so they do not depend on threads
+  std::mt19937 rng(seed_);
+  std::vector<FitEM> ems;
+  ems.reserve(n_starts);
+  for (size_t k = 0; k < n_starts; k++) {
+    ems.emplace_back(k == 0 ? fit0_ : Perturb(rng), ViewData(u_),
+                     ViewData(z_));
+    if (em_setup_) {
+      em_setup_(ems.back());
+    }
+  }
+
+  log_lik_ = Vector(n_starts);
+  log_lik_.fill(-arma::datum::inf);
+  n_iter_ = std::vector<size_t>(n_starts, 0);
+  std::vector<char> is_done(n_starts, false);  // converged or failed
+  std::vector<size_t> starts(n_starts);        // remaining starts
+  for (size_t k = 0; k < n_starts; k++) {
+    starts[k] = k;
+  }
+
+  size_t n_iter_round = prune_iter_ > 0 ? prune_iter_ : max_iter;
+  for (size_t n_iter_done = 0; n_iter_done < max_iter;) {
+    n_iter_round = std::min(n_iter_round, max_iter - n_iter_done);
+
+    std::vector<size_t> running;
+    for (size_t k : starts) {
+      if (!is_done[k]) {
+        running.push_back(k);
+      }
+    }
+    if (running.empty()) {
+      break;
+    }
+
+    // n.b., EM::Run continues from the current parameters of each start
+    auto run_chunk = [&](size_t j_begin, size_t j_end) {
+      for (size_t j = j_begin; j < j_end; j++) {
+        size_t k = running[j];
+        try {
+          ems[k].Run(calc_dynamics, calc_Q, calc_init, calc_output,
+                     calc_measurement, n_iter_round, tol);
+          log_lik_[k] = ems[k].stats().log_lik;
+          n_iter_[k] += ems[k].stats().n_iter;
+          is_done[k] = ems[k].stats().is_converged;
+        } catch (const std::runtime_error&) {
+          // e.g., perturbed start is numerically unstable
+          log_lik_[k] = -arma::datum::inf;
+          is_done[k] = true;
+        }
+      }
+    };
+    if (pool_) {
+      pool_->ParallelFor(running.size(), run_chunk);
+    } else {
+      run_chunk(0, running.size());
+    }
+    n_iter_done += n_iter_round;
+
+    // prune poorest starts (n.b., stable, so ties keep lower index)
+    std::stable_sort(starts.begin(), starts.end(), [&](size_t a, size_t b) {
+      return log_lik_[a] > log_lik_[b];
+    });
+    if (prune_iter_ > 0) {
+      auto n_prune =
+          static_cast<size_t>(std::floor(prune_fraction_ * starts.size()));
+      starts.resize(std::max(starts.size() - std::min(n_prune, starts.size()),
+                             size_t(1)));
+    }
+  }
+
+  best_start_ = starts[0];
+  if (!std::isfinite(log_lik_[best_start_])) {
+    throw std::runtime_error("MultiStartEM failed to fit any start.");
+  }
+  fit_ = ems[best_start_].fit();
+
+  return fit_;
+}
+
+template <typename FitEM>
+auto MultiStartEM<FitEM>::Perturb(std::mt19937& rng) const -> Fit {
+  std::normal_distribution<data_t> randn(0, perturb_scale_);
+  auto perturb = [&](Matrix x) {
+    for (size_t k = 0; k < x.n_elem; k++) {
+      x[k] *= 1 + randn(rng);
+    }
+    return x;
+  };
+
+  Fit fit = fit0_;
+  fit.set_A(perturb(fit0_.A()));
+  fit.set_B(perturb(fit0_.B()));
+  fit.set_C(perturb(fit0_.C()));
+  return fit;
+}
+
+template <typename FitEM>
+UniformMatrixList<kMatFreeDim2> MultiStartEM<FitEM>::ViewData(
+    UniformMatrixList<kMatFreeDim2>& data) {
+  std::vector<data_t*> mems(data.size());
+  std::vector<std::array<size_t, 2>> dims(data.size());
+  for (size_t k = 0; k < data.size(); k++) {
+    // n.b., EM only reads its training data
+    mems[k] = const_cast<data_t*>(data.at(k).memptr());
+    dims[k] = {data.at(k).n_rows, data.at(k).n_cols};
+  }
+  return UniformMatrixList<kMatFreeDim2>(mems, dims);
+}
+
+}  // namespace lds
+
+#endif
@@ -33,6 +33,14 @@
 #define LDSCTRLEST_LDS_FIT_SSID_H
 
 #include "lds_fit.h"
+// thread pool
+#include "lds_thread_pool.h"
+// BLAS threading policy
+#include "lds_blas.h"
+
+#include <algorithm>
+#include <memory>
+#include <random>
 
 namespace lds {
 
@@ -63,13 +71,66 @@ class SSID {
        const Vector& d = Vector(1).fill(-kInf));
 
   /**
+   * Optionally, the singular value decomposition may be truncated to the
+   * leading `n_sv` singular values/vectors, computed by a randomized
+   * algorithm at a cost that scales with `n_sv` rather than the size of the
+   * block-hankel data matrix. `n_sv` (>= n_x) should be chosen large enough
+   * to diagnose model order from the returned singular values.
+   *
    * @brief      Runs fitting by subspace identification (SSID)
    *
    * @param      ssid_wt  weight for singular value decomp
+   * @param      n_sv     [optional] number of singular values to compute
+   *                      (0 = all, by full SVD)
+   *
+   * @return     tuple (Fit, singular values)
+   */
+  std::tuple<Fit, Vector> Run(SSIDWt ssid_wt, size_t n_sv = 0);
+
+  /**
+   * Creates/decomposes the block-hankel data matrix and performs the singular
+   * value decomposition once, then solves for the parameters at each model
+   * order from these (in parallel; see set_n_threads).
+   *
+   * The fit-quality metric returned for each order is the output residual
+   * variance (trace of the output noise covariance) of the least-squares
+   * solution, which may be compared across orders with the singular values.
+   *
+   * @brief      Runs fitting by SSID over a sweep of model orders
+   *
+   * @param      n_x_sweep  model orders
+   * @param      ssid_wt    weight for singular value decomp
+   * @param      n_sv       [optional] number of singular values to compute
+   *                        (0 = all, by full SVD)
+   *
+   * @return     tuple (Fits, output residual variances, singular values)
+   */
+  std::tuple<std::vector<Fit>, Vector, Vector> RunOrderSweep(
+      const std::vector<size_t>& n_x_sweep, SSIDWt ssid_wt, size_t n_sv = 0);
+
+  /**
+   * Folds new I/O data into the running block-hankel statistics accumulated
+   * by previous calls to Run/Update and re-solves for the parameters, without
+   * revisiting previous data (i.e., cost scales with the new data). New data
+   * are treated as a continuation of previous data, such that fitting in
+   * batches is equivalent to fitting the concatenated data at once.
+   *
+   * n.b., the new data replace the training data held (see ReturnData), and
+   * the output bias (d) is not re-estimated.
+   *
+   * @brief      Updates fit by subspace identification (SSID) with new data
+   *
+   * @param      u_new    new input training data
+   * @param      z_new    new measurement training data
+   * @param      ssid_wt  weight for singular value decomp
+   * @param      n_sv     [optional] number of singular values to compute
+   *                      (0 = all, by full SVD)
    *
    * @return     tuple (Fit, singular values)
    */
-  std::tuple<Fit, Vector> Run(SSIDWt ssid_wt);
+  std::tuple<Fit, Vector> Update(UniformMatrixList<kMatFreeDim2>&& u_new,
+                                 UniformMatrixList<kMatFreeDim2>&& z_new,
+                                 SSIDWt ssid_wt, size_t n_sv = 0);
 
   /**
    * @brief      Returns the I/O data to caller.
@@ -84,6 +145,23 @@ class SSID {
     return tuple;
   }
 
+  /// gets number of threads block-Hankel data is distributed across
+  size_t n_threads() const { return pool_ ? pool_->n_threads() : 1; };
+
+  /**
+   * @brief      sets number of threads block-Hankel data is distributed across
+   *
+   * @param      n_threads  number of threads (1 = calling thread only, 0 =
+   *                        hardware concurrency)
+   */
+  void set_n_threads(size_t n_threads) {
+    if (n_threads == 1) {
+      pool_.reset();
+    } else {
+      pool_.reset(new ThreadPool(n_threads));
+    }
+  };
+
  protected:
   /**
    * @brief      Using periods of silence in inputs (u), calculates the output \
@@ -97,40 +175,137 @@ class SSID {
   void CalcD(data_t t_silence = 0.1, data_t thresh_silence = 0.001);
 
   /**
-   * Creates the block-hankel I/O data matrix. Also calculates I/O gain @ DC.
+   * Calculates the covariance of the columns of the block-hankel I/O data
+   * matrix (cov_hankel_). The data matrix itself is never formed: blocks of
+   * its columns are copied from the training data and accumulated in
+   * parallel (see set_n_threads). Also calculates I/O gain @ DC.
    *
-   * @brief      Creates the block-hankel I/O data matrix
+   * @brief      Creates the block-hankel I/O data matrix (covariance)
    */
   void CreateHankelDataMat();
 
+  /**
+   * @brief      Folds training data into block-hankel I/O data matrix
+   *             (covariance), as a continuation of data seen so far
+   */
+  void UpdateHankelDataMat();
+
+  /**
+   * @brief      Checks that block-hankel I/O data matrix would have at least
+   *             as many columns as rows once `n_t_new` samples are folded in
+   *             (see UpdateHankelDataMat)
+   *
+   * @param      n_t_new  number of new samples
+   */
+  void CheckHankelDataLength(size_t n_t_new) const;
+
+  /**
+   * @brief      Checks and sets training data
+   *
+   * @param      u_train  input training data
+   * @param      z_train  measurement training data
+   */
+  void SetData(UniformMatrixList<kMatFreeDim2>&& u_train,
+               UniformMatrixList<kMatFreeDim2>&& z_train);
+
+  /**
+   * @brief      Solves for parameters from block-hankel data (covariance)
+   *
+   * @param      ssid_wt  weight for singular value decomp
+   * @param      n_sv     number of singular values to compute (0 = all)
+   *
+   * @return     tuple (Fit, singular values)
+   */
+  std::tuple<Fit, Vector> SolveFromHankel(SSIDWt ssid_wt, size_t n_sv);
+
   /**
    * @brief      Decompose data to lower-triangular matrix (used in Solve)
    */
   virtual void DecomposeData() = 0;
 
   /**
-   * @brief      performs the singular value decomposition (SVD)
+   * @brief      performs the singular value decomposition (SVD) of the
+   *             weighted projection (U_, s_)
    *
    * @param      ssid_wt  weight for SVD
+   * @param      n_sv     number of singular values to compute (0 = all)
+   */
+  void CalcSVD(SSIDWt wt, size_t n_sv = 0);
+
+  /**
+   * Randomized range finder with power iterations (Halko, Martinsson, Tropp
+   * 2011). Falls back on full SVD when `n_sv` is not much smaller than the
+   * dimensions of `a`.
+   *
+   * @brief      computes the leading singular values/left vectors
+   *
+   * @param      u     left singular vectors (output)
+   * @param      s     singular values (output)
+   * @param      a     matrix to decompose
+   * @param      n_sv  number of singular values to compute (0 = all)
+   */
+  static void TruncatedSVD(Matrix& u, Vector& s, const Matrix& a, size_t n_sv);
+
+  /**
+   * @brief      gets extended observability matrix of model order n_x from
+   *             singular value decomp (heart of ssid method)
+   *
+   * @param      n_x   model order
+   *
+   * @return     extended observability matrix
    */
-  void CalcSVD(SSIDWt wt);
+  Matrix ExtObs(size_t n_x) const;
 
   /**
    * @brief      solves for LDS parameters
    *
    * @param      wt_dc  weight placed on getting correct DC I/O gain
    */
-  void Solve(data_t wt_dc);
+  void Solve(data_t wt_dc) { Solve(wt_dc, n_x_, ext_obs_t_, fit_); };
+
+  /**
+   * @brief      solves for LDS parameters of model order n_x
+   *
+   * @param      wt_dc      weight placed on getting correct DC I/O gain
+   * @param      n_x        model order
+   * @param      ext_obs_t  extended observability matrix
+   * @param      fit        fit (output)
+   *
+   * @return     output residual variance (trace of output noise covariance)
+   */
+  data_t Solve(data_t wt_dc, size_t n_x, Matrix& ext_obs_t, Fit& fit) const;
 
   /**
    * @brief      recompute extended observability matrix from estimates of A, C
    */
-  void RecomputeExtObs();
+  void RecomputeExtObs() { RecomputeExtObs(fit_, ext_obs_t_); };
+
+  /**
+   * @brief      recompute extended observability matrix from estimates of A, C
+   *
+   * @param      fit        fit
+   * @param      ext_obs_t  extended observability matrix (output)
+   */
+  void RecomputeExtObs(const Fit& fit, Matrix& ext_obs_t) const;
 
   // input/output training data
   UniformMatrixList<kMatFreeDim2> u_;  ///< input training data
   UniformMatrixList<kMatFreeDim2> z_;  ///< measurement training data
-  Matrix D_;                           ///< block-Hankel I/O data matrix
+  Matrix cov_hankel_;  ///< covariance of block-Hankel I/O data matrix columns
+  size_t n_hankel_{};  ///< number of columns of block-Hankel I/O data matrix
+
+  // running statistics of all data seen so far
+  Matrix sum_hh_;      ///< sum of outer products of (centered) Hankel columns
+  Vector sum_h_;       ///< sum of (centered) Hankel columns
+  Vector mu_u_;        ///< input centering offset
+  Vector mu_z_;        ///< measurement centering offset
+  Matrix u_tail_;      ///< last 2*n_h-1 input samples (precede new data)
+  Matrix z_tail_;      ///< last 2*n_h-1 measurement samples
+  Matrix sum_zu_;      ///< measurement-input cross moment
+  Matrix sum_uu_;      ///< input second moment
+  Vector sum_u_;       ///< sum of inputs
+  Vector sum_mean_z_;  ///< sum of per-trial mean measurements
+  size_t n_trials_tot_{};  ///< number of trials
 
   Fit fit_;      ///< fit
   Matrix g_dc_;  ///< I/O gain @ DC
@@ -147,34 +322,21 @@ class SSID {
   Matrix L_;          ///< lower triangle decomp of covariance matrix
   Vector s_;          ///< singular values
   Matrix ext_obs_t_;  ///< extended observability matrix
+  Matrix U_;          ///< left singular vectors
+
+  std::unique_ptr<ThreadPool> pool_;  ///< Hankel threads (null if serial)
 };
 
 template <typename Fit>
 SSID<Fit>::SSID(size_t n_x, size_t n_h, data_t dt,
                 UniformMatrixList<kMatFreeDim2>&& u_train,
                 UniformMatrixList<kMatFreeDim2>&& z_train, const Vector& d) {
-  // check input/output data dimensions are consistent
-  if (z_train.size() != u_train.size()) {
-    throw std::runtime_error(
-        "I/O training data have different number of trials.");
-  }
-  n_trials_ = u_train.size();
-
-  n_t_tot_ = 0;
-  n_t_ = std::vector<size_t>(n_trials_);
-  for (size_t trial = 0; trial < n_trials_; trial++) {
-    if (z_train.at(trial).n_cols != u_train.at(trial).n_cols) {
-      throw std::runtime_error(
-          "I/O training data have different number of time steps.");
-    }
-    n_t_[trial] = u_train.at(trial).n_cols;
-    n_t_tot_ += n_t_[trial];
-  }
+  n_u_ = u_train.at(0).n_rows;
+  n_y_ = z_train.at(0).n_rows;
+  SetData(std::move(u_train), std::move(z_train));
 
   dt_ = dt;
   n_x_ = n_x;
-  n_u_ = u_train.at(0).n_rows;
-  n_y_ = z_train.at(0).n_rows;
   n_h_ = n_h;
 
   // dimensionality check for eventual block-hankel data matrix
@@ -189,9 +351,6 @@ SSID<Fit>::SSID(size_t n_x, size_t n_h, data_t dt,
 
   fit_ = Fit(n_u_, n_x_, n_y_, dt_);
 
-  u_ = std::move(u_train);
-  z_ = std::move(z_train);
-
   if (!d.is_finite() || (d.n_rows != n_y_)) {
     // TODO(mfbolus): implement least-square solution for impulse response with
     // a second input of ones. Data-driven way of accounting for offset *not*
@@ -213,16 +372,127 @@ SSID<Fit>::SSID(size_t n_x, size_t n_h, data_t dt,
 }
 
 template <typename Fit>
-std::tuple<Fit, Vector> SSID<Fit>::Run(SSIDWt ssid_wt) {
+std::tuple<Fit, Vector> SSID<Fit>::Run(SSIDWt ssid_wt, size_t n_sv) {
+  BlasThreadScope blas(kBlasWorkFit);
+  // std::cout << "creating hankel mat\n";
+  CreateHankelDataMat();
+  return SolveFromHankel(ssid_wt, n_sv);
+}
+
+template <typename Fit>
+std::tuple<std::vector<Fit>, Vector, Vector> SSID<Fit>::RunOrderSweep(
+    const std::vector<size_t>& n_x_sweep, SSIDWt ssid_wt, size_t n_sv) {
+  BlasThreadScope blas(kBlasWorkFit);
   // the weight on minimizing dc I/O gain only works for gaussian,
   // and hopefully not necessary with appropriate dataset.
   data_t wt_dc = 0;
-  // std::cout << "creating hankel mat\n";
+
+  // n.b., extended observability matrix has n_h*n_y rows
+  size_t n_x_max = 0;
+  for (size_t n_x : n_x_sweep) {
+    if ((n_x == 0) || (n_x > n_h_ * n_y_)) {
+      throw std::runtime_error(
+          "Model orders must be positive and no greater than n_h*n_y.");
+    }
+    n_x_max = std::max(n_x_max, n_x);
+  }
+  if ((n_sv > 0) && (n_sv < n_x_max)) {
+    throw std::runtime_error(
+        "Number of singular values must be at least model order (n_x).");
+  }
+
+  // shared by all model orders
   CreateHankelDataMat();
+  DecomposeData();
+  CalcSVD(ssid_wt, n_sv);
+
+  size_t n_orders = n_x_sweep.size();
+  std::vector<Fit> fits(n_orders);
+  Vector err(n_orders);
+  auto solve_orders = [&](size_t k_begin, size_t k_end) {
+    for (size_t k = k_begin; k < k_end; k++) {
+      size_t n_x = n_x_sweep[k];
+      fits[k] = Fit(n_u_, n_x, n_y_, dt_);
+      fits[k].set_d(fit_.d());
+      Matrix ext_obs_t = ExtObs(n_x);
+      err[k] = Solve(wt_dc, n_x, ext_obs_t, fits[k]);
+    }
+  };
+  if (pool_) {
+    pool_->ParallelFor(n_orders, solve_orders);
+  } else {
+    solve_orders(0, n_orders);
+  }
+
+  return std::make_tuple(std::move(fits), err, s_);
+}
+
+template <typename Fit>
+std::tuple<Fit, Vector> SSID<Fit>::Update(
+    UniformMatrixList<kMatFreeDim2>&& u_new,
+    UniformMatrixList<kMatFreeDim2>&& z_new, SSIDWt ssid_wt, size_t n_sv) {
+  if ((u_new.size() == 0) || (u_new.at(0).n_rows != n_u_) ||
+      (z_new.size() == 0) || (z_new.at(0).n_rows != n_y_)) {
+    throw std::runtime_error(
+        "New I/O training data have inconsistent dimensions.");
+  }
+  if ((n_sv > 0) && (n_sv < n_x_)) {
+    throw std::runtime_error(
+        "Number of singular values must be at least model order (n_x).");
+  }
+  // n.b., checked before the data held or running statistics are touched
+  size_t n_t_new = 0;
+  for (size_t trial = 0; trial < u_new.size(); trial++) {
+    n_t_new += u_new.at(trial).n_cols;
+  }
+  CheckHankelDataLength(n_t_new);
+
+  BlasThreadScope blas(kBlasWorkFit);
+  SetData(std::move(u_new), std::move(z_new));
+  UpdateHankelDataMat();
+  return SolveFromHankel(ssid_wt, n_sv);
+}
+
+template <typename Fit>
+void SSID<Fit>::SetData(UniformMatrixList<kMatFreeDim2>&& u_train,
+                        UniformMatrixList<kMatFreeDim2>&& z_train) {
+  // check input/output data dimensions are consistent
+  if (z_train.size() != u_train.size()) {
+    throw std::runtime_error(
+        "I/O training data have different number of trials.");
+  }
+  n_trials_ = u_train.size();
+
+  n_t_tot_ = 0;
+  n_t_ = std::vector<size_t>(n_trials_);
+  for (size_t trial = 0; trial < n_trials_; trial++) {
+    if (z_train.at(trial).n_cols != u_train.at(trial).n_cols) {
+      throw std::runtime_error(
+          "I/O training data have different number of time steps.");
+    }
+    n_t_[trial] = u_train.at(trial).n_cols;
+    n_t_tot_ += n_t_[trial];
+  }
+
+  u_ = std::move(u_train);
+  z_ = std::move(z_train);
+}
+
+template <typename Fit>
+std::tuple<Fit, Vector> SSID<Fit>::SolveFromHankel(SSIDWt ssid_wt,
+                                                   size_t n_sv) {
+  // the weight on minimizing dc I/O gain only works for gaussian,
+  // and hopefully not necessary with appropriate dataset.
+  data_t wt_dc = 0;
+  if ((n_sv > 0) && (n_sv < n_x_)) {
+    throw std::runtime_error(
+        "Number of singular values must be at least model order (n_x).");
+  }
   // std::cout << "decomposing data\n";
   DecomposeData();
   // std::cout << "calculating svd\n";
-  CalcSVD(ssid_wt);
+  CalcSVD(ssid_wt, n_sv);
+  ext_obs_t_ = ExtObs(n_x_);
   // std::cout << "solving for params\n";
   Solve(wt_dc);
   // std::cout << "fin\n";
@@ -256,68 +526,163 @@ void SSID<Fit>::CalcD(data_t t_silence, data_t thresh_silence) {
 
 template <typename Fit>
 void SSID<Fit>::CreateHankelDataMat() {
-  // temporary copy of data
-  Matrix z(n_y_, n_t_tot_, fill::zeros);
-  Matrix u(n_u_, n_t_tot_, fill::zeros);
-  size_t so_far(0);
-
-  for (size_t trial = 0; trial < z_.size(); trial++) {
-    z.submat(0, so_far, n_y_ - 1, so_far + n_t_.at(trial) - 1) = z_.at(trial);
-    u.submat(0, so_far, n_u_ - 1, so_far + n_t_.at(trial) - 1) = u_.at(trial);
-    so_far += n_t_.at(trial);
+  // start from scratch
+  n_hankel_ = 0;
+  sum_hh_.reset();
+  UpdateHankelDataMat();
+}
+
+template <typename Fit>
+void SSID<Fit>::CheckHankelDataLength(size_t n_t_new) const {
+  size_t n_rows = 2 * n_h_ * (n_u_ + n_y_);
+  bool is_first = sum_hh_.is_empty();
+  size_t n_hankel = is_first ? 0 : n_hankel_;
+  size_t n_t_seq = (is_first ? 0 : u_tail_.n_cols) + n_t_new;
+
+  // n.b., new columns of hankel mat (one per new sample, after the first)
+  size_t n_hankel_new = n_t_seq + 1 > 2 * n_h_ ? n_t_seq + 1 - 2 * n_h_ : 0;
+  if (n_hankel + n_hankel_new < n_rows) {
+    std::ostringstream ss;
+    ss << "Dataset problem! More rows than columns in block-hankel data "
+          "matrix: 2*(n_u+n_y)*n_h > data-length! Need higher data-length or "
+          "lower n_h.";
+    throw std::runtime_error(ss.str());
   }
+}
 
-  // remove output bias
-  z.each_col() -= fit_.d();
+template <typename Fit>
+void SSID<Fit>::UpdateHankelDataMat() {
+  // n.b., before any statistics are touched
+  CheckHankelDataLength(n_t_tot_);
+
+  size_t n_rows = 2 * n_h_ * (n_u_ + n_y_);
+  bool is_first = sum_hh_.is_empty();
+  if (is_first) {
+    sum_hh_ = Matrix(n_rows, n_rows, fill::zeros);
+    sum_h_ = Vector(n_rows, fill::zeros);
+    u_tail_ = Matrix(n_u_, 0);
+    z_tail_ = Matrix(n_y_, 0);
+    sum_zu_ = Matrix(n_y_, n_u_, fill::zeros);
+    sum_uu_ = Matrix(n_u_, n_u_, fill::zeros);
+    sum_u_ = Vector(n_u_, fill::zeros);
+    sum_mean_z_ = Vector(n_y_, fill::zeros);
+    n_trials_tot_ = 0;
+  }
 
-  // calculate I/O gain @ DC while data in convenient form
-  g_dc_ = z * pinv(u);
-  // std::cout << "G0_data = " << g_dc_ << "\n";
+  // n.b., trials are treated as one concatenated sequence, continuing from
+  // the tail of data seen so far
+  std::vector<const Matrix*> u_seq(1, &u_tail_);
+  std::vector<const Matrix*> z_seq(1, &z_tail_);
+  std::vector<size_t> t0(1, 0);  // start time of each sequence
+  t0.push_back(u_tail_.n_cols);
+  for (size_t trial = 0; trial < n_trials_; trial++) {
+    u_seq.push_back(&u_.at(trial));
+    z_seq.push_back(&z_.at(trial));
+    t0.push_back(t0.back() + n_t_[trial]);
+  }
+  size_t n_t_seq = t0.back();
 
-  // create hankel data matrix
-  size_t len = z.n_cols - 2 * n_h_ + 1;  // data length in hankel mat
+  // n.b., new columns of hankel mat (one per new sample, after the first;
+  // enough of them, by CheckHankelDataLength)
+  size_t n_hankel_new = n_t_seq + 1 > 2 * n_h_ ? n_t_seq + 1 - 2 * n_h_ : 0;
 
-  // block-hankel data matrix
-  D_ = Matrix(2 * n_h_ * (n_u_ + n_y_), len, fill::zeros);
-  // past input
-  auto u_p = D_.submat(0, 0, n_h_ * n_u_ - 1, len - 1);
-  // future input
-  auto u_f = D_.submat(n_h_ * n_u_, 0, 2 * n_h_ * n_u_ - 1, len - 1);
-  // past output
-  auto y_p =
-      D_.submat(2 * n_h_ * n_u_, 0, n_h_ * (2 * n_u_ + n_y_) - 1, len - 1);
-  // future output
-  auto y_f = D_.submat(n_h_ * (2 * n_u_ + n_y_), 0,
-                       2 * n_h_ * (n_u_ + n_y_) - 1, len - 1);
-
-  size_t idx = 0;
-  for (size_t k = 0; k < len; k++) {
-    idx = 0;
-    for (size_t kk = k; kk < (n_h_ + k); kk++) {
-      u_p.col(k).subvec(idx, idx + n_u_ - 1) = u.col(kk);
-      idx += n_u_;
-    }
+  // calculate I/O gain @ DC while going through data
+  // n.b., z * pinv(u) = (z * u') * pinv(u * u')
+  Vector sum_z(n_y_, fill::zeros);
+  Vector sum_u(n_u_, fill::zeros);
+  for (size_t trial = 0; trial < n_trials_; trial++) {
+    const Matrix& u = u_.at(trial);
+    const Matrix& z = z_.at(trial);
+    sum_zu_ += z * u.t();
+    sum_uu_ += u * u.t();
+    sum_u += arma::sum(u, 1);
+    sum_z += arma::sum(z, 1);
+    sum_mean_z_ += arma::mean(z, 1);
+  }
+  sum_u_ += sum_u;
+  n_trials_tot_ += n_trials_;
+  // remove output bias
+  g_dc_ = (sum_zu_ - fit_.d() * sum_u_.t()) * pinv(sum_uu_);
+  // std::cout << "G0_data = " << g_dc_ << "\n";
 
-    idx = 0;
-    for (size_t kk = (n_h_ + k); kk < (2 * n_h_ + k); kk++) {
-      u_f.col(k).subvec(idx, idx + n_u_ - 1) = u.col(kk);
-      idx += n_u_;
-    }
+  // data are centered by the channel means of the first data (fixed, since
+  // covariance does not depend on it) for the sake of numerical precision
+  if (is_first) {
+    mu_u_ = sum_u / n_t_tot_;
+    mu_z_ = sum_z / n_t_tot_;
+  }
 
-    idx = 0;
-    for (size_t kk = k; kk < (n_h_ + k); kk++) {
-      y_p.col(k).subvec(idx, idx + n_y_ - 1) = z.col(kk);
-      idx += n_y_;
+  // block-hankel data matrix
+  // rows: [past input; future input; past output; future output], such that
+  // input (output) at lag `i` over columns [k, k+n) is data over [k+i, k+i+n)
+
+  // copies (centered) concatenated data over [t, t+n) into rows of block
+  auto copy_data = [&](const std::vector<const Matrix*>& seq,
+                       const Vector& mu, size_t row, size_t t, size_t n,
+                       Matrix& block) {
+    size_t row_end = row + mu.n_elem - 1;
+    size_t k_seq = std::upper_bound(t0.begin(), t0.end(), t) - t0.begin() - 1;
+    for (size_t col = 0; col < n; k_seq++) {
+      size_t t_seq = t + col - t0[k_seq];  // time within sequence
+      size_t n_seq = std::min(n - col, seq[k_seq]->n_cols - t_seq);
+      if (n_seq > 0) {
+        block.submat(row, col, row_end, col + n_seq - 1) =
+            seq[k_seq]->cols(t_seq, t_seq + n_seq - 1);
+        block.submat(row, col, row_end, col + n_seq - 1).each_col() -= mu;
+      }
+      col += n_seq;
     }
-
-    idx = 0;
-    for (size_t kk = (n_h_ + k); kk < (2 * n_h_ + k); kk++) {
-      y_f.col(k).subvec(idx, idx + n_y_ - 1) = z.col(kk);
-      idx += n_y_;
+  };
+
+  // accumulate second moments over blocks of columns, per thread
+  const size_t n_cols_block = 512;
+  size_t n_chunks = pool_ ? pool_->n_threads() : 1;
+  std::vector<Matrix> sum_hh(n_chunks);
+  std::vector<Vector> sum_h(n_chunks);
+  auto run_chunks = [&](size_t chunk_begin, size_t chunk_end) {
+    for (size_t chunk = chunk_begin; chunk < chunk_end; chunk++) {
+      sum_hh[chunk] = Matrix(n_rows, n_rows, fill::zeros);
+      sum_h[chunk] = Vector(n_rows, fill::zeros);
+      size_t k_end = n_hankel_new * (chunk + 1) / n_chunks;
+      Matrix block;
+      for (size_t k = n_hankel_new * chunk / n_chunks; k < k_end;
+           k += n_cols_block) {
+        size_t n = std::min(n_cols_block, k_end - k);
+        block.set_size(n_rows, n);
+        for (size_t i = 0; i < 2 * n_h_; i++) {
+          copy_data(u_seq, mu_u_, i * n_u_, k + i, n, block);
+          copy_data(z_seq, mu_z_, 2 * n_h_ * n_u_ + i * n_y_, k + i, n,
+                    block);
+        }
+        sum_hh[chunk] += block * block.t();
+        sum_h[chunk] += arma::sum(block, 1);
+      }
     }
+  };
+  if (pool_) {
+    pool_->ParallelFor(n_chunks, run_chunks);
+  } else {
+    run_chunks(0, n_chunks);
   }
 
-  D_ /= sqrt(static_cast<data_t>(len));
+  for (size_t chunk = 0; chunk < n_chunks; chunk++) {
+    sum_hh_ += sum_hh[chunk];
+    sum_h_ += sum_h[chunk];
+  }
+  n_hankel_ += n_hankel_new;
+  cov_hankel_ = (sum_hh_ - sum_h_ * sum_h_.t() / n_hankel_) /
+                static_cast<data_t>(n_hankel_);
+
+  // keep the last samples, which begin the next hankel columns
+  size_t n_tail = std::min(2 * n_h_ - 1, n_t_seq);
+  Matrix u_tail(n_u_, n_tail);
+  Matrix z_tail(n_y_, n_tail);
+  copy_data(u_seq, Vector(n_u_, fill::zeros), 0, n_t_seq - n_tail, n_tail,
+            u_tail);
+  copy_data(z_seq, Vector(n_y_, fill::zeros), 0, n_t_seq - n_tail, n_tail,
+            z_tail);
+  u_tail_ = std::move(u_tail);
+  z_tail_ = std::move(z_tail);
 }
 
 // template <typename Fit>
@@ -332,7 +697,7 @@ void SSID<Fit>::CreateHankelDataMat() {
 // }
 
 template <typename Fit>
-void SSID<Fit>::CalcSVD(SSIDWt wt) {
+void SSID<Fit>::CalcSVD(SSIDWt wt, size_t n_sv) {
   // submats that will be needed:
   auto R_14_14 = L_.submat(0, 0, n_h_ * (2 * n_u_ + n_y_) - 1,
                            n_h_ * (2 * n_u_ + n_y_) - 1);
@@ -364,13 +729,12 @@ void SSID<Fit>::CalcSVD(SSIDWt wt) {
   // from van Overschee subid.m:
   // Rf = R((2*m+l)*i+1:2*(m+l)*i,:);   % Future outputs
 
-  Matrix U;
-  Matrix V;
+  Matrix& U = U_;
   switch (wt) {
     case kSSIDNone: {
       // No weighting. (what van Overschee calls "N4SID")
       Matrix O_k_sans_Qt = Lup * R_11_14 + Lyp * R_44_14;
-      arma::svd(U, s_, V, O_k_sans_Qt, "std");
+      TruncatedSVD(U, s_, O_k_sans_Qt, n_sv);
     } break;
     case kSSIDMOESP: {
       // MOESP weighting
@@ -380,7 +744,7 @@ void SSID<Fit>::CalcSVD(SSIDWt wt) {
                   R_23_13.t() * inv(R_23_13 * R_23_13.t()) * R_23_13;
       Matrix O_k_ortho_Uf_sans_Qt =
           join_horiz((Lup * R_11_13 + Lyp * R_44_13) * Pi, Lyp * R_44);
-      svd(U, s_, V, O_k_ortho_Uf_sans_Qt, "std");
+      TruncatedSVD(U, s_, O_k_ortho_Uf_sans_Qt, n_sv);
     } break;
     case kSSIDCVA: {
       // CVA weighting
@@ -399,24 +763,73 @@ void SSID<Fit>::CalcSVD(SSIDWt wt) {
       Matrix w_o_w = arma::solve(
           inv_w1, O_k_ortho_Uf_sans_Qt);  // alternatively
                                           // pinv(inv_W1)*O_k_ortho_Uf_sans_Qt
-      svd(U, s_, V, w_o_w, "std");
+      TruncatedSVD(U, s_, w_o_w, n_sv);
 
       U = inv_w1 * U;
       break;
     }
   }
 
+}
+
+template <typename Fit>
+Matrix SSID<Fit>::ExtObs(size_t n_x) const {
   // Truncate to model order (heart of ssid method)
-  auto s_hat = s_.subvec(0, n_x_ - 1);
+  auto s_hat = s_.subvec(0, n_x - 1);
   Matrix diag_sqrt_s = diagmat(sqrt(s_hat));
-  auto u_hat = U.submat(0, 0, U.n_rows - 1, n_x_ - 1);
+  auto u_hat = U_.submat(0, 0, U_.n_rows - 1, n_x - 1);
 
   // get extended observability and controllability mats
-  ext_obs_t_ = u_hat * diag_sqrt_s;  // extended observability matrix
+  return u_hat * diag_sqrt_s;  // extended observability matrix
 }
 
 template <typename Fit>
-void SSID<Fit>::Solve(data_t wt_dc) {
+void SSID<Fit>::TruncatedSVD(Matrix& u, Vector& s, const Matrix& a,
+                             size_t n_sv) {
+  const size_t n_oversample = 10;  // extra samples of range
+  const size_t n_power = 2;        // power iterations (for slow sv decay)
+
+  size_t n_min = std::min(a.n_rows, a.n_cols);
+  size_t n_sample = n_sv + n_oversample;
+  if ((n_sv == 0) || (2 * n_sample >= n_min)) {
+    // not worthwhile
+    Matrix v;
+    arma::svd(u, s, v, a, "std");
+    if ((n_sv > 0) && (n_sv < s.n_elem)) {
+      s = s.subvec(0, n_sv - 1);
+      u = u.cols(0, n_sv - 1);
+    }
+    return;
+  }
+
+  // gaussian test matrix
+  // n.b., fixed seed so that fits are reproducible
+  std::mt19937 rng(0);
+  std::normal_distribution<data_t> randn;
+  Matrix omega(a.n_cols, n_sample);
+  omega.imbue([&]() { return randn(rng); });
+
+  // orthonormal basis for the range of `a` (re-orthonormalized between power
+  // iterations for numerical stability)
+  Matrix q;
+  Matrix r;
+  arma::qr_econ(q, r, a * omega);
+  for (size_t k = 0; k < n_power; k++) {
+    arma::qr_econ(q, r, a.t() * q);
+    arma::qr_econ(q, r, a * q);
+  }
+
+  // svd of the small (n_sample x n_cols) projection
+  Matrix u_b;
+  Matrix v;
+  arma::svd_econ(u_b, s, v, q.t() * a, "left");
+  s = s.subvec(0, n_sv - 1);
+  u = q * u_b.cols(0, n_sv - 1);
+}
+
+template <typename Fit>
+data_t SSID<Fit>::Solve(data_t wt_dc, size_t n_x, Matrix& ext_obs_t,
+                        Fit& fit) const {
   // required submats
   auto R_56_14 =
       L_.submat(n_h_ * (2 * n_u_ + n_y_), 0, n_h_ * (2 * n_u_ + 2 * n_y_) - 1,
@@ -436,45 +849,45 @@ void SSID<Fit>::Solve(data_t wt_dc) {
   // Solve for params using appropriate algorithm:
   // robust deterministic/stochastic algorithm in van Overschee 1996
   // algorithm that the authors say "works" in practice.
-  auto ext_obs_tm1 = ext_obs_t_.submat(
-      0, 0, ext_obs_t_.n_rows - 1 - n_y_,
-      ext_obs_t_.n_cols - 1);  // extended observability matrix
+  auto ext_obs_tm1 = ext_obs_t.submat(
+      0, 0, ext_obs_t.n_rows - 1 - n_y_,
+      ext_obs_t.n_cols - 1);  // extended observability matrix
 
   // This is what textbook (1996) says:
   //
-  // Matrix Tr = join_vert(pinv(ext_obs_t_) * R_56_15, R_23_15);
+  // Matrix Tr = join_vert(pinv(ext_obs_t) * R_56_15, R_23_15);
   //
   // HOWEVER, do not know why but have to fill the last place with zeros like
   // authors' matlab implementation (see `subid.m`)
   // Otherwise, get ridiculous covariances (although A,C estimates are close to
   // same...)
   Matrix Tr = join_vert(
-      join_horiz(pinv(ext_obs_t_) * R_56_14, Matrix(n_x_, n_y_, fill::zeros)),
+      join_horiz(pinv(ext_obs_t) * R_56_14, Matrix(n_x, n_y_, fill::zeros)),
       R_23_15);
   Matrix Tl = join_vert(pinv(ext_obs_tm1) * R_66_15, R_55_15);
   Matrix S = Tl * pinv(Tr);
 
   // Use alternative in van Overschee 1996, p. 129. Apparently, should ensure
   // stability.
-  fit_.set_C(ext_obs_t_.submat(0, 0, n_y_ - 1, ext_obs_t_.n_cols - 1));
+  fit.set_C(ext_obs_t.submat(0, 0, n_y_ - 1, ext_obs_t.n_cols - 1));
   Matrix ext_obs_t_p1 = join_vert(
-      ext_obs_t_.submat(n_y_, 0, ext_obs_t_.n_rows - 1, ext_obs_t_.n_cols - 1),
-      Matrix(n_y_, ext_obs_t_.n_cols, fill::zeros));
-  fit_.set_A(pinv(ext_obs_t_) * ext_obs_t_p1);
+      ext_obs_t.submat(n_y_, 0, ext_obs_t.n_rows - 1, ext_obs_t.n_cols - 1),
+      Matrix(n_y_, ext_obs_t.n_cols, fill::zeros));
+  fit.set_A(pinv(ext_obs_t) * ext_obs_t_p1);
 
-  // At this point, van Overschee & de Moor suggest re-calculating ext_obs_t_,
+  // At this point, van Overschee & de Moor suggest re-calculating ext_obs_t,
   // ext_obs_tm1 from (A, C) because it was just an approximation. This is
-  RecomputeExtObs();
-  ext_obs_tm1 = ext_obs_t_.submat(
-      0, 0, ext_obs_t_.n_rows - 1 - n_y_,
-      ext_obs_t_.n_cols - 1);  // extended observability matrix
+  RecomputeExtObs(fit, ext_obs_t);
+  ext_obs_tm1 = ext_obs_t.submat(
+      0, 0, ext_obs_t.n_rows - 1 - n_y_,
+      ext_obs_t.n_cols - 1);  // extended observability matrix
   Tl = join_vert(pinv(ext_obs_tm1) * R_66_15, R_55_15);
   Tr = join_vert(
-      join_horiz(pinv(ext_obs_t_) * R_56_14, Matrix(n_x_, n_y_, fill::zeros)),
+      join_horiz(pinv(ext_obs_t) * R_56_14, Matrix(n_x, n_y_, fill::zeros)),
       R_23_15);
   S = Tl * pinv(Tr);
 
-  Matrix Lcurly = S.submat(0, 0, n_x_ + n_y_ - 1, n_x_ - 1) * pinv(ext_obs_t_);
+  Matrix Lcurly = S.submat(0, 0, n_x + n_y_ - 1, n_x - 1) * pinv(ext_obs_t);
   Matrix Mcurly = pinv(ext_obs_tm1);
   Matrix Pcurly = Tl - Lcurly * R_56_15;
   Vector Pvec = vectorise(Pcurly);
@@ -482,7 +895,7 @@ void SSID<Fit>::Solve(data_t wt_dc) {
 
   // Identify [D; B], assuming D=0 and ensuring DC gain is correct
   Matrix sum_QcurlyT_kron_Ncurly(
-      (n_h_ * (2 * n_u_ + n_y_) + n_y_) * (n_y_ + n_x_), n_u_ * (n_y_ + n_x_),
+      (n_h_ * (2 * n_u_ + n_y_) + n_y_) * (n_y_ + n_x), n_u_ * (n_y_ + n_x),
       fill::zeros);
 
   Matrix eye_ext_obs_tm1(n_y_ + ext_obs_tm1.n_rows, n_y_ + ext_obs_tm1.n_cols,
@@ -492,9 +905,9 @@ void SSID<Fit>::Solve(data_t wt_dc) {
 
   // van Overschee (1996) p. 126
   Matrix N1_Tl = -Lcurly;
-  N1_Tl.submat(0, 0, n_x_ - 1, N1_Tl.n_cols - 1) +=
-      join_horiz(Matrix(n_x_, n_y_, fill::zeros), Mcurly);
-  N1_Tl.submat(n_x_, 0, n_x_ + n_y_ - 1, n_y_ - 1) +=
+  N1_Tl.submat(0, 0, n_x - 1, N1_Tl.n_cols - 1) +=
+      join_horiz(Matrix(n_x, n_y_, fill::zeros), Mcurly);
+  N1_Tl.submat(n_x, 0, n_x + n_y_ - 1, n_y_ - 1) +=
       Matrix(n_y_, n_y_, fill::eye);
 
   Matrix Nk_Tl(N1_Tl.n_rows, N1_Tl.n_cols, fill::zeros);
@@ -504,7 +917,7 @@ void SSID<Fit>::Solve(data_t wt_dc) {
         Qcurly.submat(n_u_ * k, 0, n_u_ * (k + 1) - 1, Qcurly.n_cols - 1);
 
     Nk_Tl.zeros();
-    Nk_Tl.submat(0, 0, n_x_ + n_y_ - 1, Nk_Tl.n_cols - k * n_y_ - 1) =
+    Nk_Tl.submat(0, 0, n_x + n_y_ - 1, Nk_Tl.n_cols - k * n_y_ - 1) =
         N1_Tl.submat(0, k * n_y_, N1_Tl.n_rows - 1, N1_Tl.n_cols - 1);
     N_k = Nk_Tl * eye_ext_obs_tm1;
 
@@ -524,12 +937,12 @@ void SSID<Fit>::Solve(data_t wt_dc) {
     // actually a hard constraint in that it ignores D)
     Matrix sum_QcurlyT_kron_Ncurly_db = sum_QcurlyT_kron_Ncurly;
     sum_QcurlyT_kron_Ncurly =
-        Matrix(sum_QcurlyT_kron_Ncurly_db.n_rows, n_x_ * n_u_);
+        Matrix(sum_QcurlyT_kron_Ncurly_db.n_rows, n_x * n_u_);
 
     size_t kkk = 0;
     for (size_t k = 1; k < (n_u_ + 1); k++) {
-      size_t start_idx = k * (n_y_ + n_x_) - n_x_;
-      for (size_t kk = 0; kk < n_x_; kk++) {
+      size_t start_idx = k * (n_y_ + n_x) - n_x;
+      for (size_t kk = 0; kk < n_x; kk++) {
         sum_QcurlyT_kron_Ncurly.col(kkk) =
             sum_QcurlyT_kron_Ncurly_db.col(start_idx + kk);
         kkk++;
@@ -537,7 +950,7 @@ void SSID<Fit>::Solve(data_t wt_dc) {
     }
 
     // constraint 2: Make sure DC I/O gain is correct
-    Matrix b_to_g0 = fit_.C() * inv(Matrix(n_x_, n_x_, fill::eye) - fit_.A());
+    Matrix b_to_g0 = fit.C() * inv(Matrix(n_x, n_x, fill::eye) - fit.A());
     Matrix Pvec_Gvec = join_vert(Pvec, vectorise(g_dc_));
     Matrix eye_kron_b_to_g0 = kron(Matrix(n_u_, n_u_, fill::eye), b_to_g0);
     Matrix sum_QcurlyT_kron_Ncurly_b_to_g0 =
@@ -561,7 +974,7 @@ void SSID<Fit>::Solve(data_t wt_dc) {
                        sum_QcurlyT_kron_Ncurly_b_to_g0) *
                    sum_QcurlyT_kron_Ncurly_b_to_g0.t() * w * Pvec_Gvec;
 
-    fit_.set_B(Matrix(b_vec.memptr(), n_x_, n_u_));
+    fit.set_B(Matrix(b_vec.memptr(), n_x, n_u_));
 
     // Calculate residuals and their cov.
     // Because I've added constraints, I need to re-calculate the right term
@@ -572,7 +985,7 @@ void SSID<Fit>::Solve(data_t wt_dc) {
     Vector db_vec = pinv(sum_QcurlyT_kron_Ncurly) * Pvec;
     // TODO(mfbolus) n.b., this gets thrown away...
     // Matrix D = Matrix(db_vec.memptr(), n_y_, n_u_);
-    fit_.set_B(Matrix(db_vec.memptr() + (n_u_ * n_y_), n_x_, n_u_));
+    fit.set_B(Matrix(db_vec.memptr() + (n_u_ * n_y_), n_x, n_u_));
     err_vec = Pvec - sum_QcurlyT_kron_Ncurly * db_vec;
   }
   // Matrix err = Matrix(err_vec.memptr(), Pcurly.n_rows, Pcurly.n_cols);
@@ -582,18 +995,22 @@ void SSID<Fit>::Solve(data_t wt_dc) {
   // WARNING: this ignores any above constraints, so Q, R will be approximate...
   Matrix err = Tl - S * Tr;
   Matrix cov_err = err * err.t();
-  fit_.set_Q(cov_err.submat(0, 0, n_x_ - 1, n_x_ - 1));
-  fit_.set_R(cov_err.submat(n_x_, n_x_, n_x_ + n_y_ - 1, n_x_ + n_y_ - 1));
+  fit.set_Q(cov_err.submat(0, 0, n_x - 1, n_x - 1));
+  fit.set_R(cov_err.submat(n_x, n_x, n_x + n_y_ - 1, n_x + n_y_ - 1));
+
+  // output (one-step prediction) residual variance
+  return arma::trace(
+      cov_err.submat(n_x, n_x, n_x + n_y_ - 1, n_x + n_y_ - 1));
 }
 
 template <typename Fit>
-void SSID<Fit>::RecomputeExtObs() {
-  ext_obs_t_.submat(0, 0, n_y_ - 1, ext_obs_t_.n_cols - 1) = fit_.C();
+void SSID<Fit>::RecomputeExtObs(const Fit& fit, Matrix& ext_obs_t) const {
+  ext_obs_t.submat(0, 0, n_y_ - 1, ext_obs_t.n_cols - 1) = fit.C();
   for (size_t k = 2; k < (n_h_ + 1); k++) {
-    ext_obs_t_.submat((k - 1) * n_y_, 0, k * n_y_ - 1, ext_obs_t_.n_cols - 1) =
-        ext_obs_t_.submat((k - 2) * n_y_, 0, (k - 1) * n_y_ - 1,
-                          ext_obs_t_.n_cols - 1) *
-        fit_.A();
+    ext_obs_t.submat((k - 1) * n_y_, 0, k * n_y_ - 1, ext_obs_t.n_cols - 1) =
+        ext_obs_t.submat((k - 2) * n_y_, 0, (k - 1) * n_y_ - 1,
+                          ext_obs_t.n_cols - 1) *
+        fit.A();
   }
 }
 
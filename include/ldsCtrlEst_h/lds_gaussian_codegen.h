@@ -0,0 +1,88 @@
+//===-- ldsCtrlEst_h/lds_gaussian_codegen.h - GLDS Codegen ------*- C++ -*-===//
+//
+// Copyright 2021 Michael Bolus
+// Copyright 2021 Georgia Institute of Technology
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file declares the generation of a self-contained C++ header from a
+/// configured Gaussian-output controller (`lds::gaussian::GenerateController`),
+/// for targets on which the model and gains no longer change. The generated
+/// controller has its parameters as `constexpr` arrays and folded into
+/// unrolled estimation/control steps, and depends on neither Armadillo nor
+/// this library.
+///
+/// \brief GLDS controller code generation
+//===----------------------------------------------------------------------===//
+
+#ifndef LDSCTRLEST_LDS_GAUSSIAN_CODEGEN_H
+#define LDSCTRLEST_LDS_GAUSSIAN_CODEGEN_H
+
+// controller types
+#include "lds_gaussian_ctrl.h"
+#include "lds_gaussian_sctrl.h"
+
+#include <string>
+
+namespace lds {
+namespace gaussian {
+
+/**
+ * Generates a header declaring, in namespace `name`, a `Controller` class
+ * whose `Control` and `ControlOutputReference` steps follow those of
+ * lds::Controller (including soft start, set-point hold/period, and
+ * anti-windup), starting from the current state of `controller`.
+ *
+ * Parameters are folded in as they are at generation, i.e., the estimator
+ * gain is held at its current value (rather than recursed), as are the
+ * steady-state set-point solution and references. Generation throws for
+ * what cannot be folded: online parameter adaptation and input-delay
+ * compensation. Noise added to the control signal (`sigma_u_noise`) is not
+ * supported.
+ *
+ * @brief      generates self-contained C++ header of controller
+ *
+ * @param      controller  controller
+ * @param      name        [optional] namespace of generated code (also
+ *                         basis of include guard)
+ *
+ * @return     source of the header
+ */
+std::string GenerateController(const Controller& controller,
+                               const std::string& name = "ldsctrl");
+
+/**
+ * As for a single controller, with all sub-systems folded in and a `Switch`
+ * between them matching lds::SwitchedController::Switch. Throws if
+ * sub-systems are estimated by IMM (see SwitchedController::set_imm) or their
+ * states are mapped other than by the identity (e.g., sub-systems of
+ * differing state dimensions; see SwitchedController::set_state_map).
+ *
+ * @brief      generates self-contained C++ header of switched controller
+ *
+ * @param      controller  switched controller
+ * @param      name        [optional] namespace of generated code (also
+ *                         basis of include guard)
+ *
+ * @return     source of the header
+ */
+std::string GenerateController(const SwitchedController& controller,
+                               const std::string& name = "ldsctrl");
+
+}  // namespace gaussian
+}  // namespace lds
+
+#endif
@@ -44,7 +44,7 @@ class Controller : public lds::Controller<System> {
   /// sets reference output
   void set_y_ref(const Vector& y_ref) override {
     Reassign(y_ref_,y_ref);
-    cx_ref_ = y_ref - sys_.d();
+    cx_ref_ = y_ref - sys_->d();
   };
 
   // make sure base class template methods available
@@ -29,6 +29,9 @@
 /// [2] Ghahramani Z, Hinton GE. (1996) Parameter Estimation for Linear
 /// Dynamical Systems. Technical Report CRG-TR-96-2.
 ///
+/// [3] Sarkka S, Garcia-Fernandez AF. (2021) Temporal Parallelization of
+/// Bayesian Smoothers. IEEE Transactions on Automatic Control 66(1).
+///
 /// \brief GLDS E-M fit type
 //===----------------------------------------------------------------------===//
 
@@ -50,6 +53,52 @@ class FitEM : public EM<Fit> {
  public:
   using EM<Fit>::EM;
 
+  /// gets tolerance for steady-state detection of filter/smoother
+  data_t steady_state_tol() const { return steady_state_tol_; };
+
+  /**
+   * Since the state covariance of a GLDS does not depend on the data, the
+   * filter (and smoother) covariances converge to steady state. Once the
+   * relative change of the posterior covariance between time steps falls
+   * below tolerance, the covariances and gains are held constant for the
+   * rest of the trial, such that each step only costs matrix-vector
+   * products.
+   *
+   * @brief      sets tolerance for steady-state detection of filter/smoother
+   *
+   * @param      tol   relative tolerance (e.g., 1e-9; 0 = never)
+   */
+  void set_steady_state_tol(data_t tol) { steady_state_tol_ = tol; };
+
+  /// gets min number of time steps of trials smoothed in parallel over time
+  size_t scan_min_n_t() const { return scan_min_n_t_; };
+
+  /**
+   * Rather than filtering and smoothing serially in time, a long trial can be
+   * smoothed in parallel over time by the associative-scan formulation of
+   * the Kalman filter and RTS smoother [3]. The trial is split into one block
+   * of time steps per thread (see set_n_threads). Each block is first
+   * reduced to the associative element of the filter over it, which are
+   * combined across blocks to get the filtered estimate at every block
+   * boundary. All blocks are then filtered concurrently starting from those
+   * boundaries, and likewise for the backward (smoothing) pass. This roughly
+   * doubles the work, but the span is ~n_t/n_threads rather than n_t.
+   *
+   * Shorter trials (and all trials when single-threaded) are smoothed
+   * serially, distributed across threads. So are trials whose filter
+   * estimates would not fit the smoother memory budget (see
+   * set_smoother_memory), as the scan keeps them for the whole trial.
+   *
+   * n.b., unlike the serial smoother, results may differ with the number of
+   * threads by round-off error.
+   *
+   * @brief      sets min number of time steps of trials smoothed in parallel
+   *             over time
+   *
+   * @param      n_t   min number of time steps (0 = never)
+   */
+  void set_scan_min_n_t(size_t n_t) { scan_min_n_t_ = n_t; };
+
  private:
   /**
    * @brief      estimate C+d by maximizing likelihood
@@ -67,9 +116,49 @@ class FitEM : public EM<Fit> {
    * @param      Ke      estimator gain
    * @param      P_pre   cov of predicted state est.
    * @param      P_post  cov of postior sate est.
+   * @param      y_pre   predicted output at time t
    * @param[in]  t       time
    */
-  void RecurseKe(Matrix& Ke, Cube& P_pre, Cube& P_post, size_t t) override;
+  void RecurseKe(Matrix& Ke, Cube& P_pre, Cube& P_post, const Vector& y_pre,
+                 size_t t) override;
+
+  /**
+   * @brief      log-likelihood of measurement given past measurements
+   *
+   * @param      z          measurement at time t
+   * @param      y_pre      predicted output at time t
+   * @param      P_pre      cov of predicted state est. at time t
+   * @param      is_steady  whether P_pre is the same as at previous call
+   * @param      cache      scratch reused between time steps
+   *
+   * @return     log-likelihood
+   */
+  data_t LogLikelihood(const Vector& z, const Vector& y_pre,
+                       const Matrix& P_pre, bool is_steady,
+                       LikelihoodCache& cache) const override;
+
+  /**
+   * @brief      whether trial is smoothed in parallel over time
+   *
+   * @param      trial  trial index
+   *
+   * @return     whether to smooth trial by ScanSmoothTrial
+   */
+  bool DoesSmoothByScan(size_t trial) const override;
+
+  /**
+   * @brief      get smoothed estimates of a single trial, in parallel over
+   *             time (see set_scan_min_n_t)
+   *
+   * @param      trial                 trial index
+   * @param      force_common_initial  whether to force common initial
+   *                                   conditions
+   * @param      stats                 [out] sufficient statistics of trial
+   */
+  void ScanSmoothTrial(size_t trial, bool force_common_initial,
+                       SufficientStats& stats) override;
+
+  size_t scan_min_n_t_{};  ///< min n_t of trials smoothed in parallel (0=inf)
 };
 
 }  // namespace gaussian
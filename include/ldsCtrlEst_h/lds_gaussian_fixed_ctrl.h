@@ -0,0 +1,510 @@
+//===-- ldsCtrlEst_h/lds_gaussian_fixed_ctrl.h - Fixed GLDS Ctrl *- C++ -*-===//
+//
+// Copyright 2021 Michael Bolus
+// Copyright 2021 Georgia Institute of Technology
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file declares and defines the controller matching
+/// `lds::gaussian::FixedSystem` (`lds::gaussian::FixedController`). Its
+/// control law is identical to that of `lds::Controller`, but dimensions are
+/// compile-time constants and the steady-state set-point solution is computed
+/// once per system rather than on every step.
+///
+/// \brief Fixed-size GLDS controller
+//===----------------------------------------------------------------------===//
+
+#ifndef LDSCTRLEST_LDS_GAUSSIAN_FIXED_CTRL_H
+#define LDSCTRLEST_LDS_GAUSSIAN_FIXED_CTRL_H
+
+// system
+#include "lds_gaussian_fixed_sys.h"
+
+namespace lds {
+namespace gaussian {
+
+/// Gaussian-observation Controller Type with compile-time dimensions
+template <std::size_t NU, std::size_t NX, std::size_t NY>
+class FixedController {
+ public:
+  using System = FixedSystem<NU, NX, NY>;
+  using VectorU = typename System::VectorU;
+  using VectorX = typename System::VectorX;
+  using VectorY = typename System::VectorY;
+  using MatrixUX = typename Matrix::template fixed<NU, NX>;
+  using MatrixUU = typename Matrix::template fixed<NU, NU>;
+  using MatrixUY = typename Matrix::template fixed<NU, NY>;
+  /// size of steady-state set-point problem ([x; u; lagrange mult.])
+  static const std::size_t kNSetPoint = NX + NU + NX;
+  using MatrixSetPoint =
+      typename Matrix::template fixed<kNSetPoint, kNSetPoint>;
+  using VectorSetPoint = typename Vector::template fixed<kNSetPoint>;
+
+  /**
+   * @brief      Constructs a new FixedController.
+   */
+  FixedController() = default;
+
+  /**
+   * @brief      Constructs a new FixedController.
+   *
+   * @param      sys           fixed-size system
+   * @param      u_lb          lower bound on control (u)
+   * @param      u_ub          upper bound on control (u)
+   * @param      control_type  [optional] control type bit mask
+   */
+  FixedController(const System& sys, data_t u_lb, data_t u_ub,
+                  size_t control_type = 0);
+
+  /**
+   * @brief      updates control signal (single-step)
+   *
+   * @param      z                          measurement
+   * @param      do_control                 [optional] whether to update control
+   *                                        (true) or simply feed through u_ref
+   *                                        (false)
+   * @param      do_lock_control            [optional] whether to lock control
+   *                                        at its current value
+   * @param      sigma_soft_start           [optional] standard deviation
+   *                                        (sigma) of a Gaussian soft-start to
+   *                                        control
+   * @param      sigma_u_noise              [optional] standard deviation
+   *                                        (sigma) of Gaussian noise added on
+   *                                        top of control signal
+   * @param      do_reset_at_control_onset  [optional] whether to reset
+   *                                        controller at control epoch onset
+   *
+   * @return     updated control signal
+   */
+  const VectorU& Control(const VectorY& z, bool do_control = true,
+                         bool do_lock_control = false,
+                         data_t sigma_soft_start = 0, data_t sigma_u_noise = 0,
+                         bool do_reset_at_control_onset = true);
+
+  /**
+   * Updates the control signal (single-step), given previously-set y_ref. The
+   * rest of the set point (u_ref, x_ref) is solved from the cached
+   * linearly-constrained least-squares solution (see `lds::Controller`).
+   *
+   * @brief      updates control signal, given previously-set y_ref
+   *
+   * @param      z                          measurement
+   * @param      do_control                 [optional] whether to update control
+   * @param      do_estimation              [optional] whether to update state
+   *                                        estimate
+   * @param      do_lock_control            [optional] whether to lock control
+   *                                        at its current value
+   * @param      sigma_soft_start           [optional] standard deviation
+   *                                        (sigma) of a Gaussian soft-start
+   * @param      sigma_u_noise              [optional] standard deviation
+   *                                        (sigma) of Gaussian noise added on
+   *                                        top of control signal
+   * @param      do_reset_at_control_onset  [optional] whether to reset
+   *                                        controller at control epoch onset
+   *
+   * @return     updated control signal
+   */
+  const VectorU& ControlOutputReference(const VectorY& z,
+                                        bool do_control = true,
+                                        bool do_estimation = true,
+                                        bool do_lock_control = false,
+                                        data_t sigma_soft_start = 0,
+                                        data_t sigma_u_noise = 0,
+                                        bool do_reset_at_control_onset = true);
+
+  // get methods:
+  const System& sys() const { return sys_; };
+  /// Get state feedback controller gain
+  const MatrixUX& Kc() const { return Kc_; };
+  /// Get integral controller gain
+  const MatrixUY& Kc_inty() const { return Kc_inty_; };
+  /// Get input feedback controller gain
+  const MatrixUU& Kc_u() const { return Kc_u_; };
+  /// Get input gain used in controller design
+  const VectorU& g_design() const { return g_design_; };
+  /// Get reference input
+  const VectorU& u_ref() const { return u_ref_; };
+  /// Get reference state
+  const VectorX& x_ref() const { return x_ref_; };
+  /// Get reference output
+  const VectorY& y_ref() const { return y_ref_; };
+  /// Get controller type
+  size_t control_type() const { return control_type_; };
+
+  // set methods
+  /// Set system
+  void set_sys(const System& sys) {
+    sys_ = sys;
+    CalcSetPointSolution();
+  };
+  /// Set input gain used in controller design (g_design)
+  void set_g_design(const Vector& g_design) { Reassign(g_design_, g_design); };
+  /// Set reference input (u_ref)
+  void set_u_ref(const Vector& u_ref) { Reassign(u_ref_, u_ref); };
+  /// Set reference state (x_ref)
+  void set_x_ref(const Vector& x_ref) {
+    Reassign(x_ref_, x_ref);
+    cx_ref_ = sys_.C() * x_ref_;
+  };
+  /// Set reference output (y_ref)
+  void set_y_ref(const Vector& y_ref) {
+    Reassign(y_ref_, y_ref);
+    cx_ref_ = y_ref_ - sys_.d();
+  };
+  /// Set state controller gain
+  void set_Kc(const Matrix& Kc) { Reassign(Kc_, Kc); };
+  /// Set integral controller gain
+  void set_Kc_inty(const Matrix& Kc_inty) { Reassign(Kc_inty_, Kc_inty); };
+  /// Set input controller gain
+  void set_Kc_u(const Matrix& Kc_u) { Reassign(Kc_u_, Kc_u); };
+  /// Set time constant of anti-integral-windup
+  void set_tau_awu(data_t tau) {
+    tau_awu_ = tau;
+    k_awu_ = sys_.dt() / tau_awu_;
+  };
+  /// Set control type bit mask
+  void set_control_type(size_t control_type) {
+    control_type_ = control_type & (kControlTypeDeltaU | kControlTypeIntY);
+    // only adapt set point if adapting m...
+    if ((control_type & kControlTypeAdaptM) && sys_.do_adapt_m) {
+      control_type_ = control_type_ | kControlTypeAdaptM;
+    }
+  };
+  /// sets control lower bound
+  void set_u_lb(data_t u_lb) { u_lb_ = u_lb; };
+  /// sets control upper bound
+  void set_u_ub(data_t u_ub) { u_ub_ = u_ub; };
+
+  /// reset system and control variables.
+  void Reset() {
+    sys_.Reset();
+    u_ref_.zeros();
+    u_ref_prev_.zeros();
+    int_e_.zeros();
+    int_e_awu_adjust_.zeros();
+    u_sat_.zeros();
+    u_saturated_ = false;
+    t_since_control_onset_ = 0.0;
+  };
+
+  /// prints variables to stdout
+  void Print() {
+    sys_.Print();
+    std::cout << "g_design : " << g_design_ << "\n";
+    std::cout << "u_lb : " << u_lb_ << "\n";
+    std::cout << "u_ub : " << u_ub_ << "\n";
+  };
+
+ protected:
+  System sys_;  ///< underlying LDS
+
+  VectorU u_;         ///< control signal
+  VectorU u_return_;  ///< control signal that is *returned* to user
+  VectorU g_design_;  ///< input gain of the system used for controller design
+
+  //  reference signals
+  VectorU u_ref_;       ///< reference input
+  VectorU u_ref_prev_;  ///< reference input at previous time step
+  VectorX x_ref_;       ///< reference state
+  VectorY y_ref_;       ///< reference output
+  VectorY cx_ref_;      ///< reference C*x
+
+  // Controller gains
+  MatrixUX Kc_;       ///< state controller gain
+  MatrixUU Kc_u_;     ///< input controller gain
+  MatrixUY Kc_inty_;  ///< integral controller gain
+
+  // control after g inversion
+  VectorU dv_ref_;
+  VectorU v_ref_;
+  VectorU dv_;
+  VectorU v_;  ///< Control after g inversion (e.g., control in physical units)
+
+  // integral error
+  VectorY int_e_;             ///< integrated error
+  VectorY int_e_awu_adjust_;  ///< anti-windup adjustment to intE
+  VectorU u_sat_;  ///< control signal after saturation (for antiWindup)
+
+  bool do_control_prev_ = false;
+  bool do_lock_control_prev_ = false;
+  bool u_saturated_ =
+      false;  ///< whether control signal has reached saturation limits
+
+  data_t u_lb_{};  ///< lower bound on control
+  data_t u_ub_{};  ///< upper bound on control
+
+  data_t tau_awu_ = lds::kInf;  ///< antiwindup time constant
+  data_t k_awu_ = 0;
+
+  data_t t_since_control_onset_ = 0;  ///< time since control epoch onset
+  size_t control_type_{};             ///< controller type
+
+  // cached steady-state set-point solution: [x;u;lam] = inv_phi * [b; d]
+  MatrixSetPoint inv_phi_;  ///< inverse of set-point KKT matrix
+
+  // Scratch:
+  VectorX tmp_x_;         ///< scratch (n_x)
+  VectorU tmp_u_;         ///< scratch (n_u)
+  VectorY tmp_y_;         ///< scratch (n_y)
+  MatrixUY tmp_awu_;      ///< scratch for anti-windup
+  VectorSetPoint tmp_b_;  ///< scratch for set-point right-hand side
+  VectorSetPoint tmp_xulam_;  ///< scratch for set-point solution
+
+ private:
+  /// calculates the control signal update (single-step)
+  void CalcControl(bool do_control, bool do_estimation, bool do_lock_control,
+                   data_t sigma_soft_start, data_t sigma_u_noise,
+                   bool do_reset_at_control_onset);
+
+  /// calculates set-point (u_ref, x_ref) that tracks y_ref at steady state
+  void CalcSteadyStateSetPoint();
+
+  /// caches the inverse of the set-point KKT matrix (depends on A, B, g, C)
+  void CalcSetPointSolution();
+
+  /// performs saturation check on control signal and antiwindup adjustment
+  void AntiWindup();
+};
+
+// Implement the above:
+
+template <std::size_t NU, std::size_t NX, std::size_t NY>
+inline FixedController<NU, NX, NY>::FixedController(const System& sys,
+                                                    data_t u_lb, data_t u_ub,
+                                                    size_t control_type)
+    : sys_(sys), u_lb_(u_lb), u_ub_(u_ub) {
+  u_.zeros();
+  u_return_.zeros();
+  g_design_ = sys_.g();  // by default, same as model
+  u_ref_.zeros();
+  u_ref_prev_.zeros();
+  x_ref_.zeros();
+  y_ref_.zeros();
+  cx_ref_.zeros();
+  Kc_.zeros();
+  Kc_u_.zeros();
+  Kc_inty_.zeros();
+  dv_ref_.zeros();
+  v_ref_.zeros();
+  dv_.zeros();
+  v_.zeros();
+  int_e_.zeros();
+  int_e_awu_adjust_.zeros();
+  u_sat_.zeros();
+  set_control_type(control_type);
+  CalcSetPointSolution();
+}
+
+template <std::size_t NU, std::size_t NX, std::size_t NY>
+inline const typename FixedController<NU, NX, NY>::VectorU&
+FixedController<NU, NX, NY>::Control(const VectorY& z, bool do_control,
+                                     bool do_lock_control,
+                                     data_t sigma_soft_start,
+                                     data_t sigma_u_noise,
+                                     bool do_reset_at_control_onset) {
+  // update state estimates, given latest measurement
+  sys_.Filter(u_, z);
+
+  // calculate control signal
+  CalcControl(do_control, true, do_lock_control, sigma_soft_start,
+              sigma_u_noise, do_reset_at_control_onset);
+
+  return u_return_;
+}
+
+template <std::size_t NU, std::size_t NX, std::size_t NY>
+inline const typename FixedController<NU, NX, NY>::VectorU&
+FixedController<NU, NX, NY>::ControlOutputReference(
+    const VectorY& z, bool do_control, bool do_estimation,
+    bool do_lock_control, data_t sigma_soft_start, data_t sigma_u_noise,
+    bool do_reset_at_control_onset) {
+  // update state estimates, given latest measurement
+  if (do_estimation) {
+    sys_.Filter(u_, z);
+  } else {
+    sys_.f(u_);
+  }
+
+  // calculate the set point
+  if (do_control) {
+    CalcSteadyStateSetPoint();
+  }
+
+  // calculate control signal
+  CalcControl(do_control, do_estimation, do_lock_control, sigma_soft_start,
+              sigma_u_noise, do_reset_at_control_onset);
+
+  return u_return_;
+}
+
+template <std::size_t NU, std::size_t NX, std::size_t NY>
+inline void FixedController<NU, NX, NY>::CalcControl(
+    bool do_control, bool do_estimation, bool do_lock_control,
+    data_t sigma_soft_start, data_t sigma_u_noise,
+    bool do_reset_at_control_onset) {
+  if (do_control && do_estimation) {
+    if (!do_control_prev_) {
+      if (do_reset_at_control_onset) {
+        Reset();
+      }
+      t_since_control_onset_ = 0.0;
+    } else {
+      t_since_control_onset_ += sys_.dt();
+    }
+
+    // enforce softstart on control vars.
+    if (sigma_soft_start > 0) {
+      // half-Gaussian soft-start scaling factor
+      data_t soft_start_sf = 1 - exp(-pow(t_since_control_onset_, 2) /
+                                     (2 * pow(sigma_soft_start, 2)));
+      u_ref_ *= soft_start_sf;
+    }
+
+    if (!do_lock_control) {
+      // u -> v change of vars. (v = g.*u)
+      v_ref_ = g_design_ % u_ref_;
+
+      if (control_type_ & kControlTypeDeltaU) {
+        // n.b., forcing dv_ref_ to zero (see lds::Controller)
+        dv_ref_.zeros();
+
+        dv_ = dv_ref_;               // nominally-optimal.
+        tmp_x_ = sys_.x() - x_ref_;  // instantaneous state error
+        dv_ -= Kc_ * tmp_x_;
+        tmp_u_ = v_ - v_ref_;  // penalty on amp u (rel to ref)
+        dv_ -= Kc_u_ * tmp_u_;
+
+        if (control_type_ & kControlTypeIntY) {
+          int_e_ += (sys_.cx() - cx_ref_) * sys_.dt();  // integrated error
+          dv_ -= Kc_inty_ * int_e_;  // control for integrated error
+        }
+
+        // update the control
+        v_ += dv_;
+      } else {
+        v_ = v_ref_;                 // nominally-optimal.
+        tmp_x_ = sys_.x() - x_ref_;  // instantaneous state error
+        v_ -= Kc_ * tmp_x_;
+
+        if (control_type_ & kControlTypeIntY) {
+          int_e_ += (sys_.cx() - cx_ref_) * sys_.dt();  // integrated error
+          v_ -= Kc_inty_ * int_e_;  // control for integrated error
+        }
+      }
+
+      // convert back to control voltage u[=]V
+      u_ = v_ / sys_.g();
+    }       // else do nothing until lock is low
+  } else {  // if not control
+    // feed through u_ref in open loop
+    u_ = u_ref_ % g_design_ / sys_.g();
+    v_ = sys_.g() % u_;
+    u_ref_.zeros();
+    int_e_.zeros();
+    int_e_awu_adjust_.zeros();
+    u_sat_.zeros();
+  }  // ends do_control
+
+  // enforce box constraints (and antiwindup)
+  AntiWindup();
+
+  // add noise to input?
+  u_return_ = u_;
+  if ((sigma_u_noise > 0.0) && (do_control && !do_lock_control)) {
+    tmp_u_.randn();
+    u_return_ += sigma_u_noise * tmp_u_;
+    Limit(u_return_, u_lb_, u_ub_);
+  };
+
+  // For next time step:
+  u_ref_prev_ = u_ref_;
+  do_control_prev_ = do_control;
+  do_lock_control_prev_ = do_lock_control;
+}  // CalcControl
+
+template <std::size_t NU, std::size_t NX, std::size_t NY>
+inline void FixedController<NU, NX, NY>::CalcSetPointSolution() {
+  // Linearly-constrained least squares (see lds::Controller). The KKT matrix
+  // only depends on the system parameters, so invert it once here.
+  Matrix a_ls = join_horiz(sys_.C(), Matrix(NY, NU, fill::zeros));
+  Matrix c_ls = join_horiz(sys_.A() - Matrix(NX, NX, fill::eye),
+                           sys_.B() * arma::diagmat(sys_.g()));
+  Matrix a_ls_t = a_ls.t();
+  Matrix phi_ls =
+      join_vert(join_horiz(2 * a_ls_t * a_ls, c_ls.t()),
+                join_horiz(c_ls, Matrix(NX, NX, fill::zeros)));
+  inv_phi_ = pinv(phi_ls);
+}
+
+template <std::size_t NU, std::size_t NX, std::size_t NY>
+inline void FixedController<NU, NX, NY>::CalcSteadyStateSetPoint() {
+  // rhs = [2 * a_ls' * b_ls; d_ls], where a_ls = [C, 0] and b_ls = cx_ref
+  tmp_b_.zeros();
+  tmp_x_ = sys_.C().t() * cx_ref_;
+  for (std::size_t k = 0; k < NX; k++) {
+    tmp_b_[k] = 2 * tmp_x_[k];
+  }
+  const VectorX& m =
+      (control_type_ & kControlTypeAdaptM) ? sys_.m() : sys_.m0();
+  for (std::size_t k = 0; k < NX; k++) {
+    tmp_b_[NX + NU + k] = -m[k];
+  }
+
+  tmp_xulam_ = inv_phi_ * tmp_b_;
+  for (std::size_t k = 0; k < NX; k++) {
+    x_ref_[k] = tmp_xulam_[k];
+  }
+  for (std::size_t k = 0; k < NU; k++) {
+    u_ref_[k] = tmp_xulam_[NX + k];
+  }
+  cx_ref_ = sys_.C() * x_ref_;
+}
+
+template <std::size_t NU, std::size_t NX, std::size_t NY>
+inline void FixedController<NU, NX, NY>::AntiWindup() {
+  u_saturated_ = false;
+  u_sat_ = u_;
+
+  // limit u and flag whether saturated
+  for (size_t k = 0; k < NU; k++) {
+    if (u_[k] < u_lb_) {
+      u_sat_[k] = u_lb_;
+      u_saturated_ = true;
+    }
+
+    if (u_[k] > u_ub_) {
+      u_sat_[k] = u_ub_;
+      u_saturated_ = true;
+    }
+  }
+
+  if ((control_type_ & kControlTypeIntY) && (tau_awu_ < lds::kInf)) {
+    // gradual: see Astroem, Rundqwist 1989
+    tmp_awu_ = sign(Kc_inty_);
+    tmp_u_ = u_ - u_sat_;
+    int_e_awu_adjust_ = tmp_awu_.t() * tmp_u_;
+    int_e_awu_adjust_ *= k_awu_ / NU;
+    int_e_ += int_e_awu_adjust_;
+  }
+
+  // set u to saturated version
+  u_ = u_sat_;
+}
+
+}  // namespace gaussian
+}  // namespace lds
+
+#endif
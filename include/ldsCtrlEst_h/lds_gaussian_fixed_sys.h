@@ -0,0 +1,406 @@
+//===-- ldsCtrlEst_h/lds_gaussian_fixed_sys.h - Fixed-Size GLDS -*- C++ -*-===//
+//
+// Copyright 2021 Michael Bolus
+// Copyright 2021 Georgia Institute of Technology
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file declares and defines a Gaussian-output linear dynamical system
+/// whose dimensions are fixed at compile time
+/// (`lds::gaussian::FixedSystem`). It mirrors `lds::gaussian::System`, but all
+/// signals and parameters are backed by Armadillo's fixed-size types so that
+/// the per-step filter has no dynamic memory and loop bounds are known to the
+/// compiler. This is intended for small models deployed on embedded targets.
+///
+/// \brief Fixed-size GLDS type
+//===----------------------------------------------------------------------===//
+
+#ifndef LDSCTRLEST_LDS_GAUSSIAN_FIXED_SYS_H
+#define LDSCTRLEST_LDS_GAUSSIAN_FIXED_SYS_H
+
+// namespace
+#include "lds_gaussian.h"
+
+namespace lds {
+namespace gaussian {
+
+/// Gaussian LDS Type with compile-time dimensions
+template <std::size_t NU, std::size_t NX, std::size_t NY>
+class FixedSystem {
+  static_assert((NU > 0) && (NX > 0) && (NY > 0),
+                "FixedSystem dimensions must be positive.");
+
+ public:
+  // fixed-size types
+  using VectorU = typename Vector::template fixed<NU>;
+  using VectorX = typename Vector::template fixed<NX>;
+  using VectorY = typename Vector::template fixed<NY>;
+  using MatrixXX = typename Matrix::template fixed<NX, NX>;
+  using MatrixXU = typename Matrix::template fixed<NX, NU>;
+  using MatrixYX = typename Matrix::template fixed<NY, NX>;
+  using MatrixXY = typename Matrix::template fixed<NX, NY>;
+  using MatrixYY = typename Matrix::template fixed<NY, NY>;
+
+  /**
+   * @brief      Constructs a new FixedSystem.
+   */
+  FixedSystem() : FixedSystem(0) {}
+
+  /**
+   * @brief      Constructs a new FixedSystem.
+   *
+   * @param      dt    sample period
+   * @param      p0    [optional] initial diagonal elements of state estimate
+   *                   covariance (P)
+   * @param      q0    [optional] initial diagonal elements of process noise
+   *                   covariance (Q)
+   * @param      r0    [optional] initial diagonal elements of output noise
+   *                   covariance (R)
+   */
+  explicit FixedSystem(data_t dt, data_t p0 = kDefaultP0,
+                       data_t q0 = kDefaultQ0, data_t r0 = kDefaultR0);
+
+  /**
+   * Given current measurment and input, filter data to produce causal state
+   * estimates using Kalman filtering, which procedes by predicting the state
+   * and subsequently updating.
+   *
+   * @brief      Filter data to produce causal state estimates
+   *
+   * @param      u_tm1  input at t-minus-1
+   * @param      z_t    current measurement
+   */
+  void Filter(const VectorU& u_tm1, const VectorY& z_t);
+
+  /**
+   * @brief      Simulate system measurement
+   *
+   * @param      u_tm1  input at t-1
+   *
+   * @return     z      measurement
+   */
+  const VectorY& Simulate(const VectorU& u_tm1);
+
+  /**
+   * @brief      system dynamics function
+   *
+   * @param      u             input
+   * @param      do_add_noise  whether to add simulated process noise
+   */
+  void f(const VectorU& u, bool do_add_noise = false);
+
+  /// Get number of inputs
+  static constexpr std::size_t n_u() { return NU; };
+  /// Get number of states
+  static constexpr std::size_t n_x() { return NX; };
+  /// Get number of outputs
+  static constexpr std::size_t n_y() { return NY; };
+  /// Get sample period
+  data_t dt() const { return dt_; };
+
+  /// Get current state
+  const VectorX& x() const { return x_; };
+  /// Get covariance of state estimate
+  const MatrixXX& P() const { return P_; };
+  /// Get current process disturbance/bias
+  const VectorX& m() const { return m_; };
+  /// Get covariance of process disturbance estimate
+  const MatrixXX& P_m() const { return P_m_; };
+  /// Get C*x
+  const VectorY& cx() const { return cx_; };
+  /// Get output
+  const VectorY& y() const { return y_; };
+  /// Get initial state
+  const VectorX& x0() const { return x0_; };
+  /// Get initial disturbance
+  const VectorX& m0() const { return m0_; };
+  /// Get state matrix
+  const MatrixXX& A() const { return A_; };
+  /// Get input matrix
+  const MatrixXU& B() const { return B_; };
+  /// Get input gain/conversion factor
+  const VectorU& g() const { return g_; };
+  /// Get process noise covariance
+  const MatrixXX& Q() const { return Q_; };
+  /// Get output matrix
+  const MatrixYX& C() const { return C_; };
+  /// Get output bias
+  const VectorY& d() const { return d_; };
+  /// Get output noise covariance
+  const MatrixYY& R() const { return R_; };
+  /// Get estimator gain
+  const MatrixXY& Ke() const { return Ke_; };
+  /// Get estimator gain for process disturbance (m)
+  const MatrixXY& Ke_m() const { return Ke_m_; };
+
+  /// Set state matrix
+  void set_A(const Matrix& A) { Reassign(A_, A); };
+  /// Set input matrix
+  void set_B(const Matrix& B) { Reassign(B_, B); };
+  /// Set process disturbance
+  void set_m(const Vector& m, bool do_force_assign = false) {
+    Reassign(m0_, m);
+    if ((!do_adapt_m) || do_force_assign) {
+      Reassign(m_, m);
+    }
+  };
+  /// Set input gain
+  void set_g(const Vector& g) { Reassign(g_, g); };
+  /// Set process noise covariance
+  void set_Q(const Matrix& Q) {
+    Reassign(Q_, Q);
+    do_recurse_Ke_ = true;
+  };
+  /// Set process noise covariance of disturbance evoluation
+  void set_Q_m(const Matrix& Q_m) { Reassign(Q_m_, Q_m); };
+  /// Set initial state
+  void set_x0(const Vector& x0) { Reassign(x0_, x0); };
+  /// Set covariance of initial state
+  void set_P0(const Matrix& P0) { Reassign(P0_, P0); };
+  /// Set covariance of initial process disturbance
+  void set_P0_m(const Matrix& P0_m) { Reassign(P0_m_, P0_m); };
+  /// Set output matrix
+  void set_C(const Matrix& C) { Reassign(C_, C); };
+  /// Set output bias
+  void set_d(const Vector& d) { Reassign(d_, d); };
+  /// Set output noise covariance
+  void set_R(const Matrix& R) {
+    Reassign(R_, R);
+    do_recurse_Ke_ = true;
+  };
+  /// Set estimator gain
+  void set_Ke(const Matrix& Ke) {
+    Reassign(Ke_, Ke);
+    // if users have set Ke, they must not want to calculate it online.
+    do_recurse_Ke_ = false;
+  };
+  /// Set disturbance estimator gain
+  void set_Ke_m(const Matrix& Ke_m) {
+    Reassign(Ke_m_, Ke_m);
+    // if users have set Ke, they must not want to calculate it online.
+    do_recurse_Ke_ = false;
+  };
+  /// Set state of system
+  void set_x(const Vector& x) {
+    Reassign(x_, x);
+    h();
+  };
+
+  /// Reset system variables
+  void Reset();
+
+  /// Print system variables to stdout
+  void Print();
+
+  // safe to leave this public and non-const
+  bool do_adapt_m{};  ///< whether to adaptively estimate disturbance m
+
+ protected:
+  /// System output function
+  void h() {
+    cx_ = C_ * x_;
+    y_ = cx_ + d_;
+  };
+
+  /// Recursively update estimator gain
+  void RecurseKe();
+
+  data_t dt_{};  ///< sample period
+
+  // Signals:
+  VectorX x_;     ///< state
+  MatrixXX P_;    ///< covariance of state estimate
+  VectorX m_;     ///< process disturbance
+  MatrixXX P_m_;  ///< covariance of disturbance estimate
+  VectorY cx_;    ///< C*x
+  VectorY y_;     ///< output
+  VectorY z_;     ///< measurement
+
+  // Parameters:
+  VectorX x0_;     ///< initial state
+  MatrixXX P0_;    ///< covariance of initial state estimate
+  VectorX m0_;     ///< initial process disturbance
+  MatrixXX P0_m_;  ///< covariance of initial disturbance est.
+  MatrixXX A_;     ///< state matrix
+  MatrixXU B_;     ///< input matrix
+  VectorU g_;      ///< input gain
+  MatrixXX Q_;     ///< covariance of process noise
+  MatrixXX Q_m_;   ///< covariance of disturbance random walk
+  MatrixYX C_;     ///< output matrix
+  VectorY d_;      ///< output bias
+  MatrixYY R_;     ///< covariance of output noise
+
+  MatrixXY Ke_;    ///< estimator gain
+  MatrixXY Ke_m_;  ///< estimator gain for process disturbance
+  bool do_recurse_Ke_{};  ///< whether to recursively calculate estimator gain
+
+  // Scratch:
+  VectorX tmp_x_;     ///< scratch (n_x)
+  VectorU tmp_u_;     ///< scratch (n_u)
+  VectorY tmp_y_;     ///< scratch (n_y)
+  MatrixXX tmp_xx_;   ///< scratch (n_x x n_x)
+  MatrixXY tmp_xy_;   ///< scratch (n_x x n_y)
+  MatrixYY tmp_yy_;   ///< scratch (n_y x n_y)
+  MatrixYY tmp_yy_inv_;  ///< scratch (n_y x n_y)
+};  // FixedSystem
+
+// Implement the above:
+
+template <std::size_t NU, std::size_t NX, std::size_t NY>
+inline FixedSystem<NU, NX, NY>::FixedSystem(data_t dt, data_t p0, data_t q0,
+                                            data_t r0)
+    : dt_(dt) {
+  // initial conditions.
+  x0_.zeros();
+  P0_.eye();
+  P0_ *= p0;
+  m0_.zeros();
+  P0_m_ = P0_;
+
+  // signals
+  x_ = x0_;
+  P_ = P0_;
+  m_ = m0_;
+  P_m_ = P0_m_;
+  y_.zeros();
+  cx_.zeros();
+  z_.zeros();
+
+  // By default, random walk where each state is independent
+  A_.eye();
+  B_.zeros();
+  g_.ones();
+  Q_.eye();
+  Q_ *= q0;
+  Q_m_ = Q_;
+  C_.eye();
+  d_.zeros();
+  R_.eye();
+  R_ *= r0;
+
+  Ke_.zeros();
+  Ke_m_.zeros();
+  do_recurse_Ke_ = true;
+  do_adapt_m = false;
+}
+
+template <std::size_t NU, std::size_t NX, std::size_t NY>
+inline void FixedSystem<NU, NX, NY>::f(const VectorU& u, bool do_add_noise) {
+  tmp_u_ = g_ % u;
+  tmp_x_ = m_;
+  tmp_x_ += A_ * x_;
+  tmp_x_ += B_ * tmp_u_;
+  x_ = tmp_x_;
+  if (do_add_noise) {
+    x_ += arma::mvnrnd(Vector(NX, fill::zeros), Q_);
+  }
+}
+
+template <std::size_t NU, std::size_t NX, std::size_t NY>
+inline void FixedSystem<NU, NX, NY>::Filter(const VectorU& u_tm1,
+                                            const VectorY& z_t) {
+  // predict mean
+  f(u_tm1);  // dynamics
+  h();       // output
+
+  // recursively calculate esimator gains (or just keep existing values)
+  // (also predicts+updates estimate covariance)
+  RecurseKe();
+
+  // update
+  tmp_y_ = z_t - y_;  // innovation
+  x_ += Ke_ * tmp_y_;
+  if (do_adapt_m) {
+    m_ += Ke_m_ * tmp_y_;  // adaptively estimating disturbance
+  }
+
+  // With new state, estimate output.
+  h();  // --> posterior
+}
+
+template <std::size_t NU, std::size_t NX, std::size_t NY>
+inline void FixedSystem<NU, NX, NY>::RecurseKe() {
+  if (!do_recurse_Ke_) {
+    return;
+  }
+
+  // predict covariance
+  tmp_xx_ = A_ * P_;
+  P_ = tmp_xx_ * A_.t();
+  P_ += Q_;
+
+  // calc Kalman gain
+  tmp_xy_ = P_ * C_.t();
+  tmp_yy_ = C_ * tmp_xy_;
+  tmp_yy_ += R_;
+  inv_sympd(tmp_yy_inv_, tmp_yy_);
+  Ke_ = tmp_xy_ * tmp_yy_inv_;
+
+  // update covariance
+  // Reference: Ghahramani et Hinton (1996)
+  P_ -= Ke_ * tmp_xy_.t();
+
+  if (do_adapt_m) {
+    P_m_ += Q_m_;  // A_m = I (i.e., random walk)
+    tmp_xy_ = P_m_ * C_.t();
+    tmp_yy_ = C_ * tmp_xy_;
+    tmp_yy_ += R_;
+    inv_sympd(tmp_yy_inv_, tmp_yy_);
+    Ke_m_ = tmp_xy_ * tmp_yy_inv_;
+    P_m_ -= Ke_m_ * tmp_xy_.t();
+  }
+}
+
+template <std::size_t NU, std::size_t NX, std::size_t NY>
+inline const typename FixedSystem<NU, NX, NY>::VectorY&
+FixedSystem<NU, NX, NY>::Simulate(const VectorU& u_tm1) {
+  f(u_tm1, true);  // simulate dynamics with noise added
+  h();             // output
+  z_ = y_ + arma::mvnrnd(Vector(NY, fill::zeros), R_);  // measure
+  return z_;
+}
+
+template <std::size_t NU, std::size_t NX, std::size_t NY>
+inline void FixedSystem<NU, NX, NY>::Reset() {
+  // reset to initial conditions
+  x_ = x0_;      // mean
+  P_ = P0_;      // cov of state estimate
+  m_ = m0_;      // process disturbance
+  P_m_ = P0_m_;  // cov of disturbance estimate
+  h();
+}
+
+template <std::size_t NU, std::size_t NX, std::size_t NY>
+inline void FixedSystem<NU, NX, NY>::Print() {
+  std::cout << "\n ********** SYSTEM ********** \n";
+  std::cout << "x: \n" << x_ << "\n";
+  std::cout << "P: \n" << P_ << "\n";
+  std::cout << "A: \n" << A_ << "\n";
+  std::cout << "B: \n" << B_ << "\n";
+  std::cout << "g: \n" << g_ << "\n";
+  std::cout << "m: \n" << m_ << "\n";
+  std::cout << "Q: \n" << Q_ << "\n";
+  std::cout << "Q_m: \n" << Q_m_ << "\n";
+  std::cout << "d: \n" << d_ << "\n";
+  std::cout << "C: \n" << C_ << "\n";
+  std::cout << "R: \n" << R_ << "\n";
+  std::cout << "y: \n" << y_ << "\n";
+}
+
+}  // namespace gaussian
+}  // namespace lds
+
+#endif
@@ -0,0 +1,79 @@
+//===-- ldsCtrlEst_h/lds_gaussian_lpv_ctrl.h - GLDS LPV Control -*- C++ -*-===//
+//
+// Copyright 2021 Michael Bolus
+// Copyright 2021 Georgia Institute of Technology
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file declares and partially defines the type for gain-scheduled
+/// control of a system approximated as Gaussian-output linear dynamical
+/// systems at points of a scheduling variable
+/// (lds::gaussian::ScheduledController).
+///
+/// \brief GLDS scheduled controller type
+//===----------------------------------------------------------------------===//
+
+#ifndef LDSCTRLEST_LDS_GAUSSIAN_LPV_CTRL_H
+#define LDSCTRLEST_LDS_GAUSSIAN_LPV_CTRL_H
+
+// controller type
+#include "lds_gaussian_ctrl.h"
+// scheduled controller
+#include "lds_lpv_ctrl.h"
+
+namespace lds {
+namespace gaussian {
+/// Gaussian-observation ScheduledController Type
+class ScheduledController : public lds::ScheduledController<System> {
+ public:
+  /// sets reference output
+  void set_y_ref(const Vector& y_ref) override {
+    Reassign(y_ref_, y_ref);
+    cx_ref_ = y_ref_ - sys_->d();
+  }
+
+  // make sure base class template methods available
+  using lds::ScheduledController<System>::ScheduledController;
+  using lds::ScheduledController<System>::Schedule;
+  using lds::ScheduledController<System>::Control;
+  using lds::ScheduledController<System>::ControlOutputReference;
+
+  using lds::ScheduledController<System>::sys;
+  using lds::ScheduledController<System>::Kc;
+  using lds::ScheduledController<System>::Kc_inty;
+  using lds::ScheduledController<System>::Kc_u;
+  using lds::ScheduledController<System>::g_design;
+  using lds::ScheduledController<System>::u_ref;
+  using lds::ScheduledController<System>::x_ref;
+  using lds::ScheduledController<System>::y_ref;
+  using lds::ScheduledController<System>::control_type;
+
+  using lds::ScheduledController<System>::set_g_design;
+  using lds::ScheduledController<System>::set_u_ref;
+  using lds::ScheduledController<System>::set_x_ref;
+  using lds::ScheduledController<System>::set_y_ref;
+  using lds::ScheduledController<System>::set_Kc;
+  using lds::ScheduledController<System>::set_Kc_inty;
+  using lds::ScheduledController<System>::set_Kc_u;
+  using lds::ScheduledController<System>::set_tau_awu;
+
+  using lds::ScheduledController<System>::Reset;
+  using lds::ScheduledController<System>::Print;
+};  // ScheduledController
+}  // namespace gaussian
+}  // namespace lds
+
+#endif
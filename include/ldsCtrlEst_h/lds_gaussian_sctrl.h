@@ -42,7 +42,7 @@ class SwitchedController : public lds::SwitchedController<System> {
   /// sets reference output
   void set_y_ref(const Vector& y_ref) override {
     Reassign(y_ref_, y_ref);
-    cx_ref_ = y_ref - sys_.d();
+    cx_ref_ = y_ref - sys_->d();
   }
 
   // make sure base class template methods available
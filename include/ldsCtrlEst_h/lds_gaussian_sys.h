@@ -75,6 +75,25 @@ class System : public lds::System {
    */
   const Vector& Simulate(const Vector& u_tm1) override;
 
+  /**
+   * Log-likelihood of measurement given prediction, i.e., under the Gaussian
+   * predictive distribution (see lds::System::PredictiveLogLik).
+   *
+   * n.b., the predictive covariance is propagated from the current state
+   * estimate covariance (P), which is only kept current while it is recursed,
+   * i.e., unless gains are set by set_Ke/set_Ke_m, and then only once per
+   * set_recurse_Ke_period steps. Otherwise, it is that last set or recursed
+   * (e.g., steady state, if set so).
+   *
+   * @brief      log-likelihood of measurement given prediction
+   *
+   * @param      u_tm1  input at t-minus-1
+   * @param      z      current measurement
+   *
+   * @return     log-likelihood
+   */
+  data_t PredictiveLogLik(const Vector& u_tm1, const Vector& z) override;
+
   // get methods
   /// Get output noise covariance
   const Matrix& R() const { return R_; };
@@ -103,6 +122,23 @@ class System : public lds::System {
     do_recurse_Ke_ = false;
   };
 
+  /**
+   * Besides the parameters of any system (see lds::System::set_params),
+   * copies R and, unless the other system recurses it, the estimator gain.
+   *
+   * @brief      sets parameters from another system
+   *
+   * @param      sys   system
+   */
+  void set_params(const System& sys);
+
+  /// Save system to snapshot (see lds::System::SaveSnapshot)
+  void SaveSnapshot(Snapshot& snap,
+                    const std::string& prefix = "") const override;
+  /// Restore system from snapshot (see lds::System::LoadSnapshot)
+  void LoadSnapshot(const Snapshot& snap,
+                    const std::string& prefix = "") override;
+
   /// Print system variables to stdout
   void Print();
 
@@ -116,9 +152,16 @@ class System : public lds::System {
   /// Recursively update estimator gain
   void RecurseKe() override;
 
+  /// Initialize adaptation of C, d
+  void InitAdaptOutput(data_t p0) override;
+  /// Adapt C, d by recursive least squares given current measurement
+  void AdaptOutput(const Vector& z) override;
+
   // Gaussian-output-specific
   Matrix R_;           ///< covariance of output noise
   bool do_recurse_Ke_{};  ///< whether to recursively calculate estimator gain
+  Matrix tmp_yy_inv_;     ///< scratch for innovation covariance inverse
+  Matrix P_theta_y_;      ///< covariance of [C, d] estimate (per row)
 };                      // System
 }  // namespace gaussian
 }  // namespace lds
@@ -0,0 +1,195 @@
+//===-- ldsCtrlEst_h/lds_latency.h - Latency Profiling ----------*- C++ -*-===//
+//
+// Copyright 2021 Michael Bolus
+// Copyright 2021 Georgia Institute of Technology
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file declares types for recording per-stage latency histograms of the
+/// estimation/control step (`lds::LatencyProfile`).
+///
+/// Recording is only active when the library (and any code including it) is
+/// compiled with `LDSCTRLEST_PROFILE` defined (cmake option of the same name).
+/// Otherwise, the timing scopes compile away and all statistics are zero. The
+/// layout of `lds::LatencyProfile` does not depend on this definition.
+///
+/// \brief latency profiling
+//===----------------------------------------------------------------------===//
+
+#ifndef LDSCTRLEST_LDS_LATENCY_H
+#define LDSCTRLEST_LDS_LATENCY_H
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "lds.h"
+
+namespace lds {
+
+/// Profiled stages of the estimation/control step
+enum LatencyStage : size_t {
+  kLatencyF,              ///< System::f (state prediction)
+  kLatencyH,              ///< System::h (output)
+  kLatencyRecurseKe,      ///< System::RecurseKe (covariance/gain recursion)
+  kLatencyFilterUpdate,   ///< innovation update in System::Filter
+  kLatencySetPoint,       ///< Controller::CalcSteadyStateSetPoint
+  kLatencyAntiWindup,     ///< Controller::AntiWindup
+  kLatencySwitch,         ///< SwitchedController::Switch
+  kNLatencyStages         ///< [number of stages]
+};
+
+/// Summary statistics of a stage's latency (ns)
+struct LatencyStats {
+  std::uint64_t n{};  ///< number of samples
+  data_t p50{};       ///< median latency (ns)
+  data_t p99{};       ///< 99th percentile latency (ns)
+  data_t max{};       ///< maximum latency (ns)
+};
+
+/**
+ * Log-linear histogram of latencies with 16 sub-buckets per power of two
+ * (i.e., quantiles are resolved to within ~6% of their value) and an exact
+ * maximum. Recording is O(1), does not allocate, and costs a few
+ * instructions besides reading the clock.
+ *
+ * @brief      latency histogram
+ */
+class LatencyHistogram {
+ public:
+  LatencyHistogram() : counts_(kNBuckets, 0) {}
+
+  /// Records a latency (ns)
+  void Record(std::uint64_t ns) {
+    counts_[Bucket(ns)]++;
+    n_++;
+    if (ns > max_) {
+      max_ = ns;
+    }
+  };
+
+  /**
+   * @brief      estimates quantile of recorded latencies
+   *
+   * @param      q     quantile in [0,1]
+   *
+   * @return     latency (ns; 0 if nothing has been recorded)
+   */
+  data_t Quantile(data_t q) const;
+
+  /// Get number of samples
+  std::uint64_t n() const { return n_; };
+  /// Get maximum latency (ns)
+  std::uint64_t max() const { return max_; };
+
+  /// Resets histogram
+  void Reset();
+
+ private:
+  static const size_t kNSubBits = 4;
+  static const size_t kNSub = 1 << kNSubBits;
+  static const size_t kNBuckets = kNSub * (64 - kNSubBits + 1);
+
+  /// bucket index of latency
+  static size_t Bucket(std::uint64_t ns);
+  /// lower bound of bucket
+  static std::uint64_t LowerBound(size_t bucket);
+
+  std::vector<std::uint64_t> counts_;  ///< counts per bucket
+  std::uint64_t n_{};                  ///< number of samples
+  std::uint64_t max_{};                ///< maximum latency (ns)
+};
+
+/**
+ * Latency histograms for each profiled stage. The histograms are held behind
+ * a pointer that is only allocated when the library is built with
+ * `LDSCTRLEST_PROFILE`, so an unprofiled build carries one null pointer. A
+ * copy starts out with empty histograms rather than copying those recorded.
+ *
+ * @brief      per-stage latency histograms
+ */
+class LatencyProfile {
+ public:
+  /// Constructs a new LatencyProfile (empty)
+  LatencyProfile();
+  /// Constructs a new LatencyProfile (empty; n.b., records are not copied)
+  LatencyProfile(const LatencyProfile&);
+  LatencyProfile(LatencyProfile&&) = default;
+  /// Keeps own records (n.b., records are not copied)
+  LatencyProfile& operator=(const LatencyProfile&) { return *this; };
+  LatencyProfile& operator=(LatencyProfile&&) = default;
+  ~LatencyProfile() = default;
+
+  /// Current time (ns on a monotonic clock)
+  static std::uint64_t Now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  };
+
+  /// Records a latency (ns) for stage (n.b., no-op unless profiling)
+  void Record(LatencyStage stage, std::uint64_t ns) {
+    if (hists_) {
+      (*hists_)[stage].Record(ns);
+    }
+  };
+
+  /// Get summary statistics of a stage's latency
+  LatencyStats stats(LatencyStage stage) const;
+
+  /// Resets all histograms
+  void Reset();
+
+  /// Prints summary statistics of all stages that have samples
+  void Print() const;
+
+ private:
+  using Histograms = std::array<LatencyHistogram, kNLatencyStages>;
+  std::unique_ptr<Histograms> hists_;  ///< per-stage hists (if profiling)
+};
+
+#ifdef LDSCTRLEST_PROFILE
+/// Records the lifetime of this object as the latency of a stage
+class LatencyTimer {
+ public:
+  LatencyTimer(LatencyProfile& profile, LatencyStage stage)
+      : profile_(profile), stage_(stage), t0_(LatencyProfile::Now()) {}
+  ~LatencyTimer() { profile_.Record(stage_, LatencyProfile::Now() - t0_); }
+
+  LatencyTimer(const LatencyTimer&) = delete;
+  LatencyTimer& operator=(const LatencyTimer&) = delete;
+
+ private:
+  LatencyProfile& profile_;  ///< profile to record into
+  LatencyStage stage_;       ///< stage being timed
+  std::uint64_t t0_;         ///< start time (ns)
+};
+
+#define LDSCTRLEST_LATENCY_CAT_(a, b) a##b
+#define LDSCTRLEST_LATENCY_CAT(a, b) LDSCTRLEST_LATENCY_CAT_(a, b)
+/// Times the rest of the enclosing scope as `stage` of `profile`
+#define LDSCTRLEST_LATENCY_SCOPE(profile, stage)                           \
+  ::lds::LatencyTimer LDSCTRLEST_LATENCY_CAT(lds_latency_timer_, __LINE__)( \
+      profile, stage)
+#else
+#define LDSCTRLEST_LATENCY_SCOPE(profile, stage)
+#endif
+
+}  // namespace lds
+
+#endif
@@ -0,0 +1,435 @@
+//===-- ldsCtrlEst_h/lds_lpv_ctrl.h - Gain-Scheduled Controller -*- C++ -*-===//
+//
+// Copyright 2021 Michael Bolus
+// Copyright 2021 Georgia Institute of Technology
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file declares the type for gain-scheduled control of a system
+/// approximated as a linear parameter-varying (LPV) system, i.e., by linear
+/// dynamical systems identified at points of a scheduling variable, in between
+/// which the model and controller are interpolated
+/// (lds::ScheduledController).
+///
+/// \brief ScheduledController type
+//===----------------------------------------------------------------------===//
+
+#ifndef LDSCTRLEST_LDS_LPV_CTRL_H
+#define LDSCTRLEST_LDS_LPV_CTRL_H
+
+#include "lds_ctrl.h"
+// lists of systems
+#include "lds_uniform_systems.h"
+// lists of gains
+#include "lds_uniform_mats.h"
+#include "lds_uniform_vecs.h"
+
+#include <algorithm>
+
+namespace lds {
+/// ScheduledController Type
+template <typename System>
+class ScheduledController : public Controller<System> {
+ public:
+  /**
+   * @brief      Constructs a new ScheduledController.
+   */
+  ScheduledController() = default;
+
+  /**
+   * Parameters of the system (A, B, g, C, d) and of the controller (gains and
+   * design-phase input gain) are interpolated linearly in the scheduling
+   * variable between those of the sub-systems at the neighbouring scheduling
+   * points. The parameters of each sub-system are packed once into a column
+   * of a table, so that scheduling is a weighted sum of two columns, copied
+   * into the system and gains in place. Other parameters (e.g., noise
+   * covariances) are those of the first sub-system.
+   *
+   * The steady-state set-point solution (see ControlOutputReference) is not
+   * linear in the parameters, so it is not interpolated: it is that solved
+   * for each sub-system up front at the scheduling points themselves, and
+   * between them it is solved again for the interpolated system on its next
+   * use (i.e., once per change of the scheduling variable).
+   *
+   * @brief      Constructs a new ScheduledController.
+   *
+   * @param      systems       sub-systems
+   * @param      schedule      scheduling point of each sub-system (strictly
+   *                           increasing)
+   * @param      u_lb          lower bound on control (u)
+   * @param      u_ub          upper bound on control (u)
+   * @param      control_type  [optional] control type bit mask
+   */
+  ScheduledController(const UniformSystemList<System>& systems,
+                      const Vector& schedule, data_t u_lb, data_t u_ub,
+                      size_t control_type = 0);
+
+  /**
+   * Outside the range of the scheduling points, the model and controller are
+   * held at those of the nearest end. The reference output is applied again
+   * (see set_y_ref), as the output function may have changed.
+   *
+   * n.b., does nothing if `rho` is already scheduled (unless forced), so that
+   * it can be called every step. Where the system's parameters affect
+   * cached quantities (e.g., input-delay prediction, or the cached estimator
+   * gains of lds::poisson::System), these are recalculated.
+   *
+   * @brief      schedules model and controller at a scheduling variable
+   *
+   * @param      rho       scheduling variable
+   * @param      do_force  [optional] whether to schedule even if `rho` is
+   *                       already scheduled
+   */
+  void Schedule(data_t rho, bool do_force = false);
+
+  /// Get scheduling variable
+  data_t rho() const { return rho_; };
+  /// Get scheduling points of sub-systems
+  const Vector& schedule() const { return schedule_; };
+  /// Get number of sub-systems
+  size_t n_sys() const { return n_sys_; };
+
+  /// sets state feedback gains (one per sub-system)
+  void set_Kc(const UniformMatrixList<>& Kc) { StoreList(kParamKc, Kc); };
+  /// sets integral feedback gains (one per sub-system)
+  void set_Kc_inty(const UniformMatrixList<>& Kc_inty) {
+    StoreList(kParamKcIntY, Kc_inty);
+  };
+  /// sets input feedback gains (one per sub-system)
+  void set_Kc_u(const UniformMatrixList<>& Kc_u) {
+    StoreList(kParamKcU, Kc_u);
+  };
+  /// sets input gain used during controller design (one per sub-system)
+  void set_g_design(const UniformVectorList& g) {
+    StoreList(kParamGDesign, g);
+  };
+
+  /**
+   * Besides the controller state (see Controller::SaveSnapshot), saves the
+   * scheduling points, the table of sub-system parameters, and the
+   * scheduling variable.
+   *
+   * @brief      saves scheduled controller to snapshot
+   *
+   * @param      snap    snapshot
+   * @param      prefix  [optional] prefix of record names
+   */
+  void SaveSnapshot(Snapshot& snap,
+                    const std::string& prefix = "") const override;
+
+  /**
+   * n.b., the scheduled controller must have the number of sub-systems and
+   * their dimensions of the scheduled controller that was saved.
+   *
+   * @brief      restores scheduled controller from snapshot
+   *
+   * @param      snap    snapshot
+   * @param      prefix  [optional] prefix of record names
+   */
+  void LoadSnapshot(const Snapshot& snap,
+                    const std::string& prefix = "") override;
+
+  // make sure base class template methods available
+  using lds::Controller<System>::Controller;
+  using lds::Controller<System>::Control;
+  using lds::Controller<System>::ControlOutputReference;
+
+  using lds::Controller<System>::sys;
+  using lds::Controller<System>::Kc;
+  using lds::Controller<System>::Kc_inty;
+  using lds::Controller<System>::Kc_u;
+  using lds::Controller<System>::g_design;
+  using lds::Controller<System>::u_ref;
+  using lds::Controller<System>::x_ref;
+  using lds::Controller<System>::y_ref;
+  using lds::Controller<System>::control_type;
+
+  using lds::Controller<System>::set_u_ref;
+  using lds::Controller<System>::set_x_ref;
+  using lds::Controller<System>::set_y_ref;
+  using lds::Controller<System>::set_tau_awu;
+
+  using lds::Controller<System>::Reset;
+  using lds::Controller<System>::Print;
+
+ protected:
+  /// Parameters interpolated (n.b., rows of the table by offsets_)
+  enum Param : size_t {
+    kParamA,          ///< state matrix
+    kParamB,          ///< input matrix
+    kParamG,          ///< input gain
+    kParamC,          ///< output matrix
+    kParamD,          ///< output bias
+    kParamKc,         ///< state feedback gain
+    kParamKcIntY,     ///< integral feedback gain
+    kParamKcU,        ///< input feedback gain
+    kParamGDesign,    ///< design-phase input gain
+    kParamSetPointB,  ///< set-point solution (cx_ref), at scheduling point
+    kParamSetPointM,  ///< set-point solution (m), at scheduling point
+    kNumParams,       ///< number of parameters
+  };
+
+  size_t n_sys_{};   ///< number of sub-systems
+  Vector schedule_;  ///< scheduling point of each sub-system
+  Vector inv_span_;  ///< 1/(distance between neighbouring scheduling points)
+
+  // n.b., column k of values_ holds the parameters of sub-system k, each
+  // (column-major) from row offsets_[param]
+  Matrix values_;                      ///< table of sub-system parameters
+  size_t offsets_[kNumParams + 1]{};   ///< first row of each parameter
+  Vector params_;                      ///< parameters interpolated at rho_
+  data_t rho_{};                       ///< scheduling variable
+  bool is_scheduled_ = false;          ///< whether params_ is of rho_
+
+  // TODO(mfbolus): not sure why I need to do this.
+  using Controller<System>::Kc_;
+  using Controller<System>::Kc_inty_;
+  using Controller<System>::Kc_u_;
+  using Controller<System>::g_design_;
+  using Controller<System>::sys_;
+  using Controller<System>::y_ref_;
+  using Controller<System>::setpoint_b_;
+  using Controller<System>::setpoint_m_;
+  using Controller<System>::setpoint_revision_;
+  using Controller<System>::is_setpoint_cached_;
+  using Controller<System>::CalcSetPointSolution;
+  using Controller<System>::InvalidateSetPoint;
+
+ private:
+  /// packs parameters of each sub-system into table
+  void InitParams(const std::vector<System>& systems);
+
+  /// stores parameter of sub-system `k` in table (checking its size)
+  void Store(size_t k, Param param, const Matrix& value);
+
+  /// stores parameter of every sub-system in table and schedules again
+  template <typename List>
+  void StoreList(Param param, const List& list);
+
+  /// copies interpolated parameters into system and controller (with the
+  /// stored set-point solution if `is_at_point`, i.e., at a scheduling point)
+  void Unpack(bool is_at_point);
+
+  using lds::Controller<System>::set_sys;
+  using lds::Controller<System>::set_control_type;
+};
+
+template <typename System>
+inline ScheduledController<System>::ScheduledController(
+    const UniformSystemList<System>& systems, const Vector& schedule,
+    data_t u_lb, data_t u_ub, size_t control_type)
+    : Controller<System>(
+          static_cast<const std::vector<System>&>(systems).at(0), u_lb, u_ub,
+          control_type),
+      n_sys_(static_cast<const std::vector<System>&>(systems).size()),
+      schedule_(schedule) {
+  if (n_sys_ < 2) {
+    throw std::runtime_error(
+        "ScheduledController requires at least two sub-systems");
+  }
+  if (schedule_.n_elem != n_sys_) {
+    throw std::runtime_error(
+        "ScheduledController requires a scheduling point per sub-system");
+  }
+  inv_span_ = Vector(n_sys_ - 1);
+  for (size_t k = 0; k < n_sys_ - 1; k++) {
+    data_t span = schedule_[k + 1] - schedule_[k];
+    if (!(span > 0)) {
+      throw std::runtime_error(
+          "scheduling points of ScheduledController must be strictly "
+          "increasing");
+    }
+    inv_span_[k] = 1 / span;
+  }
+  InitParams(systems);
+}
+
+template <typename System>
+inline void ScheduledController<System>::InitParams(
+    const std::vector<System>& systems) {
+  size_t n_u = sys_->n_u();
+  size_t n_x = sys_->n_x();
+  size_t n_y = sys_->n_y();
+  size_t n_xu = n_x + n_u;
+  const size_t sizes[kNumParams] = {
+      n_x * n_x,      n_x * n_u,     n_u,          n_y * n_x,
+      n_y,            Kc_.n_elem,    Kc_inty_.n_elem,
+      Kc_u_.n_elem,   n_u,           n_xu * n_y,   n_xu * n_x};
+  offsets_[0] = 0;
+  for (size_t p = 0; p < kNumParams; p++) {
+    offsets_[p + 1] = offsets_[p] + sizes[p];
+  }
+  values_.zeros(offsets_[kNumParams], n_sys_);
+  params_.zeros(offsets_[kNumParams]);
+
+  // n.b., set-point solution of each sub-system solved up front
+  for (size_t k = 0; k < n_sys_; k++) {
+    sys_ = systems[k];
+    CalcSetPointSolution();
+    Store(k, kParamA, sys_->A());
+    Store(k, kParamB, sys_->B());
+    Store(k, kParamG, sys_->g());
+    Store(k, kParamC, sys_->C());
+    Store(k, kParamD, sys_->d());
+    Store(k, kParamKc, Kc_);
+    Store(k, kParamKcIntY, Kc_inty_);
+    Store(k, kParamKcU, Kc_u_);
+    Store(k, kParamGDesign, g_design_);
+    Store(k, kParamSetPointB, setpoint_b_);
+    Store(k, kParamSetPointM, setpoint_m_);
+  }
+  sys_ = systems[0];
+  Schedule(schedule_[0], true);
+}
+
+template <typename System>
+inline void ScheduledController<System>::Store(size_t k, Param param,
+                                               const Matrix& value) {
+  size_t offset = offsets_[param];
+  if (value.n_elem != offsets_[param + 1] - offset) {
+    throw std::runtime_error(
+        "parameter of sub-system does not match dimensionality of "
+        "ScheduledController");
+  }
+  for (size_t j = 0; j < value.n_elem; j++) {
+    values_(offset + j, k) = value[j];
+  }
+}
+
+template <typename System>
+template <typename List>
+inline void ScheduledController<System>::StoreList(Param param,
+                                                   const List& list) {
+  const std::vector<typename List::value_type>& values = list;
+  if (values.size() != n_sys_) {
+    throw std::runtime_error(
+        "ScheduledController requires a parameter per sub-system");
+  }
+  // n.b., checked up front, so that the table is not partially stored
+  for (size_t k = 0; k < n_sys_; k++) {
+    if (values[k].n_elem != offsets_[param + 1] - offsets_[param]) {
+      throw std::runtime_error(
+          "parameter of sub-system does not match dimensionality of "
+          "ScheduledController");
+    }
+  }
+  for (size_t k = 0; k < n_sys_; k++) {
+    Store(k, param, values[k]);
+  }
+  Schedule(rho_, true);
+}
+
+template <typename System>
+inline void ScheduledController<System>::Schedule(data_t rho, bool do_force) {
+  rho = std::min(std::max(rho, schedule_[0]), schedule_[n_sys_ - 1]);
+  if (is_scheduled_ && (rho == rho_) && !do_force) {
+    return;
+  }
+
+  // segment [k, k+1] containing rho
+  size_t k = std::upper_bound(schedule_.begin(), schedule_.end(), rho) -
+             schedule_.begin();
+  k = std::min(std::max<size_t>(k, 1), n_sys_ - 1) - 1;
+  data_t s = (rho - schedule_[k]) * inv_span_[k];
+
+  // n.b., evaluated into existing memory
+  params_ = values_.col(k) * (1 - s) + values_.col(k + 1) * s;
+  Unpack((s == 0) || (s == 1));
+
+  rho_ = rho;
+  is_scheduled_ = true;
+}
+
+template <typename System>
+inline void ScheduledController<System>::Unpack(bool is_at_point) {
+  size_t n_u = sys_->n_u();
+  size_t n_x = sys_->n_x();
+  size_t n_y = sys_->n_y();
+  size_t n_xu = n_x + n_u;
+  data_t* p = params_.memptr();
+
+  // n.b., views of params_ (no copy until assigned)
+  sys_->set_A(Matrix(p + offsets_[kParamA], n_x, n_x, false, true));
+  sys_->set_B(Matrix(p + offsets_[kParamB], n_x, n_u, false, true));
+  sys_->set_g(Vector(p + offsets_[kParamG], n_u, false, true));
+  sys_->set_C(Matrix(p + offsets_[kParamC], n_y, n_x, false, true));
+  sys_->set_d(Vector(p + offsets_[kParamD], n_y, false, true));
+
+  Kc_ = Matrix(p + offsets_[kParamKc], Kc_.n_rows, Kc_.n_cols, false, true);
+  if (Kc_inty_.n_elem > 0) {
+    Kc_inty_ = Matrix(p + offsets_[kParamKcIntY], Kc_inty_.n_rows,
+                      Kc_inty_.n_cols, false, true);
+  }
+  if (Kc_u_.n_elem > 0) {
+    Kc_u_ = Matrix(p + offsets_[kParamKcU], Kc_u_.n_rows, Kc_u_.n_cols,
+                   false, true);
+  }
+  g_design_ = Vector(p + offsets_[kParamGDesign], n_u, false, true);
+
+  // n.b., the set-point solution is not linear in the parameters, so the
+  // stored solution is only used at a scheduling point; between points it is
+  // solved for the interpolated system on its next use
+  if (is_at_point) {
+    setpoint_b_ =
+        Matrix(p + offsets_[kParamSetPointB], n_xu, n_y, false, true);
+    setpoint_m_ =
+        Matrix(p + offsets_[kParamSetPointM], n_xu, n_x, false, true);
+    setpoint_revision_ = sys_->revision();
+    is_setpoint_cached_ = true;
+  } else {
+    InvalidateSetPoint();
+  }
+
+  // output function may have changed
+  set_y_ref(y_ref_);
+}
+
+template <typename System>
+inline void ScheduledController<System>::SaveSnapshot(
+    Snapshot& snap, const std::string& prefix) const {
+  Controller<System>::SaveSnapshot(snap, prefix);
+  snap.Set(prefix + "n_sys", n_sys_);
+  snap.Set(prefix + "schedule", schedule_);
+  snap.Set(prefix + "schedule_values", values_);
+  snap.Set(prefix + "rho", rho_);
+}
+
+template <typename System>
+inline void ScheduledController<System>::LoadSnapshot(
+    const Snapshot& snap, const std::string& prefix) {
+  if (snap.GetScalar(prefix + "n_sys") != n_sys_) {
+    throw std::runtime_error(
+        "number of sub-systems of snapshot does not match that of "
+        "ScheduledController");
+  }
+  Matrix values = snap.Get(prefix + "schedule_values");
+  if ((values.n_rows != values_.n_rows) || (values.n_cols != values_.n_cols)) {
+    throw std::runtime_error(
+        "parameters of snapshot do not match dimensionality of "
+        "ScheduledController");
+  }
+  Controller<System>::LoadSnapshot(snap, prefix);
+  schedule_ = snap.Get(prefix + "schedule");
+  for (size_t k = 0; k < n_sys_ - 1; k++) {
+    inv_span_[k] = 1 / (schedule_[k + 1] - schedule_[k]);
+  }
+  values_ = values;
+  Schedule(snap.GetScalar(prefix + "rho"), true);
+}
+
+}  // namespace lds
+
+#endif
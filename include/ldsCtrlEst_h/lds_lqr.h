@@ -0,0 +1,113 @@
+//===-- ldsCtrlEst_h/lds_lqr.h - LQR Controller Design ----------*- C++ -*-===//
+//
+// Copyright 2021 Michael Bolus
+// Copyright 2021 Georgia Institute of Technology
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file declares functions for designing the feedback gains of
+/// `lds::Controller` by linear-quadratic regulation (LQR), by way of a solver
+/// for the discrete algebraic Riccati equation (DARE).
+///
+/// References:
+/// [1] Chu EKW, Fan HY, Lin WW, Wang CS. (2004) Structure-Preserving
+/// Algorithms for Periodic Discrete-Time Algebraic Riccati Equations.
+/// International Journal of Control 77(8).
+///
+/// \brief LQR controller design
+//===----------------------------------------------------------------------===//
+
+#ifndef LDSCTRLEST_LDS_LQR_H
+#define LDSCTRLEST_LDS_LQR_H
+
+#include "lds.h"
+
+namespace lds {
+
+/// Feedback gains of lds::Controller
+struct LQRGains {
+  Matrix Kc;       ///< state feedback gain
+  Matrix Kc_inty;  ///< integral feedback gain (empty unless kControlTypeIntY)
+  Matrix Kc_u;     ///< input feedback gain (empty unless kControlTypeDeltaU)
+};
+
+/**
+ * Solves P = A'PA - A'PB(R+B'PB)^-1 B'PA + Q by the structure-preserving
+ * doubling algorithm [1], which converges quadratically and only needs
+ * linear solves (i.e., no eigen/Schur decomposition).
+ *
+ * @brief      solves discrete algebraic Riccati equation
+ *
+ * @param      A     state matrix
+ * @param      B     input matrix
+ * @param      Q     state cost (symmetric positive semi-definite)
+ * @param      R     input cost (symmetric positive definite)
+ *
+ * @return     stabilizing solution P
+ */
+Matrix SolveDARE(const Matrix& A, const Matrix& B, const Matrix& Q,
+                 const Matrix& R);
+
+/**
+ * @brief      calculates infinite-horizon LQR gain (u = -K*x)
+ *
+ * @param      A     state matrix
+ * @param      B     input matrix
+ * @param      Q     state cost
+ * @param      R     input cost
+ *
+ * @return     feedback gain K
+ */
+Matrix CalcLQRGain(const Matrix& A, const Matrix& B, const Matrix& Q,
+                   const Matrix& R);
+
+/**
+ * Designs the gains of the control law of lds::Controller, which operates on
+ * the (design-phase) input v = g_design % u, to minimize
+ *
+ *     J = sum((y-y*)'*Q_y*(y-y*) + int_e'*Q_inty*int_e + (v-v*)'*R*(v-v*))
+ *
+ * where y = C*x (n.b., i.e., log-linear output of Poisson-output systems).
+ * If kControlTypeIntY, the state is augmented with the integrated output
+ * error (int_e). If kControlTypeDeltaU, the state is augmented with the
+ * input, such that the control is its change (dv), which is penalized by R
+ * instead.
+ *
+ * n.b., does not depend on any controller state, so that gains may be
+ * redesigned (e.g., after model updates) in another thread and set with
+ * Controller::set_gains.
+ *
+ * @brief      designs controller gains by LQR
+ *
+ * @param      A             state matrix
+ * @param      B             input matrix
+ * @param      C             output matrix
+ * @param      dt            sample period
+ * @param      control_type  control type bit mask
+ * @param      q_y           output cost (n_y x n_y)
+ * @param      q_inty        integrated output error cost (n_y x n_y; unused
+ *                           unless kControlTypeIntY)
+ * @param      r             input cost (n_u x n_u)
+ *
+ * @return     controller gains
+ */
+LQRGains DesignLQR(const Matrix& A, const Matrix& B, const Matrix& C,
+                   data_t dt, size_t control_type, const Matrix& q_y,
+                   const Matrix& q_inty, const Matrix& r);
+
+}  // namespace lds
+
+#endif
@@ -0,0 +1,161 @@
+//===-- ldsCtrlEst_h/lds_model_swap.h - Model Hot-Swap ----------*- C++ -*-===//
+//
+// Copyright 2021 Michael Bolus
+// Copyright 2021 Georgia Institute of Technology
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file declares and defines a lock-free slot through which a model
+/// (system parameters and controller gains) refit on one thread (e.g., by
+/// EM or SSID on the latest data) is handed to a controller stepping on
+/// another (`lds::ModelSwap`), e.g.,
+///
+///     auto swap = std::make_shared<ModelSwap<gaussian::System>>(sys);
+///     controller.set_model_swap(swap);
+///     // background thread:
+///     //   fit sys_fit, design gains_fit (lds::DesignLQR)
+///     swap->Publish(sys_fit, gains_fit);
+///
+/// The controller picks up the latest model published at its next step
+/// boundary, keeping its state estimate (see Controller::set_model_swap).
+///
+/// \brief model hot-swap (triple buffer)
+//===----------------------------------------------------------------------===//
+
+#ifndef LDSCTRLEST_LDS_MODEL_SWAP_H
+#define LDSCTRLEST_LDS_MODEL_SWAP_H
+
+// namespace
+#include "lds.h"
+// system type
+#include "lds_sys.h"
+// gains type
+#include "lds_lqr.h"
+
+#include <atomic>
+#include <stdexcept>
+
+namespace lds {
+
+/// Single-Publisher, Single-Taker Model Hot-Swap Type
+template <typename System>
+class ModelSwap {
+  static_assert(std::is_base_of<lds::System, System>::value,
+                "System must be derived from lds::System type.");
+
+ public:
+  /// Model handed from publisher to taker
+  struct Model {
+    System sys;      ///< system (parameters taken, not state)
+    LQRGains gains;  ///< controller gains (empty Kc = keep current gains)
+  };
+
+  /**
+   * Models are held in three buffers, one each owned by the publisher and
+   * taker and one in between them, which are exchanged by a single atomic
+   * index. Neither side ever waits on the other, and a model published
+   * before the previous one was taken simply replaces it.
+   *
+   * n.b., buffers are allocated here from `prototype`, so that publishing
+   * models of the same dimensions copies into existing memory.
+   *
+   * @brief      Constructs a new ModelSwap.
+   *
+   * @param      prototype  system of dimensions of models published
+   */
+  explicit ModelSwap(const System& prototype)
+      : n_u_(prototype.n_u()), n_x_(prototype.n_x()), n_y_(prototype.n_y()) {
+    for (Model& model : buffers_) {
+      model.sys = prototype;
+    }
+  }
+
+  ModelSwap(const ModelSwap&) = delete;
+  ModelSwap& operator=(const ModelSwap&) = delete;
+
+  /**
+   * @brief      publishes model (publishing thread only)
+   *
+   * @param      sys    system (of the dimensions of the prototype)
+   * @param      gains  [optional] controller gains (empty Kc = keep current)
+   */
+  void Publish(const System& sys, const LQRGains& gains = LQRGains()) {
+    if ((sys.n_u() != n_u()) || (sys.n_x() != n_x()) ||
+        (sys.n_y() != n_y())) {
+      throw std::runtime_error(
+          "dimensionality of published system does not match that of "
+          "ModelSwap");
+    }
+    Model& model = buffers_[back_];
+    model.sys = sys;
+    model.gains = gains;
+    back_ = middle_.exchange(back_ | kFresh, std::memory_order_acq_rel) &
+            kIndexMask;
+    n_published_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  /**
+   * Returns the latest model published since the last take (if any), which
+   * remains valid until the next call.
+   *
+   * @brief      takes latest model (taking thread only)
+   *
+   * @return     model (null = none published since last take)
+   */
+  const Model* TryTake() {
+    if (!(middle_.load(std::memory_order_acquire) & kFresh)) {
+      return nullptr;
+    }
+    front_ = middle_.exchange(front_, std::memory_order_acq_rel) & kIndexMask;
+    n_taken_.fetch_add(1, std::memory_order_relaxed);
+    return &buffers_[front_];
+  }
+
+  /// gets number of models published
+  size_t n_published() const {
+    return n_published_.load(std::memory_order_relaxed);
+  };
+  /// gets number of models taken (n.b., models replaced before being taken
+  /// are not counted)
+  size_t n_taken() const { return n_taken_.load(std::memory_order_relaxed); };
+  /// gets number of inputs
+  size_t n_u() const { return n_u_; };
+  /// gets number of states
+  size_t n_x() const { return n_x_; };
+  /// gets number of outputs
+  size_t n_y() const { return n_y_; };
+
+ private:
+  static const size_t kIndexMask = 0x3;  ///< buffer index bits of middle_
+  static const size_t kFresh = 0x4;      ///< whether middle_ is untaken
+
+  const size_t n_u_;  ///< number of inputs
+  const size_t n_x_;  ///< number of states
+  const size_t n_y_;  ///< number of outputs
+
+  Model buffers_[3];  ///< model buffers
+  size_t back_ = 0;   ///< buffer owned by publisher
+  size_t front_ = 2;  ///< buffer owned by taker
+
+  // n.b., on their own cache lines, as they are touched by both threads
+  alignas(64) std::atomic<size_t> middle_{1};  ///< buffer between threads
+  alignas(64) std::atomic<size_t> n_published_{0};  ///< models published
+  std::atomic<size_t> n_taken_{0};                  ///< models taken
+};
+
+}  // namespace lds
+
+#endif
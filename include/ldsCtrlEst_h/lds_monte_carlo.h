@@ -0,0 +1,254 @@
+//===-- ldsCtrlEst_h/lds_monte_carlo.h - Monte-Carlo Simulation -*- C++ -*-===//
+//
+// Copyright 2021 Michael Bolus
+// Copyright 2021 Georgia Institute of Technology
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file declares the type for simulating many closed-loop trajectories of
+/// a system under control in parallel (`lds::MonteCarlo`).
+///
+/// \brief Monte-Carlo simulation
+//===----------------------------------------------------------------------===//
+
+#ifndef LDSCTRLEST_LDS_MONTE_CARLO_H
+#define LDSCTRLEST_LDS_MONTE_CARLO_H
+
+#include "lds_gaussian_sys.h"
+#include "lds_poisson_sys.h"
+#include "lds_rng.h"
+#include "lds_thread_pool.h"
+#include "lds_uniform_mats.h"
+
+#include <memory>
+#include <tuple>
+
+namespace lds {
+
+/**
+ * @brief      factor L of covariance, such that L*w ~ N(0, cov) if w ~ N(0, I)
+ *
+ * @param      cov   covariance
+ *
+ * @return     lower Cholesky factor (zero if covariance is zero)
+ */
+Matrix NoiseFactor(const Matrix& cov);
+
+namespace gaussian {
+/**
+ * @brief      factor of measurement noise covariance (see NoiseFactor)
+ *
+ * @param      sys   system
+ *
+ * @return     noise factor
+ */
+Matrix MeasurementNoiseFactor(const System& sys);
+
+/**
+ * @brief      samples measurement of system, given its current output
+ *
+ * @param      sys           system
+ * @param      noise_factor  factor of measurement noise covariance
+ * @param      rng           random number generator
+ * @param      z             [out] measurement
+ */
+void SampleMeasurement(const System& sys, const Matrix& noise_factor,
+                       CounterRng& rng, Vector& z);
+}  // namespace gaussian
+
+namespace poisson {
+/**
+ * @brief      factor of measurement noise covariance (none for Poisson)
+ *
+ * @param      sys   system
+ *
+ * @return     empty matrix
+ */
+Matrix MeasurementNoiseFactor(const System& sys);
+
+/**
+ * @brief      samples measurement of system, given its current output
+ *
+ * @param      sys           system
+ * @param      noise_factor  (unused)
+ * @param      rng           random number generator
+ * @param      z             [out] measurement
+ */
+void SampleMeasurement(const System& sys, const Matrix& noise_factor,
+                       CounterRng& rng, Vector& z);
+}  // namespace poisson
+
+///
+/// @brief      Monte-Carlo Simulation Type
+///
+///             Simulates trajectories of a system (`Plant`, e.g.,
+///             lds::gaussian::System) under closed-loop control (`Controller`,
+///             e.g., lds::gaussian::Controller) in parallel. Each trajectory
+///             starts from copies of the given plant and controller and draws
+///             its noise from its own stream of a counter-based random number
+///             generator, such that the trajectories are reproducible
+///             regardless of the number of threads.
+///
+///             n.b., the controller should not add its own noise to the
+///             control signal (e.g., sigma_u_noise), as that would be drawn
+///             from the shared global random number generator.
+///
+template <typename Plant, typename Controller>
+class MonteCarlo {
+ public:
+  /**
+   * @brief      Constructs a new MonteCarlo.
+   */
+  MonteCarlo() = default;
+
+  /**
+   * @brief      Constructs a new MonteCarlo.
+   *
+   * @param      plant       system to be controlled (i.e., ground truth)
+   * @param      controller  controller (incl. its model of the system)
+   */
+  MonteCarlo(const Plant& plant, const Controller& controller);
+
+  /**
+   * At every time step t, the plant is simulated given the control signal of
+   * the previous step and the controller is updated with the resulting
+   * measurement (see Controller::ControlOutputReference), after which
+   * `observe(trajectory, t, u, z, plant, controller)` is called with the
+   * updated control signal (u) and measurement (z).
+   *
+   * n.b., trajectories are simulated concurrently (see set_n_threads), so
+   * `observe` must be safe to call concurrently for different trajectories.
+   *
+   * @brief      simulates trajectories
+   *
+   * @param      n_trajectories  number of trajectories
+   * @param      n_t             number of time steps
+   * @param      observe         function called at every time step
+   */
+  template <typename F>
+  void Run(size_t n_trajectories, size_t n_t, const F& observe);
+
+  /**
+   * @brief      simulates trajectories and records input/output
+   *
+   * @param      n_trajectories  number of trajectories
+   * @param      n_t             number of time steps
+   *
+   * @return     tuple(control signals, measurements)
+   */
+  std::tuple<UniformMatrixList<kMatFreeDim2>, UniformMatrixList<kMatFreeDim2>>
+  Run(size_t n_trajectories, size_t n_t);
+
+  /// gets system to be controlled
+  const Plant& plant() const { return plant_; };
+  /// gets controller
+  const Controller& controller() const { return controller_; };
+
+  /// gets seed of random number generator
+  std::uint64_t seed() const { return seed_; };
+  /// sets seed of random number generator
+  void set_seed(std::uint64_t seed) { seed_ = seed; };
+
+  /// gets number of threads trajectories are distributed across
+  size_t n_threads() const { return pool_ ? pool_->n_threads() : 1; };
+
+  /**
+   * @brief      sets number of threads trajectories are distributed across
+   *
+   * @param      n_threads  number of threads (1 = calling thread only, 0 =
+   *                        hardware concurrency)
+   */
+  void set_n_threads(size_t n_threads) {
+    if (n_threads == 1) {
+      pool_.reset();
+    } else {
+      pool_.reset(new ThreadPool(n_threads));
+    }
+  };
+
+ private:
+  Plant plant_;            ///< system to be controlled
+  Controller controller_;  ///< controller
+  Matrix q_factor_;        ///< factor of process noise cov (see NoiseFactor)
+  Matrix r_factor_;        ///< factor of measurement noise cov
+  std::uint64_t seed_{};   ///< seed of random number generator
+
+  std::unique_ptr<ThreadPool> pool_;  ///< threads (null if serial)
+};
+
+template <typename Plant, typename Controller>
+MonteCarlo<Plant, Controller>::MonteCarlo(const Plant& plant,
+                                          const Controller& controller)
+    : plant_(plant), controller_(controller) {
+  // n.b., factored once rather than at every step
+  q_factor_ = NoiseFactor(plant_.Q());
+  r_factor_ = MeasurementNoiseFactor(plant_);
+}
+
+template <typename Plant, typename Controller>
+template <typename F>
+void MonteCarlo<Plant, Controller>::Run(size_t n_trajectories, size_t n_t,
+                                        const F& observe) {
+  auto run_chunk = [&](size_t k_begin, size_t k_end) {
+    Vector u(plant_.n_u());
+    Vector z(plant_.n_y());
+    Vector w(plant_.n_x());  // standard normal process noise
+    for (size_t k = k_begin; k < k_end; k++) {
+      Plant plant = plant_;
+      Controller controller = controller_;
+      CounterRng rng(seed_, k);
+
+      u.zeros();
+      for (size_t t = 0; t < n_t; t++) {
+        // simulate plant
+        plant.f(u);
+        rng.Randn(w);
+        plant.set_x(plant.x() + q_factor_ * w);  // n.b., also updates output
+        SampleMeasurement(plant, r_factor_, rng, z);
+
+        // control
+        u = controller.ControlOutputReference(z);
+        observe(k, t, u, z, plant, controller);
+      }
+    }
+  };
+
+  if (pool_) {
+    pool_->ParallelFor(n_trajectories, run_chunk);
+  } else {
+    run_chunk(0, n_trajectories);
+  }
+}
+
+template <typename Plant, typename Controller>
+std::tuple<UniformMatrixList<kMatFreeDim2>, UniformMatrixList<kMatFreeDim2>>
+MonteCarlo<Plant, Controller>::Run(size_t n_trajectories, size_t n_t) {
+  std::vector<Matrix> u(n_trajectories, Matrix(plant_.n_u(), n_t));
+  std::vector<Matrix> z(n_trajectories, Matrix(plant_.n_y(), n_t));
+  Run(n_trajectories, n_t,
+      [&](size_t k, size_t t, const Vector& u_t, const Vector& z_t,
+          const Plant&, const Controller&) {
+        u[k].col(t) = u_t;
+        z[k].col(t) = z_t;
+      });
+
+  return std::make_tuple(UniformMatrixList<kMatFreeDim2>(std::move(u)),
+                         UniformMatrixList<kMatFreeDim2>(std::move(z)));
+}
+
+}  // namespace lds
+
+#endif
@@ -0,0 +1,431 @@
+//===-- ldsCtrlEst_h/lds_mpc_ctrl.h - MPC Controller ------------*- C++ -*-===//
+//
+// Copyright 2021 Michael Bolus
+// Copyright 2021 Georgia Institute of Technology
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file declares and defines the base type for receding-horizon (model
+/// predictive) control of a linear dynamical system (`lds::MPCController`).
+/// The input sequence over the horizon is chosen each step by solving a
+/// box-constrained quadratic program whose condensed prediction matrices are
+/// prebuilt from the system parameters.
+///
+/// \brief MPC Controller base type
+//===----------------------------------------------------------------------===//
+
+#ifndef LDSCTRLEST_LDS_MPC_CTRL_H
+#define LDSCTRLEST_LDS_MPC_CTRL_H
+
+// namespace
+#include "lds.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace lds {
+
+/**
+ * Receding-horizon controller that, every step, minimizes
+ *
+ *   sum_{k=1}^{N} (cx_k - cx_ref)' Q (cx_k - cx_ref) + u_{k-1}' R u_{k-1}
+ *     + (u_{k-1} - u_{k-2})' S (u_{k-1} - u_{k-2})
+ *
+ * subject to u_lb <= u <= u_ub, with the state predicted from the current
+ * estimate as x_{k+1} = A x_k + B (g % u_k) + m. The first input of the
+ * optimal sequence is applied.
+ *
+ * The QP is solved by accelerated projected gradient (FISTA), warm-started
+ * from the previous step's solution shifted by one sample. All matrices it
+ * needs are rebuilt only when the system parameters or weights change, and
+ * the per-step solve does not allocate.
+ *
+ * @brief      MPC controller base type
+ */
+template <typename System>
+class MPCController {
+ public:
+  /**
+   * @brief      Constructs a new MPCController.
+   */
+  MPCController() = default;
+
+  /**
+   * @brief      Constructs a new MPCController.
+   *
+   * @param      sys        system being controlled
+   * @param      u_lb       lower bound on control (u)
+   * @param      u_ub       upper bound on control (u)
+   * @param      n_horizon  [optional] number of steps in prediction horizon
+   */
+  MPCController(const System& sys, data_t u_lb, data_t u_ub,
+                size_t n_horizon = kDefaultNHorizon);
+
+  /**
+   * @brief      Constructs a new MPCController (moves system).
+   *
+   * @param      sys        system being controlled
+   * @param      u_lb       lower bound on control (u)
+   * @param      u_ub       upper bound on control (u)
+   * @param      n_horizon  [optional] number of steps in prediction horizon
+   */
+  MPCController(System&& sys, data_t u_lb, data_t u_ub,
+                size_t n_horizon = kDefaultNHorizon);
+
+  virtual ~MPCController() = default;
+
+  /**
+   * Given a new measurement (z), update the state estimate and solve for the
+   * control signal that tracks the previously-set output reference (y_ref)
+   * over the horizon.
+   *
+   * @brief      updates control signal (single-step)
+   *
+   * @param      z              measurement
+   * @param      do_control     [optional] whether to update control (true) or
+   *                            simply feed through u_ref (false)
+   * @param      do_estimation  [optional] whether to update state estimate
+   *                            (if false, effectively open-loop control)
+   *
+   * @return     control signal
+   */
+  const Vector& ControlOutputReference(const Vector& z, bool do_control = true,
+                                       bool do_estimation = true);
+
+  /// Get system
+  const System& sys() const { return sys_; };
+  /// Get control signal
+  const Vector& u() const { return u_; };
+  /// Get reference input (fed through while not controlling)
+  const Vector& u_ref() const { return u_ref_; };
+  /// Get reference output
+  const Vector& y_ref() const { return y_ref_; };
+  /// Get number of steps in prediction horizon
+  size_t n_horizon() const { return n_horizon_; };
+  /// Get weight on output tracking error (n_y x n_y)
+  const Matrix& Q_y() const { return Q_y_; };
+  /// Get weight on input (n_u x n_u)
+  const Matrix& R_u() const { return R_u_; };
+  /// Get weight on change in input (n_u x n_u)
+  const Matrix& S_du() const { return S_du_; };
+  /// Get optimal input sequence over horizon from last solve (n_u*n_horizon)
+  const Vector& u_horizon() const { return u_horizon_; };
+  /// Get number of solver iterations of last solve
+  size_t n_iter() const { return n_iter_; };
+  /// Get whether last solve converged within max_iter
+  bool is_converged() const { return is_converged_; };
+
+  /// Set system
+  void set_sys(const System& sys) {
+    bool does_match = sys_.n_u() == sys.n_u();
+    does_match = does_match && (sys_.n_x() == sys.n_x());
+    does_match = does_match && (sys_.n_y() == sys.n_y());
+    if (does_match) {
+      sys_ = sys;
+      is_prediction_built_ = false;
+    } else {
+      throw std::runtime_error(
+          "new system argument to `set_sys` does not match dimensionality of "
+          "existing system");
+    }
+  };
+  /// Set reference input (fed through while not controlling)
+  void set_u_ref(const Vector& u_ref) { Reassign(u_ref_, u_ref); };
+  /// Set reference output
+  virtual void set_y_ref(const Vector& y_ref) = 0;
+  /// Set weight on output tracking error (n_y x n_y)
+  void set_Q_y(const Matrix& Q_y) {
+    Reassign(Q_y_, Q_y);
+    is_prediction_built_ = false;
+  };
+  /// Set weight on input (n_u x n_u)
+  void set_R_u(const Matrix& R_u) {
+    Reassign(R_u_, R_u);
+    is_prediction_built_ = false;
+  };
+  /// Set weight on change in input (n_u x n_u)
+  void set_S_du(const Matrix& S_du) {
+    Reassign(S_du_, S_du);
+    is_prediction_built_ = false;
+  };
+  /// Set lower bound on control
+  void set_u_lb(data_t u_lb) { u_lb_ = u_lb; };
+  /// Set upper bound on control
+  void set_u_ub(data_t u_ub) { u_ub_ = u_ub; };
+  /// Set maximum number of solver iterations per step
+  void set_max_iter(size_t max_iter) { max_iter_ = max_iter; };
+  /// Set solver tolerance (max change in any input between iterations)
+  void set_tol(data_t tol) { tol_ = tol; };
+
+  /// reset system and control variables
+  void Reset() {
+    sys_.Reset();
+    u_.zeros();
+    u_horizon_.zeros();
+    n_iter_ = 0;
+    is_converged_ = false;
+  };
+
+  /// prints variables to stdout
+  void Print() {
+    sys_.Print();
+    std::cout << "n_horizon : " << n_horizon_ << "\n";
+    std::cout << "Q_y : \n" << Q_y_ << "\n";
+    std::cout << "R_u : \n" << R_u_ << "\n";
+    std::cout << "S_du : \n" << S_du_ << "\n";
+    std::cout << "u_lb : " << u_lb_ << "\n";
+    std::cout << "u_ub : " << u_ub_ << "\n";
+  };
+
+ protected:
+  static const size_t kDefaultNHorizon = 20;
+  constexpr static const data_t kDefaultRu = 1e-6;  ///< default input weight
+
+  System sys_;  ///< underlying LDS
+
+  Vector u_;       ///< control signal
+  Vector u_ref_;   ///< reference input (fed through while not controlling)
+  Vector y_ref_;   ///< reference output
+  Vector cx_ref_;  ///< reference output in terms of C*x
+
+  size_t n_horizon_{};  ///< number of steps in prediction horizon
+  Matrix Q_y_;          ///< weight on output tracking error
+  Matrix R_u_;          ///< weight on input
+  Matrix S_du_;         ///< weight on change in input
+  data_t u_lb_{};       ///< lower bound on control
+  data_t u_ub_{};       ///< upper bound on control
+
+  size_t max_iter_ = 200;  ///< maximum number of solver iterations
+  data_t tol_ = 1e-6;      ///< solver tolerance
+  size_t n_iter_{};        ///< solver iterations of last solve
+  bool is_converged_{};    ///< whether last solve converged
+
+ private:
+  /// initializes variables
+  void InitVars();
+
+  /// builds condensed prediction matrices and QP Hessian
+  void BuildPrediction();
+
+  /// solves box-constrained QP (warm-started from u_horizon_)
+  void Solve();
+
+  // Condensed QP: minimize U' H U + 2 f' U, s.t. u_lb <= U <= u_ub, where
+  // f = F_x x + F_m m - F_r cx_ref - F_u u_prev.
+  Matrix H_;    ///< QP Hessian
+  Matrix F_x_;  ///< linear term due to current state
+  Matrix F_m_;  ///< linear term due to process disturbance
+  Matrix F_r_;  ///< linear term due to output reference
+  Matrix F_u_;  ///< linear term due to previous input
+  data_t lipschitz_{};  ///< largest eigenvalue of H (step size = 1/lipschitz)
+  size_t revision_{};   ///< system revision prediction was built for
+  bool is_prediction_built_ = false;  ///< whether prediction is valid
+
+  // Solver state (preallocated so the per-step path does not allocate):
+  Vector u_horizon_;  ///< optimal input sequence over horizon
+  Vector f_;          ///< linear term of QP
+  Vector v_;          ///< extrapolated point (FISTA)
+  Vector grad_;       ///< gradient
+  Vector u_next_;     ///< next iterate
+};
+
+// Implement the above:
+
+template <typename System>
+inline MPCController<System>::MPCController(const System& sys, data_t u_lb,
+                                            data_t u_ub, size_t n_horizon)
+    : sys_(sys), n_horizon_(n_horizon), u_lb_(u_lb), u_ub_(u_ub) {
+  InitVars();
+}
+
+template <typename System>
+inline MPCController<System>::MPCController(System&& sys, data_t u_lb,
+                                            data_t u_ub, size_t n_horizon)
+    : sys_(std::move(sys)), n_horizon_(n_horizon), u_lb_(u_lb), u_ub_(u_ub) {
+  InitVars();
+}
+
+template <typename System>
+inline void MPCController<System>::InitVars() {
+  if (n_horizon_ == 0) {
+    throw std::runtime_error("MPCController horizon must be positive");
+  }
+
+  u_ = Vector(sys_.n_u(), fill::zeros);
+  u_ref_ = Vector(sys_.n_u(), fill::zeros);
+  y_ref_ = Vector(sys_.n_y(), fill::zeros);
+  cx_ref_ = Vector(sys_.n_y(), fill::zeros);
+
+  Q_y_ = Matrix(sys_.n_y(), sys_.n_y(), fill::eye);
+  R_u_ = Matrix(sys_.n_u(), sys_.n_u(), fill::eye) * data_t(kDefaultRu);
+  S_du_ = Matrix(sys_.n_u(), sys_.n_u(), fill::zeros);
+
+  size_t n_u_horizon = sys_.n_u() * n_horizon_;
+  u_horizon_ = Vector(n_u_horizon, fill::zeros);
+  f_ = Vector(n_u_horizon, fill::zeros);
+  v_ = Vector(n_u_horizon, fill::zeros);
+  grad_ = Vector(n_u_horizon, fill::zeros);
+  u_next_ = Vector(n_u_horizon, fill::zeros);
+  is_prediction_built_ = false;
+}
+
+template <typename System>
+inline const Vector& MPCController<System>::ControlOutputReference(
+    const Vector& z, bool do_control, bool do_estimation) {
+  // update state estimates, given latest measurement
+  if (do_estimation) {
+    sys_.Filter(u_, z);
+  } else {
+    sys_.f(u_);
+  }
+
+  if (!do_control) {
+    u_ = u_ref_;
+    u_horizon_.zeros();  // n.b., do not warm start from stale solution
+    return u_;
+  }
+
+  if (!is_prediction_built_ || (revision_ != sys_.revision())) {
+    BuildPrediction();
+  }
+
+  // linear term of QP given current state, disturbance, reference
+  // (n.b., evaluated in place with preallocated scratch)
+  f_ = F_x_ * sys_.x();
+  f_ += F_m_ * sys_.m();
+  f_ -= F_r_ * cx_ref_;
+  f_ -= F_u_ * u_;
+
+  // warm start: previous solution shifted by one step (last input repeated)
+  size_t n_u = sys_.n_u();
+  for (size_t k = 0; k + n_u < u_horizon_.n_elem; k++) {
+    u_horizon_[k] = u_horizon_[k + n_u];
+  }
+
+  Solve();
+
+  u_ = u_horizon_.subvec(0, n_u - 1);
+  return u_;
+}
+
+template <typename System>
+inline void MPCController<System>::BuildPrediction() {
+  size_t n_x = sys_.n_x();
+  size_t n_u = sys_.n_u();
+  size_t n_y = sys_.n_y();
+  size_t n = n_horizon_;
+
+  Matrix bg = sys_.B() * arma::diagmat(sys_.g());
+
+  // C A^k, C sum_{j<=k} A^j
+  std::vector<Matrix> c_a_pow(n + 1);
+  std::vector<Matrix> c_a_sum(n);
+  Matrix a_pow(n_x, n_x, fill::eye);
+  Matrix a_sum(n_x, n_x, fill::zeros);
+  for (size_t k = 0; k <= n; k++) {
+    c_a_pow[k] = sys_.C() * a_pow;
+    if (k < n) {
+      a_sum += a_pow;
+      c_a_sum[k] = sys_.C() * a_sum;
+    }
+    a_pow = sys_.A() * a_pow;
+  }
+
+  // condensed prediction: cX = c_phi x + c_lambda m + g_y U
+  Matrix c_phi(n_y * n, n_x);
+  Matrix c_lambda(n_y * n, n_x);
+  Matrix g_y(n_y * n, n_u * n, fill::zeros);
+  for (size_t k = 0; k < n; k++) {
+    c_phi.rows(k * n_y, (k + 1) * n_y - 1) = c_a_pow[k + 1];
+    c_lambda.rows(k * n_y, (k + 1) * n_y - 1) = c_a_sum[k];
+    for (size_t j = 0; j <= k; j++) {
+      g_y.submat(k * n_y, j * n_u, (k + 1) * n_y - 1, (j + 1) * n_u - 1) =
+          c_a_pow[k - j] * bg;
+    }
+  }
+
+  Matrix eye_n(n, n, fill::eye);
+  Matrix q_bar = arma::kron(eye_n, Q_y_);
+  Matrix r_bar = arma::kron(eye_n, R_u_);
+  Matrix s_bar = arma::kron(eye_n, S_du_);
+
+  // differencing: dU = D U - E u_prev
+  Matrix d_diff(n_u * n, n_u * n, fill::eye);
+  for (size_t k = n_u; k < n_u * n; k++) {
+    d_diff(k, k - n_u) = -1;
+  }
+  Matrix e_prev(n_u * n, n_u, fill::zeros);
+  e_prev.rows(0, n_u - 1) = Matrix(n_u, n_u, fill::eye);
+
+  Matrix g_y_t_q = g_y.t() * q_bar;
+  H_ = g_y_t_q * g_y + r_bar + d_diff.t() * s_bar * d_diff;
+  H_ = 0.5 * (H_ + H_.t());
+  F_x_ = g_y_t_q * c_phi;
+  F_m_ = g_y_t_q * c_lambda;
+  F_r_ = g_y_t_q * arma::repmat(Matrix(n_y, n_y, fill::eye), n, 1);
+  F_u_ = d_diff.t() * s_bar * e_prev;
+
+  Vector eig_h = arma::eig_sym(H_);
+  lipschitz_ = std::max(eig_h.max(), std::numeric_limits<data_t>::epsilon());
+
+  revision_ = sys_.revision();
+  is_prediction_built_ = true;
+}
+
+template <typename System>
+inline void MPCController<System>::Solve() {
+  // accelerated projected gradient (FISTA)
+  // _reference:
+  //  Beck & Teboulle (2009) A fast iterative shrinkage-thresholding algorithm
+  //  for linear inverse problems
+  size_t n_elem = u_horizon_.n_elem;
+  for (size_t k = 0; k < n_elem; k++) {
+    u_horizon_[k] = std::min(std::max(u_horizon_[k], u_lb_), u_ub_);
+  }
+  v_ = u_horizon_;
+  data_t t = 1;
+
+  is_converged_ = false;
+  for (n_iter_ = 1; n_iter_ <= max_iter_; n_iter_++) {
+    grad_ = H_ * v_;
+    grad_ += f_;
+
+    data_t t_next = (1 + std::sqrt(1 + 4 * t * t)) / 2;
+    data_t momentum = (t - 1) / t_next;
+    data_t max_step = 0;
+    for (size_t k = 0; k < n_elem; k++) {
+      data_t u_k = v_[k] - grad_[k] / lipschitz_;
+      u_k = std::min(std::max(u_k, u_lb_), u_ub_);
+      max_step = std::max(max_step, std::abs(u_k - u_horizon_[k]));
+      u_next_[k] = u_k;
+      v_[k] = u_k + momentum * (u_k - u_horizon_[k]);
+    }
+    u_horizon_.swap(u_next_);
+    t = t_next;
+
+    if (max_step < tol_) {
+      is_converged_ = true;
+      break;
+    }
+  }
+  n_iter_ = std::min(n_iter_, max_iter_);
+}
+
+}  // namespace lds
+
+#endif
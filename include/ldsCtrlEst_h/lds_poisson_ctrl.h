@@ -45,7 +45,7 @@ class Controller : public lds::Controller<System> {
   void set_y_ref(const Vector& y_ref) override {
     Reassign(y_ref_, y_ref);
     lds::Limit(y_ref_, kYRefLb, lds::kInf);
-    cx_ref_ = log(y_ref_) - sys_.d();
+    cx_ref_ = log(y_ref_) - sys_->d();
   };
 
   // make sure base class template methods available
@@ -53,6 +53,22 @@ class FitEM : public EM<Fit> {
  public:
   using EM<Fit>::EM;
 
+  /**
+   * Enables a sparse representation of the output matrix (e.g., many
+   * outputs, each loading on few states), with the sparsity pattern of the
+   * current fit's C held fixed: i.e., structurally-zero coefficients are not
+   * solved for in the M step and remain zero. The E step and M step for the
+   * output then scale with the number of nonzeros of C.
+   *
+   * @brief      sets whether output matrix is treated as sparse
+   *
+   * @param      do_sparse_C  whether C is treated as sparse
+   */
+  void set_sparse_C(bool do_sparse_C);
+
+  /// Get whether output matrix is treated as sparse
+  bool do_sparse_C() const { return do_sparse_C_; };
+
  private:
   /**
    * @brief      estimate C+d by maximizing likelihood
@@ -64,15 +80,40 @@ class FitEM : public EM<Fit> {
    */
   void MaximizeMeasurement() override{};
 
+  /// Newton's method for output needs smoothed state cov at every time step
+  bool DoesStoreCov() const override { return true; }
+
+  /// updates sparse copy of C (if sparse)
+  void PrepareExpectation() override;
+
   /**
    * @brief      recursively update estimator gain Ke
    *
    * @param      Ke      estimator gain
    * @param      P_pre   cov of predicted state est.
    * @param      P_post  cov of postior sate est.
+   * @param      y_pre   predicted output at time t
    * @param      t       time
    */
-  void RecurseKe(Matrix& Ke, Cube& P_pre, Cube& P_post, size_t t) override;
+  void RecurseKe(Matrix& Ke, Cube& P_pre, Cube& P_post, const Vector& y_pre,
+                 size_t t) override;
+
+  /**
+   * n.b., approximated by the Poisson likelihood of the predicted rate.
+   *
+   * @brief      log-likelihood of measurement given past measurements
+   *
+   * @param      z          measurement at time t
+   * @param      y_pre      predicted output at time t
+   * @param      P_pre      cov of predicted state est. at time t
+   * @param      is_steady  whether P_pre is the same as at previous call
+   * @param      cache      scratch reused between time steps
+   *
+   * @return     log-likelihood
+   */
+  data_t LogLikelihood(const Vector& z, const Vector& y_pre,
+                       const Matrix& P_pre, bool is_steady,
+                       LikelihoodCache& cache) const override;
 
   /**
    * @brief      Solve for output matrix by Newton's method.
@@ -85,6 +126,13 @@ class FitEM : public EM<Fit> {
    * @brief      analytically solve for output bias
    */
   void AnalyticalSolveD();
+
+  /// nonzero coefficients of row `p` of C (on its sparsity pattern)
+  Vector SupportCoefs(size_t p) const;
+
+  bool do_sparse_C_{};                 ///< whether C is treated as sparse
+  SpMatrix c_sp_;                      ///< sparse copy of C
+  std::vector<arma::uvec> c_support_;  ///< nonzero columns of each row of C
 };
 
 }  // namespace poisson
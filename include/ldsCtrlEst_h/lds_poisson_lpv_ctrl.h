@@ -0,0 +1,84 @@
+//===-- ldsCtrlEst_h/lds_poisson_lpv_ctrl.h - PLDS LPV Control --*- C++ -*-===//
+//
+// Copyright 2021 Michael Bolus
+// Copyright 2021 Georgia Institute of Technology
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file declares and partially defines the type for gain-scheduled
+/// control of a system approximated as Poisson-output linear dynamical
+/// systems at points of a scheduling variable
+/// (lds::poisson::ScheduledController).
+///
+/// \brief PLDS scheduled controller type
+//===----------------------------------------------------------------------===//
+
+#ifndef LDSCTRLEST_LDS_POISSON_LPV_CTRL_H
+#define LDSCTRLEST_LDS_POISSON_LPV_CTRL_H
+
+// controller type
+#include "lds_poisson_ctrl.h"
+// scheduled controller
+#include "lds_lpv_ctrl.h"
+
+namespace lds {
+namespace poisson {
+/// Poisson-observation ScheduledController Type
+class ScheduledController : public lds::ScheduledController<System> {
+ public:
+  /// sets reference output
+  void set_y_ref(const Vector& y_ref) override {
+    Reassign(y_ref_, y_ref);
+    lds::Limit(y_ref_, kYRefLb, lds::kInf);
+    cx_ref_ = log(y_ref_) - sys_->d();
+  }
+
+  // make sure base class template methods available
+  using lds::ScheduledController<System>::ScheduledController;
+  using lds::ScheduledController<System>::Schedule;
+  using lds::ScheduledController<System>::Control;
+  using lds::ScheduledController<System>::ControlOutputReference;
+
+  using lds::ScheduledController<System>::sys;
+  using lds::ScheduledController<System>::Kc;
+  using lds::ScheduledController<System>::Kc_inty;
+  using lds::ScheduledController<System>::Kc_u;
+  using lds::ScheduledController<System>::g_design;
+  using lds::ScheduledController<System>::u_ref;
+  using lds::ScheduledController<System>::x_ref;
+  using lds::ScheduledController<System>::y_ref;
+  using lds::ScheduledController<System>::control_type;
+
+  using lds::ScheduledController<System>::set_g_design;
+  using lds::ScheduledController<System>::set_u_ref;
+  using lds::ScheduledController<System>::set_x_ref;
+  using lds::ScheduledController<System>::set_y_ref;
+  using lds::ScheduledController<System>::set_Kc;
+  using lds::ScheduledController<System>::set_Kc_inty;
+  using lds::ScheduledController<System>::set_Kc_u;
+  using lds::ScheduledController<System>::set_tau_awu;
+
+  using lds::ScheduledController<System>::Reset;
+  using lds::ScheduledController<System>::Print;
+
+ private:
+  constexpr static data_t kYRefLb =
+      1e-4;  ///< lower bound on yRef (to avoid numerical log(0) issue)
+};  // ScheduledController
+}  // namespace poisson
+}  // namespace lds
+
+#endif
@@ -0,0 +1,61 @@
+//===-- ldsCtrlEst_h/lds_poisson_mpc_ctrl.h - PLDS MPC ----------*- C++ -*-===//
+//
+// Copyright 2021 Michael Bolus
+// Copyright 2021 Georgia Institute of Technology
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file declares the type for receding-horizon (model predictive) control
+/// of a poisson-observation linear dynamical system
+/// (lds::poisson::MPCController).
+///
+/// \brief PLDS MPC Controller
+//===----------------------------------------------------------------------===//
+
+#ifndef LDSCTRLEST_LDS_POISSON_MPC_CTRL_H
+#define LDSCTRLEST_LDS_POISSON_MPC_CTRL_H
+
+// namespace
+#include "lds_poisson.h"
+// system
+#include "lds_poisson_sys.h"
+// controller
+#include "lds_mpc_ctrl.h"
+
+namespace lds {
+namespace poisson {
+/// Poisson-observation MPC Controller Type
+class MPCController : public lds::MPCController<System> {
+ public:
+  /// sets reference output
+  void set_y_ref(const Vector& y_ref) override {
+    Reassign(y_ref_, y_ref);
+    lds::Limit(y_ref_, kYRefLb, lds::kInf);
+    cx_ref_ = log(y_ref_) - sys_.d();
+  };
+
+  // make sure base class template methods available
+  using lds::MPCController<System>::MPCController;
+  using lds::MPCController<System>::ControlOutputReference;
+
+ private:
+  constexpr static const data_t kYRefLb =
+      1e-4;  ///< lower bound on yRef (to avoid numerical log(0) issue)
+};
+}  // namespace poisson
+}  // namespace lds
+
+#endif
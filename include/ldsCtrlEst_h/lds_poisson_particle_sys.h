@@ -0,0 +1,261 @@
+//===-- ldsCtrlEst_h/lds_poisson_particle_sys.h - PLDS PF -------*- C++ -*-===//
+//
+// Copyright 2021 Michael Bolus
+// Copyright 2021 Georgia Institute of Technology
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file declares the type for state estimation (filtering) of
+/// Poisson-output linear dynamical systems by a particle filter
+/// (`lds::poisson::ParticleSystem`), for regimes (e.g., low output rates) in
+/// which the Gaussian approximation of the posterior made by
+/// `lds::poisson::System` is poor. It inherits functionality from the
+/// underlying linear dynamical system (`lds::System`), such that it may be
+/// used in place of `lds::poisson::System` by `lds::Controller`.
+///
+/// References:
+///
+/// Doucet A, de Freitas N, Gordon N. (2001) Sequential Monte Carlo Methods in
+/// Practice. Springer.
+///
+/// Kitagawa G. (1996) Monte Carlo Filter and Smoother for Non-Gaussian
+/// Nonlinear State Space Models. J Comput Graph Stat 5(1).
+///
+/// \brief PLDS particle filter type
+//===----------------------------------------------------------------------===//
+
+#ifndef LDSCTRLEST_LDS_POISSON_PARTICLE_SYS_H
+#define LDSCTRLEST_LDS_POISSON_PARTICLE_SYS_H
+
+// namespace
+#include "lds_poisson.h"
+// system
+#include "lds_sys.h"
+// random number generation
+#include "lds_rng.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace lds {
+namespace poisson {
+
+/// default number of particles
+static const size_t kDefaultNParticles = 2048;
+/// default effective sample size (fraction of particles) below which to
+/// resample
+static const data_t kDefaultResampleThresh = 0.5;
+
+/// Poisson System type, filtered by a particle filter
+class ParticleSystem : public lds::System {
+ public:
+  /**
+   * @brief      Constructs a new ParticleSystem.
+   */
+  ParticleSystem() = default;
+
+  /**
+   * @brief      Constructs a new ParticleSystem.
+   *
+   * @param      n_u          number of inputs
+   * @param      n_x          number of states
+   * @param      n_y          number of outputs
+   * @param      dt           sample period
+   * @param      n_particles  [optional] number of particles
+   * @param      p0           [optional] initial diagonal elements of state
+   *                          estimate covariance (P)
+   * @param      q0           [optional] initial diagonal elements of process
+   *                          noise covariance (Q)
+   */
+  ParticleSystem(std::size_t n_u, std::size_t n_x, std::size_t n_y, data_t dt,
+                 size_t n_particles = kDefaultNParticles,
+                 data_t p0 = kDefaultP0, data_t q0 = kDefaultQ0);
+
+  /**
+   * Propagates the particles by the dynamics (with process noise), weights
+   * them by the Poisson likelihood of the measurement at their output rates
+   * (exp(C*x+d)), and resamples them (systematically) when the effective
+   * sample size falls below the threshold (see set_resample_thresh). The
+   * state estimate (x) and its covariance (P) are the weighted mean and
+   * covariance of the particles.
+   *
+   * Particles are held in structure-of-arrays layout (one contiguous column
+   * of all particles per state), so that propagation and weighting are
+   * matrix products over all particles at once.
+   *
+   * n.b., the particles are drawn from N(x, P) at the first step after
+   * construction, Reset, set_x, or set_P. Neither the disturbance (see
+   * do_adapt_m) nor the parameters (see set_adapt_params) are adapted.
+   *
+   * @brief      Filter data to produce causal state estimates
+   *
+   * @param      u_tm1  input at t-minus-1
+   * @param      z      current measurement
+   */
+  void Filter(const Vector& u_tm1, const Vector& z);
+
+  /**
+   * n.b., as the particles represent the estimate, they are propagated along
+   * with it, e.g., when a controller steps without estimation.
+   *
+   * @brief      system dynamics function
+   *
+   * @param      u             input
+   * @param      do_add_noise  whether to add simulated process noise (to the
+   *                           state only, not the particles)
+   */
+  void f(const Vector& u, bool do_add_noise = false);
+
+  /**
+   * @brief      Simulate system measurement
+   *
+   * @param      u_tm1  input at t-1
+   *
+   * @return     z      measurement
+   */
+  const Vector& Simulate(const Vector& u_tm1) override;
+
+  /// Log-likelihood of measurement given prediction, i.e., under Poisson
+  /// counts at the output rates of the predicted particles (see
+  /// lds::System::PredictiveLogLik)
+  data_t PredictiveLogLik(const Vector& u_tm1, const Vector& z) override;
+
+  /// Set current state (particles redrawn at next step)
+  void set_x(const Vector& x) {
+    lds::System::set_x(x);
+    do_draw_particles_ = true;
+  };
+  /// Set covariance of state estimate (particles redrawn at next step)
+  void set_P(const Matrix& P) {
+    lds::System::set_P(P);
+    do_draw_particles_ = true;
+  };
+
+  /**
+   * @brief      sets number of particles (redrawn at next step)
+   *
+   * @param      n_particles  number of particles (must be > 0)
+   */
+  void set_n_particles(size_t n_particles);
+
+  /**
+   * @brief      sets effective sample size below which to resample
+   *
+   * @param      thresh  threshold, as fraction of particles (0, 1]
+   */
+  void set_resample_thresh(data_t thresh);
+
+  /**
+   * @brief      sets seed of random number generation (of particles)
+   *
+   * @param      seed    seed
+   * @param      stream  [optional] index of stream
+   */
+  void set_seed(std::uint64_t seed, std::uint64_t stream = 0) {
+    rng_ = CounterRng(seed, stream);
+  };
+
+  /// Reset system variables (particles redrawn at next step)
+  void Reset() {
+    lds::System::Reset();
+    do_draw_particles_ = true;
+  };
+
+  /**
+   * Besides the parameters and state saved for any system (see
+   * lds::System::SaveSnapshot), saves the particles and their weights, so
+   * that a restored system continues with the same posterior.
+   *
+   * @brief      saves system to snapshot
+   *
+   * @param      snap    snapshot
+   * @param      prefix  [optional] prefix of record names
+   */
+  void SaveSnapshot(Snapshot& snap,
+                    const std::string& prefix = "") const override;
+  /// Restore system from snapshot (see lds::System::LoadSnapshot)
+  void LoadSnapshot(const Snapshot& snap,
+                    const std::string& prefix = "") override;
+
+  /// Get number of particles
+  size_t n_particles() const { return n_particles_; };
+  /// Get particles (n_particles x n_x, i.e., column per state)
+  const Matrix& particles() const { return X_; };
+  /// Get (normalized) weights of particles
+  const Vector& w() const { return w_; };
+  /// Get effective sample size (number of particles) at most recent step
+  data_t ess() const { return ess_; };
+  /// Get effective sample size below which to resample (fraction)
+  data_t resample_thresh() const { return resample_thresh_; };
+  /// Get number of steps at which particles were resampled
+  size_t n_resampled() const { return n_resampled_; };
+
+ protected:
+  /// System output function
+  void h() override {
+    cx_ = C_ * x_;
+    y_ = exp(cx_ + d_);
+  };
+
+  /// Estimator gain is unused by particle filter
+  void RecurseKe() override{};
+
+ private:
+  /// allocates particles and scratch
+  void InitParticles();
+
+  /// draws particles from N(x, P), with uniform weights
+  void DrawParticles();
+
+  /// propagates particles `X_` by dynamics into `X` (with process noise)
+  void Propagate(const Vector& u, Matrix& X);
+
+  /// calculates log-likelihood of `z` for each particle `X` into `log_lik_`
+  void CalcLogLik(const Matrix& X, const Vector& z);
+
+  /// resamples particles systematically (uniform weights after)
+  void Resample();
+
+  /// sets x, P to weighted mean and covariance of particles
+  void CalcMoments();
+
+  size_t n_particles_ = kDefaultNParticles;  ///< number of particles
+  data_t resample_thresh_ = kDefaultResampleThresh;  ///< resample threshold
+  bool do_draw_particles_ = true;  ///< whether to redraw at next step
+
+  Matrix X_;        ///< particles (n_particles x n_x)
+  Vector log_w_;    ///< log-weights (normalized to max of zero)
+  Vector w_;        ///< weights (normalized to sum of one)
+  data_t ess_{};    ///< effective sample size
+  size_t n_resampled_{};  ///< steps at which resampled
+
+  Matrix Q_chol_;  ///< upper Cholesky factor of Q
+  Matrix Q_last_;  ///< Q at which Q_chol_ was factored
+
+  CounterRng rng_;  ///< random number generator
+
+  // Scratch (preallocated so the per-step path does not allocate):
+  Matrix X_tmp_;              ///< scratch particles (n_particles x n_x)
+  Matrix noise_;              ///< scratch noise (n_particles x n_x)
+  Matrix log_rate_;           ///< scratch log-rates (n_particles x n_y)
+  Vector log_lik_;            ///< scratch log-likelihoods (n_particles)
+  std::vector<size_t> idx_;   ///< scratch resampled indices (n_particles)
+};  // ParticleSystem
+
+}  // namespace poisson
+}  // namespace lds
+
+#endif
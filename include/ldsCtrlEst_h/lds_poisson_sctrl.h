@@ -40,7 +40,7 @@ class SwitchedController : public lds::SwitchedController<System> {
   void set_y_ref(const Vector& y_ref) override {
     Reassign(y_ref_,y_ref);
     lds::Limit(y_ref_, kYRefLB, lds::kInf);
-    cx_ref_ = log(y_ref_) - sys_.d();
+    cx_ref_ = log(y_ref_) - sys_->d();
   };
 
   // make sure base class template methods available
@@ -36,10 +36,22 @@
 
 // needed for Poisson random number generation
 #include <random>
+// needed for estimator gain cache
+#include <map>
 
 namespace lds {
 namespace poisson {
 
+/// lower bound on output rate (per sample) used in Cholesky covariance update
+/// (n.b., bounds the equivalent noise variance, 1/y, well within range, so
+/// silent channels carry negligible information without overflow)
+static const data_t kYMin = 1e-12;
+
+/// default bound on number of entries of estimator gain cache
+static const std::size_t kDefaultKeCacheMaxEntries = 1024;
+/// number of output-rate regimes queued for FillKeCache, at most
+static const std::size_t kKeCacheMaxPending = 16;
+
 /// Poisson System type
 class System : public lds::System {
  public:
@@ -75,12 +87,167 @@ class System : public lds::System {
    */
   const Vector& Simulate(const Vector& u_tm1) override;
 
+  /**
+   * Log-likelihood of measurement given prediction (see
+   * lds::System::PredictiveLogLik), i.e., that of Poisson counts expected
+   * under the Gaussian predicted state (A P A' + Q covariance), by which the
+   * log-rate is Gaussian and the expected rate is exp(C x + d) scaled by
+   * exp(diag(C (A P A' + Q) C')/2). n.b., between recursions of P (see
+   * set_recurse_Ke_period), it is that last recursed.
+   *
+   * @brief      log-likelihood of measurement given prediction
+   *
+   * @param      u_tm1  input at t-minus-1
+   * @param      z      current measurement
+   *
+   * @return     log-likelihood
+   */
+  data_t PredictiveLogLik(const Vector& u_tm1, const Vector& z) override;
+
+  /**
+   * Enables a sparse representation of the output matrix for filtering (e.g.,
+   * many outputs, each loading on few states), so that the output function
+   * and covariance update scale with the number of nonzeros of C. The
+   * sparsity pattern is that of C when this is enabled (or the parameters are
+   * set; see lds::System::revision), and it is maintained while adapting
+   * parameters (see set_adapt_params).
+   *
+   * n.b., the Cholesky covariance update (kCovUpdateCholesky) treats C as
+   * dense.
+   *
+   * @brief      sets whether output matrix is treated as sparse
+   *
+   * @param      do_sparse_C  whether C is treated as sparse
+   */
+  void set_sparse_C(bool do_sparse_C);
+
+  /// Get whether output matrix is treated as sparse
+  bool do_sparse_C() const { return do_sparse_C_; };
+
+  /**
+   * Rather than recursively calculating the estimator gain every sample (which
+   * requires pseudo-inverses), uses a bank of steady-state gains keyed on the
+   * quantized log-rate (C*x+d). Each entry of the bank is calculated by
+   * iterating the covariance recursion (in the mode set by set_cov_update and
+   * set_sparse_C) to its fixed point with the output rate held at the bin
+   * center.
+   *
+   * Entries are not calculated on the real-time path: a sample whose regime
+   * is not cached takes the exact recursion, and the regime is queued (up to
+   * kKeCacheMaxPending at a time) to be calculated by FillKeCache, which the
+   * application calls when the deadline allows. Entries may also be
+   * calculated ahead of time (PrecomputeKeCache). As there is one bin per
+   * output, the number of regimes grows geometrically with n_y, so the
+   * number of entries is bounded by `max_entries`; beyond it, unvisited
+   * regimes always take the exact recursion. (With many outputs, few samples
+   * may then hit the cache.)
+   *
+   * The error of the cached gain (relative to the gain the exact recursion
+   * would have produced) is controlled by the bin width `log_y_step`. It is
+   * measured every `check_period` samples and reported by `Ke_cache_err`. An
+   * entry found by a check to be in error by more than `max_err` is not used
+   * again (n.b., so error is only bounded at checks).
+   *
+   * n.b., the cache is cleared on its next use after the parameters it
+   * depends on have been set, however they were set (see
+   * lds::System::revision), so it is of no use while parameters are set
+   * every step (e.g., a gain-scheduled controller with a moving scheduling
+   * variable). While parameters are adapted (see set_adapt_params), the cache
+   * is bypassed.
+   *
+   * @brief      enables caching of estimator gains by output-rate regime
+   *
+   * @param      log_y_step    bin width of quantized log-rate (must be > 0)
+   * @param      check_period  [optional] period (in samples) at which to
+   *                           measure the error of the cached gain (0 = never)
+   * @param      max_entries   [optional] maximum number of entries
+   * @param      max_err       [optional] maximum relative error of a cached
+   *                           gain found by a check
+   */
+  void set_Ke_cache(data_t log_y_step, size_t check_period = 0,
+                    size_t max_entries = kDefaultKeCacheMaxEntries,
+                    data_t max_err = kInf);
+
+  /**
+   * Calculates entries of the estimator gain cache for output-rate regimes
+   * visited since they were last calculated (see set_Ke_cache). Each entry
+   * iterates the covariance recursion to convergence, so this is not meant
+   * for the real-time path; call it between samples when there is time to
+   * spare (e.g., bounding `max_filled`), or on a copy of the system that is
+   * then swapped in.
+   *
+   * @brief      calculates estimator gains of queued output-rate regimes
+   *
+   * @param      max_filled  [optional] maximum number of entries to calculate
+   *
+   * @return     number of entries calculated
+   */
+  size_t FillKeCache(size_t max_filled = static_cast<size_t>(-1));
+
+  /**
+   * @brief      calculates estimator gains of output-rate regimes ahead of
+   *             time (see set_Ke_cache)
+   *
+   * @param      log_y  log-rates (C*x+d), column per sample (e.g., those of
+   *                    training data)
+   */
+  void PrecomputeKeCache(const Matrix& log_y);
+
+  /// Disable caching of estimator gains (recurse every sample)
+  void UnsetKeCache() {
+    do_cache_Ke_ = false;
+    ClearKeCache();
+  };
+
+  /// Clear cached estimator gains (e.g., after changing model parameters)
+  void ClearKeCache() {
+    Ke_cache_.clear();
+    n_pending_ = 0;
+    Ke_cache_err_ = 0;
+    Ke_cache_err_max_ = 0;
+    Ke_cache_revision_ = revision_;
+  };
+
+  /**
+   * Besides the parameters and state saved for any system (see
+   * lds::System::SaveSnapshot), saves the estimator gain cache (see
+   * set_Ke_cache), so that a restored system does not recalculate the gains
+   * of output-rate regimes already visited.
+   *
+   * @brief      saves system to snapshot
+   *
+   * @param      snap    snapshot
+   * @param      prefix  [optional] prefix of record names
+   */
+  void SaveSnapshot(Snapshot& snap,
+                    const std::string& prefix = "") const override;
+  /// Restore system from snapshot (see lds::System::LoadSnapshot)
+  void LoadSnapshot(const Snapshot& snap,
+                    const std::string& prefix = "") override;
+
+  /// Get whether estimator gains are cached
+  bool do_cache_Ke() const { return do_cache_Ke_; };
+  /// Get number of entries in estimator gain cache
+  size_t Ke_cache_size() const { return Ke_cache_.size(); };
+  /// Get number of output-rate regimes queued for FillKeCache
+  size_t Ke_cache_n_pending() const { return n_pending_; };
+  /// Get relative error of cached gain at most recent check
+  data_t Ke_cache_err() const { return Ke_cache_err_; };
+  /// Get maximum relative error of cached gain over all checks
+  data_t Ke_cache_err_max() const { return Ke_cache_err_max_; };
+
  protected:
   /// System output function
   void h() override {
-    cx_ = C_ * x_;
+    if (do_sparse_C_) {
+      if (C_sp_revision_ != revision_) {
+        set_sparse_C(true);  // parameters were set (new sparsity pattern)
+      }
+      cx_ = C_sp_ * x_;
+    } else {
+      cx_ = C_ * x_;
+    }
     y_ = exp(cx_ + d_);
-    diag_y_.diag() = y_;
   };
 
   /**
@@ -98,9 +265,86 @@ class System : public lds::System {
    */
   void RecurseKe() override;
 
+  /// Initialize adaptation of C, d
+  void InitAdaptOutput(data_t p0) override;
+
+  /**
+   * Adapts each row of [C, d] by a step of the point process adaptive filter
+   * (Eden et al. 2004), i.e., recursive least squares weighted by the
+   * predicted output rate.
+   *
+   * n.b., estimator gains cached by set_Ke_cache are bypassed while
+   * parameters are adapted.
+   *
+   * @brief      adapt C, d given current measurement
+   *
+   * @param      z     measurement
+   */
+  void AdaptOutput(const Vector& z) override;
+
  private:
+  /// Cached estimator gain for one output-rate regime
+  struct KeCacheEntry {
+    Matrix P;     ///< steady-state covariance of state estimate
+    Matrix Ke;    ///< steady-state estimator gain
+    Matrix P_m;   ///< steady-state covariance of disturbance estimate
+    Matrix Ke_m;  ///< steady-state disturbance estimator gain
+    bool is_rejected{};  ///< whether found by a check to be in error
+  };
+
+  /// Recursively recalculate estimator gain (Ke), not using cache
+  void RecurseKeExact();
+
+  /// Update covariance `P` (in place) given output rate `y`
+  void UpdateCov(Matrix& P, const Vector& y);
+
+  /// Calculate estimator gain `Ke` given covariance `P`
+  void CalcGain(const Matrix& P, Matrix& Ke);
+
+  /// Get output rate at bin center of quantized log-rate `key`
+  Vector KeCacheBinCenter(const std::vector<long>& key) const;
+
+  /// Calculate steady-state gains for output rate `y_c` (cache entry)
+  KeCacheEntry CalcKeCacheEntry(const Vector& y_c);
+
+  /// Calculate steady-state disturbance gains for output rate `y_c` into
+  /// `entry` (n.b., only once m is adapted)
+  void CalcKeCacheEntryM(const Vector& y_c, KeCacheEntry& entry);
+
+  /// Recalculate estimator gain (Ke) using cache
+  void RecurseKeCached();
+
+  /// Clear cache if parameters were set (and refresh sparse copy of C)
+  void PrepareKeCache();
+
+  /// Queue current quantized log-rate for FillKeCache (if not yet queued)
+  void QueueKeCacheKey();
+
   // Poisson-output-specific
-  Matrix diag_y_;                 ///< diagonal matrix with elements y
+  Cube P_theta_y_;  ///< covariance of [C, d] estimate (slice per row)
+
+  // sparse output matrix
+  bool do_sparse_C_{};  ///< whether C is treated as sparse
+  SpMatrix C_sp_;       ///< sparse copy of C
+  Matrix C_mask_;       ///< sparsity pattern of C (1 where nonzero)
+  size_t C_sp_revision_{};  ///< system revision of sparse copy of C
+
+  // estimator gain cache
+  bool do_cache_Ke_{};      ///< whether to cache estimator gains
+  data_t log_y_step_{};     ///< bin width of quantized log-rate
+  size_t check_period_{};   ///< period at which to check cached gain error
+  size_t max_entries_{};    ///< max number of cached gains
+  data_t max_err_{};        ///< max relative error of cached gain at a check
+  size_t n_since_check_{};  ///< samples since cached gain error checked
+  data_t Ke_cache_err_{};   ///< relative error of cached gain at last check
+  data_t Ke_cache_err_max_{};  ///< max relative error of cached gain
+  size_t Ke_cache_revision_{};  ///< system revision of cached gains
+  std::vector<long> Ke_cache_key_;  ///< scratch for quantized log-rate
+  std::vector<std::vector<long>>
+      Ke_cache_pending_;  ///< regimes queued for FillKeCache
+  size_t n_pending_{};    ///< number of regimes queued for FillKeCache
+  std::map<std::vector<long>, KeCacheEntry>
+      Ke_cache_;  ///< cached gains (keyed on quantized log-rate)
   std::poisson_distribution<size_t>
       pd_;  ///< poisson distribution for simulating data
 };          // System
@@ -0,0 +1,269 @@
+//===-- ldsCtrlEst_h/lds_recorder.h - Session Recorder ----------*- C++ -*-===//
+//
+// Copyright 2021 Michael Bolus
+// Copyright 2021 Georgia Institute of Technology
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file declares a type by which the per-step signals of a closed-loop
+/// session (control, measurement, estimates) are streamed to file in
+/// fixed-size chunks by a background thread (`lds::Recorder`), so that a long
+/// session is neither held in memory nor lost whole on a crash, and a type by
+/// which a recorded session is read back, e.g., as training data of the
+/// fitting types (`lds::RecordReader`).
+///
+/// A record file consists of (in native byte order):
+///
+/// 1. a header: magic "LDSREC\0\0", format version (uint32), byte-order mark
+///    (uint32), size of data_t in bytes (uint32), fields recorded
+///    (RecordField bit mask, uint32), and n_u, n_x, n_y, and steps per chunk
+///    (uint64 each);
+/// 2. any number of chunks: number of steps in the chunk (uint64), then the
+///    block of each field recorded (data_t, n_field x n_steps, column-major),
+///    in the order of their RecordField bits.
+///
+/// Each chunk is flushed to file when written, so a file cut short (e.g., by
+/// a crash) is readable up to its last whole chunk.
+///
+/// \brief session recorder
+//===----------------------------------------------------------------------===//
+
+#ifndef LDSCTRLEST_LDS_RECORDER_H
+#define LDSCTRLEST_LDS_RECORDER_H
+
+// namespace
+#include "lds.h"
+// system type
+#include "lds_sys.h"
+// list of matrices
+#include "lds_uniform_mats.h"
+// queue
+#include "lds_spsc_queue.h"
+
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace lds {
+
+const std::uint32_t kRecordVersion = 1;  ///< version of record file format
+
+/// Fields of each step recorded (bit mask)
+enum RecordField : size_t {
+  kRecordU = 0x1,     ///< control signal (as returned to user)
+  kRecordZ = 0x2,     ///< measurement
+  kRecordX = 0x4,     ///< state estimate
+  kRecordY = 0x8,     ///< output estimate
+  kRecordM = 0x10,    ///< process disturbance estimate
+  kRecordAll = 0x1f,  ///< all of the above
+};
+
+/// Chunked, Background-Thread Session Recorder Type
+class Recorder {
+ public:
+  /**
+   * Steps are recorded into preallocated chunks, which are handed to a
+   * background thread through a lock-free queue when full, so that recording
+   * neither allocates nor waits on the file. If the background thread falls
+   * behind by all chunks, steps are dropped (see n_dropped) rather than
+   * waited for.
+   *
+   * @brief      Constructs a new Recorder (opening file and starting thread).
+   *
+   * @param      path       path of file (overwritten)
+   * @param      n_u        number of inputs
+   * @param      n_x        number of states
+   * @param      n_y        number of outputs
+   * @param      fields     [optional] fields recorded (RecordField bit mask)
+   * @param      chunk_len  [optional] steps per chunk
+   * @param      n_chunks   [optional] number of chunks in memory (>= 2)
+   */
+  Recorder(const std::string& path, size_t n_u, size_t n_x, size_t n_y,
+           size_t fields = kRecordAll, size_t chunk_len = 1024,
+           size_t n_chunks = 4);
+
+  /// Closes file (discarding any exception the background thread threw)
+  ~Recorder();
+
+  Recorder(const Recorder&) = delete;
+  Recorder& operator=(const Recorder&) = delete;
+
+  /**
+   * @brief      records a step (recording thread only)
+   *
+   * @param      u     control signal (e.g., as returned by Controller::Control)
+   * @param      z     measurement
+   * @param      sys   system (of which x, y, and m are recorded)
+   *
+   * @return     whether there was room to record it (false = dropped)
+   */
+  bool Record(const Vector& u, const Vector& z, const System& sys);
+
+  /**
+   * Hands the (partial) chunk being recorded to the background thread, so
+   * that it is written without waiting for the chunk to fill, e.g., at the
+   * end of a trial. The next step starts a new chunk.
+   *
+   * @brief      flushes steps recorded so far (recording thread only)
+   */
+  void Flush();
+
+  /**
+   * If the background thread threw (e.g., failed to write), that exception
+   * is rethrown here.
+   *
+   * @brief      flushes, stops background thread, and closes file
+   */
+  void Close();
+
+  /// Get number of steps recorded (including those not yet written)
+  size_t n_recorded() const { return n_recorded_.load(); };
+  /// Get number of steps written to file
+  size_t n_written() const { return n_written_.load(); };
+  /// Get number of steps dropped because no chunk was free
+  size_t n_dropped() const { return n_dropped_.load(); };
+  /// Get fields recorded (RecordField bit mask)
+  size_t fields() const { return fields_; };
+  /// Get steps per chunk
+  size_t chunk_len() const { return chunk_len_; };
+
+ private:
+  static const size_t kNumFields = 5;  ///< number of RecordField fields
+
+  /// Chunk handed to the background thread
+  struct Filled {
+    size_t idx{};      ///< index of chunk
+    size_t n_steps{};  ///< steps in chunk
+  };
+
+  /// copies vector field `idx` of the current step into the current chunk
+  void Store(size_t idx, const Vector& v);
+
+  /// background thread entry point (records any exception)
+  void Run();
+
+  /// writes chunk to file
+  void Write(const Filled& filled);
+
+  size_t n_u_{};        ///< number of inputs
+  size_t n_x_{};        ///< number of states
+  size_t n_y_{};        ///< number of outputs
+  size_t fields_{};     ///< fields recorded
+  size_t chunk_len_{};  ///< steps per chunk
+
+  size_t sizes_[kNumFields]{};    ///< size of each field (0 = absent)
+  size_t offsets_[kNumFields]{};  ///< offset of each field block in a chunk
+
+  std::vector<std::vector<data_t>> chunks_;  ///< chunks in memory
+  SpscQueue<size_t> free_;                   ///< chunks free (to recorder)
+  SpscQueue<Filled> filled_;                 ///< chunks filled (to writer)
+  size_t idx_{};                             ///< chunk being recorded
+  size_t n_steps_{};                         ///< steps in chunk recorded
+  bool has_chunk_ = false;                   ///< whether idx_ is held
+
+  std::ofstream file_;                   ///< file written
+  std::thread thread_;                   ///< background thread
+  std::atomic<bool> do_stop_{false};     ///< whether thread should stop
+  std::exception_ptr error_;             ///< exception thrown by thread
+
+  std::atomic<size_t> n_recorded_{0};  ///< steps recorded
+  std::atomic<size_t> n_written_{0};   ///< steps written
+  std::atomic<size_t> n_dropped_{0};   ///< steps dropped
+};
+
+/// Reader of Recorded Sessions Type
+class RecordReader {
+ public:
+  /**
+   * Reads the whole file into memory. A trailing chunk that is cut short
+   * (e.g., by a crash while recording) is skipped (see is_truncated).
+   *
+   * @brief      Constructs a new RecordReader (reading file).
+   *
+   * @param      path  path of file
+   */
+  explicit RecordReader(const std::string& path);
+
+  /**
+   * Each chunk is a trial, whose matrix views the reader's memory in place
+   * (n.b., the reader must outlive the list and anything it is moved into,
+   * e.g., the fitting types, which only read their training data). Chunks
+   * of fewer than `min_steps` steps (e.g., the last one) are skipped.
+   *
+   * @brief      gets views of a field as a list of trials (one per chunk)
+   *
+   * @param      field      field (a single RecordField bit)
+   * @param      min_steps  [optional] minimum steps of chunks included
+   *
+   * @return     list of views (n_field x n_steps each)
+   */
+  UniformMatrixList<kMatFreeDim2> Trials(RecordField field,
+                                         size_t min_steps = 1) const;
+
+  /**
+   * @brief      gets a field of the whole session (copied into one matrix)
+   *
+   * @param      field  field (a single RecordField bit)
+   *
+   * @return     field (n_field x n_steps)
+   */
+  Matrix Session(RecordField field) const;
+
+  /// Get number of inputs
+  size_t n_u() const { return n_u_; };
+  /// Get number of states
+  size_t n_x() const { return n_x_; };
+  /// Get number of outputs
+  size_t n_y() const { return n_y_; };
+  /// Get fields recorded (RecordField bit mask)
+  size_t fields() const { return fields_; };
+  /// Get steps per chunk (as recorded)
+  size_t chunk_len() const { return chunk_len_; };
+  /// Get number of chunks read
+  size_t n_chunks() const { return chunk_offsets_.size(); };
+  /// Get number of steps read
+  size_t n_steps() const { return n_steps_; };
+  /// Get whether file ended in the middle of a chunk
+  bool is_truncated() const { return is_truncated_; };
+
+ private:
+  static const size_t kNumFields = 5;  ///< number of RecordField fields
+
+  /// gets index of field (position of its bit), checking it was recorded
+  size_t FieldIndex(RecordField field) const;
+
+  size_t n_u_{};        ///< number of inputs
+  size_t n_x_{};        ///< number of states
+  size_t n_y_{};        ///< number of outputs
+  size_t fields_{};     ///< fields recorded
+  size_t chunk_len_{};  ///< steps per chunk
+  size_t n_steps_{};    ///< steps read
+  bool is_truncated_ = false;  ///< whether file ended mid-chunk
+
+  size_t sizes_[kNumFields]{};  ///< size of each field (0 = absent)
+
+  std::vector<data_t> data_;           ///< data of all chunks
+  std::vector<size_t> chunk_offsets_;  ///< offset of each chunk in data_
+  std::vector<size_t> chunk_steps_;    ///< steps in each chunk
+};
+
+}  // namespace lds
+
+#endif
@@ -0,0 +1,136 @@
+//===-- ldsCtrlEst_h/lds_rng.h - Counter-Based RNG --------------*- C++ -*-===//
+//
+// Copyright 2021 Michael Bolus
+// Copyright 2021 Georgia Institute of Technology
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file declares a counter-based random number generator
+/// (`lds::CounterRng`), by which independent, reproducible streams of random
+/// numbers can be drawn concurrently.
+///
+/// References:
+/// [1] Salmon JK, Moraes MA, Dror RO, Shaw DE. (2011) Parallel Random
+/// Numbers: As Easy as 1, 2, 3. Proceedings of SC11.
+///
+/// [2] Hormann W. (1993) The Transformed Rejection Method for Generating
+/// Poisson Random Variables. Insurance: Mathematics and Economics 12(1).
+///
+/// \brief counter-based random number generator
+//===----------------------------------------------------------------------===//
+
+#ifndef LDSCTRLEST_LDS_RNG_H
+#define LDSCTRLEST_LDS_RNG_H
+
+#include "lds.h"
+
+#include <array>
+#include <cstdint>
+
+namespace lds {
+
+///
+/// @brief      Counter-Based Random Number Generator (Philox4x32-10 [1])
+///
+///             Each number is a pure function of (seed, stream, position), so
+///             that different streams (e.g., one per simulated trajectory)
+///             are independent and reproducible regardless of which thread
+///             draws them. Also satisfies UniformRandomBitGenerator, so it can
+///             be used with the std random number distributions.
+///
+class CounterRng {
+ public:
+  using result_type = std::uint32_t;  ///< type of random bits
+
+  /**
+   * @brief      Constructs a new CounterRng.
+   *
+   * @param      seed    [optional] seed (key) shared among streams
+   * @param      stream  [optional] index of stream
+   */
+  explicit CounterRng(std::uint64_t seed = 0, std::uint64_t stream = 0);
+
+  /// smallest value returned
+  static constexpr result_type min() { return 0; }
+  /// largest value returned
+  static constexpr result_type max() { return 0xFFFFFFFF; }
+
+  /// draws 32 random bits
+  result_type operator()() {
+    if (idx_ == kBlockSize) {
+      Generate();
+    }
+    return block_[idx_++];
+  }
+
+  /**
+   * n.b., double regardless of data_t, such that its log is well defined.
+   *
+   * @brief      draws uniformly distributed number on (0, 1)
+   *
+   * @return     random number
+   */
+  double Uniform();
+
+  /**
+   * @brief      draws standard normally distributed number
+   *
+   * @return     random number
+   */
+  data_t Randn();
+
+  /**
+   * @brief      fills vector with standard normally distributed numbers
+   *
+   * @param      x     [out] random vector
+   */
+  void Randn(Vector& x);
+
+  /**
+   * @brief      draws Poisson distributed number
+   *
+   * @param      mean  mean (i.e., rate)
+   *
+   * @return     random number
+   */
+  size_t Poisson(data_t mean);
+
+  /**
+   * @brief      draws vector of Poisson distributed numbers
+   *
+   * @param      mean  mean of each element
+   * @param      z     [out] random vector
+   */
+  void Poisson(const Vector& mean, Vector& z);
+
+ private:
+  static constexpr size_t kBlockSize = 4;  ///< words per Philox block
+
+  /// generates next block of random bits
+  void Generate();
+
+  std::array<std::uint32_t, 2> key_;               ///< seed
+  std::array<std::uint32_t, 4> counter_;           ///< (block, stream)
+  std::array<std::uint32_t, kBlockSize> block_{};  ///< current block
+  size_t idx_{kBlockSize};  ///< position in current block (empty if end)
+
+  double randn_spare_{};    ///< second normal number of Box-Muller pair
+  bool has_randn_spare_{};  ///< whether randn_spare_ is unused
+};
+
+}  // namespace lds
+
+#endif
@@ -29,6 +29,13 @@
 #define LDSCTRLEST_LDS_SCTRL_H
 
 #include "lds_ctrl.h"
+// lists of gains
+#include "lds_uniform_mats.h"
+#include "lds_uniform_vecs.h"
+// threads
+#include "lds_thread_pool.h"
+
+#include <memory>
 
 namespace lds {
 /// SwitchedController Type
@@ -41,6 +48,10 @@ class SwitchedController : public Controller<System> {
   SwitchedController() = default;
 
   /**
+   * n.b., sub-systems must share numbers of inputs and outputs, but may differ
+   * in number of states (see set_state_map), so that simple ones are filtered
+   * at the cost of their own state dimension.
+   *
    * @brief      Constructs a new SwitchedController.
    *
    * @param      systems       vector of sub-systems
@@ -71,72 +82,176 @@ class SwitchedController : public Controller<System> {
    */
   void Switch(size_t idx, bool do_force_switch = false);
 
-  /// sets state feedback gains
+  /**
+   * Sets the matrix by which the state (and disturbance) of sub-system `from`
+   * is carried into the state space of sub-system `to` on switching (see
+   * Switch), as well as the reference state and, under IMM, the estimates
+   * mixed into `to` (see set_imm). By default, this is the identity, which
+   * for sub-systems of different state dimensions keeps the states they have
+   * in common (i.e., leading states) and zeros the rest.
+   *
+   * n.b., while a state monitor or model swap (see Controller) is attached,
+   * switching between sub-systems of different state dimensions throws, as
+   * either is of the dimensions of one sub-system.
+   *
+   * @brief      sets mapping of state between sub-systems
+   *
+   * @param      from  index of sub-system switched from
+   * @param      to    index of sub-system switched to
+   * @param      map   mapping matrix (n_x of `to` x n_x of `from`)
+   */
+  void set_state_map(size_t from, size_t to, const Matrix& map);
+
+  /// Get mapping of state from sub-system `from` to `to` (see set_state_map)
+  const Matrix& state_map(size_t from, size_t to) const {
+    return state_maps_.at(to * n_sys_ + from);
+  };
+
+  /**
+   * Enables an interacting-multiple-model (IMM) estimator over the
+   * sub-systems, by which the sub-system in control is chosen automatically.
+   * Every step, the estimate of each sub-system is mixed from those of all of
+   * them (weighted by the probability of having transitioned from each), then
+   * filtered with the latest measurement. Mode probabilities are updated by
+   * the likelihood of that measurement under each sub-system's prediction
+   * (see System::PredictiveLogLik), and the controller switches to the most
+   * probable sub-system. n.b., as each sub-system keeps its own estimate, this
+   * switch does not copy the state across (cf. Switch).
+   *
+   * Sub-systems are filtered in parallel if set_n_threads is not 1.
+   *
+   * References:
+   *
+   * Blom HAP, Bar-Shalom Y. (1988) The Interacting Multiple Model Algorithm
+   * for Systems with Markovian Switching Coefficients. IEEE Transactions on
+   * Automatic Control 33.
+   *
+   * @brief      enables IMM estimation of sub-system (and switching to it)
+   *
+   * @param      transition  probabilities of transitioning between
+   *                         sub-systems per step (n_sys x n_sys; row i is from
+   *                         sub-system i)
+   * @param      mode_prob0  [optional] initial mode probabilities (default:
+   *                         uniform)
+   */
+  void set_imm(const Matrix& transition, const Vector& mode_prob0 = Vector());
+
+  /// disables IMM estimation (i.e., sub-system only changed by Switch)
+  void UnsetIMM() { do_imm_ = false; };
+
+  /// Get whether sub-system is estimated by IMM
+  bool do_imm() const { return do_imm_; };
+  /// Get per-step sub-system transition probabilities of IMM
+  const Matrix& imm_transition() const { return imm_transition_; };
+  /// Get probability of each sub-system (IMM)
+  const Vector& mode_prob() const { return mode_prob_; };
+  /// Get log-likelihood of latest measurement under each sub-system (IMM)
+  const Vector& mode_log_lik() const { return mode_log_lik_; };
+  /// Get probability-weighted state estimate (IMM)
+  const Vector& x_imm() const { return x_imm_; };
+  /// Get covariance of probability-weighted state estimate (IMM)
+  const Matrix& P_imm() const { return P_imm_; };
+
+  /// Get number of threads sub-systems are filtered across (IMM)
+  size_t n_threads() const { return pool_ ? pool_->n_threads() : 1; };
+
+  /**
+   * n.b., copies of the controller share these threads, so they must not be
+   * stepped concurrently.
+   *
+   * @brief      sets number of threads sub-systems are filtered across (IMM)
+   *
+   * @param      n_threads  number of threads (1 = serial, 0 = hardware
+   *                        concurrency)
+   */
+  void set_n_threads(size_t n_threads);
+
+  /**
+   * Solves the steady-state set-point problem of every sub-system up front
+   * (rather than on first use after switching to it), so that later switches
+   * do not incur this cost.
+   *
+   * @brief      precomputes set-point solutions of all sub-systems
+   */
+  void PrecomputeSetPoints();
+
+  /**
+   * Besides the active sub-system and controller state (see
+   * Controller::SaveSnapshot), saves every other sub-system with its gains
+   * and cached set-point solution.
+   *
+   * @brief      saves switched controller to snapshot
+   *
+   * @param      snap    snapshot
+   * @param      prefix  [optional] prefix of record names
+   */
+  void SaveSnapshot(Snapshot& snap,
+                    const std::string& prefix = "") const override;
+
+  /**
+   * n.b., the switched controller must have the number of sub-systems and
+   * their dimensions of the switched controller that was saved.
+   *
+   * @brief      restores switched controller from snapshot
+   *
+   * @param      snap    snapshot
+   * @param      prefix  [optional] prefix of record names
+   */
+  void LoadSnapshot(const Snapshot& snap,
+                    const std::string& prefix = "") override;
+
+  /// sets state feedback gains (of sub-systems sharing a state dimension)
   void set_Kc(const UniformMatrixList<>& Kc) {
-    Kc_list_ = Kc;
-    Kc_ = Kc_list_.at(0);  // set to first
-    if (idx_ != 0) {
-      Switch(idx_, true);
-    }
+    UniformMatrixList<> list = Kc;
+    set_Kc(std::move(list));
   };
   /// sets state feedback gains (moving)
   void set_Kc(UniformMatrixList<>&& Kc) {
-    Kc_list_ = std::move(Kc);
-    Kc_ = Kc_list_.at(0);  // set to first
-    if (idx_ != 0) {
-      Switch(idx_, true);
+    std::vector<Matrix> kc(Kc.size());
+    for (size_t k = 0; k < kc.size(); k++) {
+      kc[k] = Kc.at(k);
     }
+    set_Kc(UniformMatrixList<kMatFreeDim2>(std::move(kc)));
+  };
+  /// sets state feedback gains (n_u x n_x of each sub-system)
+  void set_Kc(const UniformMatrixList<kMatFreeDim2>& Kc) {
+    UniformMatrixList<kMatFreeDim2> list = Kc;
+    set_Kc(std::move(list));
+  };
+  /// sets state feedback gains (n_u x n_x of each sub-system, moving)
+  void set_Kc(UniformMatrixList<kMatFreeDim2>&& Kc) {
+    CheckKc(Kc);
+    LoadModes(Kc, &Mode::Kc, Kc_);
   };
 
   /// sets integral feedback gains
   void set_Kc_inty(const UniformMatrixList<>& Kc_inty) {
-    Kc_inty_list_ = Kc_inty;
-    Kc_inty_ = Kc_inty_list_.at(0);  // set to first
-    if (idx_ != 0) {
-      Switch(idx_, true);
-    }
+    UniformMatrixList<> list = Kc_inty;
+    LoadModes(list, &Mode::Kc_inty, Kc_inty_);
   };
   /// sets integral feedback gains (moving)
   void set_Kc_inty(UniformMatrixList<>&& Kc_inty) {
-    Kc_inty_list_ = std::move(Kc_inty);
-    Kc_inty_ = Kc_inty_list_.at(0);  // set to first
-    if (idx_ != 0) {
-      Switch(idx_, true);
-    }
+    LoadModes(Kc_inty, &Mode::Kc_inty, Kc_inty_);
   };
 
   /// sets input feedback gains
   void set_Kc_u(const UniformMatrixList<>& Kc_u) {
-    Kc_u_list_ = Kc_u;
-    Kc_u_ = Kc_u_list_.at(0);  // set to first
-    if (idx_ != 0) {
-      Switch(idx_, true);
-    }
+    UniformMatrixList<> list = Kc_u;
+    LoadModes(list, &Mode::Kc_u, Kc_u_);
   };
   /// sets input feedback gains (moving)
   void set_Kc_u(UniformMatrixList<>&& Kc_u) {
-    Kc_u_list_ = std::move(Kc_u);
-    Kc_u_ = Kc_u_list_.at(0);  // set to first
-    if (idx_ != 0) {
-      Switch(idx_, true);
-    }
+    LoadModes(Kc_u, &Mode::Kc_u, Kc_u_);
   };
 
   /// sets input gain used during controller design
   void set_g_design(const UniformVectorList& g) {
-    g_design_list_ = g;
-    g_design_ = g_design_list_.at(0);  // set to first
-    if (idx_ != 0) {
-      Switch(idx_, true);
-    }
+    UniformVectorList list = g;
+    LoadModes(list, &Mode::g_design, g_design_);
   };
   /// sets input gain used during controller design (moving)
   void set_g_design(UniformVectorList&& g) {
-    g_design_list_ = std::move(g);
-    g_design_ = g_design_list_.at(0);  // set to first
-    if (idx_ != 0) {
-      Switch(idx_, true);
-    }
+    LoadModes(g, &Mode::g_design, g_design_);
   };
 
   // make sure base class template methods available
@@ -164,18 +279,56 @@ class SwitchedController : public Controller<System> {
   using lds::Controller<System>::Print;
 
  protected:
-  std::vector<System>
-      systems_;     ///< underlying sub-systems which are switched between
+  // n.b., the sub-systems which are switched between are held by the
+  // controller (see ActiveSystem), so that switching does not move them
   size_t n_sys_{};  ///< number of systems
   size_t idx_{};    ///< current system/controller index.
 
-  // controller gains could be different for each
-  UniformMatrixList<> Kc_list_;
-  UniformMatrixList<> Kc_inty_list_;
-  UniformMatrixList<> Kc_u_list_;
+  /// Precomputed controller state of a sub-system (n.b., gains could be
+  /// different for each; state feedback gains are of each sub-system's state
+  /// dimension)
+  struct Mode {
+    Matrix Kc;                        ///< state feedback gain
+    Matrix Kc_inty;                   ///< integral feedback gain
+    Matrix Kc_u;                      ///< input feedback gain
+    Vector g_design;                  ///< design-phase input gain
+    Matrix setpoint_b;                ///< cached set-point solution (cx_ref)
+    Matrix setpoint_m;                ///< cached set-point solution (m)
+    size_t setpoint_revision{};       ///< system revision of set point
+    bool is_setpoint_cached = false;  ///< whether set point is cached
+    Matrix delay_a;                   ///< cached delay prediction (x)
+    Matrix delay_b;                   ///< cached delay prediction (u)
+    Matrix delay_m;                   ///< cached delay prediction (m)
+    size_t delay_revision{};          ///< system revision of prediction
+    bool is_delay_cached = false;     ///< whether prediction is cached
+    // n.b., of the sub-system's state dimension, so that switching does not
+    // reallocate them
+    Vector x_ref;   ///< reference state
+    Vector x_pred;  ///< scratch for delay prediction (n_x)
+    Vector tmp_x;   ///< scratch (n_x)
+    Vector tmp_xu;  ///< scratch for set point (n_x + n_u)
+    Vector x_imm;   ///< probability-weighted state estimate (IMM)
+    Matrix P_imm;   ///< covariance of weighted state estimate (IMM)
+  };
+
+  // n.b., the active sub-system's state lives in the Controller members, so
+  // element idx_ is a spare that is exchanged on the next switch.
+  std::vector<Mode> modes_;  ///< controller state of each sub-system
 
-  // design-phase input gain could also be different
-  UniformVectorList g_design_list_;
+  /// exchanges controller state of sub-system `idx` with the active state
+  void SwapMode(size_t idx);
+
+  /// copies list of gains into modes and activates that of current sub-system
+  template <typename List, typename T>
+  void LoadModes(List& list, T Mode::*field, T& active);
+
+  /// checks that state feedback gains are of dimensions of their sub-systems
+  void CheckKc(UniformMatrixList<kMatFreeDim2>& Kc);
+
+  // mapping of state between sub-systems (see set_state_map)
+  // n.b., element (to * n_sys + from); identity maps are not multiplied
+  std::vector<Matrix> state_maps_;  ///< mapping of state between sub-systems
+  std::vector<char> is_map_eye_;    ///< whether mapping is square identity
 
   // TODO(mfbolus): not sure why I need to do this.
   using Controller<System>::Kc_;
@@ -188,10 +341,109 @@ class SwitchedController : public Controller<System> {
   // using Controller<System>::y_ref_;
   //
   using Controller<System>::control_type_;
+  using Controller<System>::x_ref_;
+  using Controller<System>::x_pred_;
+  using Controller<System>::tmp_x_;
+  using Controller<System>::tmp_xu_;
+  using Controller<System>::setpoint_b_;
+  using Controller<System>::setpoint_m_;
+  using Controller<System>::setpoint_revision_;
+  using Controller<System>::is_setpoint_cached_;
+  using Controller<System>::delay_a_;
+  using Controller<System>::delay_b_;
+  using Controller<System>::delay_m_;
+  using Controller<System>::delay_revision_;
+  using Controller<System>::is_delay_cached_;
+  using Controller<System>::latency_;
+  using Controller<System>::monitor_;
+  using Controller<System>::model_swap_;
+  using Controller<System>::InvalidateSetPoint;
+  using Controller<System>::InvalidateDelayPrediction;
+  using Controller<System>::CalcSetPointSolution;
+
+  /// updates state estimate(s) given latest measurement (see set_imm)
+  void Estimate(const Vector& u_tm1, const Vector& z) override;
 
  private:
   void InitVars();
 
+  /**
+   * @brief      switches sub-system
+   *
+   * @param      idx              index
+   * @param      do_force_switch  whether to switch even if already there
+   * @param      do_carry_state   whether to set the state of the new
+   *                              sub-system to that of the old
+   */
+  void SwitchTo(size_t idx, bool do_force_switch, bool do_carry_state);
+
+  /// steps IMM estimator given latest measurement
+  void StepIMM(const Vector& u_tm1, const Vector& z);
+
+  /// Get sub-system `idx`
+  System& ModeSystem(size_t idx) { return sys_[idx]; };
+
+  /// maps state `x` of sub-system `from` into that of `to` (into `tmp` if
+  /// not the identity)
+  const Vector& MapState(size_t from, size_t to, const Vector& x,
+                         Vector& tmp) const {
+    size_t k = to * n_sys_ + from;
+    if (is_map_eye_[k]) {
+      return x;
+    }
+    tmp = state_maps_[k] * x;
+    return tmp;
+  };
+
+  /// adds covariance `P` of sub-system `from`, mapped into the state space of
+  /// `to` and weighted by `w`, to `out` (n.b., into preallocated scratch)
+  void AddMappedCov(size_t from, size_t to, data_t w, const Matrix& P,
+                    Matrix& out) {
+    size_t k = to * n_sys_ + from;
+    if (is_map_eye_[k]) {
+      out += w * P;
+      return;
+    }
+    const Matrix& map = state_maps_[k];
+    imm_map_p_[k] = map * P;
+    imm_pp_[to] = imm_map_p_[k] * map.t();
+    out += w * imm_pp_[to];
+  };
+
+  /// adds outer product of `dx`, weighted by `w`, to `out` (n.b., so that
+  /// nothing is allocated)
+  static void AddOuter(data_t w, const Vector& dx, Matrix& out) {
+    for (size_t c = 0; c < dx.n_elem; c++) {
+      data_t w_c = w * dx[c];
+      for (size_t r = 0; r < dx.n_elem; r++) {
+        out(r, c) += w_c * dx[r];
+      }
+    }
+  };
+
+  // interacting multiple model (IMM) estimator
+  bool do_imm_{};            ///< whether sub-system is estimated by IMM
+  Matrix imm_transition_;    ///< sub-system transition probabilities
+  Vector mode_prob_;         ///< probability of each sub-system
+  Vector mode_log_lik_;      ///< log-likelihood of measurement per sub-system
+  Vector imm_prob_pre_;      ///< predicted probability of each sub-system
+  Matrix imm_mix_;           ///< mixing weights (column j is into j)
+  std::vector<Vector> imm_x0_;  ///< mixed initial state of each sub-system
+  std::vector<Matrix> imm_P0_;  ///< mixed initial covariance of each
+  std::vector<Vector> imm_m0_;  ///< mixed initial disturbance of each
+  // n.b., scratch per sub-system (of its n_x), so that mapping between state
+  // spaces does not reallocate
+  std::vector<Vector> imm_dx_;  ///< scratch (n_x)
+  std::vector<Vector> imm_tx_;  ///< scratch (mapped state)
+  std::vector<Vector> imm_tm_;  ///< scratch (mapped disturbance)
+  std::vector<Matrix> imm_pp_;  ///< scratch (mapped covariance)
+  std::vector<Matrix> imm_map_p_;  ///< scratch (map * P, per state map)
+  Vector x_imm_;             ///< probability-weighted state estimate
+  Matrix P_imm_;             ///< covariance of weighted state estimate
+
+  // n.b., shared so that the controller remains copyable
+  std::shared_ptr<ThreadPool> pool_;  ///< threads (null if serial)
+
   using lds::Controller<System>::set_sys;
   // using Controller<System>::set_Kc;
   // using Controller<System>::set_Kc_inty;
@@ -203,8 +455,8 @@ template <typename System>
 inline SwitchedController<System>::SwitchedController(
     const std::vector<System>& systems, data_t u_lb, data_t u_ub,
     size_t control_type)
-    : Controller<System>(systems.at(0), u_lb, u_ub, control_type),
-      systems_(systems) {
+    : Controller<System>(std::vector<System>(systems), u_lb, u_ub,
+                         control_type) {
   InitVars();
 }
 
@@ -212,60 +464,485 @@ template <typename System>
 inline SwitchedController<System>::SwitchedController(
     std::vector<System>&& systems, data_t u_lb, data_t u_ub,
     size_t control_type)
-    : Controller<System>(System(systems.at(0).n_u(), systems.at(0).n_x(),
-                                systems.at(0).n_y(), systems.at(0).dt()),
-                         u_lb, u_ub, control_type),
-      systems_(std::move(systems)) {
+    : Controller<System>(std::move(systems), u_lb, u_ub, control_type) {
   InitVars();
 }
 
 template <typename System>
 inline void SwitchedController<System>::InitVars() {
-  n_sys_ = systems_.size();
-  sys_ = systems_.at(0);
+  n_sys_ = sys_.size();
+
+  state_maps_ = std::vector<Matrix>(n_sys_ * n_sys_);
+  is_map_eye_ = std::vector<char>(n_sys_ * n_sys_);
+  imm_map_p_ = std::vector<Matrix>(n_sys_ * n_sys_);
+  std::vector<Matrix> kc(n_sys_);
+  for (size_t k = 0; k < n_sys_; k++) {
+    const System& sys_k = sys_[k];
+    if ((sys_k.n_u() != sys_->n_u()) || (sys_k.n_y() != sys_->n_y())) {
+      throw std::runtime_error(
+          "SwitchedController sub-systems must share numbers of inputs and "
+          "outputs");
+    }
+    kc[k] = Matrix(sys_k.n_u(), sys_k.n_x(), fill::zeros);
+    for (size_t j = 0; j < n_sys_; j++) {
+      size_t n_x_j = sys_[j].n_x();
+      state_maps_[j * n_sys_ + k] = Matrix(n_x_j, sys_k.n_x(), fill::eye);
+      is_map_eye_[j * n_sys_ + k] = n_x_j == sys_k.n_x();
+      if (!is_map_eye_[j * n_sys_ + k]) {
+        imm_map_p_[j * n_sys_ + k] = Matrix(n_x_j, sys_k.n_x(), fill::zeros);
+      }
+    }
+  }
 
-  Kc_list_ = UniformMatrixList<>(std::vector<Matrix>(n_sys_, Kc_));
-  Kc_inty_list_ = UniformMatrixList<>(std::vector<Matrix>(n_sys_, Kc_inty_));
-  Kc_u_list_ = UniformMatrixList<>(std::vector<Matrix>(n_sys_, Kc_inty_));
-  g_design_list_ = UniformVectorList(std::vector<Vector>(n_sys_, g_design_));
+  Mode mode;
+  mode.Kc_inty = Kc_inty_;
+  mode.Kc_u = Kc_u_;
+  mode.g_design = g_design_;
+  modes_ = std::vector<Mode>(n_sys_, mode);
+  imm_dx_ = std::vector<Vector>(n_sys_);
+  imm_tx_ = std::vector<Vector>(n_sys_);
+  imm_tm_ = std::vector<Vector>(n_sys_);
+  imm_pp_ = std::vector<Matrix>(n_sys_);
+  for (size_t k = 0; k < n_sys_; k++) {
+    size_t n_x = sys_[k].n_x();
+    size_t n_u = sys_[k].n_u();
+    Mode& mode_k = modes_[k];
+    mode_k.Kc = kc[k];
+    mode_k.x_ref = Vector(n_x, fill::zeros);
+    mode_k.x_pred = Vector(n_x, fill::zeros);
+    mode_k.tmp_x = Vector(n_x, fill::zeros);
+    mode_k.tmp_xu = Vector(n_x + n_u, fill::zeros);
+    imm_dx_[k] = Vector(n_x, fill::zeros);
+    imm_tx_[k] = Vector(n_x, fill::zeros);
+    imm_tm_[k] = Vector(n_x, fill::zeros);
+    imm_pp_[k] = Matrix(n_x, n_x, fill::zeros);
+  }
 }
 
 template <typename System>
 inline void SwitchedController<System>::Switch(size_t idx,
                                                bool do_force_switch) {
+  // n.b., under IMM, each sub-system keeps its own estimate
+  SwitchTo(idx, do_force_switch, !do_imm_);
+}  // Switch
+
+template <typename System>
+inline void SwitchedController<System>::SwitchTo(size_t idx,
+                                                 bool do_force_switch,
+                                                 bool do_carry_state) {
   if ((idx == idx_) && !do_force_switch) {
     return;  // already there.
   }
+  if (idx >= n_sys_) {
+    throw std::runtime_error("SwitchedController index out of bounds");
+  }
+  if ((monitor_ || model_swap_) && (sys_[idx].n_x() != sys_->n_x())) {
+    throw std::runtime_error(
+        "SwitchedController cannot switch between sub-systems of different "
+        "state dimensions while a state monitor or model swap is attached");
+  }
+  LDSCTRLEST_LATENCY_SCOPE(latency_, kLatencySwitch);
+
+  if (idx != idx_) {
+    // n.b., O(1): sub-systems stay in place
+    sys_.Activate(idx);
+
+    // set the state of this system to that of the previous system (mapped
+    // into its state space; see set_state_map)
+    if (do_carry_state) {
+      const System& sys_prev = sys_[idx_];
+      sys_->set_m(MapState(idx_, idx, sys_prev.m(), imm_tm_[idx]), true);
+      sys_->set_x(MapState(idx_, idx, sys_prev.x(), imm_tx_[idx]));
+    }
 
-  // put old up and get new one out
-  systems_.at(idx_) = std::move(sys_);
-  sys_ = std::move(systems_.at(idx));
+    // reference state is carried into the new state space (n.b., into that
+    // sub-system's storage, exchanged below)
+    modes_[idx].x_ref = MapState(idx_, idx, x_ref_, imm_tx_[idx]);
+  }
 
-  // set the state of this system to that of the previous system
-  // TODO(mfbolus): This will only work as intended if state matrix is the same.
-  // See example fudge in 0.4 branch src/lds_poisson_sctrl.cpp.
-  sys_.set_m(systems_.at(idx_).m(), true);
-  sys_.set_x(systems_.at(idx_).x());
+  // exchange precomputed controller state (gains, set point, delay prediction)
+  // and storage of the sub-system's state dimension
+  // n.b., these are O(1) exchanges of memory rather than checked copies.
+  SwapMode(idx_);  // put old away
+  SwapMode(idx);   // get new out
 
-  // swap controller gains
-  Kc_list_.Swap(Kc_, idx_);
-  Kc_list_.Swap(Kc_, idx);
+  idx_ = idx;
+}  // SwitchTo
 
-  if (control_type_ & kControlTypeIntY) {
-    Kc_inty_list_.Swap(Kc_inty_, idx_);
-    Kc_inty_list_.Swap(Kc_inty_, idx);
+template <typename System>
+inline void SwitchedController<System>::set_state_map(size_t from, size_t to,
+                                                      const Matrix& map) {
+  if ((from >= n_sys_) || (to >= n_sys_)) {
+    throw std::runtime_error("SwitchedController index out of bounds");
+  }
+  if ((map.n_rows != ModeSystem(to).n_x()) ||
+      (map.n_cols != ModeSystem(from).n_x())) {
+    throw std::runtime_error(
+        "SwitchedController state map must be n_x (to) x n_x (from)");
   }
+  size_t k = to * n_sys_ + from;
+  state_maps_[k] = map;
+  is_map_eye_[k] = (map.n_rows == map.n_cols) &&
+                   arma::approx_equal(
+                       map, Matrix(map.n_rows, map.n_cols, fill::eye),
+                       "absdiff", 0);
+  // n.b., scratch of mapped covariance (see AddMappedCov)
+  if (is_map_eye_[k]) {
+    imm_map_p_[k].reset();
+  } else {
+    imm_map_p_[k] = Matrix(map.n_rows, map.n_cols, fill::zeros);
+  }
+}
 
-  if (control_type_ & kControlTypeDeltaU) {
-    Kc_u_list_.Swap(Kc_u_, idx_);
-    Kc_u_list_.Swap(Kc_u_, idx);
+template <typename System>
+inline void SwitchedController<System>::CheckKc(
+    UniformMatrixList<kMatFreeDim2>& Kc) {
+  if (Kc.size() != n_sys_) {
+    throw std::runtime_error(
+        "number of SwitchedController gains must match number of systems");
+  }
+  for (size_t k = 0; k < n_sys_; k++) {
+    const System& sys_k = ModeSystem(k);
+    if ((Kc.at(k).n_rows != sys_k.n_u()) || (Kc.at(k).n_cols != sys_k.n_x())) {
+      throw std::runtime_error(
+          "SwitchedController state feedback gains must be n_u x n_x of "
+          "their sub-systems");
+    }
   }
+}
 
-  g_design_list_.Swap(g_design_, idx_);
-  g_design_list_.Swap(g_design_, idx);
+template <typename System>
+inline void SwitchedController<System>::set_imm(const Matrix& transition,
+                                                const Vector& mode_prob0) {
+  if ((transition.n_rows != n_sys_) || (transition.n_cols != n_sys_)) {
+    throw std::runtime_error(
+        "IMM transition matrix must be n_sys x n_sys");
+  }
+  // n.b., tolerance allows for rounding of user-supplied probabilities
+  const data_t tol = 1e-4;
+  Vector row_sums = arma::sum(transition, 1);
+  if (transition.min() < 0 ||
+      arma::any(arma::abs(row_sums - 1) > tol)) {
+    throw std::runtime_error(
+        "IMM transition matrix rows must be probabilities (summing to 1)");
+  }
 
-  idx_ = idx;
-}  // Switch
+  Vector mode_prob(n_sys_);
+  if (mode_prob0.n_elem == 0) {
+    mode_prob.fill(data_t(1) / n_sys_);
+  } else {
+    if (mode_prob0.n_elem != n_sys_ || mode_prob0.min() < 0 ||
+        std::abs(arma::accu(mode_prob0) - 1) > tol) {
+      throw std::runtime_error(
+          "IMM initial mode probabilities must be n_sys probabilities "
+          "(summing to 1)");
+    }
+    mode_prob = mode_prob0;
+  }
+
+  imm_transition_ = transition;
+  imm_transition_.each_col() /= row_sums;
+  mode_prob_ = mode_prob / arma::accu(mode_prob);
+  mode_log_lik_ = Vector(n_sys_, fill::zeros);
+  imm_prob_pre_ = mode_prob_;
+  imm_mix_ = Matrix(n_sys_, n_sys_, fill::zeros);
+
+  imm_x0_ = std::vector<Vector>(n_sys_);
+  imm_P0_ = std::vector<Matrix>(n_sys_);
+  imm_m0_ = std::vector<Vector>(n_sys_);
+  for (size_t j = 0; j < n_sys_; j++) {
+    size_t n_x = ModeSystem(j).n_x();
+    imm_x0_[j] = Vector(n_x, fill::zeros);
+    imm_P0_[j] = Matrix(n_x, n_x, fill::zeros);
+    imm_m0_[j] = Vector(n_x, fill::zeros);
+  }
+  x_imm_ = sys_->x();
+  P_imm_ = sys_->P();
+  for (size_t j = 0; j < n_sys_; j++) {
+    if (j != idx_) {
+      size_t n_x = ModeSystem(j).n_x();
+      modes_[j].x_imm = Vector(n_x, fill::zeros);
+      modes_[j].P_imm = Matrix(n_x, n_x, fill::zeros);
+    }
+  }
+  do_imm_ = true;
+}
+
+template <typename System>
+inline void SwitchedController<System>::set_n_threads(size_t n_threads) {
+  if (n_threads == 1) {
+    pool_.reset();
+  } else {
+    pool_ = std::make_shared<ThreadPool>(n_threads);
+  }
+}
+
+template <typename System>
+inline void SwitchedController<System>::Estimate(const Vector& u_tm1,
+                                                 const Vector& z) {
+  if (do_imm_) {
+    StepIMM(u_tm1, z);
+  } else {
+    sys_->Filter(u_tm1, z);
+  }
+}
+
+template <typename System>
+inline void SwitchedController<System>::StepIMM(const Vector& u_tm1,
+                                                const Vector& z) {
+  // predicted mode probabilities, c_j = sum_i T(i,j) mu_i, and mixing weights,
+  // mu_(i|j) = T(i,j) mu_i / c_j
+  imm_prob_pre_ = imm_transition_.t() * mode_prob_;
+  for (size_t j = 0; j < n_sys_; j++) {
+    for (size_t i = 0; i < n_sys_; i++) {
+      imm_mix_(i, j) =
+          imm_prob_pre_[j] > 0
+              ? imm_transition_(i, j) * mode_prob_[i] / imm_prob_pre_[j]
+              : data_t(i == j);
+    }
+  }
+
+  // mix initial estimates (n.b., all from estimates before any are filtered,
+  // each mapped into the state space of the sub-system mixed into)
+  for (size_t j = 0; j < n_sys_; j++) {
+    imm_x0_[j].zeros();
+    imm_m0_[j].zeros();
+    for (size_t i = 0; i < n_sys_; i++) {
+      if (imm_mix_(i, j) > 0) {
+        const System& sys_i = ModeSystem(i);
+        imm_x0_[j] += imm_mix_(i, j) * MapState(i, j, sys_i.x(), imm_tx_[j]);
+        imm_m0_[j] += imm_mix_(i, j) * MapState(i, j, sys_i.m(), imm_tm_[j]);
+      }
+    }
+    imm_P0_[j].zeros();
+    for (size_t i = 0; i < n_sys_; i++) {
+      if (imm_mix_(i, j) > 0) {
+        const System& sys_i = ModeSystem(i);
+        Vector& dx = imm_dx_[j];
+        dx = MapState(i, j, sys_i.x(), imm_tx_[j]);
+        dx -= imm_x0_[j];
+        AddMappedCov(i, j, imm_mix_(i, j), sys_i.P(), imm_P0_[j]);
+        AddOuter(imm_mix_(i, j), dx, imm_P0_[j]);
+      }
+    }
+  }
+
+  // filter each sub-system from its mixed estimate
+  // n.b., sub-systems are disjoint, so they may be filtered in parallel
+  auto filter_chunk = [&](size_t j_begin, size_t j_end) {
+    for (size_t j = j_begin; j < j_end; j++) {
+      System& sys_j = ModeSystem(j);
+      sys_j.set_x(imm_x0_[j]);
+      sys_j.set_P(imm_P0_[j]);
+      if (sys_j.do_adapt_m) {
+        sys_j.set_m(imm_m0_[j], true);
+      }
+      mode_log_lik_[j] = sys_j.PredictiveLogLik(u_tm1, z);
+      sys_j.Filter(u_tm1, z);
+    }
+  };
+  if (pool_) {
+    pool_->ParallelFor(n_sys_, filter_chunk);
+  } else {
+    filter_chunk(0, n_sys_);
+  }
+
+  // update mode probabilities, mu_j ~ c_j L_j
+  // n.b., in logs relative to the most likely, so that they do not underflow
+  data_t log_max = -kInf;
+  for (size_t j = 0; j < n_sys_; j++) {
+    if (imm_prob_pre_[j] > 0 && !std::isnan(mode_log_lik_[j])) {
+      log_max = std::max(log_max,
+                         mode_log_lik_[j] + std::log(imm_prob_pre_[j]));
+    }
+  }
+  if (std::isfinite(log_max)) {
+    for (size_t j = 0; j < n_sys_; j++) {
+      bool is_valid = imm_prob_pre_[j] > 0 && !std::isnan(mode_log_lik_[j]);
+      mode_prob_[j] =
+          is_valid ? std::exp(mode_log_lik_[j] + std::log(imm_prob_pre_[j]) -
+                              log_max)
+                   : 0;
+    }
+    mode_prob_ /= arma::accu(mode_prob_);
+  } else {
+    // measurement is uninformative about sub-system (e.g., none could score
+    // it), so keep predicted probabilities
+    mode_prob_ = imm_prob_pre_;
+  }
+
+  // control with most probable sub-system (n.b., only on a strict gain, so
+  // that ties do not flap)
+  size_t idx = mode_prob_.index_max();
+  if (mode_prob_[idx] > mode_prob_[idx_]) {
+    SwitchTo(idx, false, false);
+  }
+
+  // probability-weighted estimate (in the state space of the active one)
+  // n.b., storage is of the active state dimension (see SwapMode)
+  Vector& tx = imm_tx_[idx_];
+  Vector& dx = imm_dx_[idx_];
+  x_imm_.zeros();
+  for (size_t j = 0; j < n_sys_; j++) {
+    x_imm_ += mode_prob_[j] * MapState(j, idx_, ModeSystem(j).x(), tx);
+  }
+  P_imm_.zeros();
+  for (size_t j = 0; j < n_sys_; j++) {
+    const System& sys_j = ModeSystem(j);
+    dx = MapState(j, idx_, sys_j.x(), tx);
+    dx -= x_imm_;
+    AddMappedCov(j, idx_, mode_prob_[j], sys_j.P(), P_imm_);
+    AddOuter(mode_prob_[j], dx, P_imm_);
+  }
+}
+
+template <typename System>
+inline void SwitchedController<System>::SwapMode(size_t idx) {
+  Mode& mode = modes_[idx];
+  Kc_.swap(mode.Kc);
+  Kc_inty_.swap(mode.Kc_inty);
+  Kc_u_.swap(mode.Kc_u);
+  g_design_.swap(mode.g_design);
+  setpoint_b_.swap(mode.setpoint_b);
+  setpoint_m_.swap(mode.setpoint_m);
+  std::swap(setpoint_revision_, mode.setpoint_revision);
+  std::swap(is_setpoint_cached_, mode.is_setpoint_cached);
+  delay_a_.swap(mode.delay_a);
+  delay_b_.swap(mode.delay_b);
+  delay_m_.swap(mode.delay_m);
+  std::swap(delay_revision_, mode.delay_revision);
+  std::swap(is_delay_cached_, mode.is_delay_cached);
+  x_ref_.swap(mode.x_ref);
+  x_pred_.swap(mode.x_pred);
+  tmp_x_.swap(mode.tmp_x);
+  tmp_xu_.swap(mode.tmp_xu);
+  x_imm_.swap(mode.x_imm);
+  P_imm_.swap(mode.P_imm);
+}
+
+template <typename System>
+template <typename List, typename T>
+inline void SwitchedController<System>::LoadModes(List& list, T Mode::*field,
+                                                  T& active) {
+  if (list.size() != n_sys_) {
+    throw std::runtime_error(
+        "number of SwitchedController gains must match number of systems");
+  }
+  for (size_t k = 0; k < n_sys_; k++) {
+    modes_[k].*field = list.at(k);
+  }
+  active.swap(modes_[idx_].*field);
+}
+
+template <typename System>
+inline void SwitchedController<System>::SaveSnapshot(
+    Snapshot& snap, const std::string& prefix) const {
+  Controller<System>::SaveSnapshot(snap, prefix);
+  snap.Set(prefix + "n_sys", n_sys_);
+  snap.Set(prefix + "idx", idx_);
+
+  // n.b., the active sub-system and mode are saved as the controller's
+  for (size_t k = 0; k < n_sys_; k++) {
+    if (k == idx_) {
+      continue;
+    }
+    std::string prefix_k = prefix + "mode" + std::to_string(k) + ".";
+    sys_[k].SaveSnapshot(snap, prefix_k + "sys.");
+
+    const Mode& mode = modes_[k];
+    snap.Set(prefix_k + "Kc", mode.Kc);
+    snap.Set(prefix_k + "Kc_inty", mode.Kc_inty);
+    snap.Set(prefix_k + "Kc_u", mode.Kc_u);
+    snap.Set(prefix_k + "g_design", mode.g_design);
+    bool is_setpoint_valid =
+        mode.is_setpoint_cached &&
+        (mode.setpoint_revision == sys_[k].revision());
+    snap.Set(prefix_k + "is_setpoint_cached", is_setpoint_valid);
+    if (is_setpoint_valid) {
+      snap.Set(prefix_k + "setpoint_b", mode.setpoint_b);
+      snap.Set(prefix_k + "setpoint_m", mode.setpoint_m);
+    }
+  }
+
+  // n.b., only mappings other than the identity
+  for (size_t k = 0; k < state_maps_.size(); k++) {
+    if (!is_map_eye_[k]) {
+      snap.Set(prefix + "state_map" + std::to_string(k), state_maps_[k]);
+    }
+  }
+
+  snap.Set(prefix + "do_imm", do_imm_);
+  if (do_imm_) {
+    snap.Set(prefix + "imm_transition", imm_transition_);
+    snap.Set(prefix + "mode_prob", mode_prob_);
+  }
+}
+
+template <typename System>
+inline void SwitchedController<System>::LoadSnapshot(
+    const Snapshot& snap, const std::string& prefix) {
+  if (snap.GetScalar(prefix + "n_sys") != n_sys_) {
+    throw std::runtime_error(
+        "number of sub-systems of snapshot does not match that of "
+        "SwitchedController");
+  }
+  // n.b., switch first, so that the active sub-system/mode is the saved one's
+  SwitchTo(static_cast<size_t>(snap.GetScalar(prefix + "idx")), false, false);
+  Controller<System>::LoadSnapshot(snap, prefix);
+
+  for (size_t k = 0; k < n_sys_; k++) {
+    if (k == idx_) {
+      continue;
+    }
+    std::string prefix_k = prefix + "mode" + std::to_string(k) + ".";
+    sys_[k].LoadSnapshot(snap, prefix_k + "sys.");
+
+    Mode& mode = modes_[k];
+    mode.Kc = snap.Get(prefix_k + "Kc");
+    mode.Kc_inty = snap.Get(prefix_k + "Kc_inty");
+    mode.Kc_u = snap.Get(prefix_k + "Kc_u");
+    mode.g_design = snap.Get(prefix_k + "g_design");
+    mode.is_setpoint_cached =
+        snap.GetScalar(prefix_k + "is_setpoint_cached") != 0;
+    if (mode.is_setpoint_cached) {
+      mode.setpoint_b = snap.Get(prefix_k + "setpoint_b");
+      mode.setpoint_m = snap.Get(prefix_k + "setpoint_m");
+      mode.setpoint_revision = sys_[k].revision();
+    }
+  }
+
+  for (size_t k = 0; k < state_maps_.size(); k++) {
+    size_t from = k % n_sys_;
+    size_t to = k / n_sys_;
+    std::string name = prefix + "state_map" + std::to_string(k);
+    if (snap.Has(name)) {
+      set_state_map(from, to, snap.Get(name));
+    } else {
+      set_state_map(from, to,
+                    Matrix(ModeSystem(to).n_x(), ModeSystem(from).n_x(),
+                           fill::eye));
+    }
+  }
+
+  // n.b., snapshots from before IMM have no record of it
+  if (snap.Has(prefix + "do_imm") && snap.GetScalar(prefix + "do_imm") != 0) {
+    Vector mode_prob = snap.Get(prefix + "mode_prob");
+    set_imm(snap.Get(prefix + "imm_transition"), mode_prob);
+  } else {
+    UnsetIMM();
+  }
+}
+
+template <typename System>
+inline void SwitchedController<System>::PrecomputeSetPoints() {
+  size_t idx_orig = idx_;
+  // n.b., sub-system states are left alone
+  for (size_t k = 0; k < n_sys_; k++) {
+    SwitchTo(k, false, false);
+    CalcSetPointSolution();
+  }
+  SwitchTo(idx_orig, false, false);
+}
 
 }  // namespace lds
 
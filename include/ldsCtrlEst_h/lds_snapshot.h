@@ -0,0 +1,167 @@
+//===-- ldsCtrlEst_h/lds_snapshot.h - Binary Snapshot -----------*- C++ -*-===//
+//
+// Copyright 2021 Michael Bolus
+// Copyright 2021 Georgia Institute of Technology
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file declares a type holding named parameters/state of systems and
+/// controllers, along with a compact binary file format by which they are
+/// saved and restored (`lds::Snapshot`).
+///
+/// A snapshot file consists of (in native byte order):
+///
+/// 1. a header: magic "LDSSNAP\0", format version (uint32), byte-order mark
+///    (uint32), size of data_t in bytes (uint32), padding (uint32), number of
+///    records (uint64), and number of data_t elements (uint64);
+/// 2. a table of records: name (null-padded, kSnapshotNameLen bytes), then
+///    offset into data (in elements), number of rows, columns, and slices
+///    (uint64 each);
+/// 3. the data (data_t, column-major, 8-byte aligned).
+///
+/// The data section is read by a single read (or may be memory-mapped), and
+/// each record is a contiguous block within it.
+///
+/// \brief binary snapshot
+//===----------------------------------------------------------------------===//
+
+#ifndef LDSCTRLEST_LDS_SNAPSHOT_H
+#define LDSCTRLEST_LDS_SNAPSHOT_H
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "lds.h"
+
+namespace lds {
+
+const std::uint32_t kSnapshotVersion = 1;  ///< version of snapshot format
+const size_t kSnapshotNameLen = 48;  ///< bytes per record name (incl. null)
+
+/// Binary Snapshot Type
+class Snapshot {
+ public:
+  /**
+   * @brief      Constructs a new (empty) Snapshot.
+   */
+  Snapshot() = default;
+
+  /**
+   * @brief      Constructs a Snapshot by loading a file (see Load).
+   *
+   * @param      path  path to snapshot file
+   */
+  explicit Snapshot(const std::string& path) { Load(path); };
+
+  /**
+   * @brief      saves snapshot to file
+   *
+   * @param      path  path to snapshot file
+   */
+  void Save(const std::string& path) const;
+
+  /**
+   * Replaces the contents of this snapshot with those of a file. Throws if
+   * the file is not a snapshot, is of a newer format version, or was written
+   * with a different byte order or precision (data_t).
+   *
+   * @brief      loads snapshot from file
+   *
+   * @param      path  path to snapshot file
+   */
+  void Load(const std::string& path);
+
+  /**
+   * @brief      sets (or replaces) a named matrix
+   *
+   * @param      name  name (< kSnapshotNameLen characters)
+   * @param      mat   matrix
+   */
+  void Set(const std::string& name, const Matrix& mat);
+  /// sets (or replaces) a named cube
+  void Set(const std::string& name, const Cube& cube);
+  /// sets (or replaces) a named scalar
+  void Set(const std::string& name, data_t scalar) {
+    Set(name, Matrix(1, 1).fill(scalar));
+  };
+
+  /**
+   * @brief      gets a named matrix (throws if absent)
+   *
+   * @param      name  name
+   *
+   * @return     matrix
+   */
+  Matrix Get(const std::string& name) const;
+  /**
+   * @brief      copies a named matrix into an existing matrix in place
+   *             (throws if absent or of another size)
+   *
+   * @param      name  name
+   * @param      mat   matrix
+   */
+  void Get(const std::string& name, Matrix& mat) const;
+  /// gets a named cube (throws if absent)
+  Cube GetCube(const std::string& name) const;
+  /// gets a named scalar (throws if absent or not 1x1)
+  data_t GetScalar(const std::string& name) const;
+
+  /// gets whether snapshot has a named record
+  bool Has(const std::string& name) const {
+    return records_.find(name) != records_.end();
+  };
+  /// gets number of records
+  size_t size() const { return records_.size(); };
+  /// removes all records
+  void Clear() {
+    records_.clear();
+    data_.clear();
+  };
+
+ private:
+  /// Location of a record in data
+  struct Record {
+    size_t offset{};    ///< offset into data (elements)
+    size_t n_rows{};    ///< number of rows
+    size_t n_cols{};    ///< number of columns
+    size_t n_slices{};  ///< number of slices
+  };
+
+  /**
+   * @brief      reserves space in data for a named record
+   *
+   * @param      name      name
+   * @param      n_rows    number of rows
+   * @param      n_cols    number of columns
+   * @param      n_slices  number of slices
+   *
+   * @return     pointer to data of record
+   */
+  data_t* Reserve(const std::string& name, size_t n_rows, size_t n_cols,
+                  size_t n_slices);
+
+  /// finds a named record (throws if absent)
+  const Record& Find(const std::string& name) const;
+
+  std::map<std::string, Record> records_;  ///< records (by name)
+  std::vector<data_t> data_;               ///< data of all records
+};
+
+}  // namespace lds
+
+#endif
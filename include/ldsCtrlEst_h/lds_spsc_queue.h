@@ -0,0 +1,117 @@
+//===-- ldsCtrlEst_h/lds_spsc_queue.h - SPSC Queue --------------*- C++ -*-===//
+//
+// Copyright 2021 Michael Bolus
+// Copyright 2021 Georgia Institute of Technology
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file declares and defines a bounded, lock-free,
+/// single-producer/single-consumer ring buffer (`lds::SpscQueue`). Slots are
+/// allocated once at construction from a prototype element, so that pushing
+/// and popping same-sized Armadillo objects only copies into existing memory.
+///
+/// \brief SPSC ring buffer
+//===----------------------------------------------------------------------===//
+
+#ifndef LDSCTRLEST_LDS_SPSC_QUEUE_H
+#define LDSCTRLEST_LDS_SPSC_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+namespace lds {
+
+/// Bounded lock-free single-producer/single-consumer queue
+template <typename T>
+class SpscQueue {
+ public:
+  /**
+   * @brief      Constructs a new SpscQueue.
+   *
+   * @param      capacity   maximum number of queued elements
+   * @param      prototype  [optional] element used to preallocate slots
+   */
+  explicit SpscQueue(std::size_t capacity, const T& prototype = T())
+      : slots_(capacity + 1, prototype) {
+    if (capacity == 0) {
+      throw std::runtime_error("SpscQueue capacity must be positive");
+    }
+  }
+
+  SpscQueue(const SpscQueue&) = delete;
+  SpscQueue& operator=(const SpscQueue&) = delete;
+
+  /**
+   * @brief      pushes element (producer thread only)
+   *
+   * @param      el    element
+   *
+   * @return     whether there was room in the queue
+   */
+  bool Push(const T& el) {
+    std::size_t tail = tail_.load(std::memory_order_relaxed);
+    std::size_t next = Next(tail);
+    if (next == head_.load(std::memory_order_acquire)) {
+      return false;  // full
+    }
+    slots_[tail] = el;
+    tail_.store(next, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * @brief      pops element (consumer thread only)
+   *
+   * @param      el    [out] element
+   *
+   * @return     whether there was an element in the queue
+   */
+  bool Pop(T& el) {
+    std::size_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire)) {
+      return false;  // empty
+    }
+    el = slots_[head];
+    head_.store(Next(head), std::memory_order_release);
+    return true;
+  }
+
+  /// Get whether queue is empty (approximate if called concurrently)
+  bool empty() const {
+    return head_.load(std::memory_order_acquire) ==
+           tail_.load(std::memory_order_acquire);
+  }
+
+  /// Get capacity of queue
+  std::size_t capacity() const { return slots_.size() - 1; };
+
+ private:
+  std::size_t Next(std::size_t k) const {
+    return (k + 1 == slots_.size()) ? 0 : k + 1;
+  }
+
+  // n.b., head/tail on separate cache lines to avoid false sharing between
+  // producer and consumer
+  std::vector<T> slots_;                          ///< preallocated slots
+  alignas(64) std::atomic<std::size_t> head_{0};  ///< next slot to pop
+  alignas(64) std::atomic<std::size_t> tail_{0};  ///< next slot to push
+};
+
+}  // namespace lds
+
+#endif
@@ -0,0 +1,191 @@
+//===-- ldsCtrlEst_h/lds_state_monitor.h - State Monitor --------*- C++ -*-===//
+//
+// Copyright 2021 Michael Bolus
+// Copyright 2021 Georgia Institute of Technology
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file declares a type through which the state of a system or
+/// controller is published by the thread stepping it (e.g., a real-time
+/// control thread) and read consistently by any number of other threads
+/// (e.g., GUI, logging) without either ever blocking the other
+/// (`lds::StateMonitor`).
+///
+/// \brief state monitor (seqlock)
+//===----------------------------------------------------------------------===//
+
+#ifndef LDSCTRLEST_LDS_STATE_MONITOR_H
+#define LDSCTRLEST_LDS_STATE_MONITOR_H
+
+// namespace
+#include "lds.h"
+// system type
+#include "lds_sys.h"
+
+#include <atomic>
+#include <memory>
+
+namespace lds {
+
+/// Fields of state published to a StateMonitor (bit mask)
+enum MonitorField : size_t {
+  kMonitorU = 0x1,      ///< control signal (as returned to user)
+  kMonitorX = 0x2,      ///< state estimate
+  kMonitorP = 0x4,      ///< covariance of state estimate
+  kMonitorY = 0x8,      ///< output estimate
+  kMonitorM = 0x10,     ///< process disturbance estimate
+  kMonitorURef = 0x20,  ///< reference input
+  kMonitorXRef = 0x40,  ///< reference state
+  kMonitorYRef = 0x80,  ///< reference output
+  kMonitorAll = 0xff,   ///< all of the above
+};
+
+/// Consistent copy of state read from a StateMonitor
+struct MonitorState {
+  size_t k{};    ///< number of steps published before this one
+  Vector u;      ///< control signal (as returned to user)
+  Vector x;      ///< state estimate
+  Matrix P;      ///< covariance of state estimate
+  Vector y;      ///< output estimate
+  Vector m;      ///< process disturbance estimate
+  Vector u_ref;  ///< reference input
+  Vector x_ref;  ///< reference state
+  Vector y_ref;  ///< reference output
+};
+
+/// Single-Writer, Multiple-Reader State Monitor Type
+class StateMonitor {
+ public:
+  /**
+   * Publishing never waits on readers, and the space for published state is
+   * allocated here, so it does not allocate either. Readers retry (or, see
+   * TryRead, give up) when they overlap a publication.
+   *
+   * n.b., published words are std::atomic<data_t> (accessed with relaxed
+   * ordering, i.e., plain loads/stores where that is lock-free, e.g.,
+   * x86-64 and AArch64), so that the protocol is free of data races.
+   *
+   * @brief      Constructs a new StateMonitor.
+   *
+   * @param      n_u     number of inputs
+   * @param      n_x     number of states
+   * @param      n_y     number of outputs
+   * @param      fields  [optional] fields published (MonitorField bit mask)
+   */
+  StateMonitor(size_t n_u, size_t n_x, size_t n_y,
+               size_t fields = kMonitorAll);
+
+  StateMonitor(const StateMonitor&) = delete;
+  StateMonitor& operator=(const StateMonitor&) = delete;
+
+  /**
+   * @brief      publishes state of a system (publishing thread only)
+   *
+   * n.b., control fields (u, u_ref, x_ref, y_ref) are published as zeros.
+   * Throws (without publishing) if a published field is not of the
+   * dimensions of the monitor.
+   *
+   * @param      sys   system
+   */
+  void Publish(const System& sys);
+
+  /**
+   * @brief      publishes state of a controller (publishing thread only)
+   *
+   * n.b., throws (without publishing) if a published field is not of the
+   * dimensions of the monitor.
+   *
+   * @param      sys    system of controller
+   * @param      u      control signal
+   * @param      u_ref  reference input
+   * @param      x_ref  reference state
+   * @param      y_ref  reference output
+   */
+  void Publish(const System& sys, const Vector& u, const Vector& u_ref,
+               const Vector& x_ref, const Vector& y_ref);
+
+  /**
+   * Makes a single attempt at reading, which fails if it overlaps a
+   * publication (or nothing has been published yet), so it returns in
+   * bounded time. Only the published fields of `state` are written (and
+   * only allocated if they are not already of the right size).
+   *
+   * @brief      tries to read a consistent copy of published state
+   *
+   * @param      state  [out] state
+   *
+   * @return     whether state is a consistent copy
+   */
+  bool TryRead(MonitorState& state) const;
+
+  /**
+   * @brief      reads a consistent copy of published state, retrying while
+   *             reads overlap publications
+   *
+   * @param      state  [out] state
+   *
+   * @return     whether anything has been published
+   */
+  bool Read(MonitorState& state) const;
+
+  /// gets number of steps published
+  size_t n_published() const {
+    return seq_.load(std::memory_order_acquire) / 2;
+  };
+  /// gets fields published (MonitorField bit mask)
+  size_t fields() const { return fields_; };
+  /// gets number of inputs
+  size_t n_u() const { return n_u_; };
+  /// gets number of states
+  size_t n_x() const { return n_x_; };
+  /// gets number of outputs
+  size_t n_y() const { return n_y_; };
+
+ private:
+  static const size_t kNumFields = 8;  ///< number of MonitorField fields
+
+  /// starts a publication (n.b., sequence is odd while publishing)
+  void BeginWrite();
+  /// ends a publication
+  void EndWrite();
+  // n.b., fields are indexed by the position of their MonitorField bit
+  /// checks that `mat` is of the size of field `idx` (if published)
+  void CheckSize(size_t idx, const Matrix& mat) const;
+  /// writes field `idx` (if published)
+  void Store(size_t idx, const data_t* mem);
+  /// writes field `idx` as zeros (if published)
+  void StoreZeros(size_t idx);
+  /// reads field `idx` (if published), sizing out as n_rows x n_cols
+  void Load(size_t idx, size_t n_rows, size_t n_cols, Matrix& out) const;
+  /// reads vector field `idx` (if published)
+  void Load(size_t idx, Vector& out) const;
+
+  size_t n_u_{};     ///< number of inputs
+  size_t n_x_{};     ///< number of states
+  size_t n_y_{};     ///< number of outputs
+  size_t fields_{};  ///< fields published
+
+  size_t offsets_[kNumFields]{};  ///< offset of each field (words)
+  size_t sizes_[kNumFields]{};    ///< size of each field (words, 0 = absent)
+  std::unique_ptr<std::atomic<data_t>[]> words_;  ///< published state
+
+  // n.b., on its own cache line, as it is polled by readers
+  alignas(64) std::atomic<size_t> seq_{0};  ///< sequence (odd = publishing)
+};
+
+}  // namespace lds
+
+#endif
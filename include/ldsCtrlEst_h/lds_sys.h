@@ -30,6 +30,9 @@
 #define LDSCTRLEST_LDS_SYS_H
 
 #include "lds.h"
+// latency profiling
+#include "lds_latency.h"
+#include "lds_snapshot.h"
 
 namespace lds {
 /// Linear Dynamical System Type
@@ -74,6 +77,21 @@ class System {
    */
   virtual const Vector& Simulate(const Vector& u_tm1) = 0;
 
+  /**
+   * Scores a measurement under the one-step-ahead prediction from the current
+   * estimate (i.e., before it is assimilated by Filter), without changing the
+   * estimate, e.g., to weigh sub-systems against one another (see
+   * SwitchedController::set_imm).
+   *
+   * @brief      log-likelihood of measurement given prediction
+   *
+   * @param      u_tm1  input at t-minus-1
+   * @param      z      current measurement
+   *
+   * @return     log-likelihood
+   */
+  virtual data_t PredictiveLogLik(const Vector& u_tm1, const Vector& z) = 0;
+
   /**
    * @brief      system dynamics function
    *
@@ -81,7 +99,14 @@ class System {
    * @param      do_add_noise  whether to add simulated process noise
    */
   void f(const Vector& u, bool do_add_noise = false) {
-    x_ = A_ * x_ + B_ * (g_ % u) + m_;
+    // n.b., evaluated in place with preallocated scratch so that this does not
+    // allocate (x_ = A_ * x_ + B_ * (g_ % u) + m_)
+    LDSCTRLEST_LATENCY_SCOPE(latency_, kLatencyF);
+    tmp_u_ = g_ % u;
+    tmp_x_ = m_;
+    tmp_x_ += A_ * x_;
+    tmp_x_ += B_ * tmp_u_;
+    x_ = tmp_x_;
     if (do_add_noise) {
       x_ += arma::mvnrnd(Vector(n_x_).fill(0), Q_);
     }
@@ -129,14 +154,27 @@ class System {
   const Matrix& C() const { return C_; };
   /// Get output bias
   const Vector& d() const { return d_; };
+  /// Get process noise covariance
+  const Matrix& Q() const { return Q_; };
   /// Get estimator gain
   const Matrix& Ke() const { return Ke_; };
   /// Get estimator gain for process disturbance (m)
   const Matrix& Ke_m() const { return Ke_m_; };
+  /// Get method of updating state estimate covariance
+  CovUpdateType cov_update() const { return cov_update_; };
+  /// Get revision of parameters A, B, g, C, Q, Q_m (incremented whenever one
+  /// is set, e.g., so that quantities derived from them can be invalidated)
+  size_t revision() const { return revision_; };
   /// Set state matrix
-  void set_A(const Matrix& A) { Reassign(A_, A); };
+  void set_A(const Matrix& A) {
+    Reassign(A_, A);
+    revision_++;
+  };
   /// Set input matrix
-  void set_B(const Matrix& B) { Reassign(B_, B); };
+  void set_B(const Matrix& B) {
+    Reassign(B_, B);
+    revision_++;
+  };
   /// Set process disturbance
   void set_m(const Vector& m, bool do_force_assign=false) {
     Reassign(m0_, m);
@@ -145,19 +183,33 @@ class System {
     }
   };
   /// Set input gain
-  void set_g(const Vector& g) { Reassign(g_, g); };
+  void set_g(const Vector& g) {
+    Reassign(g_, g);
+    revision_++;
+  };
   /// Set process noise covariance
-  void set_Q(const Matrix& Q) { Reassign(Q_, Q); };
+  void set_Q(const Matrix& Q) {
+    Reassign(Q_, Q);
+    revision_++;
+  };
   /// Set process noise covariance of disturbance evoluation
-  void set_Q_m(const Matrix& Q_m) { Reassign(Q_m_, Q_m); };
+  void set_Q_m(const Matrix& Q_m) {
+    Reassign(Q_m_, Q_m);
+    revision_++;
+  };
   /// Set initial state
   void set_x0(const Vector& x0) { Reassign(x0_, x0); };
   /// Set covariance of initial state
   void set_P0(const Matrix& P0) { Reassign(P0_, P0); };
+  /// Set covariance of state estimate
+  void set_P(const Matrix& P) { Reassign(P_, P); };
   /// Set covariance of initial process disturbance
   void set_P0_m(const Matrix& P0_m) { Reassign(P0_m_, P0_m); };
   /// Set output matrix
-  void set_C(const Matrix& C) { Reassign(C_, C); };
+  void set_C(const Matrix& C) {
+    Reassign(C_, C);
+    revision_++;
+  };
   /// Set output bias
   void set_d(const Vector& d) { Reassign(d_, d); };
   /// Set state of system
@@ -165,13 +217,101 @@ class System {
     Reassign(x_, x);
     h();
   };
+  /**
+   * Copies the parameters of another system of the same dimensions (e.g.,
+   * one refit to the latest data): A, B, g, m0, Q, Q_m, C, d, x0, P0, P0_m.
+   * The state (x, P, and m if adapted) is kept.
+   *
+   * @brief      sets parameters from another system
+   *
+   * @param      sys   system
+   */
+  void set_params(const System& sys);
+  /// Set method of updating state estimate covariance
+  void set_cov_update(CovUpdateType cov_update) { cov_update_ = cov_update; };
+
+  /**
+   * Decouples the rate of the covariance/gain recursion (RecurseKe) from the
+   * rate of filtering: the state estimate is updated by every call to Filter,
+   * but the covariance and estimator gain are only recursed on every `n`-th
+   * call and held in between. For a gain that changes slowly relative to the
+   * sample period (e.g., Poisson observations sampled at 1 kHz), this cuts the
+   * average cost per step at little loss of estimation accuracy.
+   *
+   * @brief      sets number of filter steps per covariance/gain recursion
+   *
+   * @param      n     number of steps (1 = every step)
+   */
+  void set_recurse_Ke_period(size_t n);
+  /// Get number of filter steps per covariance/gain recursion
+  size_t recurse_Ke_period() const { return recurse_Ke_period_; };
+
+  /**
+   * Enables online adaptation of the model parameters while filtering. After
+   * every call to Filter, [A, B] are updated by recursive least squares (RLS)
+   * with exponential forgetting, regressing the posterior state estimate on
+   * the previous estimate and input. The output parameters [C, d] are likewise
+   * updated from the predicted state and the measurement (by the output model
+   * of the derived type). The cost per step is O((n_x + n_u)^2).
+   *
+   * n.b., the effective memory of the estimator is 1/(1-forgetting) samples.
+   *
+   * @brief      enables online adaptation of parameters A, B, C, d
+   *
+   * @param      forgetting  forgetting factor (0 < forgetting <= 1)
+   * @param      p0          [optional] initial diagonal elements of parameter
+   *                         estimate covariance
+   */
+  void set_adapt_params(data_t forgetting, data_t p0 = 1);
+
+  /// Disable online adaptation of parameters A, B, C, d
+  void UnsetAdaptParams() { do_adapt_params_ = false; };
+
+  /// Get whether parameters A, B, C, d are adapted online
+  bool do_adapt_params() const { return do_adapt_params_; };
+  /// Get forgetting factor of online parameter adaptation
+  data_t forgetting() const { return forgetting_; };
+  /// Get initial covariance (diagonal) of online parameter adaptation
+  data_t adapt_p0() const { return adapt_p0_; };
 
   /// Reset system variables
   void Reset();
 
+  /**
+   * Saves the parameters and state of the system to a snapshot: the state
+   * estimate and its covariance, the estimator gains, initial conditions, and
+   * the state of online parameter adaptation (if any), so that a system
+   * restored from it continues filtering without a transient.
+   *
+   * @brief      saves system to snapshot
+   *
+   * @param      snap    snapshot
+   * @param      prefix  [optional] prefix of record names
+   */
+  virtual void SaveSnapshot(Snapshot& snap,
+                            const std::string& prefix = "") const;
+
+  /**
+   * n.b., the system must have the dimensions (n_u, n_x, n_y) of the system
+   * that was saved.
+   *
+   * @brief      restores system from snapshot
+   *
+   * @param      snap    snapshot
+   * @param      prefix  [optional] prefix of record names
+   */
+  virtual void LoadSnapshot(const Snapshot& snap,
+                            const std::string& prefix = "");
+
   /// Print system variables to stdout
   void Print();
 
+  /// Get per-stage latency histograms (empty unless built with
+  /// LDSCTRLEST_PROFILE)
+  const LatencyProfile& latency() const { return latency_; };
+  /// Reset per-stage latency histograms
+  void ResetLatency() { latency_.Reset(); };
+
   // safe to leave this public and non-const
   bool do_adapt_m{};  ///< whether to adaptively estimate disturbance m
 
@@ -180,6 +320,27 @@ class System {
   virtual void RecurseKe() = 0;
   void InitVars(data_t p0 = kDefaultP0, data_t q0 = kDefaultQ0);
 
+  /// Adapt A, B given previous input (see set_adapt_params)
+  void AdaptDynamics(const Vector& u_tm1);
+  /// Initialize adaptation of C, d (default: C, d not adapted)
+  virtual void InitAdaptOutput(data_t p0){};
+  /// Adapt C, d given current measurement (default: C, d not adapted)
+  virtual void AdaptOutput(const Vector& z){};
+
+  /**
+   * Given regressor `phi`, takes a step of (weighted) recursive least squares
+   * with forgetting: calculates the parameter gain `k` and updates the
+   * parameter estimate covariance `p` in place.
+   *
+   * @brief      recursive least squares step
+   *
+   * @param      p       covariance of parameter estimate
+   * @param      phi     regressor
+   * @param      weight  weight (inverse variance) of this sample
+   * @param      k       parameter gain
+   */
+  void RLSUpdate(Matrix& p, const Vector& phi, data_t weight, Vector& k) const;
+
   std::size_t n_x_{};  ///< number of states
   std::size_t n_u_{};  ///< number of inputs
   std::size_t n_y_{};  ///< number of outputs
@@ -209,7 +370,39 @@ class System {
 
   Matrix Ke_;    ///< estimator gain
   Matrix Ke_m_;  ///< estimator gain for process disturbance
-};               // System
+
+  CovUpdateType cov_update_ =
+      kCovUpdateInverse;  ///< method of updating state estimate covariance
+
+  size_t revision_{};  ///< revision of A, B, g, C, Q, Q_m
+
+  size_t recurse_Ke_period_ = 1;  ///< filter steps per covariance recursion
+  size_t n_until_recurse_Ke_{};   ///< filter steps until next recursion
+
+  // Online parameter adaptation:
+  bool do_adapt_params_{};  ///< whether to adapt A, B, C, d online
+  data_t forgetting_ = 1;   ///< forgetting factor of parameter adaptation
+  data_t adapt_p0_ = 1;     ///< initial covariance of parameter estimate
+  Matrix P_theta_x_;        ///< covariance of [A, B] estimate (per row)
+  Vector x_tm1_;            ///< posterior state estimate at t-1
+  Vector x_pre_;            ///< predicted state at t
+  Vector phi_x_;            ///< regressor of dynamics ([x_tm1; g.*u_tm1])
+  Vector k_x_;              ///< parameter gain of dynamics
+  Vector phi_y_;            ///< regressor of output ([x_pre; 1])
+  Vector k_y_;              ///< parameter gain of output
+
+  // Scratch (preallocated so the per-step path does not allocate):
+  Vector tmp_x_;   ///< scratch (n_x)
+  Vector tmp_u_;   ///< scratch (n_u)
+  Vector tmp_y_;   ///< scratch (n_y)
+  Matrix tmp_xx_;  ///< scratch (n_x x n_x)
+  Matrix tmp_xx2_;  ///< scratch (n_x x n_x)
+  Matrix tmp_xy_;  ///< scratch (n_x x n_y)
+  Matrix tmp_yy_;  ///< scratch (n_y x n_y)
+  JosephWork joseph_work_;  ///< scratch of Cholesky covariance update
+
+  LatencyProfile latency_;  ///< per-stage latency histograms
+};                          // System
 
 }  // namespace lds
 
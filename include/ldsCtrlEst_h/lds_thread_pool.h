@@ -0,0 +1,97 @@
+//===-- ldsCtrlEst_h/lds_thread_pool.h - Thread Pool ------------*- C++ -*-===//
+//
+// Copyright 2021 Michael Bolus
+// Copyright 2021 Georgia Institute of Technology
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file declares a minimal pool of persistent worker threads
+/// (`lds::ThreadPool`) used to parallelize independent work (e.g., stepping a
+/// bank of controllers) without spawning threads on every call.
+///
+/// \brief thread pool
+//===----------------------------------------------------------------------===//
+
+#ifndef LDSCTRLEST_LDS_THREAD_POOL_H
+#define LDSCTRLEST_LDS_THREAD_POOL_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace lds {
+
+/// Pool of persistent worker threads
+class ThreadPool {
+ public:
+  /**
+   * @brief      Constructs a new ThreadPool.
+   *
+   * @param      n_threads  [optional] total number of threads, including the
+   *                        calling thread (0 = hardware concurrency)
+   */
+  explicit ThreadPool(std::size_t n_threads = 0);
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  /// Joins worker threads
+  ~ThreadPool();
+
+  /**
+   * Partitions the range [0, n) into contiguous chunks (one per thread) and
+   * calls `fn(k_begin, k_end)` on each chunk in parallel. The calling thread
+   * works on the first chunk. Blocks until all chunks are finished. If any
+   * chunk throws, the first exception is rethrown here.
+   *
+   * @brief      parallel for-loop over contiguous chunks
+   *
+   * @param      n     size of range
+   * @param      fn    function of chunk [k_begin, k_end)
+   */
+  void ParallelFor(std::size_t n,
+                   const std::function<void(std::size_t, std::size_t)>& fn);
+
+  /// Get total number of threads (including the calling thread)
+  std::size_t n_threads() const { return workers_.size() + 1; };
+
+ private:
+  /// Worker thread loop
+  void Work(std::size_t id);
+
+  /// Runs chunk `id` of current job and records any exception
+  void RunChunk(std::size_t id);
+
+  std::vector<std::thread> workers_;  ///< worker threads
+  std::mutex mutex_;                  ///< guards job state below
+  std::condition_variable cv_job_;    ///< signals new job (or stop)
+  std::condition_variable cv_done_;   ///< signals job completion
+
+  const std::function<void(std::size_t, std::size_t)>* fn_{};  ///< job
+  std::size_t n_{};            ///< size of range for current job
+  std::size_t generation_{};   ///< job counter
+  std::size_t n_remaining_{};  ///< worker chunks remaining in current job
+  std::exception_ptr error_;   ///< first exception thrown by current job
+  bool do_stop_{};             ///< whether workers should exit
+};
+
+}  // namespace lds
+
+#endif
@@ -27,8 +27,10 @@
 #ifndef LDSCTRLEST_LDS_UNIFORM_MATS_H
 #define LDSCTRLEST_LDS_UNIFORM_MATS_H
 
-#include <array>   // std::array
-#include <vector>  // std::vector
+#include <algorithm>  // std::copy
+#include <array>      // std::array
+#include <cstdint>    // std::uintptr_t
+#include <vector>     // std::vector
 
 #include "lds.h"
 
@@ -81,6 +83,21 @@ class UniformMatrixList : public std::vector<Matrix> {
   UniformMatrixList(std::initializer_list<Matrix> mats,
                     std::array<size_t, 2> dim = {0, 0});
 
+  /**
+   * Wraps caller-owned, column-major memory as matrices without copying it
+   * (i.e., `copy_aux_mem = false`, `strict = true`), such that, e.g., large
+   * training datasets may be read in place by the fitting types. n.b., the
+   * memory must outlive this list and anything it is moved into, and a copy of
+   * the list copies the memory.
+   *
+   * @brief      Constructs a new UniformMatrixList of views of external memory
+   *
+   * @param      mems  pointers to first element of each matrix
+   * @param      dims  dimensions (n_rows, n_cols) of each matrix
+   */
+  UniformMatrixList(const std::vector<data_t*>& mems,
+                    const std::vector<std::array<size_t, 2>>& dims);
+
   /**
    * @brief      Constructs a new UniformMatrixList (copy).
    *
@@ -123,6 +140,22 @@ class UniformMatrixList : public std::vector<Matrix> {
    */
   void Swap(Matrix& that, size_t n);
 
+  /**
+   * Packs every matrix into one contiguous, aligned buffer (arena), such that
+   * each element becomes a view of it. This amounts to one allocation (rather
+   * than one per matrix), better locality when iterating over matrices, and
+   * cheaper copies of the list.
+   *
+   * n.b., an element that is later assigned a matrix of different size is
+   * released from the arena.
+   *
+   * @brief      packs matrices into contiguous storage
+   */
+  void Pack();
+
+  /// gets whether matrices are packed into contiguous storage (see Pack)
+  bool is_packed() const { return !arena_.empty(); };
+
   /**
    * @brief      assigns the contents (copy)
    *
@@ -142,7 +175,18 @@ class UniformMatrixList : public std::vector<Matrix> {
 
  private:
   void CheckDimensions(std::array<size_t, 2> dim);
+
+  /// replaces elements with views of arena at offsets_
+  void ViewArena();
+
+  /// gets offset (in elements) at which arena is aligned
+  static size_t ArenaOffset(const std::vector<data_t>& arena);
+
+  static const size_t kArenaAlignment = 64;  ///< arena alignment (bytes)
+
   std::vector<std::array<size_t, 2>> dim_;
+  std::vector<data_t> arena_;   ///< contiguous storage of packed matrices
+  std::vector<size_t> offsets_;  ///< offset of each packed matrix in arena
 };
 
 template <MatrixListFreeDim D>
@@ -167,7 +211,8 @@ inline void UniformMatrixList<D>::Swap(Matrix& that, size_t n) {
     return;
   }
   // if checks pass, perform swap
-  Matrix tmp = std::move((*this)[n]);
+  // n.b., if packed, must copy out of arena (caller cannot hold a view of it)
+  Matrix tmp = is_packed() ? Matrix((*this)[n]) : std::move((*this)[n]);
   (*this)[n] = std::move(that);
   that = std::move(tmp);
 
@@ -278,6 +323,8 @@ inline UniformMatrixList<D>& UniformMatrixList<D>::operator=(
 
   dim_ = that.dim_;
   std::vector<Matrix>::operator=(std::move(that));
+  arena_ = std::move(that.arena_);
+  offsets_ = std::move(that.offsets_);
 
   return (*this);
 }
@@ -303,19 +350,93 @@ UniformMatrixList<D>::UniformMatrixList(std::initializer_list<Matrix> mats,
   CheckDimensions(dim);
 };
 
+template <MatrixListFreeDim D>
+UniformMatrixList<D>::UniformMatrixList(
+    const std::vector<data_t*>& mems,
+    const std::vector<std::array<size_t, 2>>& dims) {
+  if (mems.size() != dims.size()) {
+    throw std::runtime_error(
+        "number of memory pointers must match number of dimensions");
+  }
+  this->reserve(mems.size());
+  for (size_t k = 0; k < mems.size(); k++) {
+    // n.b., mat(ptr_aux_mem, n_rows, n_cols, copy_aux_mem, strict)
+    this->emplace_back(mems[k], dims[k][0], dims[k][1], false, true);
+  }
+  CheckDimensions({0, 0});
+}
+
 template <MatrixListFreeDim D>
 UniformMatrixList<D>::UniformMatrixList(const UniformMatrixList<D>& that)
-    : vector(that) {
-  (*this) = that;
+    : vector(that.is_packed() ? std::vector<Matrix>()
+                              : static_cast<const std::vector<Matrix>&>(that)) {
+  if (!that.is_packed()) {
+    (*this) = that;
+    return;
+  }
+
+  // copy the arena wholesale and view it
+  // n.b., alignment offset of the new arena may differ
+  dim_ = that.dim_;
+  offsets_ = that.offsets_;
+  size_t n_align = kArenaAlignment / sizeof(data_t);
+  arena_ = std::vector<data_t>(that.arena_.size());
+  auto that_begin = that.arena_.begin() + ArenaOffset(that.arena_);
+  std::copy(that_begin, that_begin + (that.arena_.size() - n_align),
+            arena_.begin() + ArenaOffset(arena_));
+  ViewArena();
 }
 
 template <MatrixListFreeDim D>
 UniformMatrixList<D>::UniformMatrixList(UniformMatrixList<D>&& that) noexcept
-    : vector(std::move(that)) {
+    : vector(std::move(that)),
+      dim_(std::move(that.dim_)),
+      arena_(std::move(that.arena_)),
+      offsets_(std::move(that.offsets_)) {}
+
+template <MatrixListFreeDim D>
+void UniformMatrixList<D>::Pack() {
+  // offset of each matrix, padded such that every matrix is aligned
+  size_t n_align = kArenaAlignment / sizeof(data_t);
+  std::vector<size_t> offsets(this->size());
+  size_t n_elem = 0;
   for (size_t k = 0; k < this->size(); k++) {
-    dim_[k][0] = (*this)[k].n_rows;
-    dim_[k][1] = (*this)[k].n_cols;
+    offsets[k] = n_elem;
+    n_elem += ((*this)[k].n_elem + n_align - 1) / n_align * n_align;
   }
+
+  // n.b., extra room to align the start of the arena
+  std::vector<data_t> arena(n_elem + n_align);
+  data_t* base = arena.data() + ArenaOffset(arena);
+  for (size_t k = 0; k < this->size(); k++) {
+    std::copy((*this)[k].begin(), (*this)[k].end(), base + offsets[k]);
+  }
+
+  // n.b., elements may view the previous arena until replaced
+  arena_ = std::move(arena);
+  offsets_ = std::move(offsets);
+  ViewArena();
+}
+
+template <MatrixListFreeDim D>
+void UniformMatrixList<D>::ViewArena() {
+  data_t* base = arena_.data() + ArenaOffset(arena_);
+  std::vector<Matrix> views;
+  views.reserve(offsets_.size());
+  for (size_t k = 0; k < offsets_.size(); k++) {
+    // n.b., mat(ptr_aux_mem, n_rows, n_cols, copy_aux_mem, strict)
+    // (not strict, so that assigning a different size releases the element)
+    views.emplace_back(base + offsets_[k], dim_[k][0], dim_[k][1], false,
+                       false);
+  }
+  std::vector<Matrix>::operator=(std::move(views));
+}
+
+template <MatrixListFreeDim D>
+size_t UniformMatrixList<D>::ArenaOffset(const std::vector<data_t>& arena) {
+  auto addr = reinterpret_cast<std::uintptr_t>(arena.data());
+  size_t n_pad = (kArenaAlignment - addr % kArenaAlignment) % kArenaAlignment;
+  return n_pad / sizeof(data_t);
 }
 
 template <MatrixListFreeDim D>
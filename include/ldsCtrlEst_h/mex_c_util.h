@@ -76,9 +76,16 @@ inline auto m2a_mat(const mxArray *matlab_mat, bool copy_aux_mem = false,
   if (mxGetData(matlab_mat)) {
     const mwSize n_dim = mxGetNumberOfDimensions(matlab_mat);
     if (n_dim == 2) {
+#ifdef LDSCTRLEST_SINGLE_PRECISION
+      // n.b., matlab data are double precision: must convert (copy)
+      return arma::conv_to<arma::Mat<T>>::from(arma::Mat<double>(
+          static_cast<double *>(mxGetData(matlab_mat)), mxGetM(matlab_mat),
+          mxGetN(matlab_mat), false, true));
+#else
       return arma::Mat<T>(static_cast<T *>(mxGetData(matlab_mat)),
                           mxGetM(matlab_mat), mxGetN(matlab_mat), copy_aux_mem,
                           strict);
+#endif
     }
     mexErrMsgTxt("Number of dimensions must be 2.");
     return arma::Mat<T>();
@@ -101,10 +108,11 @@ inline auto a2m_mat(arma::Mat<T> const &arma_mat) -> mxArray * {
   mxArray *matlab_mat = mxCreateNumericMatrix(arma_mat.n_rows, arma_mat.n_cols,
                                               mxDOUBLE_CLASS, mxREAL);
   if (matlab_mat) {
-    auto *dst_pointer = static_cast<T *>(mxGetData(matlab_mat));
-    const auto *src_pointer = const_cast<T *>(arma_mat.memptr());
+    // n.b., matlab data are double precision (converted from T)
+    auto *dst_pointer = static_cast<double *>(mxGetData(matlab_mat));
+    const T *src_pointer = arma_mat.memptr();
     // TODO(mfbolus): I just want to MOVE the data, not copy.
-    std::memcpy(dst_pointer, src_pointer, sizeof(T) * arma_mat.n_elem);
+    std::copy(src_pointer, src_pointer + arma_mat.n_elem, dst_pointer);
     return matlab_mat;
   }
   mexErrMsgTxt("Failed to create matlab mat from arma::Mat.");
@@ -123,10 +131,11 @@ inline auto a2m_vec(arma::Col<T> const &arma_vec) -> mxArray * {
   mxArray *matlab_mat =
       mxCreateNumericMatrix(arma_vec.n_elem, 1, mxDOUBLE_CLASS, mxREAL);
   if (matlab_mat) {
-    auto *dst_pointer = static_cast<T *>(mxGetData(matlab_mat));
-    const auto *src_pointer = const_cast<T *>(arma_vec.memptr());
+    // n.b., matlab data are double precision (converted from T)
+    auto *dst_pointer = static_cast<double *>(mxGetData(matlab_mat));
+    const T *src_pointer = arma_vec.memptr();
     // TODO(mfbolus): I just want to MOVE the data, not copy.
-    std::memcpy(dst_pointer, src_pointer, sizeof(T) * arma_vec.n_elem);
+    std::copy(src_pointer, src_pointer + arma_vec.n_elem, dst_pointer);
     return matlab_mat;
   }
   mexErrMsgTxt("Failed to create matlab mat from arma::Col.");
@@ -34,6 +34,10 @@
 
 /// utilities for arma/mex interface
 /// *using Matlab C++ API*
+///
+/// n.b., Matlab arrays are always double precision; elements are converted to
+/// type T at the boundary (e.g., single-precision builds of the library).
+///
 /// \brief arma/mex interface using Matlab C++ API
 namespace armamexcpp {
 /**
@@ -51,9 +55,10 @@ std::vector<arma::Mat<T>> m2a_cellmat(matlab::data::CellArray& matlab_cell) {
   std::vector<arma::Mat<T>> arma_mat(n_cells,
                                      arma::Mat<T>(1, 1, arma::fill::zeros));
   for (size_t k = 0; k < n_cells; k++) {
-    matlab::data::TypedArray<T> matlab_mat = matlab_cell[k];
+    matlab::data::TypedArray<double> matlab_mat = matlab_cell[k];
     auto dims = matlab_mat.getDimensions();
-    arma_mat[k] = arma::Mat<T>(matlab_mat.release().get(), dims[0], dims[1]);
+    arma_mat[k] = arma::conv_to<arma::Mat<T>>::from(
+        arma::Mat<double>(matlab_mat.release().get(), dims[0], dims[1]));
   }
   return arma_mat;
 };
@@ -68,9 +73,9 @@ std::vector<arma::Mat<T>> m2a_cellmat(matlab::data::CellArray& matlab_cell) {
  * @return     vector of type T
  */
 template <class T>
-std::vector<T> m2s_vec(matlab::data::TypedArray<T>& matlab_array) {
+std::vector<T> m2s_vec(matlab::data::TypedArray<double>& matlab_array) {
   size_t n_elem = matlab_array.getNumberOfElements();
-  T* ptr = matlab_array.release().get();
+  double* ptr = matlab_array.release().get();
   std::vector<T> vec(ptr, ptr + n_elem);
   return vec;
 };
@@ -85,7 +90,7 @@ std::vector<T> m2s_vec(matlab::data::TypedArray<T>& matlab_array) {
  * @return     armadillo vector of type T
  */
 template <class T>
-arma::Col<T> m2a_vec(matlab::data::TypedArray<T> matlab_array) {
+arma::Col<T> m2a_vec(matlab::data::TypedArray<double> matlab_array) {
   size_t n_elem = matlab_array.getNumberOfElements();
   // T* ptr = matlab_array.release().get();
   // arma::Col<T> vec(ptr, n_elem);  //, false);
@@ -109,7 +114,7 @@ arma::Col<T> m2a_vec(matlab::data::TypedArray<T> matlab_array) {
  * @return     armadillo matrix of type T
  */
 template <class T>
-arma::Mat<T> m2a_mat(matlab::data::TypedArray<T> matlab_array) {
+arma::Mat<T> m2a_mat(matlab::data::TypedArray<double> matlab_array) {
   // ArrayDimensions == std::vector<size_t>
   auto dims = matlab_array.getDimensions();
   // T* ptr = matlab_array.release().get();
@@ -131,6 +136,73 @@ arma::Mat<T> m2a_mat(matlab::data::TypedArray<T> matlab_array) {
   return mat;
 };
 
+/**
+ * Wraps matlab matrices without copying them. n.b., the returned matrices are
+ * only valid while `matlab_mats`, which holds references to the matlab
+ * arrays, is in scope (e.g., held by a persistent mex object).
+ *
+ * @brief      View matlab matrices as list of armadillo matrices (no copy)
+ *
+ * @param      matlab_mats  matlab matrices
+ *
+ * @return     list of armadillo matrices (views of matlab memory)
+ */
+inline lds::UniformMatrixList<lds::kMatFreeDim2> m2a_mats_view(
+    std::vector<matlab::data::TypedArray<double>>& matlab_mats) {
+#ifdef LDSCTRLEST_SINGLE_PRECISION
+  // n.b., cannot view double-precision memory: convert (copy)
+  std::vector<lds::Matrix> mats;
+  mats.reserve(matlab_mats.size());
+  for (auto& matlab_mat : matlab_mats) {
+    mats.push_back(m2a_mat<lds::data_t>(matlab_mat));
+  }
+  return lds::UniformMatrixList<lds::kMatFreeDim2>(std::move(mats));
+#else
+  size_t n_mats = matlab_mats.size();
+  std::vector<lds::data_t*> mems(n_mats);
+  std::vector<std::array<size_t, 2>> dims(n_mats);
+  for (size_t k = 0; k < n_mats; k++) {
+    auto dims_k = matlab_mats[k].getDimensions();
+    dims[k] = {dims_k[0], dims_k[1]};
+    // n.b., const iterator so as not to trigger a copy-on-write (read only)
+    mems[k] = const_cast<lds::data_t*>(&(*matlab_mats[k].cbegin()));
+  }
+  return lds::UniformMatrixList<lds::kMatFreeDim2>(mems, dims);
+#endif
+};
+
+/**
+ * Wraps the matrices of a matlab cell array without copying them. n.b., the
+ * returned matrices are only valid while `matlab_mats`, which holds references
+ * to the matlab arrays, is in scope.
+ *
+ * @brief      View matlab cell array as list of armadillo matrices (no copy)
+ *
+ * @param      matlab_cell  matlab cell
+ * @param      matlab_mats  matlab matrices referenced by views (output)
+ *
+ * @return     list of armadillo matrices (views of matlab memory)
+ */
+inline lds::UniformMatrixList<lds::kMatFreeDim2> m2a_cellmat_view(
+    matlab::data::CellArray& matlab_cell,
+    std::vector<matlab::data::TypedArray<double>>& matlab_mats) {
+#ifdef LDSCTRLEST_SINGLE_PRECISION
+  // n.b., cannot view double-precision memory: convert (copy)
+  matlab_mats.clear();
+  return lds::UniformMatrixList<lds::kMatFreeDim2>(
+      m2a_cellmat<lds::data_t>(matlab_cell));
+#else
+  size_t n_cells = matlab_cell.getNumberOfElements();
+  matlab_mats.clear();
+  matlab_mats.reserve(n_cells);
+  for (size_t k = 0; k < n_cells; k++) {
+    matlab::data::TypedArray<double> matlab_mat = matlab_cell[k];
+    matlab_mats.push_back(std::move(matlab_mat));
+  }
+  return m2a_mats_view(matlab_mats);
+#endif
+};
+
 /**
  * @brief      Convert armadillo to matlab matrix
  *
@@ -142,11 +214,12 @@ arma::Mat<T> m2a_mat(matlab::data::TypedArray<T> matlab_array) {
  * @return     matlab matrix
  */
 template <class T>
-matlab::data::TypedArray<T> a2m_mat(const arma::Mat<T>& arma_mat,
-                                    matlab::data::ArrayFactory& factory) {
-  const matlab::data::TypedArray<T> matlab_mat = factory.createArray<T>(
-      {arma_mat.n_rows, arma_mat.n_cols}, arma_mat.memptr(),
-      arma_mat.memptr() + arma_mat.n_elem);
+matlab::data::TypedArray<double> a2m_mat(const arma::Mat<T>& arma_mat,
+                                         matlab::data::ArrayFactory& factory) {
+  const matlab::data::TypedArray<double> matlab_mat =
+      factory.createArray<double>({arma_mat.n_rows, arma_mat.n_cols},
+                                  arma_mat.memptr(),
+                                  arma_mat.memptr() + arma_mat.n_elem);
   return matlab_mat;
 };
 
@@ -161,11 +234,11 @@ matlab::data::TypedArray<T> a2m_mat(const arma::Mat<T>& arma_mat,
  * @return     matlab matrix
  */
 template <class T>
-matlab::data::TypedArray<T> a2m_vec(const arma::Col<T>& arma_vec,
-                                    matlab::data::ArrayFactory& factory) {
-  const matlab::data::TypedArray<T> matlab_mat =
-      factory.createArray<T>({arma_vec.n_elem, 1}, arma_vec.memptr(),
-                             arma_vec.memptr() + arma_vec.n_elem);
+matlab::data::TypedArray<double> a2m_vec(const arma::Col<T>& arma_vec,
+                                         matlab::data::ArrayFactory& factory) {
+  const matlab::data::TypedArray<double> matlab_mat =
+      factory.createArray<double>({arma_vec.n_elem, 1}, arma_vec.memptr(),
+                                  arma_vec.memptr() + arma_vec.n_elem);
   return matlab_mat;
 };
 
@@ -180,10 +253,11 @@ matlab::data::TypedArray<T> a2m_vec(const arma::Col<T>& arma_vec,
  * @return     matlab matrix
  */
 template <class T>
-matlab::data::TypedArray<T> s2m_vec(const std::vector<T>& std_vec,
-                                    matlab::data::ArrayFactory& factory) {
-  const matlab::data::TypedArray<T> matlab_mat = factory.createArray<T>(
-      {std_vec.size(), 1}, std_vec.data(), std_vec.data() + std_vec.size());
+matlab::data::TypedArray<double> s2m_vec(const std::vector<T>& std_vec,
+                                         matlab::data::ArrayFactory& factory) {
+  const matlab::data::TypedArray<double> matlab_mat =
+      factory.createArray<double>({std_vec.size(), 1}, std_vec.data(),
+                                  std_vec.data() + std_vec.size());
   return matlab_mat;
 };
 }  // namespace armamexcpp
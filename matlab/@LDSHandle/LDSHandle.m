@@ -0,0 +1,38 @@
+classdef LDSHandle < handle
+% this = LDSHandle(type, varargin)
+%
+% Persistent C++ fit/controller object (see lds_handle_mex), deleted along with this handle.
+%
+% type: 'glds_em', 'plds_em', 'glds_ssid', 'plds_ssid', 'glds_ctrl', 'plds_ctrl'
+%
+% EXAMPLE
+% em = LDSHandle('glds_em', fit, u, z);
+% em.call('run', fit, true, true, true, true, true, 10);
+% em.call('append', u_new, z_new);
+% em.call('run', fit);
+
+properties (SetAccess = private)
+type char = '';
+id double = 0;
+end
+
+methods
+function this = LDSHandle(type, varargin)
+  % this = LDSHandle(type, varargin)
+  this.type = type;
+  this.id = lds_handle_mex('new', type, varargin{:});
+end
+
+function varargout = call(this, method, varargin)
+  % varargout = call(this, method, varargin)
+  [varargout{1:nargout}] = lds_handle_mex(method, this.id, varargin{:});
+end
+
+function delete(this)
+  if this.id > 0
+    lds_handle_mex('delete', this.id);
+  end
+end
+end
+
+end%classdef
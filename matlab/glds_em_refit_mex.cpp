@@ -38,18 +38,13 @@ class MexFunction : public matlab::mex::Function {
     matlab::data::CellArray z_matlab = std::move(inputs[2]);
     dt = (matlab_ptr_->getProperty(fit0, u"dt"))[0];
 
-    lds::UniformMatrixList<lds::kMatFreeDim2> u;
-    lds::UniformMatrixList<lds::kMatFreeDim2> z;
-    {
-      std::vector<lds::Matrix> tmp =
-          std::move(armamexcpp::m2a_cellmat<data_t>(u_matlab));
-      u = lds::UniformMatrixList<lds::kMatFreeDim2>(std::move(tmp));
-    }
-    {
-      std::vector<lds::Matrix> tmp =
-          std::move(armamexcpp::m2a_cellmat<data_t>(z_matlab));
-      z = lds::UniformMatrixList<lds::kMatFreeDim2>(std::move(tmp));
-    }
+    // n.b., training data are read in place (views of matlab memory)
+    std::vector<TypedArray<double>> u_mats;
+    std::vector<TypedArray<double>> z_mats;
+    lds::UniformMatrixList<lds::kMatFreeDim2> u =
+        armamexcpp::m2a_cellmat_view(u_matlab, u_mats);
+    lds::UniformMatrixList<lds::kMatFreeDim2> z =
+        armamexcpp::m2a_cellmat_view(z_matlab, z_mats);
 
     if (inputs.size() > 3) {
       calc_dynamics = static_cast<bool>(inputs[3][0]);
@@ -114,16 +109,16 @@ class MexFunction : public matlab::mex::Function {
     // TODO(mfbolus): this causes a seg fault
     // std::tie(u, z) = em.ReturnData();
 
-    TypedArray<data_t> a = armamexcpp::a2m_mat<data_t>(lds_fit.A(), factory);
-    TypedArray<data_t> b = armamexcpp::a2m_mat<data_t>(lds_fit.B(), factory);
-    TypedArray<data_t> g = armamexcpp::a2m_vec<data_t>(lds_fit.g(), factory);
-    TypedArray<data_t> m = armamexcpp::a2m_vec<data_t>(lds_fit.m(), factory);
-    TypedArray<data_t> q = armamexcpp::a2m_mat<data_t>(lds_fit.Q(), factory);
-    TypedArray<data_t> x0 = armamexcpp::a2m_vec<data_t>(lds_fit.x0(), factory);
-    TypedArray<data_t> p0 = armamexcpp::a2m_mat<data_t>(lds_fit.P0(), factory);
-    TypedArray<data_t> c = armamexcpp::a2m_mat<data_t>(lds_fit.C(), factory);
-    TypedArray<data_t> d = armamexcpp::a2m_vec<data_t>(lds_fit.d(), factory);
-    TypedArray<data_t> r = armamexcpp::a2m_mat<data_t>(lds_fit.R(), factory);
+    TypedArray<double> a = armamexcpp::a2m_mat<data_t>(lds_fit.A(), factory);
+    TypedArray<double> b = armamexcpp::a2m_mat<data_t>(lds_fit.B(), factory);
+    TypedArray<double> g = armamexcpp::a2m_vec<data_t>(lds_fit.g(), factory);
+    TypedArray<double> m = armamexcpp::a2m_vec<data_t>(lds_fit.m(), factory);
+    TypedArray<double> q = armamexcpp::a2m_mat<data_t>(lds_fit.Q(), factory);
+    TypedArray<double> x0 = armamexcpp::a2m_vec<data_t>(lds_fit.x0(), factory);
+    TypedArray<double> p0 = armamexcpp::a2m_mat<data_t>(lds_fit.P0(), factory);
+    TypedArray<double> c = armamexcpp::a2m_mat<data_t>(lds_fit.C(), factory);
+    TypedArray<double> d = armamexcpp::a2m_vec<data_t>(lds_fit.d(), factory);
+    TypedArray<double> r = armamexcpp::a2m_mat<data_t>(lds_fit.R(), factory);
 
     matlab_ptr_->setProperty(fit0, u"A", a);
     matlab_ptr_->setProperty(fit0, u"B", b);
@@ -160,25 +155,25 @@ class MexFunction : public matlab::mex::Function {
 
     if (outputs.size() > 2) {
       lds::Matrix sum_e_xu_tm1_xu_tm1 = em.sum_E_xu_tm1_xu_tm1();
-      TypedArray<data_t> sum_e_xu_tm1_xu_tm1_m =
+      TypedArray<double> sum_e_xu_tm1_xu_tm1_m =
           armamexcpp::a2m_mat<data_t>(sum_e_xu_tm1_xu_tm1, factory);
       outputs[2] = std::move(sum_e_xu_tm1_xu_tm1_m);
     }
     if (outputs.size() > 3) {
       lds::Matrix sum_e_xu_t_xu_tm1 = em.sum_E_xu_t_xu_tm1();
-      TypedArray<data_t> sum_e_xu_t_xu_tm1_m =
+      TypedArray<double> sum_e_xu_t_xu_tm1_m =
           armamexcpp::a2m_mat<data_t>(sum_e_xu_t_xu_tm1, factory);
       outputs[3] = std::move(sum_e_xu_t_xu_tm1_m);
     }
     if (outputs.size() > 4) {
       lds::Matrix sum_e_x_t_x_t = em.sum_E_x_t_x_t();
-      TypedArray<data_t> sum_e_x_t_x_t_m =
+      TypedArray<double> sum_e_x_t_x_t_m =
           armamexcpp::a2m_mat<data_t>(sum_e_x_t_x_t, factory);
       outputs[4] = std::move(sum_e_x_t_x_t_m);
     }
     if (outputs.size() > 5) {
       size_t t = em.n_t_tot();
-      TypedArray<data_t> t_m = factory.createScalar<data_t>(t);
+      TypedArray<double> t_m = factory.createScalar<double>(t);
       outputs[5] = std::move(t_m);
     }
   }
@@ -0,0 +1,515 @@
+#include <ldsCtrlEst_h/mex_cpp_util.h>
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+
+using matlab::data::Array;
+using matlab::data::ArrayFactory;
+using matlab::data::CellArray;
+using matlab::data::CharArray;
+using matlab::data::TypedArray;
+using matlab::engine::MATLABEngine;
+using matlab::mex::ArgumentList;
+
+using lds::data_t;
+using lds::Matrix;
+using lds::Vector;
+
+namespace {
+
+// ---------------------------------------------------------------------------
+// parameters: matlab GLDS/PLDS objects <-> C++ fits/systems
+// ---------------------------------------------------------------------------
+
+// gets parameters common to all models (n.b., fits and systems share setters)
+template <typename T>
+void GetCommonParams(MATLABEngine& matlab, const Array& obj, T& lds) {
+  using armamexcpp::m2a_mat;
+  using armamexcpp::m2a_vec;
+  lds.set_A(m2a_mat<data_t>(matlab.getProperty(obj, u"A")));
+  lds.set_B(m2a_mat<data_t>(matlab.getProperty(obj, u"B")));
+  lds.set_g(m2a_vec<data_t>(matlab.getProperty(obj, u"g")));
+  lds.set_m(m2a_vec<data_t>(matlab.getProperty(obj, u"m")));
+  lds.set_Q(m2a_mat<data_t>(matlab.getProperty(obj, u"Q")));
+  lds.set_x0(m2a_vec<data_t>(matlab.getProperty(obj, u"x0")));
+  lds.set_P0(m2a_mat<data_t>(matlab.getProperty(obj, u"P0")));
+  lds.set_C(m2a_mat<data_t>(matlab.getProperty(obj, u"C")));
+  lds.set_d(m2a_vec<data_t>(matlab.getProperty(obj, u"d")));
+}
+
+// gets measurement noise cov (Gaussian models only)
+template <typename T>
+void GetGaussianParams(MATLABEngine& matlab, const Array& obj, T& lds) {
+  lds.set_R(armamexcpp::m2a_mat<data_t>(matlab.getProperty(obj, u"R")));
+}
+void GetModelParams(MATLABEngine& matlab, const Array& obj,
+                    lds::gaussian::Fit& lds) {
+  GetCommonParams(matlab, obj, lds);
+  GetGaussianParams(matlab, obj, lds);
+}
+void GetModelParams(MATLABEngine& matlab, const Array& obj,
+                    lds::gaussian::System& lds) {
+  GetCommonParams(matlab, obj, lds);
+  GetGaussianParams(matlab, obj, lds);
+}
+void GetModelParams(MATLABEngine& matlab, const Array& obj,
+                    lds::poisson::Fit& lds) {
+  GetCommonParams(matlab, obj, lds);
+}
+void GetModelParams(MATLABEngine& matlab, const Array& obj,
+                    lds::poisson::System& lds) {
+  GetCommonParams(matlab, obj, lds);
+}
+
+// constructs model (fit or system) from matlab object
+template <typename T>
+T ModelFromMatlab(MATLABEngine& matlab, const Array& obj) {
+  data_t dt = static_cast<data_t>(matlab.getProperty(obj, u"dt")[0]);
+  Matrix a = armamexcpp::m2a_mat<data_t>(matlab.getProperty(obj, u"A"));
+  Matrix b = armamexcpp::m2a_mat<data_t>(matlab.getProperty(obj, u"B"));
+  Matrix c = armamexcpp::m2a_mat<data_t>(matlab.getProperty(obj, u"C"));
+  T lds(b.n_cols, a.n_rows, c.n_rows, dt);
+  GetModelParams(matlab, obj, lds);
+  return lds;
+}
+
+// sets parameters of matlab object from fit
+template <typename Fit>
+void SetCommonParams(MATLABEngine& matlab, const Fit& fit, Array& obj) {
+  using armamexcpp::a2m_mat;
+  using armamexcpp::a2m_vec;
+  ArrayFactory factory;
+  matlab.setProperty(obj, u"dt", factory.createScalar<double>(fit.dt()));
+  matlab.setProperty(obj, u"A", a2m_mat<data_t>(fit.A(), factory));
+  matlab.setProperty(obj, u"B", a2m_mat<data_t>(fit.B(), factory));
+  matlab.setProperty(obj, u"g", a2m_vec<data_t>(fit.g(), factory));
+  matlab.setProperty(obj, u"m", a2m_vec<data_t>(fit.m(), factory));
+  matlab.setProperty(obj, u"Q", a2m_mat<data_t>(fit.Q(), factory));
+  matlab.setProperty(obj, u"x0", a2m_vec<data_t>(fit.x0(), factory));
+  matlab.setProperty(obj, u"P0", a2m_mat<data_t>(fit.P0(), factory));
+  matlab.setProperty(obj, u"C", a2m_mat<data_t>(fit.C(), factory));
+  matlab.setProperty(obj, u"d", a2m_vec<data_t>(fit.d(), factory));
+}
+void SetModelParams(MATLABEngine& matlab, const lds::gaussian::Fit& fit,
+                    Array& obj) {
+  ArrayFactory factory;
+  SetCommonParams(matlab, fit, obj);
+  matlab.setProperty(obj, u"R",
+                     armamexcpp::a2m_mat<data_t>(fit.R(), factory));
+}
+void SetModelParams(MATLABEngine& matlab, const lds::poisson::Fit& fit,
+                    Array& obj) {
+  SetCommonParams(matlab, fit, obj);
+}
+
+// ---------------------------------------------------------------------------
+// argument helpers
+// ---------------------------------------------------------------------------
+
+std::string ToString(const Array& arg) { return CharArray(arg).toAscii(); }
+
+// n.b., optional arguments that are missing or empty take the default
+template <typename T>
+T OptionalScalar(const std::vector<Array>& args, size_t k, T default_val) {
+  if (k >= args.size() || args[k].isEmpty()) {
+    return default_val;
+  }
+  return static_cast<T>(args[k][0]);
+}
+
+void RequireArgs(const std::vector<Array>& args, size_t n,
+                 const std::string& method) {
+  if (args.size() < n) {
+    throw std::runtime_error("'" + method + "' requires at least " +
+                             std::to_string(n) + " argument(s).");
+  }
+}
+
+lds::SSIDWt ToSSIDWt(size_t which_wt) {
+  switch (which_wt) {
+    case 1:
+      return lds::kSSIDMOESP;
+    case 2:
+      return lds::kSSIDCVA;
+    default:
+      return lds::kSSIDNone;
+  }
+}
+
+CellArray ToCell(const std::vector<Matrix>& mats, ArrayFactory& factory) {
+  CellArray cell = factory.createCellArray({mats.size(), 1});
+  for (size_t k = 0; k < mats.size(); k++) {
+    cell[k] = armamexcpp::a2m_mat<data_t>(mats[k], factory);
+  }
+  return cell;
+}
+
+/// Training data held by a persistent object
+///
+/// n.b., the data are only referenced (views of matlab memory, unless single
+/// precision), and the referenced matlab arrays are kept alive here.
+class TrainingData {
+ public:
+  /// appends trials
+  void Append(CellArray& u, CellArray& z) {
+    if (u.getNumberOfElements() != z.getNumberOfElements()) {
+      throw std::runtime_error(
+          "I/O training data have different number of trials.");
+    }
+    for (size_t k = 0; k < u.getNumberOfElements(); k++) {
+      TypedArray<double> u_k = u[k];
+      TypedArray<double> z_k = z[k];
+      u_mats_.push_back(std::move(u_k));
+      z_mats_.push_back(std::move(z_k));
+    }
+  }
+
+  /// replaces trials
+  void Replace(CellArray& u, CellArray& z) {
+    u_mats_.clear();
+    z_mats_.clear();
+    Append(u, z);
+  }
+
+  /// views of input training data
+  lds::UniformMatrixList<lds::kMatFreeDim2> u() {
+    return armamexcpp::m2a_mats_view(u_mats_);
+  }
+  /// views of measurement training data
+  lds::UniformMatrixList<lds::kMatFreeDim2> z() {
+    return armamexcpp::m2a_mats_view(z_mats_);
+  }
+
+ private:
+  std::vector<TypedArray<double>> u_mats_;
+  std::vector<TypedArray<double>> z_mats_;
+};
+
+// ---------------------------------------------------------------------------
+// persistent objects
+// ---------------------------------------------------------------------------
+
+/// C++ object kept alive across mex calls
+class Handle {
+ public:
+  virtual ~Handle() = default;
+
+  /**
+   * @brief      calls method of object
+   *
+   * @param      method   method name
+   * @param      matlab   matlab engine
+   * @param      outputs  mex outputs
+   * @param      args     method arguments (i.e., after method name, handle)
+   */
+  virtual void Call(const std::string& method, MATLABEngine& matlab,
+                    ArgumentList& outputs, std::vector<Array>& args) = 0;
+};
+
+/// Persistent EM fit (keeps training data and current parameters)
+template <typename Fit, typename FitEM>
+class EMHandle : public Handle {
+ public:
+  // args: fit, u, z
+  EMHandle(MATLABEngine& matlab, std::vector<Array>& args) {
+    RequireArgs(args, 3, "new");
+    CellArray u = std::move(args[1]);
+    CellArray z = std::move(args[2]);
+    data_.Append(u, z);
+    Rebuild(ModelFromMatlab<Fit>(matlab, args[0]));
+  }
+
+  void Call(const std::string& method, MATLABEngine& matlab,
+            ArgumentList& outputs, std::vector<Array>& args) override {
+    ArrayFactory factory;
+    if (method == "run") {
+      // args: fit, [calc_dynamics, calc_Q, calc_init, calc_output,
+      // calc_measurement, max_iter, tol]
+      RequireArgs(args, 1, method);
+      em_->Run(OptionalScalar<bool>(args, 1, true),
+               OptionalScalar<bool>(args, 2, true),
+               OptionalScalar<bool>(args, 3, true),
+               OptionalScalar<bool>(args, 4, true),
+               OptionalScalar<bool>(args, 5, true),
+               OptionalScalar<size_t>(args, 6, 100),
+               OptionalScalar<data_t>(args, 7, 1e-3));
+      SetModelParams(matlab, em_->fit(), args[0]);
+      if (outputs.size() > 0) {
+        outputs[0] = factory.createScalar<double>(em_->stats().log_lik);
+      }
+    } else if (method == "append") {
+      // args: u, z (n.b., continues from current parameters)
+      RequireArgs(args, 2, method);
+      CellArray u = std::move(args[0]);
+      CellArray z = std::move(args[1]);
+      data_.Append(u, z);
+      Rebuild(em_->fit());
+    } else if (method == "get_fit") {
+      // args: fit
+      RequireArgs(args, 1, method);
+      SetModelParams(matlab, em_->fit(), args[0]);
+    } else if (method == "set_fit") {
+      // args: fit
+      RequireArgs(args, 1, method);
+      Rebuild(ModelFromMatlab<Fit>(matlab, args[0]));
+    } else if (method == "smoothed") {
+      // outputs: y_hat, x_hat (at last E step)
+      if (outputs.size() > 0) {
+        outputs[0] = ToCell(em_->y(), factory);
+      }
+      if (outputs.size() > 1) {
+        outputs[1] = ToCell(em_->x(), factory);
+      }
+    } else if (method == "set_n_threads") {
+      RequireArgs(args, 1, method);
+      n_threads_ = OptionalScalar<size_t>(args, 0, 1);
+      em_->set_n_threads(n_threads_);
+    } else {
+      throw std::runtime_error("Unknown EM method '" + method + "'.");
+    }
+  }
+
+ private:
+  // (re)constructs EM over all training data held
+  void Rebuild(const Fit& fit) {
+    em_.reset(new FitEM(fit, data_.u(), data_.z()));
+    em_->set_n_threads(n_threads_);
+  }
+
+  TrainingData data_;
+  std::unique_ptr<FitEM> em_;
+  size_t n_threads_{1};
+};
+
+/// Persistent SSID fit (keeps running block-hankel statistics)
+template <typename Fit, typename FitSSID>
+class SSIDHandle : public Handle {
+ public:
+  // args: n_x, n_h, dt, u, z, [d0]
+  SSIDHandle(MATLABEngine& /* matlab */, std::vector<Array>& args) {
+    RequireArgs(args, 5, "new");
+    auto n_x = static_cast<size_t>(args[0][0]);
+    auto n_h = static_cast<size_t>(args[1][0]);
+    auto dt = static_cast<data_t>(args[2][0]);
+    CellArray u = std::move(args[3]);
+    CellArray z = std::move(args[4]);
+    Vector d0 = Vector(1).fill(-lds::kInf);
+    if (args.size() > 5 && !args[5].isEmpty()) {
+      d0 = armamexcpp::m2a_vec<data_t>(args[5]);
+    }
+    data_.Append(u, z);
+    ssid_.reset(new FitSSID(n_x, n_h, dt, data_.u(), data_.z(), d0));
+  }
+
+  void Call(const std::string& method, MATLABEngine& matlab,
+            ArgumentList& outputs, std::vector<Array>& args) override {
+    ArrayFactory factory;
+    Fit fit;
+    Vector sing_vals;
+    if (method == "run") {
+      // args: fit, [which_wt, n_sv]
+      RequireArgs(args, 1, method);
+      std::tie(fit, sing_vals) =
+          ssid_->Run(ToSSIDWt(OptionalScalar<size_t>(args, 1, 0)),
+                     OptionalScalar<size_t>(args, 2, 0));
+    } else if (method == "update") {
+      // args: fit, u, z, [which_wt, n_sv] (n.b., new data replace those held)
+      RequireArgs(args, 3, method);
+      CellArray u = std::move(args[1]);
+      CellArray z = std::move(args[2]);
+      data_.Replace(u, z);
+      std::tie(fit, sing_vals) =
+          ssid_->Update(data_.u(), data_.z(),
+                        ToSSIDWt(OptionalScalar<size_t>(args, 3, 0)),
+                        OptionalScalar<size_t>(args, 4, 0));
+    } else if (method == "set_n_threads") {
+      RequireArgs(args, 1, method);
+      ssid_->set_n_threads(OptionalScalar<size_t>(args, 0, 1));
+      return;
+    } else {
+      throw std::runtime_error("Unknown SSID method '" + method + "'.");
+    }
+
+    SetModelParams(matlab, fit, args[0]);
+    if (outputs.size() > 0) {
+      outputs[0] = armamexcpp::a2m_vec<data_t>(sing_vals, factory);
+    }
+  }
+
+ private:
+  TrainingData data_;
+  std::unique_ptr<FitSSID> ssid_;
+};
+
+/// Persistent controller (keeps state estimate, integral error, etc.)
+template <typename System, typename Controller>
+class ControllerHandle : public Handle {
+ public:
+  // args: sys, u_lb, u_ub, [control_type]
+  ControllerHandle(MATLABEngine& matlab, std::vector<Array>& args) {
+    RequireArgs(args, 3, "new");
+    System sys = ModelFromMatlab<System>(matlab, args[0]);
+    sys.Reset();
+    controller_ = Controller(std::move(sys), static_cast<data_t>(args[1][0]),
+                             static_cast<data_t>(args[2][0]),
+                             OptionalScalar<size_t>(args, 3, 0));
+  }
+
+  void Call(const std::string& method, MATLABEngine& /* matlab */,
+            ArgumentList& outputs, std::vector<Array>& args) override {
+    using armamexcpp::m2a_mat;
+    using armamexcpp::m2a_vec;
+    ArrayFactory factory;
+    if (method == "control" || method == "control_output_reference") {
+      // args: z, [do_control]; outputs: u, [x, y]
+      RequireArgs(args, 1, method);
+      Vector z = m2a_vec<data_t>(args[0]);
+      bool do_control = OptionalScalar<bool>(args, 1, true);
+      const Vector& u = (method == "control")
+                            ? controller_.Control(z, do_control)
+                            : controller_.ControlOutputReference(z, do_control);
+      if (outputs.size() > 0) {
+        outputs[0] = armamexcpp::a2m_vec<data_t>(u, factory);
+      }
+      if (outputs.size() > 1) {
+        outputs[1] =
+            armamexcpp::a2m_vec<data_t>(controller_.sys().x(), factory);
+      }
+      if (outputs.size() > 2) {
+        outputs[2] =
+            armamexcpp::a2m_vec<data_t>(controller_.sys().y(), factory);
+      }
+    } else if (method == "set_gains") {
+      // args: Kc, [Kc_inty, Kc_u] (n.b., empty = unchanged)
+      RequireArgs(args, 1, method);
+      if (!args[0].isEmpty()) {
+        controller_.set_Kc(m2a_mat<data_t>(args[0]));
+      }
+      if (args.size() > 1 && !args[1].isEmpty()) {
+        controller_.set_Kc_inty(m2a_mat<data_t>(args[1]));
+      }
+      if (args.size() > 2 && !args[2].isEmpty()) {
+        controller_.set_Kc_u(m2a_mat<data_t>(args[2]));
+      }
+    } else if (method == "design_lqr") {
+      // args: [q_inty_over_q_y, r_over_q_y]
+      controller_.DesignLQR(OptionalScalar<data_t>(args, 0, 1),
+                            OptionalScalar<data_t>(args, 1, 1));
+    } else if (method == "set_y_ref") {
+      RequireArgs(args, 1, method);
+      controller_.set_y_ref(m2a_vec<data_t>(args[0]));
+    } else if (method == "set_x_ref") {
+      RequireArgs(args, 1, method);
+      controller_.set_x_ref(m2a_vec<data_t>(args[0]));
+    } else if (method == "set_u_ref") {
+      RequireArgs(args, 1, method);
+      controller_.set_u_ref(m2a_vec<data_t>(args[0]));
+    } else if (method == "reset") {
+      controller_.Reset();
+    } else {
+      throw std::runtime_error("Unknown controller method '" + method + "'.");
+    }
+  }
+
+ private:
+  Controller controller_;
+};
+
+// constructs new object of named type
+std::unique_ptr<Handle> NewHandle(const std::string& type,
+                                  MATLABEngine& matlab,
+                                  std::vector<Array>& args) {
+  std::unique_ptr<Handle> handle;
+  if (type == "glds_em") {
+    handle.reset(new EMHandle<lds::gaussian::Fit, lds::gaussian::FitEM>(
+        matlab, args));
+  } else if (type == "plds_em") {
+    handle.reset(new EMHandle<lds::poisson::Fit, lds::poisson::FitEM>(
+        matlab, args));
+  } else if (type == "glds_ssid") {
+    handle.reset(new SSIDHandle<lds::gaussian::Fit, lds::gaussian::FitSSID>(
+        matlab, args));
+  } else if (type == "plds_ssid") {
+    handle.reset(new SSIDHandle<lds::poisson::Fit, lds::poisson::FitSSID>(
+        matlab, args));
+  } else if (type == "glds_ctrl") {
+    handle.reset(
+        new ControllerHandle<lds::gaussian::System, lds::gaussian::Controller>(
+            matlab, args));
+  } else if (type == "plds_ctrl") {
+    handle.reset(
+        new ControllerHandle<lds::poisson::System, lds::poisson::Controller>(
+            matlab, args));
+  } else {
+    throw std::runtime_error("Unknown object type '" + type + "'.");
+  }
+  return handle;
+}
+
+}  // namespace
+
+class MexFunction : public matlab::mex::Function {
+ private:
+  std::shared_ptr<matlab::engine::MATLABEngine> matlab_ptr_;
+
+  // n.b., objects persist until deleted or the mex is cleared
+  std::map<std::uint64_t, std::unique_ptr<Handle>> handles_;
+  std::uint64_t next_id_{1};
+
+ public:
+  /* Constructor for the class. */
+  MexFunction() { matlab_ptr_ = getEngine(); }
+
+  void operator()(ArgumentList outputs, ArgumentList inputs) {
+    checkArguments(outputs, inputs);
+    ArrayFactory factory;
+
+    try {
+      std::string method = ToString(inputs[0]);
+      // arguments after method name and type/handle
+      std::vector<Array> args(inputs.begin() + 2, inputs.end());
+
+      if (method == "new") {
+        std::uint64_t id = next_id_++;
+        handles_[id] = NewHandle(ToString(inputs[1]), *matlab_ptr_, args);
+        if (outputs.size() > 0) {
+          outputs[0] = factory.createScalar<double>(id);
+        }
+        return;
+      }
+
+      auto id = static_cast<std::uint64_t>(inputs[1][0]);
+      auto it = handles_.find(id);
+      if (it == handles_.end()) {
+        throw std::runtime_error("Invalid object handle.");
+      }
+      if (method == "delete") {
+        handles_.erase(it);
+      } else {
+        it->second->Call(method, *matlab_ptr_, outputs, args);
+      }
+    } catch (const std::exception& e) {
+      displayError(e.what());
+    }
+  }
+
+  /* Helper function to generate an error message from given string,
+   * and display it over MATLAB command prompt.
+   */
+  void displayError(const std::string& error_message) {
+    ArrayFactory factory;
+    matlab_ptr_->feval(
+        u"error", 0, std::vector<Array>({factory.createScalar(error_message)}));
+  }
+
+  void checkArguments(ArgumentList outputs, ArgumentList inputs) {
+    if (inputs.size() < 2) {
+      displayError("At least 2 arguments required.");
+    }
+    if (outputs.size() > 3) {
+      displayError("Too many outputs requested.");
+    }
+  }
+};
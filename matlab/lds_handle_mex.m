@@ -0,0 +1,29 @@
+% h = lds_handle_mex('new', type, ...)
+% [...] = lds_handle_mex(method, h, ...)
+% lds_handle_mex('delete', h)
+%
+% Create/use C++ objects kept alive across calls (until deleted or the mex is cleared), such that training data are not re-copied and filter/controller state persists between calls. See LDSHandle for a wrapper that deletes the object along with the handle.
+%
+% TYPES/METHODS
+% 'glds_em', 'plds_em': new(fit, u, z)
+%   log_lik = run(fit, [calc_dynamics, calc_Q, calc_init, calc_output, calc_measurement, max_iter, tol]): continue refitting; updates fit
+%   append(u, z): add trials (n.b., continues from current parameters)
+%   get_fit(fit), set_fit(fit): get/set current parameters
+%   [y_hat, x_hat] = smoothed(): smoothed estimates at last E step
+%   set_n_threads(n_threads)
+% 'glds_ssid', 'plds_ssid': new(n_x, n_h, dt, u, z, [d0])
+%   singVals = run(fit, [which_wt, n_sv]): fit by SSID; updates fit
+%   singVals = update(fit, u, z, [which_wt, n_sv]): fold in new data (continuation of previous data)
+%   set_n_threads(n_threads)
+% 'glds_ctrl', 'plds_ctrl': new(sys, u_lb, u_ub, [control_type])
+%   [u, x, y] = control(z, [do_control]), control_output_reference(z, [do_control])
+%   set_gains(Kc, [Kc_inty, Kc_u]), design_lqr([q_inty_over_q_y, r_over_q_y])
+%   set_y_ref(y_ref), set_x_ref(x_ref), set_u_ref(u_ref), reset()
+%
+% INPUTS
+% fit/sys: GLDS/PLDS object
+% u: input, cellarray(nTrials,1), where each trial is numericarray{double}(nU, nSamps)
+% z: measurement, cellarray(nTrials,1), where each trial is numericarray{double}(nY, nSamps)
+% which_wt: no weighting [0], MOESP [1], CVA [2]
+%
+% n.b., training data are referenced rather than copied, so must not be modified in place by mex functions while an object holds them.
@@ -43,25 +43,20 @@ class MexFunction : public matlab::mex::Function {
       n_h = static_cast<size_t>(inputs[5][0]);
     }
     if (n_inputs > 6) {
-      TypedArray<data_t> d0_matlab = std::move(inputs[6]);
+      TypedArray<double> d0_matlab = std::move(inputs[6]);
       d0 = armamexcpp::m2a_vec<data_t>(d0_matlab);
     }
     if (n_inputs > 7) {
       which_wt = static_cast<size_t>(inputs[7][0]);
     }
 
-    lds::UniformMatrixList<lds::kMatFreeDim2> u;
-    lds::UniformMatrixList<lds::kMatFreeDim2> z;
-    {
-      std::vector<lds::Matrix> tmp =
-          std::move(armamexcpp::m2a_cellmat<data_t>(u_matlab));
-      u = lds::UniformMatrixList<lds::kMatFreeDim2>(std::move(tmp));
-    }
-    {
-      std::vector<lds::Matrix> tmp =
-          std::move(armamexcpp::m2a_cellmat<data_t>(z_matlab));
-      z = lds::UniformMatrixList<lds::kMatFreeDim2>(std::move(tmp));
-    }
+    // n.b., training data are read in place (views of matlab memory)
+    std::vector<TypedArray<double>> u_mats;
+    std::vector<TypedArray<double>> z_mats;
+    lds::UniformMatrixList<lds::kMatFreeDim2> u =
+        armamexcpp::m2a_cellmat_view(u_matlab, u_mats);
+    lds::UniformMatrixList<lds::kMatFreeDim2> z =
+        armamexcpp::m2a_cellmat_view(z_matlab, z_mats);
 
     lds::poisson::FitSSID ssid(n_x, n_h, dt, std::move(u), std::move(z), d0);
 
@@ -82,15 +77,15 @@ class MexFunction : public matlab::mex::Function {
     lds::Vector sing_vals_fit;
     std::tie(lds_fit, sing_vals_fit) = ssid.Run(wt);
 
-    TypedArray<data_t> a = armamexcpp::a2m_mat<data_t>(lds_fit.A(), factory);
-    TypedArray<data_t> b = armamexcpp::a2m_mat<data_t>(lds_fit.B(), factory);
-    TypedArray<data_t> g = armamexcpp::a2m_vec<data_t>(lds_fit.g(), factory);
-    TypedArray<data_t> m = armamexcpp::a2m_vec<data_t>(lds_fit.m(), factory);
-    TypedArray<data_t> q = armamexcpp::a2m_mat<data_t>(lds_fit.Q(), factory);
-    TypedArray<data_t> x0 = armamexcpp::a2m_vec<data_t>(lds_fit.x0(), factory);
-    TypedArray<data_t> p0 = armamexcpp::a2m_mat<data_t>(lds_fit.P0(), factory);
-    TypedArray<data_t> c = armamexcpp::a2m_mat<data_t>(lds_fit.C(), factory);
-    TypedArray<data_t> d = armamexcpp::a2m_vec<data_t>(lds_fit.d(), factory);
+    TypedArray<double> a = armamexcpp::a2m_mat<data_t>(lds_fit.A(), factory);
+    TypedArray<double> b = armamexcpp::a2m_mat<data_t>(lds_fit.B(), factory);
+    TypedArray<double> g = armamexcpp::a2m_vec<data_t>(lds_fit.g(), factory);
+    TypedArray<double> m = armamexcpp::a2m_vec<data_t>(lds_fit.m(), factory);
+    TypedArray<double> q = armamexcpp::a2m_mat<data_t>(lds_fit.Q(), factory);
+    TypedArray<double> x0 = armamexcpp::a2m_vec<data_t>(lds_fit.x0(), factory);
+    TypedArray<double> p0 = armamexcpp::a2m_mat<data_t>(lds_fit.P0(), factory);
+    TypedArray<double> c = armamexcpp::a2m_mat<data_t>(lds_fit.C(), factory);
+    TypedArray<double> d = armamexcpp::a2m_vec<data_t>(lds_fit.d(), factory);
 
     matlab_ptr_->setProperty(fit0, u"dt", factory.createScalar(dt));
     matlab_ptr_->setProperty(fit0, u"A", a);
@@ -103,7 +98,7 @@ class MexFunction : public matlab::mex::Function {
     matlab_ptr_->setProperty(fit0, u"x0", x0);
     matlab_ptr_->setProperty(fit0, u"P0", p0);
     if (outputs.size() > 0) {
-      TypedArray<data_t> sing_vals =
+      TypedArray<double> sing_vals =
           armamexcpp::a2m_vec<data_t>(sing_vals_fit, factory);
       outputs[0] = std::move(sing_vals);
     }
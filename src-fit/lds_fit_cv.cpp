@@ -0,0 +1,147 @@
+//===-- lds_fit_cv.cpp - Cross-Validation ---------------------------------===//
+//
+// Copyright 2021 Michael Bolus
+// Copyright 2021 Georgia Institute of Technology
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file implements the scoring of held-out data by one-step-ahead
+/// predictive log-likelihood, used for cross-validation (lds::CrossValidate).
+///
+/// \brief k-fold cross-validation
+//===----------------------------------------------------------------------===//
+
+#include <ldsCtrlEst_h/lds_fit_cv.h>
+#include <ldsCtrlEst_h/lds_gaussian_sys.h>
+#include <ldsCtrlEst_h/lds_poisson_sys.h>
+
+namespace lds {
+
+namespace {
+/**
+ * @brief      constructs a system with the parameters of a fit
+ *
+ * @param      fit   fit
+ *
+ * @tparam     System  system type
+ * @tparam     Fit     fit type
+ *
+ * @return     system (reset to initial conditions)
+ */
+template <typename System, typename Fit>
+System FitToSystem(const Fit& fit) {
+  System sys(fit.n_u(), fit.n_x(), fit.n_y(), fit.dt());
+  sys.set_A(fit.A());
+  sys.set_B(fit.B());
+  sys.set_g(fit.g());
+  sys.set_m(fit.m(), true);
+  sys.set_Q(fit.Q());
+  sys.set_x0(fit.x0());
+  sys.set_P0(fit.P0());
+  sys.set_C(fit.C());
+  sys.set_d(fit.d());
+  return sys;
+}
+
+/**
+ * The initial conditions are the prior of the first time step (as in EM), so
+ * the first measurement is scored but, since System::Filter predicts before
+ * it updates, not assimilated.
+ *
+ * @brief      scores each measurement under its one-step-ahead prediction
+ *
+ * @param      sys       system (filtered in place)
+ * @param      u         input
+ * @param      z         measurement
+ * @param      log_pred  log-likelihood of a measurement given predicted state
+ *                       and covariance
+ *
+ * @tparam     System   system type
+ * @tparam     LogPred  callable (const Vector& z, const Vector& x_pre, const
+ *                      Matrix& P_pre) -> data_t
+ *
+ * @return     log-likelihood
+ */
+template <typename System, typename LogPred>
+data_t FilterLogLik(System& sys, const Matrix& u, const Matrix& z,
+                    LogPred log_pred) {
+  if ((u.n_cols != z.n_cols) || (u.n_rows != sys.n_u()) ||
+      (z.n_rows != sys.n_y())) {
+    throw std::runtime_error("Held-out data do not match dimensions of fit.");
+  }
+
+  sys.Reset();
+  data_t log_lik = log_pred(z.col(0), sys.x(), sys.P());
+  Vector x_pre(sys.n_x());
+  Matrix p_pre(sys.n_x(), sys.n_x());
+  for (size_t t = 1; t < z.n_cols; t++) {
+    // predict from posterior of t-1 (n.b., as System::Filter)
+    x_pre = sys.A() * sys.x() + sys.B() * (sys.g() % u.col(t - 1)) + sys.m();
+    p_pre = sys.A() * sys.P() * sys.A().t() + sys.Q();
+    log_lik += log_pred(z.col(t), x_pre, p_pre);
+    sys.Filter(u.col(t - 1), z.col(t));
+  }
+  return log_lik;
+}
+}  // namespace
+
+namespace gaussian {
+data_t PredictiveLogLik(const Fit& fit, const Matrix& u, const Matrix& z) {
+  auto sys = FitToSystem<System>(fit);
+  sys.set_R(fit.R());
+
+  Matrix s(fit.n_y(), fit.n_y());
+  Matrix chol_s(fit.n_y(), fit.n_y());
+  auto log_pred = [&](const Vector& z_t, const Vector& x_pre,
+                      const Matrix& p_pre) -> data_t {
+    // log N(z; C*x_pre + d, S), S = C*P_pre*C' + R
+    s = fit.C() * p_pre * fit.C().t() + fit.R();
+    ForceSymPD(s);
+    if (!arma::chol(chol_s, s, "lower")) {
+      throw std::runtime_error(
+          "Innovation covariance is not positive definite.");
+    }
+    Vector e = arma::solve(arma::trimatl(chol_s),
+                           z_t - (fit.C() * x_pre + fit.d()));
+    data_t log_det_s = 2 * accu(log(chol_s.diag()));
+    return -(log_det_s + dot(e, e) + fit.n_y() * std::log(2 * kPi)) / 2;
+  };
+  return FilterLogLik(sys, u, z, log_pred);
+}
+}  // namespace gaussian
+
+namespace poisson {
+data_t PredictiveLogLik(const Fit& fit, const Matrix& u, const Matrix& z) {
+  auto sys = FitToSystem<System>(fit);
+
+  auto log_pred = [&](const Vector& z_t, const Vector& x_pre,
+                      const Matrix& p_pre) -> data_t {
+    // log Pr(z; y_pre) = sum(z*log(y_pre) - y_pre - log(z!))
+    Vector log_y = fit.C() * x_pre + fit.d();
+    data_t log_lik = 0;
+    for (size_t k = 0; k < z_t.n_elem; k++) {
+      log_lik -= std::exp(log_y[k]);
+      if (z_t[k] != 0) {
+        log_lik += z_t[k] * log_y[k] - std::lgamma(z_t[k] + 1);
+      }
+    }
+    return log_lik;
+  };
+  return FilterLogLik(sys, u, z, log_pred);
+}
+}  // namespace poisson
+
+}  // namespace lds
@@ -28,6 +28,9 @@
 /// [2] Ghahramani Z, Hinton GE. (1996) Parameter Estimation for Linear
 /// Dynamical Systems. Technical Report CRG-TR-96-2.
 ///
+/// [3] Sarkka S, Garcia-Fernandez AF. (2021) Temporal Parallelization of
+/// Bayesian Smoothers. IEEE Transactions on Automatic Control 66(1).
+///
 /// \brief GLDS E-M fit type
 //===----------------------------------------------------------------------===//
 
@@ -36,7 +39,55 @@
 namespace lds {
 namespace gaussian {
 
-void FitEM::RecurseKe(Matrix& Ke, Cube& P_pre, Cube& P_post, size_t t) {
+namespace {
+// Associative element of the Kalman filter [3], such that combining the
+// filtered estimate (m, P) before a sequence of time steps, as the element
+// (0, m, P, 0, 0), with that of the sequence gives the filtered estimate
+// after it (b, c)
+struct FilterElement {
+  Matrix a;
+  Vector b;
+  Matrix c;
+  Vector eta;
+  Matrix j;
+};
+
+// Associative element of the RTS smoother [3], such that the smoothed
+// estimate before a sequence of (backward) time steps is e*x + g, with cov
+// e*P*e' + l, given the smoothed estimate (x, P) after it
+struct SmootherElement {
+  Matrix e;
+  Vector g;
+  Matrix l;
+};
+
+// combines element el_i with the element of the following time steps, el_j
+// (in place of el_i)
+void Combine(FilterElement& el_i, const FilterElement& el_j) {
+  size_t n_x = el_i.c.n_rows;
+  Matrix id(n_x, n_x, fill::eye);
+  // n.b., (I + C_i*J_j)' = I + J_j*C_i, so all terms need only one solve
+  Matrix w = arma::solve(
+      Matrix(id + el_j.j * el_i.c),
+      Matrix(join_horiz(join_horiz(el_j.a.t(), el_j.eta - el_j.j * el_i.b),
+                        el_j.j * el_i.a)));
+  Matrix am = w.cols(0, n_x - 1).t();  // A_j*inv(I + C_i*J_j)
+
+  Vector b = am * (el_i.b + el_i.c * el_j.eta) + el_j.b;
+  Matrix c = am * el_i.c * el_j.a.t() + el_j.c;
+  Vector eta = el_i.a.t() * w.col(n_x) + el_i.eta;
+  Matrix j = el_i.a.t() * w.cols(n_x + 1, 2 * n_x) + el_i.j;
+
+  el_i.a = am * el_i.a;
+  el_i.b = std::move(b);
+  el_i.c = (c + c.t()) / 2;
+  el_i.eta = std::move(eta);
+  el_i.j = (j + j.t()) / 2;
+}
+}  // namespace
+
+void FitEM::RecurseKe(Matrix& Ke, Cube& P_pre, Cube& P_post,
+                      const Vector& y_pre, size_t t) {
   // predict covar
   P_pre.slice(t) = fit_.A() * P_post.slice(t - 1) * fit_.A().t() + fit_.Q();
   ForceSymPD(P_pre.slice(t));
@@ -51,45 +102,252 @@ void FitEM::RecurseKe(Matrix& Ke, Cube& P_pre, Cube& P_post, size_t t) {
   ForceSymPD(P_post.slice(t));
 }
 
+data_t FitEM::LogLikelihood(const Vector& z, const Vector& y_pre,
+                            const Matrix& P_pre, bool is_steady,
+                            LikelihoodCache& cache) const {
+  // innovation cov, S = C*P_pre*C' + R (only refactored if it could change)
+  if (!is_steady || cache.chol_s.is_empty()) {
+    Matrix s = fit_.C() * P_pre * fit_.C().t() + fit_.R();
+    ForceSymPD(s);
+    if (!arma::chol(cache.chol_s, s, "lower")) {
+      throw std::runtime_error(
+          "Innovation covariance is not positive definite.");
+    }
+    cache.log_det_s = 2 * accu(log(cache.chol_s.diag()));
+  }
+
+  // log N(z; y_pre, S)
+  Vector e = arma::solve(arma::trimatl(cache.chol_s), z - y_pre);
+  return -(cache.log_det_s + dot(e, e) + n_y_ * std::log(2 * kPi)) / 2;
+}
+
 void FitEM::MaximizeOutput() {
   // solve for C+d:
-  Matrix sum_zx(n_y_, n_x_ + 1, fill::zeros);
-  Vector x1(n_x_ + 1, fill::zeros);
-  x1[n_x_] = 1.0;  // augment with one to solve for bias
+  // (augment state with one to solve for bias)
+  Matrix sum_zx = join_horiz(sum_z_x_t_, sum_z_t_);
   Matrix sum_e_x1_x1(n_x_ + 1, n_x_ + 1, fill::zeros);
-  for (size_t trial = 0; trial < z_.size(); trial++) {
-    for (size_t t = 1; t < n_t_[trial]; t++) {
-      x1.subvec(0, n_x_ - 1) = x_[trial].col(t);
-      sum_zx += z_.at(trial).col(t) * x1.t();
-      sum_e_x1_x1 += x1 * x1.t();
-      sum_e_x1_x1.submat(0, 0, n_x_ - 1, n_x_ - 1) += P_[trial].slice(t);
-    }
-  }
+  sum_e_x1_x1.submat(0, 0, n_x_ - 1, n_x_ - 1) = sum_E_x_t_x_t_;
+  sum_e_x1_x1.submat(0, n_x_, n_x_ - 1, n_x_) = sum_E_x_t_;
+  sum_e_x1_x1.submat(n_x_, 0, n_x_, n_x_ - 1) = sum_E_x_t_.t();
+  sum_e_x1_x1(n_x_, n_x_) = n_t_tot_;
   Matrix cd = sum_zx * inv_sympd(sum_e_x1_x1);
   fit_.set_C(cd.submat(0, 0, n_y_ - 1, n_x_ - 1));
   fit_.set_d(vectorise(cd.submat(0, n_x_, n_y_ - 1, n_x_)));
-  std::cout << "C_new[0]: " << fit_.C()[0] << "\n";
-  std::cout << "d_new[0]: " << fit_.d()[0] << "\n";
 }
 
 void FitEM::MaximizeMeasurement() {
   // Solve for measurement noise covar
-  size_t n_t_tot = 0;
   // Ghahgramani, Hinton 1996:
-  Matrix sum_zz(n_y_, n_y_, fill::zeros);
-  Matrix sum_yz(n_y_, n_y_, fill::zeros);
-  for (size_t trial = 0; trial < z_.size(); trial++) {
-    for (size_t t = 1; t < n_t_[trial]; t++) {
-      sum_zz += z_.at(trial).col(t) * z_.at(trial).col(t).t();
-      // Use Cnew:
-      sum_yz +=
-          (fit_.C() * x_[trial].col(t) + fit_.d()) * z_.at(trial).col(t).t();
-      n_t_tot += 1;
+  // Use Cnew:
+  Matrix sum_yz = fit_.C() * sum_z_x_t_.t() + fit_.d() * sum_z_t_.t();
+  fit_.set_R((sum_z_z_t_ - sum_yz) / n_t_tot_);
+}
+
+bool FitEM::DoesSmoothByScan(size_t trial) const {
+  // n.b., the scan keeps the filter estimates of the whole trial
+  return (scan_min_n_t_ > 0) && (n_t_[trial] >= scan_min_n_t_) &&
+         (n_threads() > 1) && !packed_cov_ &&
+         (SmootherSegmentLength(n_t_[trial]) == n_t_[trial] - 1);
+}
+
+void FitEM::ScanSmoothTrial(size_t trial, bool force_common_initial,
+                            SufficientStats& stats) {
+  bool do_store_cov = DoesStoreCov();
+  InitSmoothTrial(trial, force_common_initial);
+
+  // The trial is split into blocks of time steps [t_begin, t_last], one per
+  // thread. Reducing each block to its filter element lets the filtered
+  // estimates at the block boundaries be found by combining elements across
+  // blocks only. Then all blocks are filtered concurrently, and the same goes
+  // for the backward pass, with smoother elements.
+  size_t t_end = n_t_[trial] - 1;
+  size_t n_blocks = std::min(n_threads(), t_end);
+  std::vector<size_t> t_begin(n_blocks);
+  std::vector<size_t> t_last(n_blocks);
+  for (size_t k = 0; k < n_blocks; k++) {
+    t_begin[k] = 1 + k * t_end / n_blocks;
+    t_last[k] = (k + 1) * t_end / n_blocks;
+  }
+
+  const Matrix& a = fit_.A();
+  const Matrix& b = fit_.B();
+  const Matrix& c = fit_.C();
+  const Vector& d = fit_.d();
+  const Matrix& u = u_.at(trial);
+  const Matrix& z = z_.at(trial);
+
+  // filter element of a single time step [3], of which only b, eta depend on
+  // the data
+  Matrix s = c * fit_.Q() * c.t() + fit_.R();
+  ForceSymPD(s);
+  Matrix s_inv_ca = arma::solve(s, Matrix(c * a));      // inv(S)*C*A
+  Matrix k = fit_.Q() * arma::solve(s, c).t();           // Q*C'*inv(S)
+  Matrix i_kc = Matrix(n_x_, n_x_, fill::eye) - k * c;  // I - K*C
+  FilterElement el_t;
+  el_t.a = i_kc * a;
+  el_t.c = i_kc * fit_.Q();
+  el_t.c = (el_t.c + el_t.c.t()) / 2;
+  el_t.j = (c * a).t() * s_inv_ca;
+  el_t.j = (el_t.j + el_t.j.t()) / 2;
+  auto set_data = [&](FilterElement& el, size_t t) {
+    Vector bu = b * u.col(t - 1);
+    Vector e = z.col(t) - d - c * bu;
+    el.b = bu + k * e;
+    el.eta = s_inv_ca.t() * e;
+  };
+
+  // filter elements of blocks (n.b., not needed for last)
+  std::vector<FilterElement> block_filt(n_blocks);
+  ForEach(n_blocks - 1, [&](size_t kb) {
+    FilterElement& el_block = block_filt[kb];
+    el_block = el_t;
+    set_data(el_block, t_begin[kb]);
+    FilterElement el = el_t;
+    for (size_t t = t_begin[kb] + 1; t <= t_last[kb]; t++) {
+      set_data(el, t);
+      Combine(el_block, el);
     }
+  });
+
+  // filtered estimates at the start of blocks (i.e., t_begin-1)
+  std::vector<Vector> x_bound(n_blocks);
+  std::vector<Matrix> p_bound(n_blocks);
+  x_bound[0] = x_[trial].col(0);
+  p_bound[0] = P_[trial].slice(0);
+  for (size_t kb = 1; kb < n_blocks; kb++) {
+    FilterElement el;
+    el.a = Matrix(n_x_, n_x_, fill::zeros);
+    el.b = x_bound[kb - 1];
+    el.c = p_bound[kb - 1];
+    el.eta = Vector(n_x_, fill::zeros);
+    el.j = Matrix(n_x_, n_x_, fill::zeros);
+    Combine(el, block_filt[kb - 1]);
+    x_bound[kb] = std::move(el.b);
+    p_bound[kb] = std::move(el.c);
+    ForceSymPD(p_bound[kb]);
   }
-  fit_.set_R((sum_zz - sum_yz) / n_t_tot);
-  std::cout << "R_new[0]: " << fit_.R()[0] << "\n";
-}
+
+  // filter each block, then get its smoother elements
+  struct Block {
+    Matrix x_pre;
+    Matrix x_post;
+    Cube p_pre;
+    Cube p_post;
+    Matrix y;
+    Matrix k_e;
+    SmootherElement el_smooth;  // smoother element of whole block
+    SufficientStats stats;
+    data_t log_lik{};
+  };
+  std::vector<Block> blocks(n_blocks);
+  ForEach(n_blocks, [&](size_t kb) {
+    Block& blk = blocks[kb];
+    size_t j_last = t_last[kb] - t_begin[kb] + 1;
+    blk.x_pre = Matrix(n_x_, j_last + 1, fill::zeros);
+    blk.x_post = Matrix(n_x_, j_last + 1, fill::zeros);
+    blk.p_pre = Cube(n_x_, n_x_, j_last + 1, fill::zeros);
+    blk.p_post = Cube(n_x_, n_x_, j_last + 1, fill::zeros);
+    blk.y = Matrix(n_y_, j_last + 1, fill::zeros);
+    blk.k_e = Matrix(n_x_, n_y_);
+    blk.x_post.col(0) = x_bound[kb];
+    blk.p_post.slice(0) = p_bound[kb];
+    FilterSegment(trial, t_begin[kb], t_last[kb], blk.x_pre, blk.x_post,
+                  blk.p_pre, blk.p_post, blk.y, blk.k_e, &blk.log_lik);
+    ForceSymPD(blk.p_post.slice(j_last));
+
+    // smoother elements of the backward steps t -> t-1, in place of the
+    // filter estimates that are no longer needed (i.e., to keep within the
+    // smoother memory budget): e in p_pre(j), g in x_pre(j), l in p_post(j-1)
+    SmootherElement& el_block = blk.el_smooth;
+    for (size_t t = t_last[kb]; t >= t_begin[kb]; t--) {
+      size_t j = t - t_begin[kb] + 1;  // index within block
+      ForceSymPD(blk.p_pre.slice(j));
+      ForceSymPD(blk.p_post.slice(j - 1));
+      Matrix e =
+          blk.p_post.slice(j - 1) * a.t() * inv_sympd(blk.p_pre.slice(j));
+      Matrix l = blk.p_post.slice(j - 1) - e * blk.p_pre.slice(j) * e.t();
+      blk.x_pre.col(j) = blk.x_post.col(j - 1) - e * blk.x_pre.col(j);
+      blk.p_post.slice(j - 1) = (l + l.t()) / 2;
+      blk.p_pre.slice(j) = e;
+
+      // n.b., element of first block is not needed
+      if (kb == 0) {
+        continue;
+      }
+      if (t == t_last[kb]) {
+        el_block.e = e;
+        el_block.g = blk.x_pre.col(j);
+        el_block.l = blk.p_post.slice(j - 1);
+      } else {
+        el_block.g = e * el_block.g + blk.x_pre.col(j);
+        el_block.l = e * el_block.l * e.t() + blk.p_post.slice(j - 1);
+        el_block.e = e * el_block.e;
+      }
+    }
+  });
+
+  // smoothed estimates at the end of blocks (i.e., t_last)
+  std::vector<Matrix> p_smooth(n_blocks);
+  size_t j_end = t_end - t_begin.back() + 1;  // index of t_end within block
+  x_[trial].col(t_end) = blocks.back().x_post.col(j_end);
+  p_smooth.back() = blocks.back().p_post.slice(j_end);
+  for (size_t kb = n_blocks - 1; kb > 0; kb--) {
+    const SmootherElement& el = blocks[kb].el_smooth;
+    x_[trial].col(t_last[kb - 1]) = el.e * x_[trial].col(t_last[kb]) + el.g;
+    p_smooth[kb - 1] = el.e * p_smooth[kb] * el.e.t() + el.l;
+    ForceSymPD(p_smooth[kb - 1]);
+  }
+
+  // smooth each block
+  ForEach(n_blocks, [&](size_t kb) {
+    Block& blk = blocks[kb];
+    InitStats(blk.stats);
+    Matrix p_t = p_smooth[kb];  // smoothed cov at t
+    Matrix p_tm1;               // smoothed cov at t-1
+    Matrix p_t_tm1;             // smoothed single-lag cov (t, t-1)
+    for (size_t t = t_last[kb]; t >= t_begin[kb]; t--) {
+      size_t j = t - t_begin[kb] + 1;  // index within block
+      const Matrix& e = blk.p_pre.slice(j);
+      if ((t == t_begin[kb]) && (kb > 0)) {
+        p_tm1 = p_smooth[kb - 1];  // end of previous block
+      } else {
+        x_[trial].col(t - 1) = e * x_[trial].col(t) + blk.x_pre.col(j);
+        p_tm1 = e * p_t * e.t() + blk.p_post.slice(j - 1);
+        ForceSymPD(p_tm1);
+      }
+      p_t_tm1 = p_t * e.t();
+
+      AccumulateCovStats(p_t, p_tm1, p_t_tm1, blk.stats);
+      if (do_store_cov) {
+        P_[trial].slice(t) = p_t;
+      }
+      p_t.swap(p_tm1);
+    }
+    if (kb == 0) {
+      P_[trial].slice(0) = p_t;
+    }
+
+    // smoothed estimate of output
+    for (size_t t = (kb == 0) ? 0 : t_begin[kb]; t <= t_last[kb]; t++) {
+      fit_.h(y_[trial], x_[trial], t);
+    }
+  });
+
+  // n.b., reduced in block order
+  InitStats(stats);
+  for (const Block& blk : blocks) {
+    stats.x_t_x_t += blk.stats.x_t_x_t;
+    stats.xu_tm1_xu_tm1 += blk.stats.xu_tm1_xu_tm1;
+    stats.xu_t_xu_tm1 += blk.stats.xu_t_xu_tm1;
+    stats.x_t += blk.stats.x_t;
+    stats.z_x_t += blk.stats.z_x_t;
+    stats.z_t += blk.stats.z_t;
+    stats.z_z_t += blk.stats.z_z_t;
+    stats.n_t += blk.stats.n_t;
+    stats.log_lik += blk.log_lik;
+  }
+  AccumulateMeanStats(trial, stats);
+}  // ScanSmoothTrial
 
 }  // namespace gaussian
 }  // namespace lds
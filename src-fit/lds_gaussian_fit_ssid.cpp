@@ -45,8 +45,7 @@ void FitSSID::DecomposeData() {
   // Depending on dataset, this may be faster:
   // Buesing CoreSSID/ssidN4SIDsmall.m:
   // "Cholesky decomposition of SIG, corresponds to QR of data matrix"
-  Matrix cov = arma::cov(D_.t(), 1) * D_.n_cols;  // undo normalization
-  L_ = arma::chol(cov, "lower");
+  L_ = arma::chol(cov_hankel_, "lower");
 }
 
 void FitSSID::SolveVanOverschee() {
@@ -40,6 +40,31 @@
 namespace lds {
 namespace poisson {
 
+void FitEM::set_sparse_C(bool do_sparse_C) {
+  do_sparse_C_ = do_sparse_C;
+  c_support_.clear();
+  if (do_sparse_C_) {
+    c_support_.resize(n_y_);
+    for (size_t p = 0; p < n_y_; p++) {
+      c_support_[p] = arma::find(fit_.C().row(p));
+    }
+  }
+  PrepareExpectation();
+}
+
+void FitEM::PrepareExpectation() {
+  if (do_sparse_C_) {
+    c_sp_ = SpMatrix(fit_.C());
+  } else {
+    c_sp_.reset();
+  }
+}
+
+Vector FitEM::SupportCoefs(size_t p) const {
+  Vector c_p = fit_.C().row(p).t();
+  return c_p.elem(c_support_[p]);
+}
+
 void FitEM::MaximizeOutput() {
   data_t tol = 1e-1;  // 1e-2;           // frac abs change
   size_t iters_allowed =
@@ -55,12 +80,6 @@ void FitEM::MaximizeOutput() {
   Vector theta_new = theta;
 
   data_t crit(0);
-  data_t n_events(0);
-  for (size_t k = 0; k < z_.size(); k++) {             // trial loop
-    for (size_t kk = 0; kk < z_.at(k).n_cols; kk++) {  // time samp loop
-      n_events += sum(z_.at(k).col(kk));
-    }
-  }
 
   // loop through multiple intereations (l)...
   for (size_t l = 0; l <= iters_allowed; l++) {
@@ -70,13 +89,14 @@ void FitEM::MaximizeOutput() {
     // joint iterations.
     AnalyticalSolveD();
     nll = NewtonSolveC();
-    std::cout << "-logL = " << (nll / n_events) << "\n";
     if ((l > 0) && ((nll - nll_prev) > 0)) {
       break;
     }
 
     theta_new = join_vert(fit_.d(), vectorise(fit_.C()));
-    crit = max(abs(theta - theta_new) / abs(theta));
+    // n.b., ignoring structurally-zero coefficients (if C sparse)
+    arma::uvec nz = arma::find(theta);
+    crit = max(abs(theta.elem(nz) - theta_new.elem(nz)) / abs(theta.elem(nz)));
 
     if (crit < tol) {
       // std::cout << "MaximizeOutput converged.\n";
@@ -86,11 +106,10 @@ void FitEM::MaximizeOutput() {
       std::cerr << "MaximizeOutput failed to converge.\n";
     }
   }  // iterations loop
-  std::cout << "C_new[0]: " << fit_.C()[0] << "\n";
-  std::cout << "d_new[0]: " << fit_.d()[0] << "\n";
 }
 
-void FitEM::RecurseKe(Matrix& Ke, Cube& P_pre, Cube& P_post, size_t t) {
+void FitEM::RecurseKe(Matrix& Ke, Cube& P_pre, Cube& P_post,
+                      const Vector& y_pre, size_t t) {
   // predict cov
   P_pre.slice(t) = fit_.A() * P_post.slice(t - 1) * fit_.A().t() + fit_.Q();
   ForceSymPD(P_pre.slice(t));
@@ -101,19 +120,14 @@ void FitEM::RecurseKe(Matrix& Ke, Cube& P_pre, Cube& P_post, size_t t) {
     std::cout << "P_PRE NOT SYMPD\n";
   }
 
-  // update cov
-  Matrix p_inv = inv_sympd(P_pre.slice(t)) + fit_.C().t() * diag_y_ * fit_.C();
-  Matrix p_inv0 = p_inv;
-  ForceSymPD(p_inv);
-
-  is_sympd = p_inv.is_sympd();
-  if (!is_sympd) {
-    std::cout << "P_INV NOT SYMPD\n";
-    p_inv.print("p_inv = ");
-    p_inv0.print("p_inv0 = ");
+  // update cov: P_post = inv(inv(P_pre) + C' * diag(y_pre) * C)
+  // (n.b., by Woodbury identity if fewer active outputs than states)
+  P_post.slice(t) = P_pre.slice(t);
+  if (do_sparse_C_) {
+    InfoUpdate(P_post.slice(t), c_sp_, y_pre);
+  } else {
+    InfoUpdate(P_post.slice(t), fit_.C(), y_pre);
   }
-
-  P_post.slice(t) = inv_sympd(p_inv);
   ForceSymPD(P_post.slice(t));
 
   is_sympd = P_post.slice(t).is_sympd();
@@ -122,7 +136,26 @@ void FitEM::RecurseKe(Matrix& Ke, Cube& P_pre, Cube& P_post, size_t t) {
   }
 
   // update Ke
-  Ke = P_post.slice(t) * fit_.C().t();
+  if (do_sparse_C_) {
+    Ke = P_post.slice(t) * c_sp_.t();
+  } else {
+    Ke = P_post.slice(t) * fit_.C().t();
+  }
+}
+
+data_t FitEM::LogLikelihood(const Vector& z, const Vector& y_pre,
+                            const Matrix& P_pre, bool is_steady,
+                            LikelihoodCache& cache) const {
+  // log Pr(z; y_pre) = sum(z*log(y_pre) - y_pre - log(z!))
+  // (n.b., only -y_pre is left of bins without events, which are most)
+  data_t log_lik = 0;
+  for (size_t k = 0; k < n_y_; k++) {
+    log_lik -= y_pre[k];
+    if (z[k] != 0) {
+      log_lik += z[k] * std::log(y_pre[k]) - std::lgamma(z[k] + 1);
+    }
+  }
+  return log_lik;
 }
 
 void FitEM::AnalyticalSolveD() {
@@ -131,13 +164,29 @@ void FitEM::AnalyticalSolveD() {
   Vector logr(n_y_, fill::zeros);
   Vector cpc(n_y_, fill::zeros);
 
+  // nonzero coefficients of each row (if C sparse)
+  std::vector<Vector> c_s(do_sparse_C_ ? n_y_ : 0);
+  for (size_t p = 0; p < c_s.size(); p++) {
+    c_s[p] = SupportCoefs(p);
+  }
+
   for (size_t k = 0; k < x_.size(); k++) {
     sum_events += sum(z_.at(k), 1);
     for (size_t kk = 0; kk < x_[k].n_cols; kk++) {
-      logr = fit_.C() * x_[k].col(kk);
-      for (size_t p = 0; p < n_y_; p++) {
-        auto c_p = fit_.C().submat(p, 0, p, n_x_ - 1);
-        cpc[p] = (c_p * P_[k].slice(kk) * c_p.t() / 2)[0];
+      if (do_sparse_C_) {
+        logr = c_sp_ * x_[k].col(kk);
+        for (size_t p = 0; p < n_y_; p++) {
+          const arma::uvec& s = c_support_[p];
+          cpc[p] = arma::as_scalar(
+                       c_s[p].t() * P_[k].slice(kk).submat(s, s) * c_s[p]) /
+                   2;
+        }
+      } else {
+        logr = fit_.C() * x_[k].col(kk);
+        for (size_t p = 0; p < n_y_; p++) {
+          auto c_p = fit_.C().submat(p, 0, p, n_x_ - 1);
+          cpc[p] = (c_p * P_[k].slice(kk) * c_p.t() / 2)[0];
+        }
       }
       logr += cpc;
       Limit(logr, -50, 50);
@@ -156,71 +205,132 @@ data_t FitEM::NewtonSolveC() {
   size_t iters_allowed =
       10;  // 100;  // how many iterations of newtons allowed for convergence
   Vector nll(n_y_, fill::zeros);
-
-  Vector f(n_x_, fill::zeros);
-  Matrix fprime(n_x_, n_x_, fill::zeros);
-  Matrix f_over_fprime(1, n_x_, fill::zeros);
-  data_t crit(0);
+  std::vector<char> did_converge(n_y_, false);
 
   Matrix c = fit_.C();
 
   // Since they are independent, conditioned on state,
   // solve output-by-output (p)
-  for (size_t p = 0; p < n_y_; p++) {  // output loop
-    auto c_p = c.submat(p, 0, p, c.n_cols - 1);
-    Vector c_p_new = vectorise(c_p);
+  // n.b., outputs are solved in parallel (if n_threads>1); each only writes
+  // its own row of c.
+  ForEach(n_y_, [&](size_t p) {
+    // n.b., if C is sparse, only the nonzero coefficients of the row (s) are
+    // solved for, given the corresponding states (i.e., rows of x and
+    // rows/cols of P), gathered once up front.
+    bool is_sparse_row = do_sparse_C_ && (c_support_[p].n_elem < n_x_);
+    size_t n_s = is_sparse_row ? c_support_[p].n_elem : n_x_;
+    std::vector<Matrix> x_s(is_sparse_row ? x_.size() : 0);
+    std::vector<Cube> p_s(is_sparse_row ? x_.size() : 0);
+    for (size_t k = 0; k < x_s.size(); k++) {
+      const arma::uvec& s = c_support_[p];
+      x_s[k] = x_[k].rows(s);
+      p_s[k].set_size(n_s, n_s, x_[k].n_cols);
+      for (size_t t = 0; t < x_[k].n_cols; t++) {
+        p_s[k].slice(t) = P_[k].slice(t).submat(s, s);
+      }
+    }
+
+    // n.b., measurements are mostly zero (e.g., spike counts in short bins),
+    // so the terms linear in z are only summed over events (z>0), once
+    std::vector<arma::uvec> events(x_.size());
+    std::vector<Vector> z_events(x_.size());
+    Vector xz(n_s, fill::zeros);  // sum_t x_t * z_t
+    for (size_t k = 0; k < x_.size(); k++) {
+      const Matrix& x_k = is_sparse_row ? x_s[k] : x_[k];
+      Vector z_kp = z_.at(k).row(p).t();
+      events[k] = arma::find(z_kp);
+      z_events[k] = z_kp.elem(events[k]);
+      xz += x_k.cols(events[k]) * z_events[k];
+    }
+
+    Vector c_p = is_sparse_row ? SupportCoefs(p) : Vector(c.row(p).t());
+    Vector c_p_new = c_p;
+    data_t d_p = fit_.d()[p];
+
+    Vector f(n_s, fill::zeros);
+    Matrix fprime(n_s, n_s, fill::zeros);
+    Vector f_over_fprime(n_s, fill::zeros);
+    Matrix r_chol;
 
     // loop through multiple intereations (l)...
-    for (size_t l = 0; l <= iters_allowed; l++) {
+    for (size_t l = 0; (n_s > 0) && (l <= iters_allowed); l++) {
       f.zeros();
       fprime.zeros();
 
-      for (size_t k = 0; k < x_.size(); k++) {          // trial loop
-        for (size_t kk = 0; kk < x_[0].n_cols; kk++) {  // time samp loop
-          // TODO(mfbolus): not sure this is correct!
-          // From a version of EM implementation written years ago, and cannot
-          // tell if these expectations are correct
-          Vector cx_cpc =
-              c_p * x_[k].col(kk) + c_p * P_[k].slice(kk) * c_p.t() / 2;
-          f += exp(fit_.d()[p] + cx_cpc)[0] *
-                   (x_[k].col(kk) + P_[k].slice(kk) * c_p.t()) -
-               z_.at(k).col(kk)[p] * x_[k].col(kk);
-
-          Matrix tmp = P_[k].slice(kk) +
-                       (x_[k].col(kk) + P_[k].slice(kk) * c_p.t()) *
-                           (x_[k].col(kk) + P_[k].slice(kk) * c_p.t()).t();
-          fprime += exp(fit_.d()[p] + cx_cpc)[0] * tmp;
-        }  // time
-      }    // trial
-      f_over_fprime = inv(fprime) * f;
-      // f_over_fprime = solve(fprime,f);
+      for (size_t k = 0; k < x_.size(); k++) {  // trial loop
+        const Matrix& x_k = is_sparse_row ? x_s[k] : x_[k];
+        const Cube& p_kc = is_sparse_row ? p_s[k] : P_[k];
+        size_t n_t = x_k.n_cols;
+        // stacked cov over time, as [P_0 ... P_T] and [vec(P_0) ... vec(P_T)]
+        const Matrix p_k(const_cast<data_t*>(p_kc.memptr()), n_s, n_s * n_t,
+                         false, true);
+        const Matrix p_k_vec(const_cast<data_t*>(p_kc.memptr()), n_s * n_s,
+                             n_t, false, true);
+
+        // TODO(mfbolus): not sure this is correct!
+        // From a version of EM implementation written years ago, and cannot
+        // tell if these expectations are correct
+        // n.b., P is symmetric, so P_t*c_p = (c_p'*P_t)'
+        Matrix pc = reshape(c_p.t() * p_k, n_s, n_t);
+        Matrix x_pc = x_k + pc;
+        // rate, i.e., exp(d + c_p'x_t + c_p'P_t*c_p/2)
+        Matrix r = exp(d_p + c_p.t() * x_k + c_p.t() * pc / 2);
+
+        f += x_pc * r.t();
+        fprime += reshape(p_k_vec * r.t(), n_s, n_s);
+        x_pc.each_row() %= arma::sqrt(r);
+        fprime += x_pc * x_pc.t();
+      }  // trial
+      f -= xz;
+
+      // Newton step by Cholesky solve (fprime is positive definite)
+      if (chol(r_chol, fprime)) {
+        f_over_fprime =
+            solve(trimatu(r_chol), solve(trimatl(r_chol.t()), f));
+      } else {
+        f_over_fprime = solve(fprime, f);
+      }
       // optionally, could change the step size if there are numerical issues
       // f_over_fprime *= 0.1;//0.05;//0.1;
       c_p_new -= f_over_fprime;
-      crit = max(abs(c_p - c_p_new.t()) / abs(c_p));
-      c_p = c_p_new.t();  // assign to old val.
+      data_t crit = max(abs(c_p - c_p_new) / abs(c_p));
+      c_p = c_p_new;  // assign to old val.
       if (crit < tol) {
+        did_converge[p] = true;
         break;
       }
-      if (l == iters_allowed) {
-        std::cerr << "NewtonSolveC failed to converge for output " << p + 1
-                  << ".\n";
-      }
     }  // iterations loop
+    if (n_s == 0) {
+      did_converge[p] = true;  // nothing to solve
+    }
+    if (is_sparse_row) {
+      for (size_t j = 0; j < n_s; j++) {
+        c(p, c_support_[p][j]) = c_p[j];
+      }
+    } else {
+      c.row(p) = c_p.t();
+    }
 
     // calculate likelihood
     nll[p] = 0;
-    Vector cx;
-    for (size_t k = 0; k < x_.size(); k++) {          // trial loop
-      for (size_t kk = 0; kk < x_[k].n_cols; kk++) {  // time samp loop
-        cx = c_p * x_[k].col(kk);
-        nll[p] += exp(fit_.d()[p] + cx[0]) -
-                  z_.at(k).col(kk)[p] * (fit_.d()[p] + cx[0]);
-      }  // time
-    }    // trial
-  }      // outputs loop
+    for (size_t k = 0; k < x_.size(); k++) {  // trial loop
+      const Matrix& x_k = is_sparse_row ? x_s[k] : x_[k];
+      Matrix dcx = d_p + c_p.t() * x_k;
+      nll[p] += accu(exp(dcx)) - dot(z_events[k], dcx.elem(events[k]));
+    }  // trial
+  });  // outputs loop
+
+  for (size_t p = 0; p < n_y_; p++) {
+    if (!did_converge[p]) {
+      std::cerr << "NewtonSolveC failed to converge for output " << p + 1
+                << ".\n";
+    }
+  }
 
   fit_.set_C(c);
+  if (do_sparse_C_) {
+    c_sp_ = SpMatrix(c);
+  }
   return (arma::sum(nll));
 }
 
@@ -40,104 +40,83 @@ void FitSSID::PoissonToGaussianMoments() {
   // for numerical reasons, Buesing 2012 adds small number to diagonal
   cov_.diag() += 1e-5;
 
-  // get the across-time mean
-  Vector mu_y(n_y_, arma::fill::zeros);
-  for (size_t trial = 0; trial < n_trials_; trial++) {
-    mu_y += arma::mean(z_.at(trial), 1);
-  }
-  mu_y /= n_trials_;
+  // get the across-time mean (of all trials seen so far)
+  Vector mu_y = sum_mean_z_ / n_trials_tot_;
 
   // make sure average rates are greater than zero
-  bool is_zero = false;
-  for (size_t k = 0; k < n_y_; k++) {
-    is_zero = mu_y[k] <= 0;
-    if (is_zero) {
-      throw std::runtime_error(
-          "One or more output channels have zero event rates. Consider "
-          "removing "
-          "those dimensions.");
-    }
+  if (arma::any(mu_y <= 0)) {
+    throw std::runtime_error(
+        "One or more output channels have zero event rates. Consider "
+        "removing "
+        "those dimensions.");
   }
 
   // will need this below:
-  Matrix mu_yy = arma::repmat(mu_y, 2 * n_h_, 1);
+  Vector mu_yy = arma::repmat(mu_y, 2 * n_h_, 1);
 
   // needed submats:
-  // input covariances
-  auto cov_uu = cov_.submat(0, 0, 2 * n_h_ * n_u_ - 1, 2 * n_h_ * n_u_ - 1);
+  // n.b., rows/cols of inputs are followed by those of outputs
+  arma::span span_u(0, 2 * n_h_ * n_u_ - 1);
+  arma::span span_y(2 * n_h_ * n_u_, 2 * n_h_ * (n_u_ + n_y_) - 1);
   // output covariances
-  auto cov_yy =
-      cov_.submat(2 * n_h_ * n_u_, 2 * n_h_ * n_u_,
-                  2 * n_h_ * (n_u_ + n_y_) - 1, 2 * n_h_ * (n_u_ + n_y_) - 1);
-  auto cov_yu = cov_.submat(2 * n_h_ * n_u_, 0, 2 * n_h_ * (n_u_ + n_y_) - 1,
-                            2 * n_h_ * n_u_ - 1);
-  auto cov_uy = cov_.submat(0, 2 * n_h_ * n_u_, 2 * n_h_ * n_u_ - 1,
-                            2 * n_h_ * (n_u_ + n_y_) - 1);
+  Matrix cov_yy = cov_(span_y, span_y);
+  // input/output covariances
+  Matrix cov_uy = cov_(span_u, span_y);
 
   // Convert from poisson to gaussian moments:
   // First, the output-only pieces of cov.
   // see CoreSSID/PoissonMomentsToGaussMoments.m
+  // n.b., as whole-matrix operations, rather than elementwise loops
 
   // Buesing makes sure minimum Fano factor at least 1.02 by default
   // TODO(mfbolus): make this a user option?
   const data_t ff_min = 1.01;  // 1.01;
-  Vector ff = cov_yy.diag() / mu_yy;
-  Vector ff_upscale_vec = ff_min / ff;
-  Limit(ff_upscale_vec, 1.0, kInf);
-  Matrix ff_upscale_mat(cov_yy.n_rows, cov_yy.n_cols, fill::ones);
-  ff_upscale_mat.each_col() %= arma::sqrt(ff_upscale_vec);
-  cov_yy = cov_yy % ff_upscale_mat % ff_upscale_mat.t();
+  Vector ff_upscale = ff_min * mu_yy / cov_yy.diag();
+  Limit(ff_upscale, 1.0, kInf);
+  ff_upscale = arma::sqrt(ff_upscale);
+  cov_yy.each_col() %= ff_upscale;
+  cov_yy.each_row() %= ff_upscale.t();
 
   // Buesing makes minimums second moment 1e-3 (for short datasets)
   // Alternatively, Buesing sets `minMoment` to 5/allT.
   // TODO(mfbolus): make this a user option?
-  const data_t m_min = 1 / static_cast<data_t>(D_.n_cols);
+  const data_t m_min = 1 / static_cast<data_t>(n_hankel_);
   // second moments
-  Matrix m(cov_yy.n_rows, cov_yy.n_cols, fill::zeros);
-  // take care of diagonel elements (variances)
-  auto m_diag = m.diag();
-  Vector alpha(cov_yy.n_rows, fill::zeros);
-  Vector beta(cov_yy.n_rows, fill::zeros);
-  for (size_t k = 0; k < cov_yy.n_rows; k++) {
-    data_t tmp = cov_yy(k, k) + pow(mu_yy[k], 2);
-    m_diag[k] = tmp < m_min ? m_min : tmp;
-    alpha[k] = pow(mu_yy[k], 2) / sqrt(m_diag[k] - mu_yy[k]);
-    beta[k] = sqrt(m_diag[k] - mu_yy[k]) / mu_yy[k];
-  }
-  Vector mu_gauss_yy = arma::log(alpha);
-  cov_yy.diag() = 2 * arma::log(beta);
-
-  // now cross terms
-  for (size_t k = 0; k < cov_yy.n_rows; k++) {
-    data_t tmp = 0;
-    for (size_t kk = k + 1; kk < cov_yy.n_cols; kk++) {
-      if (cov_yy(k, kk) != 0) {
-        m(k, kk) = tmp < m_min ? m_min : tmp;
-        cov_yy(kk, k) =
-            (2 * (log(m(k, kk)) - mu_gauss_yy[k] - mu_gauss_yy[kk]) -
-             cov_yy(k, k) - cov_yy(kk, kk)) /
-            2;
-        cov_yy(k, kk) = cov_yy(kk, k);
-      }
-    }  // kk
-  }    // k
+  Matrix m = cov_yy + mu_yy * mu_yy.t();
+  m.elem(arma::find(m < m_min)).fill(m_min);
+
+  // take care of diagonal elements (variances)
+  Vector sd_diag = arma::sqrt(m.diag() - mu_yy);
+  Vector mu_gauss_yy = arma::log(arma::square(mu_yy) / sd_diag);
+  Vector var_gauss_yy = 2 * arma::log(sd_diag / mu_yy);
+
+  // now cross terms:
+  // cov_ij = log(m_ij) - mu_i - mu_j - (cov_ii + cov_jj) / 2
+  Vector half_log_m = mu_gauss_yy + var_gauss_yy / 2;
+  Matrix cov_gauss_yy = arma::log(m);
+  cov_gauss_yy.each_col() -= half_log_m;
+  cov_gauss_yy.each_row() -= half_log_m.t();
+  // n.b., pairs without covariance are left uncorrelated
+  cov_gauss_yy.elem(arma::find(cov_yy == 0)).zeros();
+  cov_gauss_yy.diag() = var_gauss_yy;
+  cov_(span_y, span_y) = cov_gauss_yy;
 
   // the "mixed" input/output crossterms:
   // see CoreSSID/PoissonMomentsToGaussMomentsMixed.m
   // TODO(mfbolus): not sure if indexing is correct here.
   // Buesing used (k < 2*n_h_*n_u_) here
-  for (size_t k = 0; k < cov_yu.n_rows; k++) {
-    cov_uy.col(k) *= exp(-0.5 * cov_yy(k, k) * mu_gauss_yy(k));
-    cov_yu.row(k) = cov_uy.col(k).t();
-  }
+  Vector mixed_scale = arma::exp(-0.5 * var_gauss_yy % mu_gauss_yy);
+  cov_uy.each_row() %= mixed_scale.t();
+  cov_(span_u, span_y) = cov_uy;
+  cov_(span_y, span_u) = cov_uy.t();
 
   // Buesing makes sure transformed cov_yy has a min eigen value
   ForceSymMinEig(cov_, 1e-4);
 }
 
 void FitSSID::CalcCov() {
-  // TODO(mfbolus): more efficient way to do this?
-  cov_ = arma::cov(D_.t(), 1);
+  // n.b., covariance of data matrix normalized by sqrt(data length)
+  cov_ = cov_hankel_ / static_cast<data_t>(n_hankel_);
 
   // // calculate I/O gain @ DC while data in convenient form
   // Matrix u_tmp = D_.submat(0, 0, n_u_ - 1, D_.n_cols - 1);
@@ -104,6 +104,184 @@ void ForceSymMinEig(Matrix& X, data_t eig_min) {
   X = (X + X.t()) / 2;
 }
 
+void PackSym(const Matrix& X, data_t* packed) {
+  size_t n = X.n_rows;
+  for (size_t c = 0; c < n; c++) {
+    const data_t* x_c = X.colptr(c);
+    for (size_t r = 0; r < c; r++) {
+      *packed++ = (x_c[r] + X(c, r)) / 2;
+    }
+    *packed++ = x_c[c];
+  }
+}
+
+void UnpackSym(const data_t* packed, Matrix& X) {
+  size_t n = X.n_rows;
+  for (size_t c = 0; c < n; c++) {
+    data_t* x_c = X.colptr(c);
+    for (size_t r = 0; r <= c; r++) {
+      x_c[r] = *packed;
+      X(c, r) = *packed++;
+    }
+  }
+}
+
+namespace {
+// gain, K = P*C'*inv(S), from P*C' (work.pct) and innovation covariance S
+// (work.s; factorized in place, S = L*L')
+// n.b., by forward and back substitution along rows of K (k*L*L' = b), so
+// that nothing is allocated
+void JosephGain(Matrix& K, JosephWork& work) {
+  if (!arma::chol(work.s, work.s, "lower")) {
+    throw std::runtime_error(
+        "JosephUpdate failed (innovation covariance not positive definite).");
+  }
+  const Matrix& l = work.s;
+  size_t n_y = l.n_rows;
+  K = work.pct;
+  for (size_t i = 0; i < K.n_rows; i++) {
+    for (size_t k = 0; k < n_y; k++) {  // L*w = b'
+      data_t w = K(i, k);
+      for (size_t j = 0; j < k; j++) {
+        w -= l(k, j) * K(i, j);
+      }
+      K(i, k) = w / l(k, k);
+    }
+    for (size_t k = n_y; k-- > 0;) {  // L'*k' = w
+      data_t v = K(i, k);
+      for (size_t j = k + 1; j < n_y; j++) {
+        v -= l(j, k) * K(i, j);
+      }
+      K(i, k) = v / l(k, k);
+    }
+  }
+}
+
+// P = (I-K*C)*P*(I-K*C)' + K*R*K', given K*R (work.pct)
+void JosephCov(Matrix& P, const Matrix& K, const Matrix& C, JosephWork& work) {
+  work.i_kc = K * C;
+  work.i_kc *= -1;
+  work.i_kc.diag() += 1;
+  work.i_kc_p = work.i_kc * P;
+  P = work.i_kc_p * work.i_kc.t();
+  P += work.pct * K.t();
+}
+}  // namespace
+
+void JosephUpdate(Matrix& P, Matrix& K, const Matrix& C, const Matrix& R) {
+  JosephWork work;
+  JosephUpdate(P, K, C, R, work);
+}
+
+void JosephUpdate(Matrix& P, Matrix& K, const Matrix& C, const Matrix& R,
+                  JosephWork& work) {
+  work.pct = P * C.t();
+  work.s = C * work.pct;
+  work.s += R;  // innovation covariance
+  JosephGain(K, work);
+
+  work.pct = K * R;
+  JosephCov(P, K, C, work);
+}
+
+void JosephUpdate(Matrix& P, Matrix& K, const Matrix& C, const Vector& r) {
+  JosephWork work;
+  JosephUpdate(P, K, C, r, work);
+}
+
+void JosephUpdate(Matrix& P, Matrix& K, const Matrix& C, const Vector& r,
+                  JosephWork& work) {
+  work.pct = P * C.t();
+  work.s = C * work.pct;
+  work.s.diag() += r;  // innovation covariance
+  JosephGain(K, work);
+
+  // n.b., K*diag(r) without forming diag(r)
+  for (size_t k = 0; k < r.n_elem; k++) {
+    work.pct.col(k) = r[k] * K.col(k);
+  }
+  JosephCov(P, K, C, work);
+}
+
+namespace {
+// rows `idx` of C, and rows of C scaled by w (i.e., diag(w)*C)
+Matrix SelectRows(const Matrix& C, const arma::uvec& idx) {
+  return C.rows(idx);
+}
+Matrix ScaleRows(const Matrix& C, const Vector& w) { return diagmat(w) * C; }
+
+// n.b., sparse matrices only support contiguous row ranges, so rows are
+// selected/scaled by multiplying with a sparse selection matrix.
+SpMatrix SelectionMatrix(const arma::uvec& idx, const Vector& vals,
+                         size_t n_cols) {
+  arma::umat locations(2, idx.n_elem);
+  for (size_t k = 0; k < idx.n_elem; k++) {
+    locations(0, k) = k;
+    locations(1, k) = idx[k];
+  }
+  return SpMatrix(locations, vals, idx.n_elem, n_cols);
+}
+SpMatrix SelectRows(const SpMatrix& C, const arma::uvec& idx) {
+  return SelectionMatrix(idx, Vector(idx.n_elem, fill::ones), C.n_rows) * C;
+}
+SpMatrix ScaleRows(const SpMatrix& C, const Vector& w) {
+  arma::uvec idx(w.n_elem);
+  for (size_t k = 0; k < w.n_elem; k++) {
+    idx[k] = k;
+  }
+  return SelectionMatrix(idx, w, C.n_rows) * C;
+}
+
+template <typename M>
+void InfoUpdateImpl(Matrix& P, const M& C, const Vector& w) {
+  // outputs carrying information (n.b., the Woodbury form needs 1/w finite)
+  arma::uvec idx = arma::find(w > std::numeric_limits<data_t>::min());
+  if (idx.is_empty()) {
+    return;  // nothing to update
+  }
+  bool is_dense = idx.n_elem == w.n_elem;
+  M c_sel;
+  if (!is_dense) {
+    c_sel = SelectRows(C, idx);
+  }
+  const M& c_a = is_dense ? C : c_sel;
+  Vector w_a = is_dense ? w : Vector(w.elem(idx));
+
+  if (idx.n_elem < P.n_rows) {
+    // Woodbury: P = P - P*C'*inv(S)*C*P, with S = diag(1/w) + C*P*C' = L*L'
+    Matrix cp = c_a * P;
+    Matrix s = cp * c_a.t();
+    s.diag() += 1 / w_a;
+    Matrix l;
+    if (arma::chol(l, s, "lower")) {
+      Matrix v = arma::solve(arma::trimatl(l), cp);  // inv(L)*C*P
+      P -= v.t() * v;
+      return;
+    }
+    // otherwise, fall back to information form
+  }
+
+  // information form: P = inv(inv(P) + C'*diag(w)*C)
+  // n.b., pseudo-inverse if not numerically positive definite
+  Matrix p_inv;
+  if (!arma::inv_sympd(p_inv, P)) {
+    arma::pinv(p_inv, P);
+  }
+  p_inv += Matrix(c_a.t() * ScaleRows(c_a, w_a));
+  if (!arma::inv_sympd(P, p_inv)) {
+    arma::pinv(P, p_inv);
+  }
+}
+}  // namespace
+
+void InfoUpdate(Matrix& P, const Matrix& C, const Vector& w) {
+  InfoUpdateImpl(P, C, w);
+}
+
+void InfoUpdate(Matrix& P, const SpMatrix& C, const Vector& w) {
+  InfoUpdateImpl(P, C, w);
+}
+
 void lq(Matrix& L, Matrix& Qt, const Matrix& X) {
   bool did_succeed(true);
   did_succeed = arma::qr_econ(Qt, L, X.t());
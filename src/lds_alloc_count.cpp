@@ -0,0 +1,50 @@
+//===-- lds_alloc_count.cpp - Allocation Hook -----------------------------===//
+//
+// Copyright 2021 Michael Bolus
+// Copyright 2021 Georgia Institute of Technology
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file implements the hook for counting the heap allocations made by
+/// Armadillo.
+///
+/// \brief Armadillo allocation-counting hook
+//===----------------------------------------------------------------------===//
+
+#include <ldsCtrlEst_h/lds_alloc_count.h>
+
+#include <atomic>
+#include <cstdlib>
+
+namespace {
+std::atomic<std::size_t> alloc_count{0};
+}  // namespace
+
+namespace lds {
+
+std::size_t AllocationCount() { return alloc_count.load(); }
+
+void ResetAllocationCount() { alloc_count.store(0); }
+
+void* CountedAcquire(std::size_t n_bytes) {
+  alloc_count++;
+  // n.b., malloc alignment suffices for armadillo (16B)
+  return std::malloc(n_bytes);
+}
+
+void CountedRelease(void* mem) { std::free(mem); }
+
+}  // namespace lds
@@ -0,0 +1,242 @@
+//===-- lds_blas.cpp - BLAS Threading Policy ------------------------------===//
+//
+// Copyright 2021 Michael Bolus
+// Copyright 2021 Georgia Institute of Technology
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file implements the policy by which the library sets the number of
+/// threads used by the BLAS/LAPACK it is linked against.
+///
+/// \brief BLAS threading policy
+//===----------------------------------------------------------------------===//
+
+#include <ldsCtrlEst_h/lds_blas.h>
+
+#include <atomic>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+// n.b., BLAS linked is known at build time if linked statically (see cmake),
+// otherwise it is looked up at run time by weak symbols where supported.
+#if defined(LDSCTRLEST_BLAS_OPENBLAS)
+extern "C" {
+void openblas_set_num_threads(int n_threads);
+int openblas_get_num_threads(void);
+}
+#elif defined(LDSCTRLEST_BLAS_MKL)
+extern "C" {
+void MKL_Set_Num_Threads(int n_threads);
+int MKL_Get_Max_Threads(void);
+int mkl_set_num_threads_local(int n_threads);
+}
+#elif defined(__GNUC__) && defined(__ELF__)
+#define LDSCTRLEST_BLAS_WEAK
+extern "C" {
+void openblas_set_num_threads(int n_threads) __attribute__((weak));
+int openblas_get_num_threads(void) __attribute__((weak));
+void MKL_Set_Num_Threads(int n_threads) __attribute__((weak));
+int MKL_Get_Max_Threads(void) __attribute__((weak));
+int mkl_set_num_threads_local(int n_threads) __attribute__((weak));
+}
+#endif
+
+namespace lds {
+
+namespace {
+/// number of threads of each kind of work
+std::atomic<std::size_t> g_policy[kNumBlasWork] = {{1}, {0}, {1}};
+std::mutex g_mutex;           ///< guards the counts below
+std::size_t g_n_threads = 0;  ///< process-wide thread count last applied
+std::size_t g_n_scopes[kNumBlasWork] = {};  ///< active (process-wide) scopes
+std::atomic<bool> g_is_enabled{false};      ///< whether policy is applied
+
+/// depth of kBlasWorkParallel scopes on this thread
+thread_local std::size_t t_parallel_depth = 0;
+
+std::size_t Resolve(std::size_t n_threads) {
+  if (n_threads == 0) {
+    n_threads = std::thread::hardware_concurrency();
+  }
+  return n_threads > 0 ? n_threads : 1;
+}
+
+void SetBackendThreads(std::size_t n_threads) {
+  int n = static_cast<int>(n_threads);
+#if defined(LDSCTRLEST_BLAS_OPENBLAS)
+  openblas_set_num_threads(n);
+#elif defined(LDSCTRLEST_BLAS_MKL)
+  MKL_Set_Num_Threads(n);
+#elif defined(LDSCTRLEST_BLAS_WEAK)
+  if (openblas_set_num_threads) {
+    openblas_set_num_threads(n);
+  } else if (MKL_Set_Num_Threads) {
+    MKL_Set_Num_Threads(n);
+  }
+#else
+  (void)n;
+#endif
+}
+
+/// whether the thread count of scopes can be set for the calling thread only
+bool IsThreadLocal() {
+#if defined(LDSCTRLEST_BLAS_MKL)
+  return true;
+#elif defined(LDSCTRLEST_BLAS_WEAK)
+  return BlasBackendLinked() == kBlasMKL && mkl_set_num_threads_local;
+#else
+  return false;
+#endif
+}
+
+/// sets thread count of calling thread (0 = process-wide count)
+///
+/// @return     previous thread count of calling thread
+std::size_t SetLocalThreads(std::size_t n_threads) {
+  int n = static_cast<int>(n_threads);
+#if defined(LDSCTRLEST_BLAS_MKL) || defined(LDSCTRLEST_BLAS_WEAK)
+  return static_cast<std::size_t>(mkl_set_num_threads_local(n));
+#else
+  (void)n;
+  return 0;
+#endif
+}
+
+/// applies process-wide thread count of the kind of work of highest priority
+/// with an active scope (n.b., g_mutex must be held)
+void ApplyLocked() {
+  BlasWork work = kBlasWorkRealTime;
+  if (g_n_scopes[kBlasWorkParallel] > 0) {
+    work = kBlasWorkParallel;
+  } else if (g_n_scopes[kBlasWorkFit] > 0) {
+    work = kBlasWorkFit;
+  }
+  std::size_t n_threads =
+      Resolve(g_policy[work].load(std::memory_order_relaxed));
+  if (g_n_threads != n_threads) {
+    SetBackendThreads(n_threads);
+    g_n_threads = n_threads;
+  }
+}
+
+/// enables policy (if not yet), applying current process-wide thread count
+void Enable() {
+  if (BlasBackendLinked() == kBlasUnknown) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(g_mutex);
+  g_is_enabled.store(true, std::memory_order_release);
+  ApplyLocked();
+}
+}  // namespace
+
+BlasBackend BlasBackendLinked() {
+#if defined(LDSCTRLEST_BLAS_OPENBLAS)
+  return kBlasOpenBLAS;
+#elif defined(LDSCTRLEST_BLAS_MKL)
+  return kBlasMKL;
+#elif defined(LDSCTRLEST_BLAS_WEAK)
+  if (openblas_set_num_threads && openblas_get_num_threads) {
+    return kBlasOpenBLAS;
+  }
+  if (MKL_Set_Num_Threads && MKL_Get_Max_Threads) {
+    return kBlasMKL;
+  }
+  return kBlasUnknown;
+#else
+  return kBlasUnknown;
+#endif
+}
+
+std::size_t BlasThreads() {
+  switch (BlasBackendLinked()) {
+#if defined(LDSCTRLEST_BLAS_OPENBLAS) || defined(LDSCTRLEST_BLAS_WEAK)
+    case kBlasOpenBLAS:
+      return static_cast<std::size_t>(openblas_get_num_threads());
+#endif
+#if defined(LDSCTRLEST_BLAS_MKL) || defined(LDSCTRLEST_BLAS_WEAK)
+    case kBlasMKL:
+      return static_cast<std::size_t>(MKL_Get_Max_Threads());
+#endif
+    default:
+      return 0;
+  }
+}
+
+std::size_t BlasPolicy(BlasWork work) {
+  if (work >= kNumBlasWork) {
+    throw std::runtime_error("unknown kind of BLAS work");
+  }
+  return g_policy[work].load(std::memory_order_relaxed);
+}
+
+void SetBlasPolicy(BlasWork work, std::size_t n_threads) {
+  if (work >= kNumBlasWork) {
+    throw std::runtime_error("unknown kind of BLAS work");
+  }
+  g_policy[work].store(n_threads, std::memory_order_relaxed);
+  Enable();
+}
+
+void InitBlasPolicy() { Enable(); }
+
+bool IsBlasPolicyEnabled() {
+  return g_is_enabled.load(std::memory_order_acquire);
+}
+
+BlasThreadScope::BlasThreadScope(BlasWork work) : work_(work) {
+  if (work_ >= kNumBlasWork) {
+    throw std::runtime_error("unknown kind of BLAS work");
+  }
+  // n.b., enabled implies backend known
+  is_applied_ = t_parallel_depth == 0 && IsBlasPolicyEnabled();
+  if (work_ == kBlasWorkParallel) {
+    t_parallel_depth++;
+  }
+  if (!is_applied_) {
+    return;
+  }
+
+  if (IsThreadLocal()) {
+    n_threads_prev_ = SetLocalThreads(Resolve(BlasPolicy(work_)));
+    return;
+  }
+  // n.b., count is process-wide, so it is that of the highest-priority kind
+  // of work of any active scope, and it is restored once the last exits
+  std::lock_guard<std::mutex> lock(g_mutex);
+  g_n_scopes[work_]++;
+  ApplyLocked();
+}
+
+BlasThreadScope::~BlasThreadScope() {
+  if (work_ == kBlasWorkParallel) {
+    t_parallel_depth--;
+  }
+  if (!is_applied_) {
+    return;
+  }
+
+  if (IsThreadLocal()) {
+    SetLocalThreads(n_threads_prev_);
+    return;
+  }
+  std::lock_guard<std::mutex> lock(g_mutex);
+  g_n_scopes[work_]--;
+  ApplyLocked();
+}
+
+}  // namespace lds
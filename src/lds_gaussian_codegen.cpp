@@ -0,0 +1,913 @@
+//===-- lds_gaussian_codegen.cpp - GLDS Codegen ---------------------------===//
+//
+// Copyright 2021 Michael Bolus
+// Copyright 2021 Georgia Institute of Technology
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file implements the generation of a self-contained C++ header from a
+/// configured Gaussian-output controller. The controller is read back from a
+/// snapshot of it (see lds::Snapshot), so that the generator depends only on
+/// what a controller saves, and each step of lds::Controller is emitted with
+/// its matrix products unrolled over their nonzero coefficients.
+///
+/// \brief GLDS controller code generation
+//===----------------------------------------------------------------------===//
+
+#include <ldsCtrlEst_h/lds_gaussian_codegen.h>
+
+#include <functional>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+
+namespace lds {
+namespace gaussian {
+
+namespace {
+/// Parameters of a sub-system (and its gains) folded into generated code
+struct CodegenMode {
+  Matrix A;           ///< state matrix
+  Matrix B;           ///< input matrix
+  Vector g;           ///< input gain
+  Matrix C;           ///< output matrix
+  Vector d;           ///< output bias
+  Matrix Ke;          ///< estimator gain
+  Matrix Ke_m;        ///< disturbance estimator gain
+  bool do_adapt_m{};  ///< whether disturbance is estimated
+  Vector x0;          ///< initial state
+  Vector m0;          ///< initial disturbance
+  Matrix Kc;          ///< state feedback gain
+  Matrix Kc_inty;     ///< integral feedback gain
+  Matrix Kc_u;        ///< input feedback gain
+  Vector g_design;    ///< design-phase input gain
+  Matrix setpoint_b;  ///< set-point solution (cx_ref)
+  Matrix setpoint_m;  ///< set-point solution (m)
+};
+
+/// Controller (and its state at generation) folded into generated code
+struct CodegenModel {
+  size_t n_u{};                    ///< number of inputs
+  size_t n_x{};                    ///< number of states
+  size_t n_y{};                    ///< number of outputs
+  data_t dt{};                     ///< sample period
+  data_t u_lb{};                   ///< lower bound on control
+  data_t u_ub{};                   ///< upper bound on control
+  data_t tau_awu{};                ///< anti-windup time constant
+  size_t control_type{};           ///< control type bit mask
+  size_t setpoint_period{};        ///< control steps per set-point calc
+  size_t idx{};                    ///< active sub-system
+  std::vector<CodegenMode> modes;  ///< sub-systems
+
+  Vector x;                        ///< state estimate
+  Vector m;                        ///< disturbance estimate
+  std::vector<Vector> m0;          ///< initial disturbance of each sub-system
+  Vector u;                        ///< control signal
+  Vector v;                        ///< control signal after g inversion
+  Vector u_sat;                    ///< control signal after saturation
+  Vector u_ref;                    ///< reference input
+  Vector u_ref_hold;               ///< held set-point input
+  Vector x_ref;                    ///< reference state
+  Vector y_ref;                    ///< reference output
+  Vector cx_ref;                   ///< reference C x
+  Vector int_e;                    ///< integrated error
+  Vector int_e_awu_adjust;         ///< anti-windup adjustment
+  data_t t_since_control_onset{};  ///< time since control epoch onset
+  size_t n_until_setpoint{};       ///< control steps until next set point
+  bool do_control_prev{};          ///< whether controlling at last step
+  bool u_saturated{};              ///< whether control signal saturated
+};
+
+/// gets vector record, or zeros of size n if absent or empty
+Vector GetVector(const Snapshot& snap, const std::string& name, size_t n) {
+  if (snap.Has(name)) {
+    Matrix mat = snap.Get(name);
+    if (mat.n_elem == n) {
+      return arma::vectorise(mat);
+    }
+  }
+  return Vector(n, fill::zeros);
+}
+
+/// gets matrix record, or zeros of size n_rows x n_cols if absent or empty
+Matrix GetMatrix(const Snapshot& snap, const std::string& name, size_t n_rows,
+                 size_t n_cols) {
+  if (snap.Has(name)) {
+    Matrix mat = snap.Get(name);
+    if ((mat.n_rows == n_rows) && (mat.n_cols == n_cols)) {
+      return mat;
+    }
+  }
+  return Matrix(n_rows, n_cols, fill::zeros);
+}
+
+/// reads sub-system whose records are at `prefix` of a controller snapshot
+CodegenMode ReadMode(const Snapshot& snap, const std::string& prefix,
+                     const CodegenModel& model) {
+  std::string prefix_sys = prefix + "sys.";
+  if (snap.GetScalar(prefix_sys + "do_adapt_params") != 0) {
+    throw std::runtime_error(
+        "cannot generate code for a system whose parameters are adapted "
+        "online");
+  }
+  if (!snap.Has(prefix + "setpoint_b")) {
+    throw std::runtime_error(
+        "cannot generate code without a set-point solution");
+  }
+
+  size_t n_u = model.n_u;
+  size_t n_x = model.n_x;
+  size_t n_y = model.n_y;
+  CodegenMode mode;
+  mode.A = snap.Get(prefix_sys + "A");
+  mode.B = snap.Get(prefix_sys + "B");
+  mode.g = GetVector(snap, prefix_sys + "g", n_u);
+  mode.C = snap.Get(prefix_sys + "C");
+  mode.d = GetVector(snap, prefix_sys + "d", n_y);
+  mode.Ke = snap.Get(prefix_sys + "Ke");
+  mode.do_adapt_m = snap.GetScalar(prefix_sys + "do_adapt_m") != 0;
+  mode.Ke_m = GetMatrix(snap, prefix_sys + "Ke_m", n_x, n_y);
+  mode.x0 = GetVector(snap, prefix_sys + "x0", n_x);
+  mode.m0 = GetVector(snap, prefix_sys + "m0", n_x);
+  mode.Kc = GetMatrix(snap, prefix + "Kc", n_u, n_x);
+  mode.Kc_inty = GetMatrix(snap, prefix + "Kc_inty", n_u, n_y);
+  mode.Kc_u = GetMatrix(snap, prefix + "Kc_u", n_u, n_u);
+  mode.g_design = GetVector(snap, prefix + "g_design", n_u);
+  mode.setpoint_b = snap.Get(prefix + "setpoint_b");
+  mode.setpoint_m = snap.Get(prefix + "setpoint_m");
+  return mode;
+}
+
+/// reads controller (and its active sub-system) from snapshot
+CodegenModel ReadModel(const Snapshot& snap) {
+  if (snap.Has("input_delay") && (snap.GetScalar("input_delay") != 0)) {
+    throw std::runtime_error(
+        "cannot generate code for a controller with input-delay "
+        "compensation");
+  }
+
+  CodegenModel model;
+  model.n_u = static_cast<size_t>(snap.GetScalar("sys.n_u"));
+  model.n_x = static_cast<size_t>(snap.GetScalar("sys.n_x"));
+  model.n_y = static_cast<size_t>(snap.GetScalar("sys.n_y"));
+  model.dt = snap.GetScalar("sys.dt");
+  model.u_lb = snap.GetScalar("u_lb");
+  model.u_ub = snap.GetScalar("u_ub");
+  model.tau_awu = snap.GetScalar("tau_awu");
+  model.control_type = static_cast<size_t>(snap.GetScalar("control_type"));
+  model.setpoint_period =
+      static_cast<size_t>(snap.GetScalar("setpoint_period"));
+
+  size_t n_u = model.n_u;
+  size_t n_x = model.n_x;
+  size_t n_y = model.n_y;
+  model.x = GetVector(snap, "sys.x", n_x);
+  model.m = GetVector(snap, "sys.m", n_x);
+  model.u = GetVector(snap, "u", n_u);
+  model.v = GetVector(snap, "v", n_u);
+  model.u_sat = GetVector(snap, "u_sat", n_u);
+  model.u_ref = GetVector(snap, "u_ref", n_u);
+  model.u_ref_hold = GetVector(snap, "u_ref_hold", n_u);
+  model.x_ref = GetVector(snap, "x_ref", n_x);
+  model.y_ref = GetVector(snap, "y_ref", n_y);
+  model.cx_ref = GetVector(snap, "cx_ref", n_y);
+  model.int_e = GetVector(snap, "int_e", n_y);
+  model.int_e_awu_adjust = GetVector(snap, "int_e_awu_adjust", n_y);
+  model.t_since_control_onset = snap.GetScalar("t_since_control_onset");
+  model.n_until_setpoint =
+      static_cast<size_t>(snap.GetScalar("n_until_setpoint"));
+  model.do_control_prev = snap.GetScalar("do_control_prev") != 0;
+  model.u_saturated = snap.GetScalar("u_saturated") != 0;
+  return model;
+}
+
+/// formats a value as a literal of the generated code's precision
+std::string Literal(data_t value) {
+  if (std::isinf(value)) {
+    // n.b., e.g., unbounded control
+    return std::string(value < 0 ? "-" : "") +
+           "std::numeric_limits<real_t>::infinity()";
+  }
+  if (std::isnan(value)) {
+    throw std::runtime_error("cannot generate code for NaN value");
+  }
+  std::ostringstream os;
+  os << std::setprecision(std::numeric_limits<data_t>::max_digits10) << value;
+  std::string literal = os.str();
+  if (literal.find_first_of(".eE") == std::string::npos) {
+    literal += ".0";
+  }
+#ifdef LDSCTRLEST_SINGLE_PRECISION
+  literal += "f";
+#endif
+  return literal;
+}
+
+/// appends a piece to a line, wrapping onto `os` if it would exceed 80 chars
+void AppendWrapped(std::ostream& os, std::string& line,
+                   const std::string& piece, const std::string& indent) {
+  if ((line.size() + piece.size() > 80) &&
+      (line.find_first_not_of(' ') != std::string::npos)) {
+    // n.b., drop trailing/leading spaces at the break
+    line.erase(line.find_last_not_of(' ') + 1);
+    os << line << "\n";
+    line = indent + piece.substr(piece.find_first_not_of(' '));
+  } else {
+    line += piece;
+  }
+}
+
+/// emits `{v0, v1, ...}` (wrapped) for the elements of a vector
+void EmitInitList(std::ostream& os, std::string& line, const Vector& v,
+                  const std::string& indent) {
+  for (size_t k = 0; k < v.n_elem; k++) {
+    std::string piece = (k == 0 ? "{" : " ") + Literal(v[k]);
+    piece += (k + 1 < v.n_elem) ? "," : "}";
+    AppendWrapped(os, line, piece, indent);
+  }
+}
+
+/// emits per-sub-system constant array `name[kNumModes][n_rows][n_cols]`
+void EmitArray(std::ostream& os, const std::string& name,
+               const std::string& dims, const std::vector<Matrix>& mats) {
+  os << "constexpr real_t " << name << "[kNumModes]" << dims << " = {\n";
+  for (size_t k = 0; k < mats.size(); k++) {
+    os << "    {\n";
+    for (size_t i = 0; i < mats[k].n_rows; i++) {
+      std::string line = "        ";
+      EmitInitList(os, line, Vector(mats[k].row(i).t()), "         ");
+      os << line << ",\n";
+    }
+    os << "    },\n";
+  }
+  os << "};\n";
+}
+
+/// emits per-sub-system constant array `name[kNumModes][n]`
+void EmitArray(std::ostream& os, const std::string& name,
+               const std::string& dims, const std::vector<Vector>& vecs) {
+  os << "constexpr real_t " << name << "[kNumModes]" << dims << " = {\n";
+  for (const auto& v : vecs) {
+    std::string line = "    ";
+    EmitInitList(os, line, v, "     ");
+    os << line << ",\n";
+  }
+  os << "};\n";
+}
+
+/// emits member array declaration `real_t name[dims] = {...};`
+void EmitMember(std::ostream& os, const std::string& name,
+                const std::string& size, const Vector& v,
+                const std::string& doc) {
+  std::string line = "  real_t " + name + "[" + size + "] = ";
+  EmitInitList(os, line, v, "      ");
+  os << line << ";  ///< " << doc << "\n";
+}
+
+/**
+ * Emits `out[i] op M(i, :) * in` for each row of M, unrolled over its nonzero
+ * coefficients (n.b., coefficients of +/-1 are folded into signs, which is
+ * exact). Rows without nonzero coefficients are skipped unless assigned.
+ */
+void EmitProduct(std::ostream& os, const std::string& indent,
+                 const std::string& out, const std::string& op,
+                 const Matrix& M, const std::string& in) {
+  for (size_t i = 0; i < M.n_rows; i++) {
+    std::string line = indent + out + "[" + std::to_string(i) + "] " + op;
+    size_t n_terms = 0;
+    for (size_t j = 0; j < M.n_cols; j++) {
+      data_t c = M(i, j);
+      if (c == 0) {
+        continue;
+      }
+      std::string term = in + "[" + std::to_string(j) + "]";
+      if (std::abs(c) != 1) {
+        term = Literal(std::abs(c)) + " * " + term;
+      }
+      std::string sep = c < 0 ? " - " : " + ";
+      if (n_terms == 0) {
+        sep = c < 0 ? " -" : " ";
+      }
+      AppendWrapped(os, line, sep + term, indent + "    ");
+      n_terms++;
+    }
+    if (n_terms == 0) {
+      if (op != "=") {
+        continue;  // nothing to add
+      }
+      line += " 0";
+    }
+    os << line << ";\n";
+  }
+}
+
+/// emits `out[i] = c[i] * in[i]` (or `in[i] / c[i]`) elementwise
+void EmitScale(std::ostream& os, const std::string& indent,
+               const std::string& out, const Vector& c, const std::string& in,
+               bool do_divide = false) {
+  for (size_t i = 0; i < c.n_elem; i++) {
+    std::string elem = in + "[" + std::to_string(i) + "]";
+    os << indent << out << "[" << i << "] = ";
+    if (c[i] == 1) {
+      os << elem;
+    } else if (do_divide) {
+      os << elem << " / " << Literal(c[i]);
+    } else {
+      os << Literal(c[i]) << " * " << elem;
+    }
+    os << ";\n";
+  }
+}
+
+/// emits the body of each sub-system (dispatched on active one, if several)
+void EmitModes(
+    std::ostream& os, const CodegenModel& model,
+    const std::function<void(std::ostream&, size_t, const std::string&)>&
+        body) {
+  if (model.modes.size() == 1) {
+    body(os, 0, "    ");
+    return;
+  }
+  os << "    switch (mode_) {\n";
+  for (size_t k = 0; k < model.modes.size(); k++) {
+    os << "      case " << k << ": {\n";
+    body(os, k, "        ");
+    os << "        break;\n";
+    os << "      }\n";
+  }
+  os << "      default:\n";
+  os << "        break;\n";
+  os << "    }\n";
+}
+
+/// emits loop `for (k < n) { stmt }` over elements
+void EmitLoop(std::ostream& os, const std::string& indent,
+              const std::string& n, const std::string& stmt) {
+  os << indent << "for (std::size_t k = 0; k < " << n << "; k++) {\n";
+  os << indent << "  " << stmt << "\n";
+  os << indent << "}\n";
+}
+
+/// emits the header source of a controller
+std::string Emit(const CodegenModel& model, const std::string& name) {
+  if (name.empty() || !(std::isalpha(name[0]) || name[0] == '_') ||
+      (name.find_first_not_of("abcdefghijklmnopqrstuvwxyz"
+                              "ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_") !=
+       std::string::npos)) {
+    throw std::runtime_error(
+        "name of generated code must be a C++ identifier");
+  }
+  std::string guard = name;
+  for (auto& c : guard) {
+    c = static_cast<char>(std::toupper(c));
+  }
+  guard += "_H";
+
+  const auto& modes = model.modes;
+  size_t n_modes = modes.size();
+  bool do_inty = (model.control_type & kControlTypeIntY) != 0;
+  bool do_delta_u = (model.control_type & kControlTypeDeltaU) != 0;
+  bool do_adapt_m_setpoint = (model.control_type & kControlTypeAdaptM) != 0;
+  bool do_awu = do_inty && (model.tau_awu < kInf);
+  bool do_any_adapt_m = false;
+  for (const auto& mode : modes) {
+    do_any_adapt_m = do_any_adapt_m || mode.do_adapt_m;
+  }
+
+  std::ostringstream os;
+  os << "// Generated by lds::gaussian::GenerateController (ldsCtrlEst). Do "
+        "not edit;\n"
+        "// regenerate from the controller instead.\n"
+        "//\n"
+        "// Parameters are folded in as they were at generation, as is the "
+        "state the\n"
+        "// controller starts in. Steps follow lds::Controller::Control and\n"
+        "// lds::Controller::ControlOutputReference.\n\n";
+  os << "#ifndef " << guard << "\n#define " << guard << "\n\n";
+  os << "#include <cmath>\n#include <cstddef>\n#include <limits>\n\n";
+  os << "namespace " << name << " {\n\n";
+
+  // constants
+#ifdef LDSCTRLEST_SINGLE_PRECISION
+  os << "typedef float real_t;\n\n";
+#else
+  os << "typedef double real_t;\n\n";
+#endif
+  os << "constexpr std::size_t kNu = " << model.n_u << ";  ///< inputs\n";
+  os << "constexpr std::size_t kNx = " << model.n_x << ";  ///< states\n";
+  os << "constexpr std::size_t kNy = " << model.n_y << ";  ///< outputs\n";
+  os << "constexpr std::size_t kNumModes = " << n_modes
+     << ";  ///< sub-systems\n\n";
+  os << "constexpr real_t kDt = " << Literal(model.dt)
+     << ";  ///< sample period\n";
+  os << "constexpr real_t kULb = " << Literal(model.u_lb)
+     << ";  ///< lower bound on control\n";
+  os << "constexpr real_t kUUb = " << Literal(model.u_ub)
+     << ";  ///< upper bound on control\n";
+  if (do_awu) {
+    // n.b., as lds::Controller: k_awu = dt / tau, scaled by 1 / n_u
+    data_t k_awu = model.dt / model.tau_awu;
+    os << "constexpr real_t kAwuScale = " << Literal(k_awu / model.n_u)
+       << ";  ///< anti-windup gain\n";
+  }
+  os << "constexpr std::size_t kSetPointPeriod = " << model.setpoint_period
+     << ";  ///< steps per set point\n\n";
+
+  // parameters of each sub-system (n.b., for reference; folded below)
+  auto collect_mat = [&](Matrix CodegenMode::*field) {
+    std::vector<Matrix> mats;
+    for (const auto& mode : modes) {
+      mats.push_back(mode.*field);
+    }
+    return mats;
+  };
+  auto collect_vec = [&](Vector CodegenMode::*field) {
+    std::vector<Vector> vecs;
+    for (const auto& mode : modes) {
+      vecs.push_back(mode.*field);
+    }
+    return vecs;
+  };
+  os << "// parameters of each sub-system\n";
+  EmitArray(os, "kA", "[kNx][kNx]", collect_mat(&CodegenMode::A));
+  EmitArray(os, "kB", "[kNx][kNu]", collect_mat(&CodegenMode::B));
+  EmitArray(os, "kG", "[kNu]", collect_vec(&CodegenMode::g));
+  EmitArray(os, "kC", "[kNy][kNx]", collect_mat(&CodegenMode::C));
+  EmitArray(os, "kD", "[kNy]", collect_vec(&CodegenMode::d));
+  EmitArray(os, "kKe", "[kNx][kNy]", collect_mat(&CodegenMode::Ke));
+  if (do_any_adapt_m) {
+    EmitArray(os, "kKeM", "[kNx][kNy]", collect_mat(&CodegenMode::Ke_m));
+  }
+  EmitArray(os, "kX0", "[kNx]", collect_vec(&CodegenMode::x0));
+  EmitArray(os, "kKc", "[kNu][kNx]", collect_mat(&CodegenMode::Kc));
+  if (do_inty) {
+    EmitArray(os, "kKcIntY", "[kNu][kNy]",
+              collect_mat(&CodegenMode::Kc_inty));
+  }
+  if (do_delta_u) {
+    EmitArray(os, "kKcU", "[kNu][kNu]", collect_mat(&CodegenMode::Kc_u));
+  }
+  EmitArray(os, "kGDesign", "[kNu]", collect_vec(&CodegenMode::g_design));
+  os << "\n";
+
+  // class
+  os << "/// Controller with parameters folded in (see lds::Controller)\n";
+  os << "class Controller {\n public:\n";
+  os << R"(  /**
+   * @brief      updates control signal (single-step)
+   *
+   * @param      z                          measurement (kNy)
+   * @param      do_control                 [optional] whether to update control
+   *                                        (true) or simply feed through u_ref
+   *                                        (false)
+   * @param      do_lock_control            [optional] whether to lock control
+   *                                        at its current value
+   * @param      sigma_soft_start           [optional] standard deviation of a
+   *                                        Gaussian soft-start to control
+   * @param      do_reset_at_control_onset  [optional] whether to reset
+   *                                        controller at control epoch onset
+   *
+   * @return     updated control signal (kNu)
+   */
+  const real_t* Control(const real_t* z, bool do_control = true,
+                        bool do_lock_control = false,
+                        real_t sigma_soft_start = 0,
+                        bool do_reset_at_control_onset = true) {
+    Filter(u_, z);
+    CalcControl(do_control, true, do_lock_control, sigma_soft_start,
+                do_reset_at_control_onset);
+    return u_;
+  }
+
+  /**
+   * @brief      updates control signal, given previously-set y_ref
+   *             (single-step)
+   *
+   * @param      z                          measurement (kNy)
+   * @param      do_control                 [optional] whether to update control
+   *                                        (true) or simply feed through u_ref
+   *                                        (false)
+   * @param      do_estimation              [optional] whether to update state
+   *                                        estimate
+   * @param      do_lock_control            [optional] whether to lock control
+   *                                        at its current value
+   * @param      sigma_soft_start           [optional] standard deviation of a
+   *                                        Gaussian soft-start to control
+   * @param      do_reset_at_control_onset  [optional] whether to reset
+   *                                        controller at control epoch onset
+   *
+   * @return     updated control signal (kNu)
+   */
+  const real_t* ControlOutputReference(const real_t* z, bool do_control = true,
+                                       bool do_estimation = true,
+                                       bool do_lock_control = false,
+                                       real_t sigma_soft_start = 0,
+                                       bool do_reset_at_control_onset = true) {
+    if (do_estimation) {
+      Filter(u_, z);
+    } else {
+      Dynamics(u_);
+    }
+
+    // n.b., set point is held in between calculations
+    if (do_control) {
+      if (n_until_setpoint_ == 0) {
+        CalcSetPoint();
+        for (std::size_t k = 0; k < kNu; k++) {
+          u_ref_hold_[k] = u_ref_[k];
+        }
+        n_until_setpoint_ = kSetPointPeriod;
+      } else {
+        for (std::size_t k = 0; k < kNu; k++) {
+          u_ref_[k] = u_ref_hold_[k];
+        }
+      }
+      n_until_setpoint_--;
+    }
+
+    CalcControl(do_control, do_estimation, do_lock_control, sigma_soft_start,
+                do_reset_at_control_onset);
+    return u_;
+  }
+)";
+
+  if (n_modes > 1) {
+    os << R"(
+  /**
+   * n.b., out-of-bounds indices are ignored.
+   *
+   * @brief      switches to a different sub-system (carrying state over)
+   *
+   * @param      idx              index
+   * @param      do_force_switch  [optional] whether to switch even if
+   *                              already there
+   */
+  void Switch(std::size_t idx, bool do_force_switch = false) {
+    if (((idx == mode_) && !do_force_switch) || (idx >= kNumModes)) {
+      return;
+    }
+    if (idx != mode_) {
+      for (std::size_t k = 0; k < kNx; k++) {
+        m0_[idx][k] = m_[k];
+      }
+      mode_ = idx;
+      Output();
+    }
+  }
+)";
+  }
+
+  os << R"(
+  /// resets estimate and control variables
+  void Reset() {
+    for (std::size_t k = 0; k < kNx; k++) {
+      x_[k] = kX0[mode_][k];
+      m_[k] = m0_[mode_][k];
+    }
+    Output();
+    for (std::size_t k = 0; k < kNu; k++) {
+      u_ref_[k] = 0;
+      u_sat_[k] = 0;
+    }
+    for (std::size_t k = 0; k < kNy; k++) {
+      int_e_[k] = 0;
+      int_e_awu_adjust_[k] = 0;
+    }
+    u_saturated_ = false;
+    t_since_control_onset_ = 0;
+    n_until_setpoint_ = 0;
+  }
+
+  /// sets reference input (kNu)
+  void set_u_ref(const real_t* u_ref) {
+    for (std::size_t k = 0; k < kNu; k++) {
+      u_ref_[k] = u_ref[k];
+    }
+  }
+  /// sets reference state (kNx)
+  void set_x_ref(const real_t* x_ref) {
+    for (std::size_t k = 0; k < kNx; k++) {
+      x_ref_[k] = x_ref[k];
+    }
+    for (std::size_t i = 0; i < kNy; i++) {
+      cx_ref_[i] = 0;
+      for (std::size_t j = 0; j < kNx; j++) {
+        cx_ref_[i] += kC[mode_][i][j] * x_ref_[j];
+      }
+    }
+  }
+  /// sets reference output (kNy)
+  void set_y_ref(const real_t* y_ref) {
+    for (std::size_t k = 0; k < kNy; k++) {
+      y_ref_[k] = y_ref[k];
+      cx_ref_[k] = y_ref[k] - kD[mode_][k];
+    }
+  }
+
+  /// gets state estimate (kNx)
+  const real_t* x() const { return x_; }
+  /// gets disturbance estimate (kNx)
+  const real_t* m() const { return m_; }
+  /// gets output estimate (kNy)
+  const real_t* y() const { return y_; }
+  /// gets control signal (kNu)
+  const real_t* u() const { return u_; }
+  /// gets reference input (kNu)
+  const real_t* u_ref() const { return u_ref_; }
+  /// gets reference state (kNx)
+  const real_t* x_ref() const { return x_ref_; }
+  /// gets reference output (kNy)
+  const real_t* y_ref() const { return y_ref_; }
+  /// gets integrated error (kNy)
+  const real_t* int_e() const { return int_e_; }
+  /// gets whether control signal has reached saturation limits
+  bool u_saturated() const { return u_saturated_; }
+  /// gets active sub-system
+  std::size_t mode() const { return mode_; }
+
+ private:
+)";
+
+  // calculates control signal update
+  os << R"(  void CalcControl(bool do_control, bool do_estimation,
+                   bool do_lock_control, real_t sigma_soft_start,
+                   bool do_reset_at_control_onset) {
+    if (do_control && do_estimation) {
+      if (!do_control_prev_) {
+        if (do_reset_at_control_onset) {
+          Reset();
+        }
+        t_since_control_onset_ = 0;
+      } else {
+        t_since_control_onset_ += kDt;
+      }
+
+      if (sigma_soft_start > 0) {
+        real_t soft_start_sf =
+            1 - std::exp(-std::pow(t_since_control_onset_, 2) /
+                         (2 * std::pow(sigma_soft_start, 2)));
+        for (std::size_t k = 0; k < kNu; k++) {
+          u_ref_[k] *= soft_start_sf;
+        }
+      }
+
+      if (!do_lock_control) {
+        Feedback();
+      }
+    } else {
+      OpenLoop();
+    }
+
+    AntiWindup();
+    do_control_prev_ = do_control;
+  }
+
+)";
+
+  // output: cx = C x, y = cx + d
+  os << "  void Output() {\n";
+  EmitModes(os, model, [&](std::ostream& os, size_t k,
+                           const std::string& indent) {
+    EmitProduct(os, indent, "cx_", "=", modes[k].C, "x_");
+    for (size_t i = 0; i < model.n_y; i++) {
+      os << indent << "y_[" << i << "] = cx_[" << i << "]";
+      if (modes[k].d[i] != 0) {
+        os << " + " << Literal(modes[k].d[i]);
+      }
+      os << ";\n";
+    }
+  });
+  os << "  }\n\n";
+
+  // dynamics: x = A x + B (g % u) + m
+  os << "  void Dynamics(const real_t* u_tm1) {\n";
+  os << "    real_t gu[kNu];\n    real_t x_pre[kNx];\n";
+  EmitModes(os, model, [&](std::ostream& os, size_t k,
+                           const std::string& indent) {
+    EmitScale(os, indent, "gu", modes[k].g, "u_tm1");
+    EmitLoop(os, indent, "kNx", "x_pre[k] = m_[k];");
+    EmitProduct(os, indent, "x_pre", "+=", modes[k].A, "x_");
+    EmitProduct(os, indent, "x_pre", "+=", modes[k].B, "gu");
+  });
+  EmitLoop(os, "    ", "kNx", "x_[k] = x_pre[k];");
+  os << "  }\n\n";
+
+  // filter: predict, then update with (frozen) estimator gain
+  os << "  void Filter(const real_t* u_tm1, const real_t* z) {\n";
+  os << "    Dynamics(u_tm1);\n    Output();\n";
+  os << "    real_t e[kNy];\n";
+  EmitLoop(os, "    ", "kNy", "e[k] = z[k] - y_[k];");
+  EmitModes(os, model, [&](std::ostream& os, size_t k,
+                           const std::string& indent) {
+    EmitProduct(os, indent, "x_", "+=", modes[k].Ke, "e");
+    if (modes[k].do_adapt_m) {
+      EmitProduct(os, indent, "m_", "+=", modes[k].Ke_m, "e");
+    }
+  });
+  os << "    Output();\n";
+  os << "  }\n\n";
+
+  // steady-state set point: [x_ref; u_ref] = B_sp cx_ref - M_sp m
+  os << "  void CalcSetPoint() {\n";
+  os << "    real_t xu[kNx + kNu];\n";
+  EmitModes(os, model, [&](std::ostream& os, size_t k,
+                           const std::string& indent) {
+    std::string m =
+        do_adapt_m_setpoint ? "m_" : "m0_[" + std::to_string(k) + "]";
+    EmitProduct(os, indent, "xu", "=", modes[k].setpoint_b, "cx_ref_");
+    EmitProduct(os, indent, "xu", "-=", modes[k].setpoint_m, m);
+    EmitLoop(os, indent, "kNx", "x_ref_[k] = xu[k];");
+    EmitLoop(os, indent, "kNu", "u_ref_[k] = xu[kNx + k];");
+    EmitProduct(os, indent, "cx_ref_", "=", modes[k].C, "x_ref_");
+  });
+  os << "  }\n\n";
+
+  // state feedback
+  os << "  void Feedback() {\n";
+  os << "    real_t v_ref[kNu];\n    real_t dx[kNx];\n";
+  if (do_delta_u) {
+    os << "    real_t dv[kNu];\n    real_t du[kNu];\n";
+  }
+  EmitLoop(os, "    ", "kNx", "dx[k] = x_[k] - x_ref_[k];");
+  if (do_inty) {
+    EmitLoop(os, "    ", "kNy",
+             "int_e_[k] += (cx_[k] - cx_ref_[k]) * kDt;");
+  }
+  EmitModes(os, model, [&](std::ostream& os, size_t k,
+                           const std::string& indent) {
+    const CodegenMode& mode = modes[k];
+    EmitScale(os, indent, "v_ref", mode.g_design, "u_ref_");
+    if (do_delta_u) {
+      // n.b., as lds::Controller, reference change in v is taken as zero
+      EmitLoop(os, indent, "kNu", "dv[k] = 0;");
+      EmitProduct(os, indent, "dv", "-=", mode.Kc, "dx");
+      EmitLoop(os, indent, "kNu", "du[k] = v_[k] - v_ref[k];");
+      EmitProduct(os, indent, "dv", "-=", mode.Kc_u, "du");
+      if (do_inty) {
+        EmitProduct(os, indent, "dv", "-=", mode.Kc_inty, "int_e_");
+      }
+      EmitLoop(os, indent, "kNu", "v_[k] += dv[k];");
+    } else {
+      EmitLoop(os, indent, "kNu", "v_[k] = v_ref[k];");
+      EmitProduct(os, indent, "v_", "-=", mode.Kc, "dx");
+      if (do_inty) {
+        EmitProduct(os, indent, "v_", "-=", mode.Kc_inty, "int_e_");
+      }
+    }
+    EmitScale(os, indent, "u_", mode.g, "v_", true);
+  });
+  os << "  }\n\n";
+
+  // open loop: feed through u_ref
+  os << "  void OpenLoop() {\n";
+  EmitModes(os, model, [&](std::ostream& os, size_t k,
+                           const std::string& indent) {
+    const CodegenMode& mode = modes[k];
+    for (size_t i = 0; i < model.n_u; i++) {
+      os << indent << "u_[" << i << "] = u_ref_[" << i << "] * "
+         << Literal(mode.g_design[i]) << " / " << Literal(mode.g[i])
+         << ";\n";
+    }
+    EmitScale(os, indent, "v_", mode.g, "u_");
+  });
+  EmitLoop(os, "    ", "kNu", "u_ref_[k] = 0;");
+  EmitLoop(os, "    ", "kNu", "u_sat_[k] = 0;");
+  EmitLoop(os, "    ", "kNy", "int_e_[k] = 0;");
+  EmitLoop(os, "    ", "kNy", "int_e_awu_adjust_[k] = 0;");
+  os << "  }\n\n";
+
+  // saturation and anti-windup
+  os << R"(  void AntiWindup() {
+    u_saturated_ = false;
+    for (std::size_t k = 0; k < kNu; k++) {
+      u_sat_[k] = u_[k];
+      if (u_[k] < kULb) {
+        u_sat_[k] = kULb;
+        u_saturated_ = true;
+      }
+      if (u_[k] > kUUb) {
+        u_sat_[k] = kUUb;
+        u_saturated_ = true;
+      }
+    }
+)";
+  if (do_awu) {
+    os << "    real_t du[kNu];\n";
+    EmitLoop(os, "    ", "kNu", "du[k] = u_[k] - u_sat_[k];");
+    EmitModes(os, model, [&](std::ostream& os, size_t k,
+                             const std::string& indent) {
+      Matrix sign_t = arma::sign(modes[k].Kc_inty).t();
+      EmitProduct(os, indent, "int_e_awu_adjust_", "=", sign_t, "du");
+    });
+    os << "    for (std::size_t k = 0; k < kNy; k++) {\n";
+    os << "      int_e_awu_adjust_[k] *= kAwuScale;\n";
+    os << "      int_e_[k] += int_e_awu_adjust_[k];\n";
+    os << "    }\n";
+  }
+  EmitLoop(os, "    ", "kNu", "u_[k] = u_sat_[k];");
+  os << "  }\n\n";
+
+  // state (as at generation)
+  Vector cx = modes[model.idx].C * model.x;
+  Vector y = cx + modes[model.idx].d;
+  EmitMember(os, "x_", "kNx", model.x, "state estimate");
+  EmitMember(os, "m_", "kNx", model.m, "disturbance estimate");
+  EmitMember(os, "cx_", "kNy", cx, "C x");
+  EmitMember(os, "y_", "kNy", y, "output estimate");
+  // initial disturbance
+  os << "  real_t m0_[kNumModes][kNx] = {";
+  for (size_t k = 0; k < n_modes; k++) {
+    std::string line = "\n      ";
+    EmitInitList(os, line, model.m0[k], "       ");
+    os << line << ",";
+  }
+  os << "\n  };\n";
+  EmitMember(os, "u_", "kNu", model.u, "control signal");
+  EmitMember(os, "v_", "kNu", model.v, "control after g inversion");
+  EmitMember(os, "u_sat_", "kNu", model.u_sat, "saturated control");
+  EmitMember(os, "u_ref_", "kNu", model.u_ref, "reference input");
+  EmitMember(os, "u_ref_hold_", "kNu", model.u_ref_hold,
+             "held set-point input");
+  EmitMember(os, "x_ref_", "kNx", model.x_ref, "reference state");
+  EmitMember(os, "y_ref_", "kNy", model.y_ref, "reference output");
+  EmitMember(os, "cx_ref_", "kNy", model.cx_ref, "reference C x");
+  EmitMember(os, "int_e_", "kNy", model.int_e, "integrated error");
+  EmitMember(os, "int_e_awu_adjust_", "kNy", model.int_e_awu_adjust,
+             "anti-windup adjustment");
+  os << "  real_t t_since_control_onset_ = "
+     << Literal(model.t_since_control_onset) << ";\n";
+  os << "  std::size_t n_until_setpoint_ = " << model.n_until_setpoint
+     << ";\n";
+  os << "  bool do_control_prev_ = "
+     << (model.do_control_prev ? "true" : "false") << ";\n";
+  os << "  bool u_saturated_ = " << (model.u_saturated ? "true" : "false")
+     << ";\n";
+  os << "  std::size_t mode_ = " << model.idx << ";  ///< active sub-system\n";
+  os << "};\n\n";
+
+  os << "}  // namespace " << name << "\n\n#endif\n";
+  return os.str();
+}
+}  // namespace
+
+std::string GenerateController(const Controller& controller,
+                               const std::string& name) {
+  // n.b., set point is solved on a copy, so that it is part of the snapshot
+  Controller ctrl = controller;
+  ctrl.PrecomputeSetPoint();
+  Snapshot snap;
+  ctrl.SaveSnapshot(snap);
+
+  CodegenModel model = ReadModel(snap);
+  model.modes.push_back(ReadMode(snap, "", model));
+  model.m0.push_back(model.modes[0].m0);
+  return Emit(model, name);
+}
+
+std::string GenerateController(const SwitchedController& controller,
+                               const std::string& name) {
+  if (controller.do_imm()) {
+    throw std::runtime_error(
+        "cannot generate code for a controller estimating sub-system by IMM");
+  }
+  SwitchedController ctrl = controller;
+  ctrl.PrecomputeSetPoints();
+  Snapshot snap;
+  ctrl.SaveSnapshot(snap);
+
+  // n.b., active sub-system is saved as the controller's, others per mode
+  CodegenModel model = ReadModel(snap);
+  model.idx = static_cast<size_t>(snap.GetScalar("idx"));
+  size_t n_sys = static_cast<size_t>(snap.GetScalar("n_sys"));
+  // n.b., only mappings other than the identity are saved
+  for (size_t k = 0; k < n_sys * n_sys; k++) {
+    if (snap.Has("state_map" + std::to_string(k))) {
+      throw std::runtime_error(
+          "cannot generate code for a controller mapping state between "
+          "sub-systems");
+    }
+  }
+  for (size_t k = 0; k < n_sys; k++) {
+    std::string prefix =
+        (k == model.idx) ? "" : "mode" + std::to_string(k) + ".";
+    model.modes.push_back(ReadMode(snap, prefix, model));
+    model.m0.push_back(model.modes[k].m0);
+  }
+  return Emit(model, name);
+}
+
+}  // namespace gaussian
+}  // namespace lds
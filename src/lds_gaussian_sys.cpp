@@ -34,31 +34,84 @@ lds::gaussian::System::System(size_t n_u, size_t n_x, size_t n_y, data_t dt, dat
 
   R_.zeros(n_y, n_y);
   R_.diag().fill(r0);
+  tmp_yy_inv_ = R_;
 
   do_recurse_Ke_=true;
 };
 
+void lds::gaussian::System::set_params(const System& sys) {
+  lds::System::set_params(sys);
+  Reassign(R_, sys.R_);
+  do_recurse_Ke_ = sys.do_recurse_Ke_;
+  if (!do_recurse_Ke_) {
+    Reassign(Ke_, sys.Ke_);
+    Reassign(Ke_m_, sys.Ke_m_);
+  }
+}
+
 // recursively estimate Ke
 void lds::gaussian::System::RecurseKe() {
   if (!do_recurse_Ke_) {
     return;
   }
 
+  // n.b., products are evaluated into preallocated scratch (no allocation)
+
   // predict covariance
-  P_ = A_ * P_ * A_.t() + Q_;
+  // P_ = A_ * P_ * A_.t() + Q_;
+  tmp_xx_ = A_ * P_;
+  P_ = tmp_xx_ * A_.t();
+  P_ += Q_;
+
+  if (cov_update_ == kCovUpdateCholesky) {
+    JosephUpdate(P_, Ke_, C_, R_, joseph_work_);  // gain + update
+    if (do_adapt_m) {
+      P_m_ += Q_m_;  // A_m = I (i.e., random walk)
+      JosephUpdate(P_m_, Ke_m_, C_, R_, joseph_work_);
+    }
+    return;
+  }
 
   // calc Kalman gain
-  Ke_ = P_ * C_.t() * inv_sympd(C_ * P_ * C_.t() + R_);
+  // Ke_ = P_ * C_.t() * inv_sympd(C_ * P_ * C_.t() + R_);
+  tmp_xy_ = P_ * C_.t();
+  tmp_yy_ = C_ * tmp_xy_;
+  tmp_yy_ += R_;
+  inv_sympd(tmp_yy_inv_, tmp_yy_);
+  Ke_ = tmp_xy_ * tmp_yy_inv_;
 
   // update covariance
   // Reference: Ghahramani et Hinton (1996)
-  P_ = P_ - Ke_ * C_ * P_;
+  // P_ = P_ - Ke_ * C_ * P_; (n.b., C_ * P_ = tmp_xy_.t())
+  P_ -= Ke_ * tmp_xy_.t();
 
   if (do_adapt_m) {
     P_m_ += Q_m_;  // A_m = I (i.e., random walk)
-    Ke_m_ = P_m_ * C_.t() * inv_sympd(C_ * P_m_ * C_.t() + R_);
-    P_m_ = P_m_ - Ke_m_ * C_ * P_m_;
+    tmp_xy_ = P_m_ * C_.t();
+    tmp_yy_ = C_ * tmp_xy_;
+    tmp_yy_ += R_;
+    inv_sympd(tmp_yy_inv_, tmp_yy_);
+    Ke_m_ = tmp_xy_ * tmp_yy_inv_;
+    P_m_ -= Ke_m_ * tmp_xy_.t();
+  }
+}
+
+void lds::gaussian::System::InitAdaptOutput(data_t p0) {
+  P_theta_y_ = p0 * Matrix(n_x_ + 1, n_x_ + 1, fill::eye);
+}
+
+// n.b., all outputs share the regressor [x_pre; 1] and have the same weight,
+// so one parameter covariance serves every row of [C, d].
+void lds::gaussian::System::AdaptOutput(const Vector& z) {
+  phi_y_.head(n_x_) = x_pre_;
+  RLSUpdate(P_theta_y_, phi_y_, 1, k_y_);
+
+  tmp_y_ = z - y_;  // n.b., y_ not yet updated (i.e., predicted output)
+  for (size_t j = 0; j < n_x_; j++) {
+    C_.col(j) += k_y_[j] * tmp_y_;
   }
+  d_ += k_y_[n_x_] * tmp_y_;
+  revision_++;
 }
 
 // Simulate
@@ -69,6 +122,66 @@ const lds::Vector& lds::gaussian::System::Simulate(const Vector& u_tm1){
   return z_;
 }
 
+lds::data_t lds::gaussian::System::PredictiveLogLik(const Vector& u_tm1,
+                                                    const Vector& z) {
+  // predicted state (as f, but into scratch)
+  tmp_u_ = g_ % u_tm1;
+  tmp_x_ = m_;
+  tmp_x_ += A_ * x_;
+  tmp_x_ += B_ * tmp_u_;
+
+  // innovation and its covariance, S = C (A P A' + Q) C' + R
+  tmp_y_ = z - d_;
+  tmp_y_ -= C_ * tmp_x_;
+  tmp_xx_ = A_ * P_;
+  tmp_xx2_ = tmp_xx_ * A_.t();
+  tmp_xx2_ += Q_;
+  tmp_xy_ = tmp_xx2_ * C_.t();
+  tmp_yy_ = C_ * tmp_xy_;
+  tmp_yy_ += R_;
+
+  // log N(z; y_pred, S) by lower Cholesky factor of S, L
+  // n.b., factorized in place, and L^-1 * innovation by forward substitution
+  // into the innovation, so that nothing is allocated (and S not positive
+  // definite is scored as impossible)
+  if (!arma::chol(tmp_yy_, tmp_yy_, "lower")) {
+    return -kInf;
+  }
+  data_t log_det = 0;
+  data_t e_sq = 0;
+  for (size_t k = 0; k < n_y_; k++) {
+    data_t e_k = tmp_y_[k];
+    for (size_t j = 0; j < k; j++) {
+      e_k -= tmp_yy_(k, j) * tmp_y_[j];
+    }
+    e_k /= tmp_yy_(k, k);
+    tmp_y_[k] = e_k;
+    e_sq += e_k * e_k;
+    log_det += 2 * std::log(tmp_yy_(k, k));
+  }
+  return -(log_det + e_sq + n_y_ * std::log(2 * kPi)) / 2;
+}
+
+void lds::gaussian::System::SaveSnapshot(Snapshot& snap,
+                                         const std::string& prefix) const {
+  lds::System::SaveSnapshot(snap, prefix);
+  snap.Set(prefix + "R", R_);
+  snap.Set(prefix + "do_recurse_Ke", do_recurse_Ke_);
+  if (do_adapt_params_) {
+    snap.Set(prefix + "P_theta_y", P_theta_y_);
+  }
+}
+
+void lds::gaussian::System::LoadSnapshot(const Snapshot& snap,
+                                         const std::string& prefix) {
+  lds::System::LoadSnapshot(snap, prefix);
+  snap.Get(prefix + "R", R_);
+  do_recurse_Ke_ = snap.GetScalar(prefix + "do_recurse_Ke") != 0;
+  if (do_adapt_params_) {
+    snap.Get(prefix + "P_theta_y", P_theta_y_);
+  }
+}
+
 void lds::gaussian::System::Print() {
   lds::System::Print();
   std::cout << "R: \n" << R_ << "\n";
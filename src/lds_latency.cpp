@@ -0,0 +1,139 @@
+//===-- lds_latency.cpp - Latency Profiling -------------------------------===//
+//
+// Copyright 2021 Michael Bolus
+// Copyright 2021 Georgia Institute of Technology
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file implements types for recording per-stage latency histograms of
+/// the estimation/control step (`lds::LatencyProfile`).
+///
+/// \brief latency profiling
+//===----------------------------------------------------------------------===//
+
+#include <ldsCtrlEst_h/lds_latency.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+namespace lds {
+
+size_t LatencyHistogram::Bucket(std::uint64_t ns) {
+  if (ns < kNSub) {
+    return ns;
+  }
+
+  // position of most significant bit
+#if defined(__GNUC__) || defined(__clang__)
+  size_t msb = 63 - __builtin_clzll(ns);
+#else
+  size_t msb = 0;
+  for (std::uint64_t v = ns; v >>= 1;) {
+    msb++;
+  }
+#endif
+
+  size_t sub = (ns >> (msb - kNSubBits)) & (kNSub - 1);
+  return kNSub * (msb - kNSubBits + 1) + sub;
+}
+
+std::uint64_t LatencyHistogram::LowerBound(size_t bucket) {
+  if (bucket < kNSub) {
+    return bucket;
+  }
+  size_t msb = bucket / kNSub + kNSubBits - 1;
+  std::uint64_t sub = bucket % kNSub;
+  return (kNSub + sub) << (msb - kNSubBits);
+}
+
+data_t LatencyHistogram::Quantile(data_t q) const {
+  if (n_ == 0) {
+    return 0;
+  }
+
+  q = std::min(std::max(q, data_t(0)), data_t(1));
+  auto rank = static_cast<std::uint64_t>(std::ceil(q * n_));
+  rank = std::max(rank, std::uint64_t(1));
+
+  std::uint64_t n_cum = 0;
+  for (size_t k = 0; k < kNBuckets; k++) {
+    n_cum += counts_[k];
+    if (n_cum >= rank) {
+      // midpoint of bucket (n.b., buckets below kNSub are exact)
+      std::uint64_t lb = LowerBound(k);
+      std::uint64_t width = (k < kNSub) ? 0 : LowerBound(k + 1) - lb;
+      return std::min(static_cast<data_t>(lb + width / 2),
+                      static_cast<data_t>(max_));
+    }
+  }
+  return static_cast<data_t>(max_);
+}
+
+void LatencyHistogram::Reset() {
+  std::fill(counts_.begin(), counts_.end(), 0);
+  n_ = 0;
+  max_ = 0;
+}
+
+LatencyProfile::LatencyProfile() {
+#ifdef LDSCTRLEST_PROFILE
+  hists_.reset(new Histograms);
+#endif
+}
+
+LatencyProfile::LatencyProfile(const LatencyProfile&) : LatencyProfile() {}
+
+LatencyStats LatencyProfile::stats(LatencyStage stage) const {
+  LatencyStats stats;
+  if (hists_) {
+    const LatencyHistogram& hist = hists_->at(stage);
+    stats.n = hist.n();
+    stats.p50 = hist.Quantile(0.50);
+    stats.p99 = hist.Quantile(0.99);
+    stats.max = static_cast<data_t>(hist.max());
+  }
+  return stats;
+}
+
+void LatencyProfile::Reset() {
+  if (hists_) {
+    for (auto& hist : *hists_) {
+      hist.Reset();
+    }
+  }
+}
+
+void LatencyProfile::Print() const {
+  static const char* kStageNames[kNLatencyStages] = {
+      "f",        "h",          "RecurseKe", "FilterUpdate",
+      "SetPoint", "AntiWindup", "Switch"};
+
+  if (!hists_) {
+    std::cout
+        << "latency profiling disabled (compile with LDSCTRLEST_PROFILE)\n";
+  }
+  for (size_t k = 0; k < kNLatencyStages; k++) {
+    LatencyStats s = stats(static_cast<LatencyStage>(k));
+    if (s.n == 0) {
+      continue;
+    }
+    std::cout << kStageNames[k] << ": n = " << s.n << ", p50 = " << s.p50
+              << " ns, p99 = " << s.p99 << " ns, max = " << s.max << " ns\n";
+  }
+}
+
+}  // namespace lds
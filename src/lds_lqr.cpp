@@ -0,0 +1,143 @@
+//===-- lds_lqr.cpp - LQR Controller Design -------------------------------===//
+//
+// Copyright 2021 Michael Bolus
+// Copyright 2021 Georgia Institute of Technology
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file implements functions for designing the feedback gains of
+/// `lds::Controller` by linear-quadratic regulation (LQR).
+///
+/// \brief LQR controller design
+//===----------------------------------------------------------------------===//
+
+#include <ldsCtrlEst_h/lds_lqr.h>
+
+#include <limits>
+
+namespace lds {
+
+namespace {
+// n.b., doubling converges quadratically, so this is never reached unless
+// the problem has no stabilizing solution.
+const size_t kDAREMaxIter = 100;
+}  // namespace
+
+Matrix SolveDARE(const Matrix& A, const Matrix& B, const Matrix& Q,
+                 const Matrix& R) {
+  // Chu et al. (2004): with A_0 = A, G_0 = B*R^-1*B', H_0 = Q, and
+  // W_k = I + G_k*H_k,
+  //   A_k+1 = A_k * W_k^-1 * A_k
+  //   G_k+1 = G_k + A_k * W_k^-1 * G_k * A_k'
+  //   H_k+1 = H_k + A_k' * H_k * W_k^-1 * A_k
+  // where H_k -> P.
+  Matrix id(A.n_rows, A.n_cols, fill::eye);
+  Matrix a = A;
+  Matrix g = B * arma::solve(R, B.t());
+  Matrix h = Q;
+  data_t tol = 100 * std::numeric_limits<data_t>::epsilon();
+
+  for (size_t k = 0; k < kDAREMaxIter; k++) {
+    Matrix w = id + g * h;
+    Matrix w_inv_a = arma::solve(w, a);
+    Matrix w_inv_g = arma::solve(w, g);
+
+    Matrix h_new = h + a.t() * h * w_inv_a;
+    g += a * w_inv_g * a.t();
+    g = (g + g.t()) / 2;
+    a = a * w_inv_a;
+
+    bool is_converged = norm(h_new - h, "inf") <= tol * norm(h_new, "inf");
+    h = (h_new + h_new.t()) / 2;
+    if (is_converged) {
+      return h;
+    }
+  }
+
+  throw std::runtime_error(
+      "SolveDARE failed to converge (is system stabilizable/detectable?)");
+}
+
+Matrix CalcLQRGain(const Matrix& A, const Matrix& B, const Matrix& Q,
+                   const Matrix& R) {
+  Matrix p = SolveDARE(A, B, Q, R);
+  Matrix bp = B.t() * p;
+  return arma::solve(R + bp * B, bp * A);
+}
+
+LQRGains DesignLQR(const Matrix& A, const Matrix& B, const Matrix& C,
+                   data_t dt, size_t control_type, const Matrix& q_y,
+                   const Matrix& q_inty, const Matrix& r) {
+  size_t n_x = A.n_rows;
+  size_t n_u = B.n_cols;
+  size_t n_y = C.n_rows;
+  bool do_delta_u = control_type & kControlTypeDeltaU;
+  bool do_int_y = control_type & kControlTypeIntY;
+
+  if ((q_y.n_rows != n_y) || (q_y.n_cols != n_y) || (r.n_rows != n_u) ||
+      (r.n_cols != n_u) ||
+      (do_int_y && ((q_inty.n_rows != n_y) || (q_inty.n_cols != n_y)))) {
+    throw std::runtime_error("DesignLQR cost dimensions do not match system");
+  }
+
+  // augmented state: [x; v (if DeltaU); int_e (if IntY)]
+  size_t n_v = do_delta_u ? n_u : 0;
+  size_t n_e = do_int_y ? n_y : 0;
+  size_t n_aug = n_x + n_v + n_e;
+  size_t idx_v = n_x;
+  size_t idx_e = n_x + n_v;
+
+  Matrix a_aug(n_aug, n_aug, fill::zeros);
+  Matrix b_aug(n_aug, n_u, fill::zeros);
+  Matrix h_aug(n_y + n_e, n_aug, fill::zeros);  // costed outputs
+  Matrix q_aug(n_y + n_e, n_y + n_e, fill::zeros);
+
+  a_aug.submat(0, 0, n_x - 1, n_x - 1) = A;
+  h_aug.submat(0, 0, n_y - 1, n_x - 1) = C;
+  q_aug.submat(0, 0, n_y - 1, n_y - 1) = q_y;
+  if (do_delta_u) {
+    // v_t = v_t-1 + dv_t-1
+    a_aug.submat(0, idx_v, n_x - 1, idx_v + n_u - 1) = B;
+    a_aug.submat(idx_v, idx_v, idx_v + n_u - 1, idx_v + n_u - 1) =
+        Matrix(n_u, n_u, fill::eye);
+    b_aug.rows(idx_v, idx_v + n_u - 1) = Matrix(n_u, n_u, fill::eye);
+  } else {
+    b_aug.rows(0, n_x - 1) = B;
+  }
+  if (do_int_y) {
+    // int_e_t = int_e_t-1 + C*x_t-1*dt
+    a_aug.submat(idx_e, 0, idx_e + n_y - 1, n_x - 1) = C * dt;
+    a_aug.submat(idx_e, idx_e, idx_e + n_y - 1, idx_e + n_y - 1) =
+        Matrix(n_y, n_y, fill::eye);
+    h_aug.submat(n_y, idx_e, 2 * n_y - 1, idx_e + n_y - 1) =
+        Matrix(n_y, n_y, fill::eye);
+    q_aug.submat(n_y, n_y, 2 * n_y - 1, 2 * n_y - 1) = q_inty;
+  }
+
+  Matrix k = CalcLQRGain(a_aug, b_aug, h_aug.t() * q_aug * h_aug, r);
+
+  LQRGains gains;
+  gains.Kc = k.cols(0, n_x - 1);
+  if (do_delta_u) {
+    gains.Kc_u = k.cols(idx_v, idx_v + n_u - 1);
+  }
+  if (do_int_y) {
+    gains.Kc_inty = k.cols(idx_e, idx_e + n_y - 1);
+  }
+  return gains;
+}
+
+}  // namespace lds
@@ -0,0 +1,72 @@
+//===-- lds_monte_carlo.cpp - Monte-Carlo Simulation ----------------------===//
+//
+// Copyright 2021 Michael Bolus
+// Copyright 2021 Georgia Institute of Technology
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file implements the noise models by which `lds::MonteCarlo`
+/// simulates Gaussian- and Poisson-output systems.
+///
+/// \brief Monte-Carlo simulation
+//===----------------------------------------------------------------------===//
+
+#include <ldsCtrlEst_h/lds_monte_carlo.h>
+
+namespace lds {
+
+Matrix NoiseFactor(const Matrix& cov) {
+  if (!any(vectorise(cov))) {
+    return Matrix(cov.n_rows, cov.n_cols, fill::zeros);  // noiseless
+  }
+
+  Matrix cov_pd = cov;
+  ForceSymPD(cov_pd);
+  Matrix factor;
+  if (!arma::chol(factor, cov_pd, "lower")) {
+    throw std::runtime_error("Noise covariance is not positive definite.");
+  }
+  return factor;
+}
+
+namespace gaussian {
+
+Matrix MeasurementNoiseFactor(const System& sys) {
+  return NoiseFactor(sys.R());
+}
+
+void SampleMeasurement(const System& sys, const Matrix& noise_factor,
+                       CounterRng& rng, Vector& z) {
+  // z ~ N(y, R)
+  rng.Randn(z);
+  z = sys.y() + noise_factor * z;
+}
+
+}  // namespace gaussian
+
+namespace poisson {
+
+Matrix MeasurementNoiseFactor(const System& sys) { return Matrix(); }
+
+void SampleMeasurement(const System& sys, const Matrix& noise_factor,
+                       CounterRng& rng, Vector& z) {
+  // z ~ Poisson(y)
+  rng.Poisson(sys.y(), z);
+}
+
+}  // namespace poisson
+
+}  // namespace lds
@@ -0,0 +1,281 @@
+//===-- lds_poisson_particle_sys.cpp - PLDS Particles ---------------------===//
+//
+// Copyright 2021 Michael Bolus
+// Copyright 2021 Georgia Institute of Technology
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file implements the type for state estimation (filtering) of
+/// Poisson-output linear dynamical systems by a particle filter
+/// (`lds::poisson::ParticleSystem`).
+///
+/// \brief PLDS particle filter type
+//===----------------------------------------------------------------------===//
+
+#include <ldsCtrlEst_h/lds_poisson_particle_sys.h>
+
+namespace {
+// upper Cholesky factor of covariance S (falls back on the square root of its
+// diagonal if S is not positive definite, e.g., zero)
+void CholUpper(const lds::Matrix& S, lds::Matrix& R) {
+  if (!arma::chol(R, S)) {
+    R = arma::diagmat(arma::sqrt(arma::clamp(S.diag(), 0, arma::datum::inf)));
+  }
+}
+}  // namespace
+
+lds::poisson::ParticleSystem::ParticleSystem(size_t n_u, size_t n_x,
+                                             size_t n_y, data_t dt,
+                                             size_t n_particles, data_t p0,
+                                             data_t q0)
+    : lds::System(n_u, n_x, n_y, dt, p0, q0) {
+  set_n_particles(n_particles);
+}
+
+void lds::poisson::ParticleSystem::set_n_particles(size_t n_particles) {
+  if (n_particles == 0) {
+    throw std::runtime_error("number of particles must be positive");
+  }
+  n_particles_ = n_particles;
+  InitParticles();
+  do_draw_particles_ = true;
+}
+
+void lds::poisson::ParticleSystem::set_resample_thresh(data_t thresh) {
+  if (!((thresh > 0) && (thresh <= 1))) {
+    throw std::runtime_error("resample threshold must be in (0, 1]");
+  }
+  resample_thresh_ = thresh;
+}
+
+void lds::poisson::ParticleSystem::InitParticles() {
+  X_ = Matrix(n_particles_, n_x_, fill::zeros);
+  X_tmp_ = X_;
+  noise_ = X_;
+  log_rate_ = Matrix(n_particles_, n_y_, fill::zeros);
+  log_lik_ = Vector(n_particles_, fill::zeros);
+  log_w_ = Vector(n_particles_, fill::zeros);
+  w_ = Vector(n_particles_).fill(data_t(1) / n_particles_);
+  ess_ = n_particles_;
+  idx_.resize(n_particles_);
+}
+
+void lds::poisson::ParticleSystem::DrawParticles() {
+  if ((X_.n_rows != n_particles_) || (X_.n_cols != n_x_)) {
+    InitParticles();
+  }
+  CholUpper(P_, tmp_xx_);
+  Vector noise(noise_.memptr(), noise_.n_elem, false, true);
+  rng_.Randn(noise);
+  X_ = noise_ * tmp_xx_;
+  X_.each_row() += x_.t();
+
+  log_w_.zeros();
+  w_.fill(data_t(1) / n_particles_);
+  ess_ = n_particles_;
+  do_draw_particles_ = false;
+}
+
+void lds::poisson::ParticleSystem::Propagate(const Vector& u, Matrix& X) {
+  // refactor process noise covariance only when it has changed
+  if (!arma::approx_equal(Q_, Q_last_, "absdiff", 0)) {
+    CholUpper(Q_, Q_chol_);
+    Q_last_ = Q_;
+  }
+
+  // n.b., as a row per particle: X = X_ * A' + (B * (g % u) + m)' + noise
+  tmp_u_ = g_ % u;
+  tmp_x_ = m_;
+  tmp_x_ += B_ * tmp_u_;
+  X = X_ * A_.t();
+  X.each_row() += tmp_x_.t();
+
+  Vector noise(noise_.memptr(), noise_.n_elem, false, true);
+  rng_.Randn(noise);
+  X += noise_ * Q_chol_;
+}
+
+void lds::poisson::ParticleSystem::CalcLogLik(const Matrix& X,
+                                              const Vector& z) {
+  // log-rates, as a row per particle: X * C' + d'
+  log_rate_ = X * C_.t();
+  log_rate_.each_row() += d_.t();
+
+  // n.b., lgamma terms are the same for all particles (omitted)
+  log_lik_ = log_rate_ * z;
+  log_rate_ = exp(log_rate_);
+  for (size_t k = 0; k < n_y_; k++) {
+    log_lik_ -= log_rate_.col(k);
+  }
+}
+
+void lds::poisson::ParticleSystem::Resample() {
+  // systematic resampling: one uniform offset for evenly spaced positions
+  // along the cumulative sum of weights
+  data_t step = data_t(1) / n_particles_;
+  data_t pos = static_cast<data_t>(rng_.Uniform()) * step;
+  data_t cum_w = w_[0];
+  size_t j = 0;
+  for (size_t i = 0; i < n_particles_; i++) {
+    while ((pos > cum_w) && (j < n_particles_ - 1)) {
+      cum_w += w_[++j];
+    }
+    idx_[i] = j;
+    pos += step;
+  }
+
+  // n.b., gathers one contiguous column (state) at a time
+  for (size_t k = 0; k < n_x_; k++) {
+    const data_t* src = X_.colptr(k);
+    data_t* dst = X_tmp_.colptr(k);
+    for (size_t i = 0; i < n_particles_; i++) {
+      dst[i] = src[idx_[i]];
+    }
+  }
+  X_.swap(X_tmp_);
+
+  log_w_.zeros();
+  w_.fill(step);
+  n_resampled_++;
+}
+
+void lds::poisson::ParticleSystem::CalcMoments() {
+  x_ = X_.t() * w_;
+
+  // weighted covariance: (X - x')' * diag(w) * (X - x')
+  X_tmp_ = X_;
+  X_tmp_.each_row() -= x_.t();
+  noise_ = X_tmp_;
+  noise_.each_col() %= w_;
+  P_ = X_tmp_.t() * noise_;
+}
+
+void lds::poisson::ParticleSystem::f(const Vector& u, bool do_add_noise) {
+  if (do_add_noise) {
+    // simulating the state (see Simulate)
+    lds::System::f(u, true);
+    return;
+  }
+
+  LDSCTRLEST_LATENCY_SCOPE(latency_, kLatencyF);
+  if (do_draw_particles_) {
+    DrawParticles();
+  }
+  Propagate(u, X_tmp_);
+  X_.swap(X_tmp_);
+  CalcMoments();
+}
+
+void lds::poisson::ParticleSystem::Filter(const Vector& u_tm1,
+                                          const Vector& z) {
+  if (do_adapt_params_) {
+    throw std::runtime_error(
+        "ParticleSystem does not support online parameter adaptation");
+  }
+
+  // predict
+  {
+    LDSCTRLEST_LATENCY_SCOPE(latency_, kLatencyF);
+    if (do_draw_particles_) {
+      DrawParticles();
+    }
+    Propagate(u_tm1, X_tmp_);
+    X_.swap(X_tmp_);
+  }
+
+  // update
+  {
+    LDSCTRLEST_LATENCY_SCOPE(latency_, kLatencyFilterUpdate);
+    CalcLogLik(X_, z);
+    log_w_ += log_lik_;
+    log_w_ -= log_w_.max();  // (n.b., avoids underflow of all weights)
+    w_ = exp(log_w_);
+    w_ /= accu(w_);
+    ess_ = 1 / arma::dot(w_, w_);
+
+    if (ess_ < resample_thresh_ * n_particles_) {
+      Resample();
+    }
+    CalcMoments();
+  }
+
+  {
+    LDSCTRLEST_LATENCY_SCOPE(latency_, kLatencyH);
+    h();
+  }
+}
+
+// Simulate Measurement: z ~ Poisson(y)
+const lds::Vector& lds::poisson::ParticleSystem::Simulate(
+    const Vector& u_tm1) {
+  lds::System::f(u_tm1, true);  // simulate dynamics with noise added
+  h();                          // output
+  rng_.Poisson(y_, z_);
+  return z_;
+}
+
+lds::data_t lds::poisson::ParticleSystem::PredictiveLogLik(
+    const Vector& u_tm1, const Vector& z) {
+  if (do_draw_particles_) {
+    DrawParticles();
+  }
+  // n.b., predicted particles into scratch (estimate not changed)
+  Propagate(u_tm1, X_tmp_);
+  CalcLogLik(X_tmp_, z);
+
+  // log of weighted mean of likelihoods
+  data_t max_log_lik = log_lik_.max();
+  data_t log_lik =
+      max_log_lik + std::log(arma::dot(w_, exp(log_lik_ - max_log_lik)));
+  for (size_t k = 0; k < n_y_; k++) {
+    if (z[k] != 0) {
+      log_lik -= std::lgamma(z[k] + 1);
+    }
+  }
+  return log_lik;
+}
+
+void lds::poisson::ParticleSystem::SaveSnapshot(
+    Snapshot& snap, const std::string& prefix) const {
+  lds::System::SaveSnapshot(snap, prefix);
+  snap.Set(prefix + "n_particles", n_particles_);
+  snap.Set(prefix + "resample_thresh", resample_thresh_);
+  snap.Set(prefix + "n_resampled", n_resampled_);
+  snap.Set(prefix + "do_draw_particles", do_draw_particles_);
+  if (!do_draw_particles_) {
+    snap.Set(prefix + "particles", X_);
+    snap.Set(prefix + "log_w", log_w_);
+  }
+}
+
+void lds::poisson::ParticleSystem::LoadSnapshot(const Snapshot& snap,
+                                                const std::string& prefix) {
+  lds::System::LoadSnapshot(snap, prefix);
+  set_n_particles(
+      static_cast<size_t>(snap.GetScalar(prefix + "n_particles")));
+  set_resample_thresh(snap.GetScalar(prefix + "resample_thresh"));
+  n_resampled_ = static_cast<size_t>(snap.GetScalar(prefix + "n_resampled"));
+  if (snap.GetScalar(prefix + "do_draw_particles") != 0) {
+    return;
+  }
+
+  snap.Get(prefix + "particles", X_);
+  snap.Get(prefix + "log_w", log_w_);
+  w_ = exp(log_w_);
+  w_ /= accu(w_);
+  ess_ = 1 / arma::dot(w_, w_);
+  do_draw_particles_ = false;
+}
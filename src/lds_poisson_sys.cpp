@@ -31,7 +31,6 @@
 lds::poisson::System::System(size_t n_u, size_t n_x, size_t n_y, data_t dt,
                              data_t p0, data_t q0)
     : lds::System(n_u, n_x, n_y, dt, p0, q0) {
-  diag_y_ = diagmat(y_);
   pd_ = std::poisson_distribution<size_t>(0);
 };
 
@@ -40,16 +39,431 @@ lds::poisson::System::System(size_t n_u, size_t n_x, size_t n_y, data_t dt,
 //
 // see Eden et al. 2004
 void lds::poisson::System::RecurseKe() {
+  // n.b., while parameters are adapted, they change every step, so a cached
+  // gain would never be used again
+  if (do_cache_Ke_ && !do_adapt_params_) {
+    RecurseKeCached();
+  } else {
+    RecurseKeExact();
+  }
+}
+
+void lds::poisson::System::RecurseKeExact() {
+  // n.b., the prediction is evaluated into preallocated scratch (see
+  // UpdateCov for the update)
+
   // predict covariance
-  P_ = A_ * P_ * A_.t() + Q_;
+  // P_ = A_ * P_ * A_.t() + Q_;
+  tmp_xx_ = A_ * P_;
+  P_ = tmp_xx_ * A_.t();
+  P_ += Q_;
+
+  // update cov + gain
+  UpdateCov(P_, y_);
+  CalcGain(P_, Ke_);
+  if (do_adapt_m) {
+    P_m_ += Q_m_;  // predict (A_m = I)
+    UpdateCov(P_m_, y_);
+    CalcGain(P_m_, Ke_m_);
+  }
+}
+
+void lds::poisson::System::UpdateCov(Matrix& P, const Vector& y) {
+  if (cov_update_ == kCovUpdateCholesky) {
+    // Equivalent to the information form below, with the output treated as
+    // having (locally) Gaussian noise of covariance diag(1/y). Only an
+    // n_y-by-n_y matrix is factorized, and no inverse is taken. (n.b., the
+    // diagonal of the noise covariance is kept in scratch tmp_y_, which is
+    // free until the innovation is taken, and everything is evaluated into
+    // preallocated scratch.)
+    for (size_t k = 0; k < n_y_; k++) {
+      tmp_y_[k] = 1 / std::max(y[k], kYMin);
+    }
+    JosephUpdate(P, tmp_xy_, C_, tmp_y_, joseph_work_);
+    return;
+  }
+
+  // P = inv(inv(P) + C_.t() * diagmat(y) * C_);
+  // (n.b., by Woodbury identity if fewer active outputs than states; requires
+  // LAPACK workspace)
+  if (do_sparse_C_) {
+    InfoUpdate(P, C_sp_, y);
+  } else {
+    InfoUpdate(P, C_, y);
+  }
+}
+
+void lds::poisson::System::CalcGain(const Matrix& P, Matrix& Ke) {
+  if (do_sparse_C_) {
+    Ke = P * C_sp_.t();
+  } else {
+    Ke = P * C_.t();
+  }
+}
+
+void lds::poisson::System::set_sparse_C(bool do_sparse_C) {
+  do_sparse_C_ = do_sparse_C;
+  if (do_sparse_C_) {
+    C_sp_ = SpMatrix(C_);
+    C_mask_ = Matrix(n_y_, n_x_, fill::zeros);
+    C_mask_.elem(arma::find(C_)).ones();
+    C_sp_revision_ = revision_;
+  } else {
+    C_sp_.reset();
+    C_mask_.reset();
+  }
+}
+
+void lds::poisson::System::set_Ke_cache(data_t log_y_step,
+                                        size_t check_period,
+                                        size_t max_entries, data_t max_err) {
+  if (!(log_y_step > 0)) {
+    throw std::runtime_error(
+        "bin width of estimator gain cache (log_y_step) must be positive");
+  }
+  do_cache_Ke_ = true;
+  log_y_step_ = log_y_step;
+  check_period_ = check_period;
+  max_entries_ = max_entries;
+  max_err_ = max_err;
+  n_since_check_ = 0;
+  Ke_cache_key_.assign(n_y_, 0);
+  Ke_cache_pending_.assign(kKeCacheMaxPending, std::vector<long>(n_y_, 0));
+  ClearKeCache();
+}
+
+namespace {
+const size_t kKeCacheMaxIter = 1000;  // max iterations of cached gain
+// tolerance of cached gain (n.b., reachable in single precision)
+const lds::data_t kKeCacheTol =
+    1e3 * std::numeric_limits<lds::data_t>::epsilon();
+}  // namespace
+
+lds::Vector lds::poisson::System::KeCacheBinCenter(
+    const std::vector<long>& key) const {
+  Vector y_c(n_y_);
+  for (size_t k = 0; k < n_y_; k++) {
+    y_c[k] = exp(key[k] * log_y_step_);
+  }
+  return y_c;
+}
+
+// Steady-state gains with output rate held at `y_c`: iterate the covariance
+// recursion (starting from the current estimate) to its fixed point.
+lds::poisson::System::KeCacheEntry lds::poisson::System::CalcKeCacheEntry(
+    const Vector& y_c) {
+  KeCacheEntry entry;
+  entry.P = P_;
+  Matrix p_post(n_x_, n_x_);
+  for (size_t k = 0; k < kKeCacheMaxIter; k++) {
+    tmp_xx_ = A_ * entry.P;
+    p_post = tmp_xx_ * A_.t();
+    p_post += Q_;
+    UpdateCov(p_post, y_c);
+    data_t delta = norm(p_post - entry.P, "fro") / norm(p_post, "fro");
+    entry.P.swap(p_post);
+    if (delta < kKeCacheTol) {
+      break;
+    }
+  }
+  CalcGain(entry.P, entry.Ke);
+
+  // n.b., disturbance gains are only calculated once m is adapted
+  if (do_adapt_m) {
+    CalcKeCacheEntryM(y_c, entry);
+  }
+  return entry;
+}
+
+void lds::poisson::System::CalcKeCacheEntryM(const Vector& y_c,
+                                            KeCacheEntry& entry) {
+  // disturbance (A_m = I)
+  entry.P_m = P_m_;
+  Matrix p_post(n_x_, n_x_);
+  for (size_t k = 0; k < kKeCacheMaxIter; k++) {
+    p_post = entry.P_m;
+    p_post += Q_m_;
+    UpdateCov(p_post, y_c);
+    data_t delta = norm(p_post - entry.P_m, "fro") / norm(p_post, "fro");
+    entry.P_m.swap(p_post);
+    if (delta < kKeCacheTol) {
+      break;
+    }
+  }
+  CalcGain(entry.P_m, entry.Ke_m);
+}
+
+void lds::poisson::System::PrepareKeCache() {
+  // gains were calculated for previous parameters
+  if (Ke_cache_revision_ != revision_) {
+    ClearKeCache();
+  }
+  if (do_sparse_C_ && (C_sp_revision_ != revision_)) {
+    set_sparse_C(true);  // parameters were set (new sparsity pattern)
+  }
+}
+
+void lds::poisson::System::RecurseKeCached() {
+  PrepareKeCache();
+
+  // quantize log-rate (n.b., log(y) = C*x + d)
+  for (size_t k = 0; k < n_y_; k++) {
+    Ke_cache_key_[k] = std::lround((cx_[k] + d_[k]) / log_y_step_);
+  }
+
+  auto entry = Ke_cache_.find(Ke_cache_key_);
+  bool is_new = entry == Ke_cache_.end();
+  if (is_new || entry->second.is_rejected ||
+      (do_adapt_m && entry->second.Ke_m.is_empty())) {
+    // n.b., gains of a regime not yet cached (or cached before m was adapted)
+    // are not calculated here, on the real-time path, but queued for
+    // FillKeCache
+    if (is_new) {
+      if (Ke_cache_.size() + n_pending_ < max_entries_) {
+        QueueKeCacheKey();
+      }
+    } else if (!entry->second.is_rejected) {
+      QueueKeCacheKey();
+    }
+    RecurseKeExact();
+    return;
+  }
+
+  // periodically compare against the gain of the exact recursion
+  if ((check_period_ > 0) && (++n_since_check_ >= check_period_)) {
+    n_since_check_ = 0;
+    RecurseKeExact();
+    Ke_cache_err_ = norm(Ke_ - entry->second.Ke, "fro") / norm(Ke_, "fro");
+    Ke_cache_err_max_ = std::max(Ke_cache_err_, Ke_cache_err_max_);
+    if (Ke_cache_err_ > max_err_) {
+      // keep exact gain, now and hereafter for this regime
+      entry->second.is_rejected = true;
+      return;
+    }
+  }
 
-  // update cov
-  P_ = pinv(pinv(P_) + C_.t() * diag_y_ * C_);
-  Ke_ = P_ * C_.t();
+  Reassign(P_, entry->second.P);
+  Reassign(Ke_, entry->second.Ke);
   if (do_adapt_m) {
-    P_m_ += Q_m_;                                     // predict (A_m = I)
-    P_m_ = pinv(pinv(P_m_) + C_.t() * diag_y_ * C_);  // update
-    Ke_m_ = P_m_ * C_.t();
+    Reassign(P_m_, entry->second.P_m);
+    Reassign(Ke_m_, entry->second.Ke_m);
+  }
+}
+
+void lds::poisson::System::QueueKeCacheKey() {
+  if (n_pending_ == Ke_cache_pending_.size()) {
+    return;  // full (n.b., regime is queued again when next visited)
+  }
+  for (size_t k = 0; k < n_pending_; k++) {
+    if (Ke_cache_pending_[k] == Ke_cache_key_) {
+      return;
+    }
+  }
+  // n.b., same size, so no allocation
+  Ke_cache_pending_[n_pending_++] = Ke_cache_key_;
+}
+
+size_t lds::poisson::System::FillKeCache(size_t max_filled) {
+  if (!do_cache_Ke_) {
+    return 0;
+  }
+  PrepareKeCache();
+
+  size_t n_filled = 0;
+  while ((n_pending_ > 0) && (n_filled < max_filled)) {
+    const std::vector<long>& key = Ke_cache_pending_[--n_pending_];
+    auto entry = Ke_cache_.find(key);
+    if (entry == Ke_cache_.end()) {
+      if (Ke_cache_.size() >= max_entries_) {
+        continue;
+      }
+      Ke_cache_.emplace(key, CalcKeCacheEntry(KeCacheBinCenter(key)));
+    } else if (do_adapt_m && entry->second.Ke_m.is_empty()) {
+      CalcKeCacheEntryM(KeCacheBinCenter(key), entry->second);
+    } else {
+      continue;
+    }
+    n_filled++;
+  }
+  return n_filled;
+}
+
+void lds::poisson::System::PrecomputeKeCache(const Matrix& log_y) {
+  if (!do_cache_Ke_) {
+    throw std::runtime_error(
+        "estimator gain cache must be enabled (set_Ke_cache) to precompute");
+  }
+  if (log_y.n_rows != n_y_) {
+    throw std::runtime_error(
+        "log-rates to precompute gains for must have n_y rows");
+  }
+  PrepareKeCache();
+
+  std::vector<long> key(n_y_);
+  for (size_t t = 0; t < log_y.n_cols; t++) {
+    for (size_t k = 0; k < n_y_; k++) {
+      key[k] = std::lround(log_y(k, t) / log_y_step_);
+    }
+    auto entry = Ke_cache_.find(key);
+    if (entry == Ke_cache_.end()) {
+      if (Ke_cache_.size() >= max_entries_) {
+        return;
+      }
+      Ke_cache_.emplace(key, CalcKeCacheEntry(KeCacheBinCenter(key)));
+    } else if (do_adapt_m && entry->second.Ke_m.is_empty()) {
+      CalcKeCacheEntryM(KeCacheBinCenter(key), entry->second);
+    }
+  }
+}
+
+void lds::poisson::System::InitAdaptOutput(data_t p0) {
+  P_theta_y_ = Cube(n_x_ + 1, n_x_ + 1, n_y_, fill::zeros);
+  for (size_t k = 0; k < n_y_; k++) {
+    P_theta_y_.slice(k).diag().fill(p0);
+  }
+}
+
+void lds::poisson::System::AdaptOutput(const Vector& z) {
+  // n.b., y_ not yet updated (i.e., predicted output rate)
+  phi_y_.head(n_x_) = x_pre_;
+  for (size_t k = 0; k < n_y_; k++) {
+    RLSUpdate(P_theta_y_.slice(k), phi_y_, y_[k], k_y_);
+    data_t err = z[k] - y_[k];
+    C_.row(k) += err * k_y_.head(n_x_).t();
+    d_[k] += err * k_y_[n_x_];
+  }
+  if (do_sparse_C_) {
+    // keep sparsity pattern
+    C_ %= C_mask_;
+    C_sp_ = SpMatrix(C_);
+  }
+  revision_++;
+  C_sp_revision_ = revision_;
+}
+
+void lds::poisson::System::SaveSnapshot(Snapshot& snap,
+                                        const std::string& prefix) const {
+  lds::System::SaveSnapshot(snap, prefix);
+  if (do_adapt_params_) {
+    snap.Set(prefix + "P_theta_y", P_theta_y_);
+  }
+  snap.Set(prefix + "do_sparse_C", do_sparse_C_);
+
+  snap.Set(prefix + "do_cache_Ke", do_cache_Ke_);
+  if (!do_cache_Ke_) {
+    return;
+  }
+  snap.Set(prefix + "log_y_step", log_y_step_);
+  snap.Set(prefix + "check_period", check_period_);
+  snap.Set(prefix + "Ke_cache_max_entries", max_entries_);
+  snap.Set(prefix + "Ke_cache_max_err", max_err_);
+  snap.Set(prefix + "n_since_check", n_since_check_);
+  snap.Set(prefix + "Ke_cache_err", Ke_cache_err_);
+  snap.Set(prefix + "Ke_cache_err_max", Ke_cache_err_max_);
+
+  // n.b., entries are stacked (column/slice per entry), with zeros for
+  // disturbance gains not calculated (see has_m)
+  size_t n_entries = Ke_cache_.size();
+  Matrix keys(n_y_, n_entries);
+  Cube p(n_x_, n_x_, n_entries);
+  Cube ke(n_x_, n_y_, n_entries);
+  Cube p_m(n_x_, n_x_, n_entries, fill::zeros);
+  Cube ke_m(n_x_, n_y_, n_entries, fill::zeros);
+  Vector has_m(n_entries, fill::zeros);
+  Vector is_rejected(n_entries, fill::zeros);
+  size_t k = 0;
+  for (const auto& entry : Ke_cache_) {
+    for (size_t j = 0; j < n_y_; j++) {
+      keys(j, k) = static_cast<data_t>(entry.first[j]);
+    }
+    p.slice(k) = entry.second.P;
+    ke.slice(k) = entry.second.Ke;
+    if (!entry.second.Ke_m.is_empty()) {
+      p_m.slice(k) = entry.second.P_m;
+      ke_m.slice(k) = entry.second.Ke_m;
+      has_m[k] = 1;
+    }
+    is_rejected[k] = entry.second.is_rejected ? 1 : 0;
+    k++;
+  }
+  snap.Set(prefix + "Ke_cache.keys", keys);
+  snap.Set(prefix + "Ke_cache.P", p);
+  snap.Set(prefix + "Ke_cache.Ke", ke);
+  snap.Set(prefix + "Ke_cache.P_m", p_m);
+  snap.Set(prefix + "Ke_cache.Ke_m", ke_m);
+  snap.Set(prefix + "Ke_cache.has_m", has_m);
+  snap.Set(prefix + "Ke_cache.is_rejected", is_rejected);
+}
+
+void lds::poisson::System::LoadSnapshot(const Snapshot& snap,
+                                        const std::string& prefix) {
+  lds::System::LoadSnapshot(snap, prefix);
+  if (do_adapt_params_) {
+    Cube p_theta_y = snap.GetCube(prefix + "P_theta_y");
+    if ((p_theta_y.n_rows != P_theta_y_.n_rows) ||
+        (p_theta_y.n_slices != P_theta_y_.n_slices)) {
+      throw std::runtime_error(
+          "dimensions of snapshot do not match those of system (P_theta_y)");
+    }
+    P_theta_y_ = p_theta_y;
+  }
+  set_sparse_C(snap.GetScalar(prefix + "do_sparse_C") != 0);
+  h();  // (n.b., with sparse copy of C)
+
+  if (snap.GetScalar(prefix + "do_cache_Ke") == 0) {
+    UnsetKeCache();
+    return;
+  }
+  // n.b., snapshots saved before the cache was bounded have neither bound
+  size_t max_entries = kDefaultKeCacheMaxEntries;
+  if (snap.Has(prefix + "Ke_cache_max_entries")) {
+    max_entries =
+        static_cast<size_t>(snap.GetScalar(prefix + "Ke_cache_max_entries"));
+  }
+  data_t max_err = snap.Has(prefix + "Ke_cache_max_err")
+                       ? snap.GetScalar(prefix + "Ke_cache_max_err")
+                       : kInf;
+  set_Ke_cache(snap.GetScalar(prefix + "log_y_step"),
+               static_cast<size_t>(snap.GetScalar(prefix + "check_period")),
+               max_entries, max_err);
+  n_since_check_ =
+      static_cast<size_t>(snap.GetScalar(prefix + "n_since_check"));
+  Ke_cache_err_ = snap.GetScalar(prefix + "Ke_cache_err");
+  Ke_cache_err_max_ = snap.GetScalar(prefix + "Ke_cache_err_max");
+
+  Matrix keys = snap.Get(prefix + "Ke_cache.keys");
+  Cube p = snap.GetCube(prefix + "Ke_cache.P");
+  Cube ke = snap.GetCube(prefix + "Ke_cache.Ke");
+  Cube p_m = snap.GetCube(prefix + "Ke_cache.P_m");
+  Cube ke_m = snap.GetCube(prefix + "Ke_cache.Ke_m");
+  // n.b., snapshots saved before disturbance gains were calculated on demand
+  // have them for every entry
+  Vector has_m = snap.Has(prefix + "Ke_cache.has_m")
+                     ? Vector(snap.Get(prefix + "Ke_cache.has_m"))
+                     : Vector(keys.n_cols, fill::ones);
+  Vector is_rejected = snap.Has(prefix + "Ke_cache.is_rejected")
+                           ? Vector(snap.Get(prefix + "Ke_cache.is_rejected"))
+                           : Vector(keys.n_cols, fill::zeros);
+  if ((keys.n_rows != n_y_) || (p.n_rows != n_x_) || (ke.n_cols != n_y_) ||
+      (p.n_slices != keys.n_cols) || (ke.n_slices != keys.n_cols) ||
+      (p_m.n_slices != keys.n_cols) || (ke_m.n_slices != keys.n_cols) ||
+      (has_m.n_elem != keys.n_cols) || (is_rejected.n_elem != keys.n_cols)) {
+    throw std::runtime_error(
+        "dimensions of snapshot do not match those of system (Ke_cache)");
+  }
+  std::vector<long> key(n_y_);
+  for (size_t k = 0; k < keys.n_cols; k++) {
+    for (size_t j = 0; j < n_y_; j++) {
+      key[j] = std::lround(keys(j, k));
+    }
+    KeCacheEntry& entry = Ke_cache_[key];
+    entry.P = p.slice(k);
+    entry.Ke = ke.slice(k);
+    if (has_m[k] != 0) {
+      entry.P_m = p_m.slice(k);
+      entry.Ke_m = ke_m.slice(k);
+    }
+    entry.is_rejected = is_rejected[k] != 0;
   }
 }
 
@@ -68,4 +482,51 @@ const lds::Vector& lds::poisson::System::Simulate(const Vector& u_tm1) {
 
   return z_;
 }
+
+lds::data_t lds::poisson::System::PredictiveLogLik(const Vector& u_tm1,
+                                                   const Vector& z) {
+  // predicted state (as f, but into scratch)
+  tmp_u_ = g_ % u_tm1;
+  tmp_x_ = m_;
+  tmp_x_ += A_ * x_;
+  tmp_x_ += B_ * tmp_u_;
+
+  // predicted log-rate
+  if (do_sparse_C_) {
+    if (C_sp_revision_ != revision_) {
+      set_sparse_C(true);  // parameters were set (new sparsity pattern)
+    }
+    tmp_y_ = C_sp_ * tmp_x_;
+  } else {
+    tmp_y_ = C_ * tmp_x_;
+  }
+  tmp_y_ += d_;
+
+  // variance of predicted log-rate, diag(C (A P A' + Q) C'), by quadratic
+  // forms in the rows of C*A (columns of tmp_xy_) and of C
+  tmp_xy_ = A_.t() * C_.t();
+
+  // expected under the (Gaussian) predicted state, such that the rate is
+  // log-normal: E[exp(eta)] = exp(mean + var/2)
+  // n.b., log and lgamma terms vanish for bins without events
+  data_t log_lik = 0;
+  for (size_t k = 0; k < n_y_; k++) {
+    const data_t* ca_k = tmp_xy_.colptr(k);
+    data_t var_k = 0;
+    for (size_t j = 0; j < n_x_; j++) {
+      data_t p_ca = 0;
+      data_t q_c = 0;
+      for (size_t i = 0; i < n_x_; i++) {
+        p_ca += P_(i, j) * ca_k[i];
+        q_c += Q_(i, j) * C_(k, i);
+      }
+      var_k += ca_k[j] * p_ca + C_(k, j) * q_c;
+    }
+    log_lik -= std::exp(tmp_y_[k] + var_k / 2);
+    if (z[k] != 0) {
+      log_lik += z[k] * tmp_y_[k] - std::lgamma(z[k] + 1);
+    }
+  }
+  return log_lik;
+}
 // ******************* SYS_T *******************
@@ -0,0 +1,338 @@
+//===-- lds_recorder.cpp - Session Recorder -------------------------------===//
+//
+// Copyright 2021 Michael Bolus
+// Copyright 2021 Georgia Institute of Technology
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file implements a type by which the per-step signals of a closed-loop
+/// session are streamed to file in fixed-size chunks by a background thread
+/// (`lds::Recorder`), and a type by which a recorded session is read back
+/// (`lds::RecordReader`).
+///
+/// \brief session recorder
+//===----------------------------------------------------------------------===//
+
+#include <ldsCtrlEst_h/lds_recorder.h>
+
+#include <chrono>
+#include <cstring>
+
+namespace lds {
+
+namespace {
+const char kRecordMagic[8] = {'L', 'D', 'S', 'R', 'E', 'C', '\0', '\0'};
+const std::uint32_t kRecordByteOrder = 0x01020304;
+
+// index of each field (i.e., position of its RecordField bit)
+enum : size_t {
+  kIdxU,
+  kIdxZ,
+  kIdxX,
+  kIdxY,
+  kIdxM,
+};
+
+/// File header
+struct Header {
+  char magic[8];             ///< "LDSREC\0\0"
+  std::uint32_t version;     ///< format version
+  std::uint32_t byte_order;  ///< byte-order mark
+  std::uint32_t size_data;   ///< size of data_t (bytes)
+  std::uint32_t fields;      ///< fields recorded
+  std::uint64_t n_u;         ///< number of inputs
+  std::uint64_t n_x;         ///< number of states
+  std::uint64_t n_y;         ///< number of outputs
+  std::uint64_t chunk_len;   ///< steps per chunk
+};
+
+/// gets size of each field, given dimensions (0 = not recorded)
+void FieldSizes(size_t n_u, size_t n_x, size_t n_y, size_t fields,
+                size_t* sizes) {
+  const size_t all[] = {n_u, n_y, n_x, n_y, n_x};
+  for (size_t k = 0; k < sizeof(all) / sizeof(all[0]); k++) {
+    sizes[k] = (fields & (size_t(1) << k)) ? all[k] : 0;
+  }
+}
+}  // namespace
+
+Recorder::Recorder(const std::string& path, size_t n_u, size_t n_x,
+                   size_t n_y, size_t fields, size_t chunk_len,
+                   size_t n_chunks)
+    : n_u_(n_u),
+      n_x_(n_x),
+      n_y_(n_y),
+      fields_(fields & kRecordAll),
+      chunk_len_(chunk_len),
+      free_(n_chunks),
+      filled_(n_chunks) {
+  if (chunk_len == 0) {
+    throw std::runtime_error("Recorder chunk length must be positive");
+  }
+  if (n_chunks < 2) {
+    throw std::runtime_error("Recorder requires at least two chunks");
+  }
+
+  FieldSizes(n_u, n_x, n_y, fields_, sizes_);
+  size_t n_chunk = 0;
+  for (size_t k = 0; k < kNumFields; k++) {
+    offsets_[k] = n_chunk;
+    n_chunk += sizes_[k] * chunk_len;
+  }
+  chunks_ = std::vector<std::vector<data_t>>(n_chunks,
+                                             std::vector<data_t>(n_chunk));
+  for (size_t k = 0; k < n_chunks; k++) {
+    free_.Push(k);
+  }
+
+  file_.open(path, std::ios::binary | std::ios::trunc);
+  Header header{};
+  std::memcpy(header.magic, kRecordMagic, sizeof(header.magic));
+  header.version = kRecordVersion;
+  header.byte_order = kRecordByteOrder;
+  header.size_data = sizeof(data_t);
+  header.fields = static_cast<std::uint32_t>(fields_);
+  header.n_u = n_u;
+  header.n_x = n_x;
+  header.n_y = n_y;
+  header.chunk_len = chunk_len;
+  file_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  file_.flush();
+  if (!file_) {
+    throw std::runtime_error("failed to open record file: " + path);
+  }
+
+  thread_ = std::thread(&Recorder::Run, this);
+}
+
+Recorder::~Recorder() {
+  try {
+    Close();
+  } catch (...) {
+  }
+}
+
+bool Recorder::Record(const Vector& u, const Vector& z, const System& sys) {
+  if ((u.n_elem != n_u_) || (z.n_elem != n_y_) || (sys.n_x() != n_x_) ||
+      (sys.n_y() != n_y_)) {
+    throw std::runtime_error(
+        "dimensionality of step does not match that of Recorder");
+  }
+  if (!has_chunk_) {
+    has_chunk_ = free_.Pop(idx_);
+    if (!has_chunk_) {
+      n_dropped_++;
+      return false;
+    }
+    n_steps_ = 0;
+  }
+
+  Store(kIdxU, u);
+  Store(kIdxZ, z);
+  Store(kIdxX, sys.x());
+  Store(kIdxY, sys.y());
+  Store(kIdxM, sys.m());
+  n_steps_++;
+  n_recorded_++;
+
+  if (n_steps_ == chunk_len_) {
+    Flush();
+  }
+  return true;
+}
+
+void Recorder::Store(size_t idx, const Vector& v) {
+  if (sizes_[idx] == 0) {
+    return;
+  }
+  data_t* mem = chunks_[idx_].data() + offsets_[idx] + n_steps_ * sizes_[idx];
+  std::memcpy(mem, v.memptr(), sizes_[idx] * sizeof(data_t));
+}
+
+void Recorder::Flush() {
+  if (!has_chunk_ || (n_steps_ == 0)) {
+    return;
+  }
+  // n.b., cannot be full, as there are only as many chunks as slots
+  Filled filled;
+  filled.idx = idx_;
+  filled.n_steps = n_steps_;
+  filled_.Push(filled);
+  has_chunk_ = false;
+}
+
+void Recorder::Close() {
+  if (!thread_.joinable()) {
+    return;
+  }
+  Flush();
+  do_stop_.store(true);
+  thread_.join();
+  file_.close();
+  if (error_) {
+    std::exception_ptr error = error_;
+    error_ = nullptr;
+    std::rethrow_exception(error);
+  }
+}
+
+void Recorder::Run() {
+  try {
+    Filled filled;
+    while (true) {
+      // n.b., stop is read before the queue, so that chunks handed over
+      // before stopping are drained
+      bool do_stop = do_stop_.load();
+      while (filled_.Pop(filled)) {
+        Write(filled);
+        free_.Push(filled.idx);
+      }
+      if (do_stop) {
+        break;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  } catch (...) {
+    error_ = std::current_exception();
+  }
+}
+
+void Recorder::Write(const Filled& filled) {
+  std::uint64_t n_steps = filled.n_steps;
+  file_.write(reinterpret_cast<const char*>(&n_steps), sizeof(n_steps));
+  const data_t* chunk = chunks_[filled.idx].data();
+  for (size_t k = 0; k < kNumFields; k++) {
+    // n.b., steps of a partial chunk are at the start of each block
+    file_.write(reinterpret_cast<const char*>(chunk + offsets_[k]),
+                sizes_[k] * filled.n_steps * sizeof(data_t));
+  }
+  file_.flush();
+  if (!file_) {
+    throw std::runtime_error("failed to write record file");
+  }
+  n_written_ += filled.n_steps;
+}
+
+RecordReader::RecordReader(const std::string& path) {
+  std::ifstream file(path, std::ios::binary);
+  Header header{};
+  if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+      (std::memcmp(header.magic, kRecordMagic, sizeof(header.magic)) != 0)) {
+    throw std::runtime_error("not a record file: " + path);
+  }
+  if (header.version > kRecordVersion) {
+    throw std::runtime_error("record is of a newer format version: " + path);
+  }
+  if (header.byte_order != kRecordByteOrder) {
+    throw std::runtime_error("record is of a different byte order: " + path);
+  }
+  if (header.size_data != sizeof(data_t)) {
+    throw std::runtime_error(
+        "record is of a different precision (data_t): " + path);
+  }
+  n_u_ = header.n_u;
+  n_x_ = header.n_x;
+  n_y_ = header.n_y;
+  fields_ = header.fields & kRecordAll;
+  chunk_len_ = header.chunk_len;
+  FieldSizes(n_u_, n_x_, n_y_, fields_, sizes_);
+  size_t n_per_step = 0;
+  for (size_t k = 0; k < kNumFields; k++) {
+    n_per_step += sizes_[k];
+  }
+
+  // n.b., size data up front from that of the file (i.e., one allocation)
+  std::streampos begin = file.tellg();
+  file.seekg(0, std::ios::end);
+  std::streamoff n_bytes = file.tellg() - begin;
+  file.seekg(begin);
+  data_.reserve(static_cast<size_t>(n_bytes) / sizeof(data_t));
+
+  std::uint64_t n_steps = 0;
+  while (file.read(reinterpret_cast<char*>(&n_steps), sizeof(n_steps))) {
+    if (n_steps > chunk_len_) {
+      throw std::runtime_error("record is corrupt: " + path);
+    }
+    size_t offset = data_.size();
+    size_t n_chunk = n_per_step * n_steps;
+    data_.resize(offset + n_chunk);
+    if (!file.read(reinterpret_cast<char*>(data_.data() + offset),
+                   n_chunk * sizeof(data_t))) {
+      data_.resize(offset);
+      is_truncated_ = true;
+      break;
+    }
+    chunk_offsets_.push_back(offset);
+    chunk_steps_.push_back(n_steps);
+    n_steps_ += n_steps;
+  }
+  // n.b., a partial chunk header also counts as truncation
+  if (file.gcount() > 0 && file.gcount() < std::streamsize(sizeof(n_steps))) {
+    is_truncated_ = true;
+  }
+}
+
+size_t RecordReader::FieldIndex(RecordField field) const {
+  for (size_t k = 0; k < kNumFields; k++) {
+    if (field == (size_t(1) << k)) {
+      if (sizes_[k] == 0) {
+        throw std::runtime_error("field was not recorded");
+      }
+      return k;
+    }
+  }
+  throw std::runtime_error("RecordReader requires a single field");
+}
+
+UniformMatrixList<kMatFreeDim2> RecordReader::Trials(RecordField field,
+                                                     size_t min_steps) const {
+  size_t idx = FieldIndex(field);
+  std::vector<data_t*> mems;
+  std::vector<std::array<size_t, 2>> dims;
+  for (size_t k = 0; k < chunk_offsets_.size(); k++) {
+    size_t n_steps = chunk_steps_[k];
+    if ((n_steps == 0) || (n_steps < min_steps)) {
+      continue;
+    }
+    size_t offset = chunk_offsets_[k];
+    for (size_t j = 0; j < idx; j++) {
+      offset += sizes_[j] * n_steps;
+    }
+    // n.b., fitting types only read their training data
+    mems.push_back(const_cast<data_t*>(data_.data() + offset));
+    dims.push_back({sizes_[idx], n_steps});
+  }
+  return UniformMatrixList<kMatFreeDim2>(mems, dims);
+}
+
+Matrix RecordReader::Session(RecordField field) const {
+  size_t idx = FieldIndex(field);
+  Matrix session(sizes_[idx], n_steps_);
+  data_t* mem = session.memptr();
+  for (size_t k = 0; k < chunk_offsets_.size(); k++) {
+    size_t n_steps = chunk_steps_[k];
+    size_t offset = chunk_offsets_[k];
+    for (size_t j = 0; j < idx; j++) {
+      offset += sizes_[j] * n_steps;
+    }
+    size_t n_elem = sizes_[idx] * n_steps;
+    std::memcpy(mem, data_.data() + offset, n_elem * sizeof(data_t));
+    mem += n_elem;
+  }
+  return session;
+}
+
+}  // namespace lds
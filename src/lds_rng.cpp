@@ -0,0 +1,157 @@
+//===-- lds_rng.cpp - Counter-Based RNG -----------------------------------===//
+//
+// Copyright 2021 Michael Bolus
+// Copyright 2021 Georgia Institute of Technology
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file implements a counter-based random number generator
+/// (`lds::CounterRng`).
+///
+/// \brief counter-based random number generator
+//===----------------------------------------------------------------------===//
+
+#include <ldsCtrlEst_h/lds_rng.h>
+
+#include <cmath>
+
+namespace lds {
+
+namespace {
+// Philox4x32 multipliers and Weyl sequence constants (Salmon et al. 2011)
+const std::uint32_t kPhiloxM0 = 0xD2511F53;
+const std::uint32_t kPhiloxM1 = 0xCD9E8D57;
+const std::uint32_t kPhiloxW0 = 0x9E3779B9;
+const std::uint32_t kPhiloxW1 = 0xBB67AE85;
+const size_t kPhiloxRounds = 10;
+
+// below this mean, Poisson numbers are drawn by inversion
+const double kPoissonInversionMax = 10;
+}  // namespace
+
+CounterRng::CounterRng(std::uint64_t seed, std::uint64_t stream)
+    : key_{{static_cast<std::uint32_t>(seed),
+            static_cast<std::uint32_t>(seed >> 32)}},
+      counter_{{0, 0, static_cast<std::uint32_t>(stream),
+                static_cast<std::uint32_t>(stream >> 32)}} {}
+
+void CounterRng::Generate() {
+  std::array<std::uint32_t, 4> ctr = counter_;
+  std::array<std::uint32_t, 2> key = key_;
+  for (size_t r = 0; r < kPhiloxRounds; r++) {
+    if (r > 0) {
+      key[0] += kPhiloxW0;
+      key[1] += kPhiloxW1;
+    }
+    std::uint64_t p0 = static_cast<std::uint64_t>(kPhiloxM0) * ctr[0];
+    std::uint64_t p1 = static_cast<std::uint64_t>(kPhiloxM1) * ctr[2];
+    ctr = {{static_cast<std::uint32_t>(p1 >> 32) ^ ctr[1] ^ key[0],
+            static_cast<std::uint32_t>(p1),
+            static_cast<std::uint32_t>(p0 >> 32) ^ ctr[3] ^ key[1],
+            static_cast<std::uint32_t>(p0)}};
+  }
+  block_ = ctr;
+  idx_ = 0;
+
+  // next block (n.b., first two words of counter)
+  if (++counter_[0] == 0) {
+    counter_[1]++;
+  }
+}
+
+double CounterRng::Uniform() {
+  // 53 random bits, offset by half a step so that 0 and 1 are excluded
+  std::uint64_t hi = (*this)();
+  std::uint64_t lo = (*this)();
+  std::uint64_t bits = ((hi << 32) | lo) >> 11;
+  return (static_cast<double>(bits) + 0.5) / 9007199254740992.0;  // 2^53
+}
+
+data_t CounterRng::Randn() {
+  if (has_randn_spare_) {
+    has_randn_spare_ = false;
+    return static_cast<data_t>(randn_spare_);
+  }
+
+  // Box-Muller (n.b., produces a pair)
+  double r = std::sqrt(-2 * std::log(Uniform()));
+  double theta = 2 * arma::datum::pi * Uniform();
+  randn_spare_ = r * std::sin(theta);
+  has_randn_spare_ = true;
+  return static_cast<data_t>(r * std::cos(theta));
+}
+
+void CounterRng::Randn(Vector& x) {
+  for (size_t k = 0; k < x.n_elem; k++) {
+    x[k] = Randn();
+  }
+}
+
+size_t CounterRng::Poisson(data_t mean) {
+  if (!(mean > 0)) {
+    return 0;
+  }
+
+  double lambda = mean;
+  if (lambda < kPoissonInversionMax) {
+    // inversion by sequential search of the cdf
+    double u = Uniform();
+    double p = std::exp(-lambda);
+    double cdf = p;
+    size_t k = 0;
+    while (u > cdf) {
+      k++;
+      p *= lambda / k;
+      cdf += p;
+      if (p <= 0) {
+        break;  // n.b., remaining mass below precision
+      }
+    }
+    return k;
+  }
+
+  // transformed rejection with squeeze (PTRS, Hormann 1993)
+  double log_lambda = std::log(lambda);
+  double b = 0.931 + 2.53 * std::sqrt(lambda);
+  double a = -0.059 + 0.02483 * b;
+  double inv_alpha = 1.1239 + 1.1328 / (b - 3.4);
+  double v_r = 0.9277 - 3.6224 / (b - 2);
+  while (true) {
+    double u = Uniform() - 0.5;
+    double v = Uniform();
+    double u_s = 0.5 - std::abs(u);
+    double k = std::floor((2 * a / u_s + b) * u + lambda + 0.43);
+    if ((u_s >= 0.07) && (v <= v_r)) {
+      return static_cast<size_t>(k);
+    }
+    if ((k < 0) || ((u_s < 0.013) && (v > u_s))) {
+      continue;
+    }
+    if ((std::log(v) + std::log(inv_alpha) - std::log(a / (u_s * u_s) + b)) <=
+        (-lambda + k * log_lambda - std::lgamma(k + 1))) {
+      return static_cast<size_t>(k);
+    }
+  }
+}
+
+void CounterRng::Poisson(const Vector& mean, Vector& z) {
+  z.set_size(mean.n_elem);
+  for (size_t k = 0; k < mean.n_elem; k++) {
+    z[k] = static_cast<data_t>(Poisson(mean[k]));
+  }
+}
+
+}  // namespace lds
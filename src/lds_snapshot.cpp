@@ -0,0 +1,225 @@
+//===-- lds_snapshot.cpp - Binary Snapshot --------------------------------===//
+//
+// Copyright 2021 Michael Bolus
+// Copyright 2021 Georgia Institute of Technology
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file implements a type holding named parameters/state of systems and
+/// controllers, along with a compact binary file format by which they are
+/// saved and restored (`lds::Snapshot`).
+///
+/// \brief binary snapshot
+//===----------------------------------------------------------------------===//
+
+#include <ldsCtrlEst_h/lds_snapshot.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+namespace lds {
+
+namespace {
+const char kSnapshotMagic[8] = {'L', 'D', 'S', 'S', 'N', 'A', 'P', '\0'};
+const std::uint32_t kSnapshotByteOrder = 0x01020304;
+
+/// File header
+struct Header {
+  char magic[8];                ///< "LDSSNAP\0"
+  std::uint32_t version;        ///< format version
+  std::uint32_t byte_order;     ///< byte-order mark
+  std::uint32_t size_data;      ///< size of data_t (bytes)
+  std::uint32_t padding;        ///< (unused)
+  std::uint64_t n_records;      ///< number of records
+  std::uint64_t n_data;         ///< number of data elements
+};
+
+/// Entry of table of records
+struct TableEntry {
+  char name[kSnapshotNameLen];  ///< name (null-padded)
+  std::uint64_t offset;         ///< offset into data (elements)
+  std::uint64_t n_rows;         ///< number of rows
+  std::uint64_t n_cols;         ///< number of columns
+  std::uint64_t n_slices;       ///< number of slices
+};
+}  // namespace
+
+void Snapshot::Save(const std::string& path) const {
+  Header header{};
+  std::memcpy(header.magic, kSnapshotMagic, sizeof(header.magic));
+  header.version = kSnapshotVersion;
+  header.byte_order = kSnapshotByteOrder;
+  header.size_data = sizeof(data_t);
+  header.n_records = records_.size();
+  header.n_data = data_.size();
+
+  std::vector<TableEntry> table;
+  table.reserve(records_.size());
+  for (const auto& record : records_) {
+    TableEntry entry{};
+    std::copy(record.first.begin(), record.first.end(), entry.name);
+    entry.offset = record.second.offset;
+    entry.n_rows = record.second.n_rows;
+    entry.n_cols = record.second.n_cols;
+    entry.n_slices = record.second.n_slices;
+    table.push_back(entry);
+  }
+
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  file.write(reinterpret_cast<const char*>(table.data()),
+             table.size() * sizeof(TableEntry));
+  file.write(reinterpret_cast<const char*>(data_.data()),
+             data_.size() * sizeof(data_t));
+  if (!file) {
+    throw std::runtime_error("failed to write snapshot: " + path);
+  }
+}
+
+void Snapshot::Load(const std::string& path) {
+  std::ifstream file(path, std::ios::binary);
+  Header header{};
+  if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+      (std::memcmp(header.magic, kSnapshotMagic, sizeof(header.magic)) != 0)) {
+    throw std::runtime_error("not a snapshot file: " + path);
+  }
+  if (header.version > kSnapshotVersion) {
+    throw std::runtime_error("snapshot is of a newer format version: " + path);
+  }
+  if (header.byte_order != kSnapshotByteOrder) {
+    throw std::runtime_error("snapshot is of a different byte order: " + path);
+  }
+  if (header.size_data != sizeof(data_t)) {
+    throw std::runtime_error(
+        "snapshot is of a different precision (data_t): " + path);
+  }
+
+  std::vector<TableEntry> table(header.n_records);
+  std::vector<data_t> data(header.n_data);
+  // n.b., all data are read at once
+  if (!file.read(reinterpret_cast<char*>(table.data()),
+                 table.size() * sizeof(TableEntry)) ||
+      !file.read(reinterpret_cast<char*>(data.data()),
+                 data.size() * sizeof(data_t))) {
+    throw std::runtime_error("snapshot is truncated: " + path);
+  }
+
+  std::map<std::string, Record> records;
+  for (const auto& entry : table) {
+    Record record;
+    record.offset = entry.offset;
+    record.n_rows = entry.n_rows;
+    record.n_cols = entry.n_cols;
+    record.n_slices = entry.n_slices;
+    if (record.offset + record.n_rows * record.n_cols * record.n_slices >
+        data.size()) {
+      throw std::runtime_error("snapshot is corrupt: " + path);
+    }
+    // n.b., name is null-padded (but need not be null-terminated)
+    size_t len =
+        std::find(entry.name, entry.name + kSnapshotNameLen, '\0') - entry.name;
+    records[std::string(entry.name, len)] = record;
+  }
+
+  records_ = std::move(records);
+  data_ = std::move(data);
+}
+
+void Snapshot::Set(const std::string& name, const Matrix& mat) {
+  data_t* mem = Reserve(name, mat.n_rows, mat.n_cols, 1);
+  std::copy(mat.begin(), mat.end(), mem);
+}
+
+void Snapshot::Set(const std::string& name, const Cube& cube) {
+  data_t* mem = Reserve(name, cube.n_rows, cube.n_cols, cube.n_slices);
+  std::copy(cube.memptr(), cube.memptr() + cube.n_elem, mem);
+}
+
+Matrix Snapshot::Get(const std::string& name) const {
+  const Record& record = Find(name);
+  if (record.n_slices != 1) {
+    throw std::runtime_error("snapshot record is not a matrix: " + name);
+  }
+  Matrix mat(record.n_rows, record.n_cols);
+  auto begin = data_.begin() + record.offset;
+  std::copy(begin, begin + mat.n_elem, mat.begin());
+  return mat;
+}
+
+void Snapshot::Get(const std::string& name, Matrix& mat) const {
+  const Record& record = Find(name);
+  if ((record.n_rows != mat.n_rows) || (record.n_cols != mat.n_cols) ||
+      (record.n_slices != 1)) {
+    std::ostringstream ss;
+    ss << "cannot restore matrix of size " << mat.n_rows << "x" << mat.n_cols
+       << " from snapshot record of size " << record.n_rows << "x"
+       << record.n_cols << "x" << record.n_slices << " (" << name << ")";
+    throw std::runtime_error(ss.str());
+  }
+  auto begin = data_.begin() + record.offset;
+  std::copy(begin, begin + mat.n_elem, mat.begin());
+}
+
+Cube Snapshot::GetCube(const std::string& name) const {
+  const Record& record = Find(name);
+  Cube cube(record.n_rows, record.n_cols, record.n_slices);
+  auto begin = data_.begin() + record.offset;
+  std::copy(begin, begin + cube.n_elem, cube.memptr());
+  return cube;
+}
+
+data_t Snapshot::GetScalar(const std::string& name) const {
+  const Record& record = Find(name);
+  if (record.n_rows * record.n_cols * record.n_slices != 1) {
+    throw std::runtime_error("snapshot record is not a scalar: " + name);
+  }
+  return data_[record.offset];
+}
+
+data_t* Snapshot::Reserve(const std::string& name, size_t n_rows,
+                          size_t n_cols, size_t n_slices) {
+  if (name.empty() || (name.size() >= kSnapshotNameLen)) {
+    throw std::runtime_error("invalid snapshot record name: " + name);
+  }
+  size_t n_elem = n_rows * n_cols * n_slices;
+  auto it = records_.find(name);
+  if ((it == records_.end()) ||
+      (it->second.n_rows * it->second.n_cols * it->second.n_slices !=
+       n_elem)) {
+    // n.b., space of a replaced record of a different size is not reclaimed
+    Record record;
+    record.offset = data_.size();
+    data_.resize(data_.size() + n_elem);
+    it = records_.insert(std::make_pair(name, record)).first;
+    it->second = record;
+  }
+  it->second.n_rows = n_rows;
+  it->second.n_cols = n_cols;
+  it->second.n_slices = n_slices;
+  return data_.data() + it->second.offset;
+}
+
+const Snapshot::Record& Snapshot::Find(const std::string& name) const {
+  auto it = records_.find(name);
+  if (it == records_.end()) {
+    throw std::runtime_error("snapshot has no record: " + name);
+  }
+  return it->second;
+}
+
+}  // namespace lds
@@ -0,0 +1,203 @@
+//===-- lds_state_monitor.cpp - State Monitor -----------------------------===//
+//
+// Copyright 2021 Michael Bolus
+// Copyright 2021 Georgia Institute of Technology
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file implements a type through which the state of a system or
+/// controller is published by one thread and read consistently by others
+/// (`lds::StateMonitor`), by a sequence lock: the publisher makes the sequence
+/// odd while it writes, and a reader's copy is only consistent if the sequence
+/// was the same even number before and after it read.
+///
+/// \brief state monitor (seqlock)
+//===----------------------------------------------------------------------===//
+
+#include <ldsCtrlEst_h/lds_state_monitor.h>
+
+#include <thread>
+
+namespace lds {
+
+namespace {
+// index of each field (i.e., position of its MonitorField bit)
+enum : size_t {
+  kIdxU,
+  kIdxX,
+  kIdxP,
+  kIdxY,
+  kIdxM,
+  kIdxURef,
+  kIdxXRef,
+  kIdxYRef,
+};
+}  // namespace
+
+StateMonitor::StateMonitor(size_t n_u, size_t n_x, size_t n_y, size_t fields)
+    : n_u_(n_u), n_x_(n_x), n_y_(n_y), fields_(fields & kMonitorAll) {
+  const size_t sizes[kNumFields] = {n_u, n_x, n_x * n_x, n_y,
+                                    n_x, n_u, n_x,       n_y};
+  size_t n_words = 0;
+  for (size_t k = 0; k < kNumFields; k++) {
+    offsets_[k] = n_words;
+    sizes_[k] = (fields_ & (size_t(1) << k)) ? sizes[k] : 0;
+    n_words += sizes_[k];
+  }
+
+  words_.reset(new std::atomic<data_t>[n_words]);
+  for (size_t k = 0; k < n_words; k++) {
+    words_[k].store(0, std::memory_order_relaxed);
+  }
+}
+
+void StateMonitor::Publish(const System& sys) {
+  // n.b., checked before the sequence is made odd, so that a throw does not
+  // leave it so
+  CheckSize(kIdxX, sys.x());
+  CheckSize(kIdxP, sys.P());
+  CheckSize(kIdxY, sys.y());
+  CheckSize(kIdxM, sys.m());
+
+  BeginWrite();
+  StoreZeros(kIdxU);
+  Store(kIdxX, sys.x().memptr());
+  Store(kIdxP, sys.P().memptr());
+  Store(kIdxY, sys.y().memptr());
+  Store(kIdxM, sys.m().memptr());
+  StoreZeros(kIdxURef);
+  StoreZeros(kIdxXRef);
+  StoreZeros(kIdxYRef);
+  EndWrite();
+}
+
+void StateMonitor::Publish(const System& sys, const Vector& u,
+                           const Vector& u_ref, const Vector& x_ref,
+                           const Vector& y_ref) {
+  CheckSize(kIdxU, u);
+  CheckSize(kIdxX, sys.x());
+  CheckSize(kIdxP, sys.P());
+  CheckSize(kIdxY, sys.y());
+  CheckSize(kIdxM, sys.m());
+  CheckSize(kIdxURef, u_ref);
+  CheckSize(kIdxXRef, x_ref);
+  CheckSize(kIdxYRef, y_ref);
+
+  BeginWrite();
+  Store(kIdxU, u.memptr());
+  Store(kIdxX, sys.x().memptr());
+  Store(kIdxP, sys.P().memptr());
+  Store(kIdxY, sys.y().memptr());
+  Store(kIdxM, sys.m().memptr());
+  Store(kIdxURef, u_ref.memptr());
+  Store(kIdxXRef, x_ref.memptr());
+  Store(kIdxYRef, y_ref.memptr());
+  EndWrite();
+}
+
+bool StateMonitor::TryRead(MonitorState& state) const {
+  size_t seq = seq_.load(std::memory_order_acquire);
+  if ((seq == 0) || (seq & 1)) {
+    return false;  // nothing published yet, or publishing
+  }
+
+  Load(kIdxU, state.u);
+  Load(kIdxX, state.x);
+  Load(kIdxP, n_x_, n_x_, state.P);
+  Load(kIdxY, state.y);
+  Load(kIdxM, state.m);
+  Load(kIdxURef, state.u_ref);
+  Load(kIdxXRef, state.x_ref);
+  Load(kIdxYRef, state.y_ref);
+
+  // n.b., orders the loads above before the check of the sequence below
+  std::atomic_thread_fence(std::memory_order_acquire);
+  if (seq_.load(std::memory_order_relaxed) != seq) {
+    return false;  // overlapped a publication
+  }
+  state.k = seq / 2 - 1;
+  return true;
+}
+
+bool StateMonitor::Read(MonitorState& state) const {
+  while (!TryRead(state)) {
+    if (seq_.load(std::memory_order_relaxed) == 0) {
+      return false;
+    }
+    std::this_thread::yield();
+  }
+  return true;
+}
+
+void StateMonitor::BeginWrite() {
+  size_t seq = seq_.load(std::memory_order_relaxed);
+  seq_.store(seq + 1, std::memory_order_relaxed);
+  // n.b., orders the odd sequence above before the stores of a publication
+  std::atomic_thread_fence(std::memory_order_release);
+}
+
+void StateMonitor::EndWrite() {
+  seq_.store(seq_.load(std::memory_order_relaxed) + 1,
+             std::memory_order_release);
+}
+
+void StateMonitor::CheckSize(size_t idx, const Matrix& mat) const {
+  if ((sizes_[idx] > 0) && (mat.n_elem != sizes_[idx])) {
+    throw std::runtime_error(
+        "size of published state does not match dimensions of StateMonitor");
+  }
+}
+
+void StateMonitor::Store(size_t idx, const data_t* mem) {
+  std::atomic<data_t>* words = words_.get() + offsets_[idx];
+  for (size_t k = 0; k < sizes_[idx]; k++) {
+    words[k].store(mem[k], std::memory_order_relaxed);
+  }
+}
+
+void StateMonitor::StoreZeros(size_t idx) {
+  std::atomic<data_t>* words = words_.get() + offsets_[idx];
+  for (size_t k = 0; k < sizes_[idx]; k++) {
+    words[k].store(0, std::memory_order_relaxed);
+  }
+}
+
+void StateMonitor::Load(size_t idx, size_t n_rows, size_t n_cols,
+                        Matrix& out) const {
+  if (sizes_[idx] == 0) {
+    return;
+  }
+  out.set_size(n_rows, n_cols);  // n.b., no-op if already this size
+  const std::atomic<data_t>* words = words_.get() + offsets_[idx];
+  data_t* mem = out.memptr();
+  for (size_t k = 0; k < sizes_[idx]; k++) {
+    mem[k] = words[k].load(std::memory_order_relaxed);
+  }
+}
+
+void StateMonitor::Load(size_t idx, Vector& out) const {
+  if (sizes_[idx] == 0) {
+    return;
+  }
+  out.set_size(sizes_[idx]);  // n.b., no-op if already this size
+  const std::atomic<data_t>* words = words_.get() + offsets_[idx];
+  data_t* mem = out.memptr();
+  for (size_t k = 0; k < sizes_[idx]; k++) {
+    mem[k] = words[k].load(std::memory_order_relaxed);
+  }
+}
+
+}  // namespace lds
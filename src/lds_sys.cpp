@@ -65,29 +65,148 @@ void lds::System::InitVars(data_t p0, data_t q0) {
   Ke_ = Matrix(n_x_, n_y_, fill::zeros);    // estimator gain.
   Ke_m_ = Matrix(n_x_, n_y_, fill::zeros);  // estimator gain for m adaptation.
 
+  // scratch for in-place (allocation-free) filtering
+  tmp_x_ = Vector(n_x_, fill::zeros);
+  tmp_u_ = Vector(n_u_, fill::zeros);
+  tmp_y_ = Vector(n_y_, fill::zeros);
+  tmp_xx_ = Matrix(n_x_, n_x_, fill::zeros);
+  tmp_xx2_ = Matrix(n_x_, n_x_, fill::zeros);
+  tmp_xy_ = Matrix(n_x_, n_y_, fill::zeros);
+  tmp_yy_ = Matrix(n_y_, n_y_, fill::zeros);
+
   do_adapt_m = false;
 }
 
 // Filter: Given measurement (`z`) and previous input (`u_tm1`), predict state
 // and update estimate of the state, covar, output using Kalman filter
 void lds::System::Filter(const Vector& u_tm1, const Vector& z_t) {
+  if (do_adapt_params_) {
+    x_tm1_ = x_;
+  }
+
   // predict mean
   f(u_tm1);  // dynamics
 
-  h();  // output
+  {
+    LDSCTRLEST_LATENCY_SCOPE(latency_, kLatencyH);
+    h();  // output
+  }
+  if (do_adapt_params_) {
+    x_pre_ = x_;
+  }
 
   // recursively calculate esimator gains (or just keep existing values)
   // (also predicts+updates estimate covariance)
-  RecurseKe();
+  // (n.b., held in between recursions; see set_recurse_Ke_period)
+  if (n_until_recurse_Ke_ == 0) {
+    LDSCTRLEST_LATENCY_SCOPE(latency_, kLatencyRecurseKe);
+    RecurseKe();
+    n_until_recurse_Ke_ = recurse_Ke_period_;
+  }
+  n_until_recurse_Ke_--;
 
   // update
-  x_ += Ke_ * (z_t - y_);
-  if (do_adapt_m) {
-    m_ += Ke_m_ * (z_t - y_);  // adaptively estimating disturbance
+  {
+    LDSCTRLEST_LATENCY_SCOPE(latency_, kLatencyFilterUpdate);
+    tmp_y_ = z_t - y_;  // innovation
+    x_ += Ke_ * tmp_y_;
+    if (do_adapt_m) {
+      m_ += Ke_m_ * tmp_y_;  // adaptively estimating disturbance
+    }
+  }
+
+  // adapt parameters
+  if (do_adapt_params_) {
+    AdaptDynamics(u_tm1);
+    AdaptOutput(z_t);
   }
 
   // With new state, estimate output.
-  h();  // --> posterior
+  {
+    LDSCTRLEST_LATENCY_SCOPE(latency_, kLatencyH);
+    h();  // --> posterior
+  }
+}
+
+void lds::System::set_recurse_Ke_period(size_t n) {
+  if (n == 0) {
+    throw std::runtime_error(
+        "period of covariance/gain recursion must be at least one step");
+  }
+  recurse_Ke_period_ = n;
+  n_until_recurse_Ke_ = 0;  // recurse on next step
+}
+
+void lds::System::set_adapt_params(data_t forgetting, data_t p0) {
+  if (!((forgetting > 0) && (forgetting <= 1))) {
+    throw std::runtime_error(
+        "forgetting factor of parameter adaptation must be in (0, 1]");
+  }
+  if (!(p0 > 0)) {
+    throw std::runtime_error(
+        "initial covariance of parameter estimate (p0) must be positive");
+  }
+  forgetting_ = forgetting;
+  adapt_p0_ = p0;
+
+  P_theta_x_ = p0 * Matrix(n_x_ + n_u_, n_x_ + n_u_, fill::eye);
+  x_tm1_ = Vector(n_x_, fill::zeros);
+  x_pre_ = Vector(n_x_, fill::zeros);
+  phi_x_ = Vector(n_x_ + n_u_, fill::zeros);
+  k_x_ = Vector(n_x_ + n_u_, fill::zeros);
+  phi_y_ = Vector(n_x_ + 1, fill::zeros);
+  phi_y_[n_x_] = 1;  // regressor for output bias
+  k_y_ = Vector(n_x_ + 1, fill::zeros);
+  InitAdaptOutput(p0);
+
+  do_adapt_params_ = true;
+}
+
+void lds::System::RLSUpdate(Matrix& p, const Vector& phi, data_t weight,
+                            Vector& k) const {
+  // k = P*phi / (lambda + w*phi'*P*phi)
+  // P = (P - w*k*phi'*P) / lambda
+  // n.b., P is symmetric, so phi'*P = k' before scaling
+  k = p * phi;
+  data_t denom = forgetting_ + weight * arma::dot(phi, k);
+  data_t scale = weight / denom;
+  for (size_t j = 0; j < p.n_cols; j++) {
+    p.col(j) -= (scale * k[j]) * k;
+  }
+  p /= forgetting_;
+  k /= denom;
+}
+
+void lds::System::AdaptDynamics(const Vector& u_tm1) {
+  phi_x_.head(n_x_) = x_tm1_;
+  phi_x_.tail(n_u_) = g_ % u_tm1;
+  RLSUpdate(P_theta_x_, phi_x_, 1, k_x_);
+
+  // n.b., prediction (x_pre) was made with current [A, B], so the regression
+  // error is that of the posterior estimate relative to it.
+  tmp_x_ = x_ - x_pre_;
+  for (size_t j = 0; j < n_x_; j++) {
+    A_.col(j) += k_x_[j] * tmp_x_;
+  }
+  for (size_t j = 0; j < n_u_; j++) {
+    B_.col(j) += k_x_[n_x_ + j] * tmp_x_;
+  }
+  revision_++;
+}
+
+void lds::System::set_params(const System& sys) {
+  set_A(sys.A_);
+  set_B(sys.B_);
+  set_g(sys.g_);
+  set_m(sys.m0_);
+  set_Q(sys.Q_);
+  set_Q_m(sys.Q_m_);
+  set_C(sys.C_);
+  set_d(sys.d_);
+  set_x0(sys.x0_);
+  set_P0(sys.P0_);
+  set_P0_m(sys.P0_m_);
+  h();
 }
 
 void lds::System::Reset() {
@@ -96,6 +215,107 @@ void lds::System::Reset() {
   P_ = P0_;      // cov of state estimate
   m_ = m0_;      // process disturbance
   P_m_ = P0_m_;  // cov of disturbance estimate
+  n_until_recurse_Ke_ = 0;
+  h();
+}
+
+void lds::System::SaveSnapshot(Snapshot& snap,
+                               const std::string& prefix) const {
+  snap.Set(prefix + "n_u", n_u_);
+  snap.Set(prefix + "n_x", n_x_);
+  snap.Set(prefix + "n_y", n_y_);
+  snap.Set(prefix + "dt", dt_);
+
+  // signals
+  snap.Set(prefix + "x", x_);
+  snap.Set(prefix + "P", P_);
+  snap.Set(prefix + "m", m_);
+  snap.Set(prefix + "P_m", P_m_);
+  snap.Set(prefix + "z", z_);
+
+  // parameters
+  snap.Set(prefix + "x0", x0_);
+  snap.Set(prefix + "P0", P0_);
+  snap.Set(prefix + "m0", m0_);
+  snap.Set(prefix + "P0_m", P0_m_);
+  snap.Set(prefix + "A", A_);
+  snap.Set(prefix + "B", B_);
+  snap.Set(prefix + "g", g_);
+  snap.Set(prefix + "Q", Q_);
+  snap.Set(prefix + "Q_m", Q_m_);
+  snap.Set(prefix + "C", C_);
+  snap.Set(prefix + "d", d_);
+
+  // estimator
+  snap.Set(prefix + "Ke", Ke_);
+  snap.Set(prefix + "Ke_m", Ke_m_);
+  snap.Set(prefix + "do_adapt_m", do_adapt_m);
+  snap.Set(prefix + "cov_update", cov_update_);
+  snap.Set(prefix + "recurse_Ke_period", recurse_Ke_period_);
+  snap.Set(prefix + "n_until_recurse_Ke", n_until_recurse_Ke_);
+
+  // online parameter adaptation
+  snap.Set(prefix + "do_adapt_params", do_adapt_params_);
+  if (do_adapt_params_) {
+    snap.Set(prefix + "forgetting", forgetting_);
+    snap.Set(prefix + "adapt_p0", adapt_p0_);
+    snap.Set(prefix + "P_theta_x", P_theta_x_);
+  }
+}
+
+void lds::System::LoadSnapshot(const Snapshot& snap,
+                               const std::string& prefix) {
+  if ((snap.GetScalar(prefix + "n_u") != n_u_) ||
+      (snap.GetScalar(prefix + "n_x") != n_x_) ||
+      (snap.GetScalar(prefix + "n_y") != n_y_)) {
+    throw std::runtime_error(
+        "dimensions of snapshot do not match those of system");
+  }
+  dt_ = snap.GetScalar(prefix + "dt");
+
+  snap.Get(prefix + "x", x_);
+  snap.Get(prefix + "P", P_);
+  snap.Get(prefix + "m", m_);
+  snap.Get(prefix + "P_m", P_m_);
+  snap.Get(prefix + "z", z_);
+
+  snap.Get(prefix + "x0", x0_);
+  snap.Get(prefix + "P0", P0_);
+  snap.Get(prefix + "m0", m0_);
+  snap.Get(prefix + "P0_m", P0_m_);
+  snap.Get(prefix + "A", A_);
+  snap.Get(prefix + "B", B_);
+  snap.Get(prefix + "g", g_);
+  snap.Get(prefix + "Q", Q_);
+  snap.Get(prefix + "Q_m", Q_m_);
+  snap.Get(prefix + "C", C_);
+  snap.Get(prefix + "d", d_);
+  revision_++;
+
+  snap.Get(prefix + "Ke", Ke_);
+  snap.Get(prefix + "Ke_m", Ke_m_);
+  do_adapt_m = snap.GetScalar(prefix + "do_adapt_m") != 0;
+  cov_update_ =
+      static_cast<CovUpdateType>(snap.GetScalar(prefix + "cov_update"));
+  recurse_Ke_period_ =
+      static_cast<size_t>(snap.GetScalar(prefix + "recurse_Ke_period"));
+  n_until_recurse_Ke_ =
+      static_cast<size_t>(snap.GetScalar(prefix + "n_until_recurse_Ke"));
+
+  if (snap.GetScalar(prefix + "do_adapt_params") != 0) {
+    // n.b., allocates adaptation variables (with the saved initial
+    // covariance) before restoring them; snapshots from before it was saved
+    // were of the default
+    data_t p0 = snap.Has(prefix + "adapt_p0")
+                    ? snap.GetScalar(prefix + "adapt_p0")
+                    : data_t(1);
+    set_adapt_params(snap.GetScalar(prefix + "forgetting"), p0);
+    snap.Get(prefix + "P_theta_x", P_theta_x_);
+  } else {
+    do_adapt_params_ = false;
+  }
+
+  // n.b., output (y) is not saved, but is a function of the state
   h();
 }
 
@@ -0,0 +1,126 @@
+//===-- lds_thread_pool.cpp - Thread Pool ---------------------------------===//
+//
+// Copyright 2021 Michael Bolus
+// Copyright 2021 Georgia Institute of Technology
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file implements a minimal pool of persistent worker threads
+/// (`lds::ThreadPool`).
+///
+/// \brief thread pool
+//===----------------------------------------------------------------------===//
+
+#include <ldsCtrlEst_h/lds_blas.h>
+#include <ldsCtrlEst_h/lds_thread_pool.h>
+
+namespace lds {
+
+ThreadPool::ThreadPool(std::size_t n_threads) {
+  if (n_threads == 0) {
+    n_threads = std::thread::hardware_concurrency();
+  }
+  // n.b., calling thread does its share of the work.
+  for (std::size_t id = 1; id < n_threads; id++) {
+    workers_.emplace_back(&ThreadPool::Work, this, id);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    do_stop_ = true;
+  }
+  cv_job_.notify_all();
+  for (auto& worker : workers_) {
+    worker.join();
+  }
+}
+
+void ThreadPool::ParallelFor(
+    std::size_t n, const std::function<void(std::size_t, std::size_t)>& fn) {
+  if (workers_.empty() || n < 2) {
+    fn(0, n);
+    return;
+  }
+  // n.b., BLAS must not multithread underneath the workers (see lds_blas.h)
+  BlasThreadScope blas(kBlasWorkParallel);
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    fn_ = &fn;
+    n_ = n;
+    error_ = nullptr;
+    n_remaining_ = workers_.size();
+    generation_++;
+  }
+  cv_job_.notify_all();
+
+  RunChunk(0);
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  cv_done_.wait(lock, [this] { return n_remaining_ == 0; });
+  fn_ = nullptr;
+  if (error_) {
+    std::exception_ptr error = error_;
+    error_ = nullptr;
+    std::rethrow_exception(error);
+  }
+}
+
+void ThreadPool::RunChunk(std::size_t id) {
+  std::size_t n_chunks = n_threads();
+  std::size_t k_begin = n_ * id / n_chunks;
+  std::size_t k_end = n_ * (id + 1) / n_chunks;
+  if (k_begin == k_end) {
+    return;
+  }
+
+  try {
+    BlasThreadScope blas(kBlasWorkParallel);
+    (*fn_)(k_begin, k_end);
+  } catch (...) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!error_) {
+      error_ = std::current_exception();
+    }
+  }
+}
+
+void ThreadPool::Work(std::size_t id) {
+  std::size_t generation = 0;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cv_job_.wait(lock,
+                   [&] { return do_stop_ || (generation_ != generation); });
+      if (do_stop_) {
+        return;
+      }
+      generation = generation_;
+    }
+
+    RunChunk(id);
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      n_remaining_--;
+    }
+    cv_done_.notify_one();
+  }
+}
+
+}  // namespace lds